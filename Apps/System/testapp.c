@@ -96,6 +96,132 @@ app_test _tests[] = {
         .test_init = &vibes_test_init,
         .test_execute = &vibes_test_exec,
         .test_deinit = &vibes_test_deinit
+    },
+    {
+        .test_name = "Layer Stress",
+        .test_desc = "200 Layer Walk",
+        .test_init = &layer_stress_test_init,
+        .test_execute = &layer_stress_test_exec,
+        .test_deinit = &layer_stress_test_deinit
+    },
+    {
+        .test_name = "Layer Cache",
+        .test_desc = "Cached Dial Layer",
+        .test_init = &layer_cache_test_init,
+        .test_execute = &layer_cache_test_exec,
+        .test_deinit = &layer_cache_test_deinit
+    },
+    {
+        .test_name = "Menu Virtual",
+        .test_desc = "10k Row Menu",
+        .test_init = &menu_virtual_test_init,
+        .test_execute = &menu_virtual_test_exec,
+        .test_deinit = &menu_virtual_test_deinit
+    },
+    {
+        .test_name = "Scroll Shift",
+        .test_desc = "Framebuffer Scrolling",
+        .test_init = &scroll_shift_test_init,
+        .test_execute = &scroll_shift_test_exec,
+        .test_deinit = &scroll_shift_test_deinit
+    },
+    {
+        .test_name = "Window Slide",
+        .test_desc = "Push Transitions",
+        .test_init = &window_slide_test_init,
+        .test_execute = &window_slide_test_exec,
+        .test_deinit = &window_slide_test_deinit
+    },
+    {
+        .test_name = "Text Layout",
+        .test_desc = "Cached Line Breaks",
+        .test_init = &text_layout_test_init,
+        .test_execute = &text_layout_test_exec,
+        .test_deinit = &text_layout_test_deinit
+    },
+    {
+        .test_name = "Overlay Cache",
+        .test_desc = "Cached Overlay Composition",
+        .test_init = &overlay_cache_test_init,
+        .test_execute = &overlay_cache_test_exec,
+        .test_deinit = &overlay_cache_test_deinit
+    },
+    {
+        .test_name = "Animation Clock",
+        .test_desc = "20 Animations, One Timer",
+        .test_init = &animation_clock_test_init,
+        .test_execute = &animation_clock_test_exec,
+        .test_deinit = &animation_clock_test_deinit
+    },
+    {
+        .test_name = "Animation Curves",
+        .test_desc = "Precomputed Easing",
+        .test_init = &animation_curve_test_init,
+        .test_execute = &animation_curve_test_exec,
+        .test_deinit = &animation_curve_test_deinit
+    },
+    {
+        .test_name = "Timer Heap",
+        .test_desc = "Hundreds of Timers",
+        .test_init = &timer_heap_test_init,
+        .test_execute = &timer_heap_test_exec,
+        .test_deinit = &timer_heap_test_deinit
+    },
+    {
+        .test_name = "Timer Coalesce",
+        .test_desc = "Wakeups With Slack",
+        .test_init = &timer_coalesce_test_init,
+        .test_execute = &timer_coalesce_test_exec,
+        .test_deinit = &timer_coalesce_test_deinit
+    },
+    {
+        .test_name = "Tickless Idle",
+        .test_desc = "Sleep Through Ticks",
+        .test_init = &tickless_test_init,
+        .test_execute = &tickless_test_exec,
+        .test_deinit = &tickless_test_deinit
+    },
+    {
+        .test_name = "Tick Service",
+        .test_desc = "App and Overlay Ticks",
+        .test_init = &tick_service_test_init,
+        .test_execute = &tick_service_test_exec,
+        .test_deinit = &tick_service_test_deinit
+    },
+    {
+        .test_name = "Time Cache",
+        .test_desc = "Cached localtime vs musl",
+        .test_init = &time_cache_test_init,
+        .test_execute = &time_cache_test_exec,
+        .test_deinit = &time_cache_test_deinit
+    },
+    {
+        .test_name = "Worker",
+        .test_desc = "Worker messages and UI under load",
+        .test_init = &worker_test_init,
+        .test_execute = &worker_test_exec,
+        .test_deinit = &worker_test_deinit
+    },
+    {
+        .test_name = "Partition",
+        .test_desc = "App and worker memory sharing",
+        .test_init = &partition_test_init,
+        .test_execute = &partition_test_exec,
+        .test_deinit = &partition_test_deinit
+    },
+    {
+        .test_name = "Pools",
+        .test_desc = "Object pools against the arena",
+        .test_init = &pool_test_init,
+        .test_execute = &pool_test_exec,
+        .test_deinit = &pool_test_deinit
+    },
+    {
+        .test_name = "Heap Stats",
+        .test_desc = "Heap high-water marks and trace",
+        .test_init = &heap_stats_test_init,
+        .test_execute = &heap_stats_test_exec,
+        .test_deinit = &heap_stats_test_deinit
     }
 };
 
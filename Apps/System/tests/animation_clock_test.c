@@ -0,0 +1,136 @@
+/* animation_clock_test.c
+ * Routines for timing lots of animations running at once
+ * RebbleOS
+ */
+
+#include "rebbleos.h"
+#include "systemapp.h"
+#include "test_defs.h"
+#include "property_animation.h"
+#include "utils.h"
+
+#define CLOCK_ANIMATIONS     20
+#define CLOCK_DURATION_MS    500
+#define CLOCK_BLOCK          8
+
+static Window *_main_window;
+static Layer *_blocks[CLOCK_ANIMATIONS];
+static GRect _from[CLOCK_ANIMATIONS];
+static GRect _to[CLOCK_ANIMATIONS];
+static Layer *_probe_layer;
+
+static uint8_t _running;
+static uint16_t _frames;
+static uint16_t _max_timers;
+static TickType_t _started;
+static TickType_t _draw_ticks;
+
+/* how many timers the app thread is juggling right now */
+static uint16_t _timer_count(void)
+{
+    return appmanager_get_current_thread()->timers.count;
+}
+
+static void _block_update_proc(Layer *layer, GContext *ctx)
+{
+    graphics_context_set_fill_color(ctx, GColorRed);
+    graphics_fill_rect(ctx, layer_get_bounds(layer), 0, GCornerNone);
+}
+
+/* painted last, so it sees every frame that makes it to the screen */
+static void _probe_update_proc(Layer *layer, GContext *ctx)
+{
+    static TickType_t last;
+    TickType_t now = xTaskGetTickCount();
+
+    if (!_running)
+        return;
+
+    _frames++;
+    if (_frames > 1)
+        _draw_ticks += now - last;
+    last = now;
+    _max_timers = MAX(_max_timers, _timer_count());
+}
+
+static void _stopped(Animation *animation, bool finished, void *context)
+{
+    if (--_running)
+        return;
+
+    TickType_t elapsed = xTaskGetTickCount() - _started;
+    APP_LOG("clktst", APP_LOG_LEVEL_ERROR, "%d animations over %d ms: %d frames drawn, %d ms between, at most %d timers queued",
+            CLOCK_ANIMATIONS, elapsed * portTICK_PERIOD_MS, _frames,
+            (_draw_ticks * portTICK_PERIOD_MS) / MAX(1, _frames - 1), _max_timers);
+
+    /* they all share the one clock rather than a timer each */
+    test_assert(_max_timers < CLOCK_ANIMATIONS);
+    /* and are drawn together, not once each */
+    test_assert(_frames <= (elapsed * portTICK_PERIOD_MS * 2) / (1000 / 60) + 2);
+    test_complete(test_get_success());
+}
+
+bool animation_clock_test_init(Window *window)
+{
+    APP_LOG("clktst", APP_LOG_LEVEL_ERROR, "Init: Animation Clock Test");
+    _main_window = window;
+    Layer *window_layer = window_get_root_layer(window);
+    GRect bounds = layer_get_bounds(window_layer);
+
+    for (int i = 0; i < CLOCK_ANIMATIONS; i++)
+    {
+        int16_t y = (i * (bounds.size.h - CLOCK_BLOCK)) / CLOCK_ANIMATIONS;
+        _from[i] = GRect(0, y, CLOCK_BLOCK, CLOCK_BLOCK);
+        _to[i] = GRect(bounds.size.w - CLOCK_BLOCK, y, CLOCK_BLOCK, CLOCK_BLOCK);
+        _blocks[i] = layer_create(_from[i]);
+        layer_set_update_proc(_blocks[i], _block_update_proc);
+        layer_add_child(window_layer, _blocks[i]);
+    }
+
+    _probe_layer = layer_create(GRect(0, 0, 1, 1));
+    layer_set_update_proc(_probe_layer, _probe_update_proc);
+    layer_add_child(window_layer, _probe_layer);
+
+    return true;
+}
+
+bool animation_clock_test_exec(void)
+{
+    APP_LOG("clktst", APP_LOG_LEVEL_ERROR, "Exec: Animation Clock Test");
+
+    _running = CLOCK_ANIMATIONS;
+    _frames = 0;
+    _max_timers = 0;
+    _draw_ticks = 0;
+    _started = xTaskGetTickCount();
+
+    for (int i = 0; i < CLOCK_ANIMATIONS; i++)
+    {
+        /* they tear themselves down when done */
+        PropertyAnimation *prop = property_animation_create_layer_frame(_blocks[i], &_from[i], &_to[i]);
+        Animation *anim = property_animation_get_animation(prop);
+        animation_set_duration(anim, CLOCK_DURATION_MS);
+        animation_set_curve(anim, AnimationCurveLinear);
+        animation_set_handlers(anim, (AnimationHandlers) {
+            .stopped = _stopped,
+        }, NULL);
+        animation_schedule(anim);
+    }
+
+    return true;
+}
+
+bool animation_clock_test_deinit(void)
+{
+    APP_LOG("clktst", APP_LOG_LEVEL_ERROR, "De-Init: Animation Clock Test");
+    for (int i = 0; i < CLOCK_ANIMATIONS; i++)
+    {
+        layer_remove_from_parent(_blocks[i]);
+        layer_destroy(_blocks[i]);
+        _blocks[i] = NULL;
+    }
+    layer_remove_from_parent(_probe_layer);
+    layer_destroy(_probe_layer);
+    _probe_layer = NULL;
+    return true;
+}
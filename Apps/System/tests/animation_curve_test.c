@@ -0,0 +1,223 @@
+/* animation_curve_test.c
+ * Routines for testing and timing the precomputed easing curves
+ * RebbleOS
+ */
+
+#include "rebbleos.h"
+#include "systemapp.h"
+#include "test_defs.h"
+#include "property_animation.h"
+#include "utils.h"
+
+#define CURVE_EVALUATIONS    20000
+/* how far the tables may stray from the sums they replaced */
+#define CURVE_TOLERANCE      8
+
+typedef struct curve_case {
+    const char *name;
+    AnimationCurve curve;
+} curve_case;
+
+static const curve_case _cases[] = {
+    { "linear", AnimationCurveLinear },
+    { "ease in", AnimationCurveEaseIn },
+    { "ease out", AnimationCurveEaseOut },
+    { "ease in out", AnimationCurveEaseInOut },
+    { "cubic ease", AnimationCurveCubicEase },
+    { "cubic ease in", AnimationCurveCubicEaseIn },
+    { "cubic ease out", AnimationCurveCubicEaseOut },
+    { "cubic ease in out", AnimationCurveCubicEaseInOut },
+    { "overshoot", AnimationCurveOvershoot },
+    { "spring", AnimationCurveSpring },
+};
+
+#define CURVE_CASES (sizeof(_cases) / sizeof(curve_case))
+
+/* How the stock curves used to be worked out, on every step */
+static int32_t _arith_curve(AnimationCurve curve, uint32_t progress)
+{
+    switch(curve) {
+        case AnimationCurveEaseIn:
+            return (progress * progress) / ANIMATION_NORMALIZED_MAX;
+        case AnimationCurveEaseOut:
+            progress -= ANIMATION_NORMALIZED_MAX;
+            return -(progress * progress / ANIMATION_NORMALIZED_MAX) + ANIMATION_NORMALIZED_MAX;
+        case AnimationCurveEaseInOut:
+            if (progress < ANIMATION_NORMALIZED_MAX / 2)
+                return (progress * progress) / (ANIMATION_NORMALIZED_MAX / 2);
+            progress -= ANIMATION_NORMALIZED_MAX;
+            return -((progress * progress) / (ANIMATION_NORMALIZED_MAX / 2)) + ANIMATION_NORMALIZED_MAX;
+        default:
+            return progress;
+    }
+}
+
+static uint32_t _cycles(TickType_t ticks)
+{
+    return (ticks * (configCPU_CLOCK_HZ / configTICK_RATE_HZ)) / CURVE_EVALUATIONS;
+}
+
+/* The tables still trace the same quadratics as before */
+static bool _accuracy(void)
+{
+    static const AnimationCurve quads[] = { AnimationCurveEaseIn, AnimationCurveEaseOut, AnimationCurveEaseInOut };
+
+    for (int c = 0; c < 3; c++)
+    {
+        int32_t worst = 0;
+        for (int32_t p = 0; p <= ANIMATION_NORMALIZED_MAX; p += 7)
+        {
+            int32_t diff = animation_curve_evaluate(quads[c], p) - _arith_curve(quads[c], p);
+            worst = MAX(worst, diff < 0 ? -diff : diff);
+        }
+        APP_LOG("crvtst", APP_LOG_LEVEL_ERROR, "%s: worst error %d", _cases[quads[c]].name, worst);
+        test_assert(worst <= CURVE_TOLERANCE);
+    }
+
+    for (int c = 0; c < CURVE_CASES; c++)
+    {
+        /* every curve starts and ends in the right place */
+        test_assert(animation_curve_evaluate(_cases[c].curve, 0) == 0);
+        test_assert(animation_curve_evaluate(_cases[c].curve, ANIMATION_NORMALIZED_MAX) == ANIMATION_NORMALIZED_MAX);
+    }
+
+    /* and the bouncy ones really do go past the end */
+    test_assert(animation_curve_evaluate(AnimationCurveOvershoot, ANIMATION_NORMALIZED_MAX * 3 / 4) > ANIMATION_NORMALIZED_MAX);
+    test_assert(animation_curve_evaluate(AnimationCurveSpring, ANIMATION_NORMALIZED_MAX / 4) > ANIMATION_NORMALIZED_MAX);
+
+    return true;
+}
+
+static void _benchmark(void)
+{
+    volatile int32_t sink = 0;
+
+    for (int c = 0; c < CURVE_CASES; c++)
+    {
+        TickType_t start = xTaskGetTickCount();
+        for (int32_t i = 0; i < CURVE_EVALUATIONS; i++)
+            sink += animation_curve_evaluate(_cases[c].curve, (i * 3) & ANIMATION_NORMALIZED_MAX);
+        TickType_t table = xTaskGetTickCount() - start;
+
+        start = xTaskGetTickCount();
+        for (int32_t i = 0; i < CURVE_EVALUATIONS; i++)
+            sink += _arith_curve(_cases[c].curve, (i * 3) & ANIMATION_NORMALIZED_MAX);
+        TickType_t arith = xTaskGetTickCount() - start;
+
+        APP_LOG("crvtst", APP_LOG_LEVEL_ERROR, "%s: table %d cycles, arithmetic %d cycles",
+                _cases[c].name, _cycles(table), _cycles(arith));
+    }
+}
+
+/* snaps to whole tens, so it's easy to spot it was us */
+static int64_t _interpolate_tens(int32_t normalized, int64_t from, int64_t to)
+{
+    int64_t v = from + ((to - from) * normalized) / ANIMATION_NORMALIZED_MAX;
+    return v - (v % 10);
+}
+
+static int16_t _value;
+static int16_t _from = 0;
+static int16_t _to = 100;
+
+static void _set_value(void *subject, int16_t value)
+{
+    _value = value;
+}
+
+static int16_t _get_value(void *subject)
+{
+    return _value;
+}
+
+static bool _custom_interpolation(void)
+{
+    static const PropertyAnimationImplementation impl = {
+        .base = {
+            .update = (AnimationUpdateImplementation) property_animation_update_int16,
+        },
+        .accessors = {
+            .setter = { .int16 = _set_value },
+            .getter = { .int16 = _get_value },
+        },
+    };
+
+    PropertyAnimation *prop = property_animation_create(&impl, NULL, &_from, &_to);
+    Animation *anim = property_animation_get_animation(prop);
+
+    test_assert(animation_set_custom_interpolation(anim, _interpolate_tens));
+    test_assert(animation_get_curve(anim) == AnimationCurveCustomInterpolationFunction);
+
+    property_animation_update_int16(prop, ANIMATION_NORMALIZED_MAX / 3);
+    test_assert(_value == 30);
+
+    property_animation_destroy(prop);
+    return true;
+}
+
+static uint32_t _big_value;
+static uint32_t _big_from = 0;
+static uint32_t _big_to = 4000000000u;
+
+static void _set_big_value(void *subject, uint32_t value)
+{
+    _big_value = value;
+}
+
+static uint32_t _get_big_value(void *subject)
+{
+    return _big_value;
+}
+
+/* Far more than 32767 apart, and past the top of an int32, on the way up
+ * and past the end on an overshoot */
+static bool _wide_range(void)
+{
+    static const PropertyAnimationImplementation impl = {
+        .base = {
+            .update = (AnimationUpdateImplementation) property_animation_update_uint32,
+        },
+        .accessors = {
+            .setter = { .uint32 = _set_big_value },
+            .getter = { .uint32 = _get_big_value },
+        },
+    };
+
+    PropertyAnimation *prop = property_animation_create(&impl, NULL, &_big_from, &_big_to);
+
+    property_animation_update_uint32(prop, ANIMATION_NORMALIZED_MAX / 2);
+    test_assert(_big_value > 1999000000u && _big_value < 2001000000u);
+    property_animation_update_uint32(prop, ANIMATION_NORMALIZED_MAX);
+    test_assert(_big_value == _big_to);
+
+    property_animation_destroy(prop);
+
+    test_assert(ANIM_LERP(-100000, 100000, ANIMATION_NORMALIZED_MAX) == 100000);
+    test_assert(ANIM_LERP(0, 100000, ANIMATION_NORMALIZED_MAX + ANIMATION_NORMALIZED_MAX / 5) > 100000);
+    return true;
+}
+
+bool animation_curve_test_init(Window *window)
+{
+    APP_LOG("crvtst", APP_LOG_LEVEL_ERROR, "Init: Animation Curve Test");
+    return true;
+}
+
+bool animation_curve_test_exec(void)
+{
+    APP_LOG("crvtst", APP_LOG_LEVEL_ERROR, "Exec: Animation Curve Test");
+
+    test_assert(_accuracy());
+    test_assert(_custom_interpolation());
+    test_assert(_wide_range());
+    _benchmark();
+
+    test_complete(test_get_success());
+    return true;
+}
+
+bool animation_curve_test_deinit(void)
+{
+    APP_LOG("crvtst", APP_LOG_LEVEL_ERROR, "De-Init: Animation Curve Test");
+    return true;
+}
@@ -8,3 +8,21 @@ SRCS_all += Apps/System/tests/menu_simple_test.c
 SRCS_all += Apps/System/tests/menu_multi_column_test.c
 SRCS_all += Apps/System/tests/action_menu_test.c
 SRCS_all += Apps/System/tests/vibes_test.c
+SRCS_all += Apps/System/tests/layer_stress_test.c
+SRCS_all += Apps/System/tests/layer_cache_test.c
+SRCS_all += Apps/System/tests/menu_virtual_test.c
+SRCS_all += Apps/System/tests/scroll_shift_test.c
+SRCS_all += Apps/System/tests/window_slide_test.c
+SRCS_all += Apps/System/tests/text_layout_test.c
+SRCS_all += Apps/System/tests/overlay_cache_test.c
+SRCS_all += Apps/System/tests/animation_clock_test.c
+SRCS_all += Apps/System/tests/animation_curve_test.c
+SRCS_all += Apps/System/tests/timer_heap_test.c
+SRCS_all += Apps/System/tests/timer_coalesce_test.c
+SRCS_all += Apps/System/tests/tickless_test.c
+SRCS_all += Apps/System/tests/tick_service_test.c
+SRCS_all += Apps/System/tests/time_cache_test.c
+SRCS_all += Apps/System/tests/worker_test.c
+SRCS_all += Apps/System/tests/partition_test.c
+SRCS_all += Apps/System/tests/pool_test.c
+SRCS_all += Apps/System/tests/heap_stats_test.c
@@ -0,0 +1,98 @@
+/* heap_stats_test.c
+ * Routines for testing the heap stats and checks, and the memory trace if it's built in
+ * RebbleOS
+ */
+
+#include "rebbleos.h"
+#include "systemapp.h"
+#include "test_defs.h"
+
+static const char *_heap_names[MemoryHeapMax] = {
+    "system", "app", "worker", "overlay", "messages"
+};
+
+/* Whatever heap it is, what it says has to add up */
+static void _check_stats(MemoryHeap heap)
+{
+    MemoryHeapStats stats;
+
+    if (!memory_heap_get_stats(heap, &stats))
+        return;
+
+    APP_LOG("heaptst", APP_LOG_LEVEL_ERROR, "%s: %d of %d used, peak %d, largest free %d",
+            _heap_names[heap], stats.used, stats.size, stats.peak, stats.largest);
+    test_assert(stats.used <= stats.size);
+    test_assert(stats.peak >= stats.used);
+    test_assert(stats.peak <= stats.size);
+    test_assert(stats.largest <= stats.size - stats.used);
+}
+
+bool heap_stats_test_init(Window *window)
+{
+    APP_LOG("heaptst", APP_LOG_LEVEL_ERROR, "Init: Heap Stats Test");
+    return true;
+}
+
+bool heap_stats_test_exec(void)
+{
+    APP_LOG("heaptst", APP_LOG_LEVEL_ERROR, "Exec: Heap Stats Test");
+    MemoryHeapStats before, during, after;
+
+    for (MemoryHeap heap = 0; heap < MemoryHeapMax; heap++)
+        _check_stats(heap);
+
+    /* the app heap is always there while we are */
+    test_assert(memory_heap_get_stats(MemoryHeapApp, &before));
+
+    /* going up takes the peak with it, coming down leaves it */
+    size_t size = before.peak - before.used + 1024;
+    if (size > before.largest)
+        size = before.largest / 2;
+
+    void *mem = app_malloc(size);
+    test_assert(mem != NULL);
+    memory_heap_get_stats(MemoryHeapApp, &during);
+    test_assert(during.used >= before.used + size);
+    test_assert(during.peak >= during.used);
+    test_assert(during.largest < before.largest);
+
+#ifdef MEMORY_TRACE
+    /* and it was us that did it */
+    MemoryTraceEvent event;
+    test_assert(memory_trace_get_event(0, &event));
+    test_assert(event.op == MemoryTraceAlloc);
+    test_assert(event.heap == MemoryHeapApp);
+    test_assert(event.ptr == mem);
+    test_assert(event.size == size);
+#endif
+
+    app_free(mem);
+    memory_heap_get_stats(MemoryHeapApp, &after);
+    test_assert(after.used == before.used);
+    test_assert(after.peak == during.peak);
+
+#ifdef MEMORY_TRACE
+    test_assert(memory_trace_get_event(0, &event));
+    test_assert(event.op == MemoryTraceFree);
+    test_assert(event.ptr == mem);
+    memory_trace_dump();
+#else
+    memory_heap_log_stats();
+#endif
+
+    /* what the idle task checks a bit at a time, all at once. It panics if
+     * anything's wrong */
+    TickType_t start = xTaskGetTickCount();
+    qcheck_arena(appmanager_get_current_thread()->arena);
+    APP_LOG("heaptst", APP_LOG_LEVEL_INFO, "whole app heap checked in %d ms",
+            (xTaskGetTickCount() - start) * portTICK_PERIOD_MS);
+
+    test_complete(test_get_success());
+    return true;
+}
+
+bool heap_stats_test_deinit(void)
+{
+    APP_LOG("heaptst", APP_LOG_LEVEL_ERROR, "De-Init: Heap Stats Test");
+    return true;
+}
@@ -0,0 +1,137 @@
+/* layer_cache_test.c
+ * Routines for testing and timing cached layers
+ * RebbleOS
+ */
+
+#include "rebbleos.h"
+#include "systemapp.h"
+#include "test_defs.h"
+
+#define CACHE_DRAW_PASSES 20
+
+static Window *_main_window;
+static Layer *_dial_layer;
+static Layer *_hands_layer;
+static uint8_t _minute;
+
+/* A nivz style dial. Lots of static work on every frame */
+static void _dial_update_proc(Layer *layer, GContext *ctx)
+{
+    GRect bounds = layer_get_bounds(layer);
+    GPoint center = GPoint(bounds.size.w / 2, bounds.size.h / 2);
+    int16_t radius = (bounds.size.w < bounds.size.h ? bounds.size.w : bounds.size.h) / 2 - 2;
+
+    graphics_context_set_fill_color(ctx, GColorBlack);
+    graphics_fill_rect(ctx, GRect(0, 0, bounds.size.w, bounds.size.h), 0, GCornerNone);
+    graphics_context_set_fill_color(ctx, GColorOxfordBlue);
+    graphics_fill_circle(ctx, center, radius);
+
+    graphics_context_set_stroke_color(ctx, GColorWhite);
+    for (int i = 0; i < 60; i++)
+    {
+        int32_t angle = TRIG_MAX_ANGLE * i / 60;
+        int16_t inner = (i % 5) ? radius - 4 : radius - 10;
+        GPoint from = GPoint(center.x + sin_lookup(angle) * inner / TRIG_MAX_RATIO,
+                             center.y - cos_lookup(angle) * inner / TRIG_MAX_RATIO);
+        GPoint to = GPoint(center.x + sin_lookup(angle) * radius / TRIG_MAX_RATIO,
+                           center.y - cos_lookup(angle) * radius / TRIG_MAX_RATIO);
+        graphics_draw_line(ctx, from, to);
+    }
+}
+
+static void _hands_update_proc(Layer *layer, GContext *ctx)
+{
+    GRect bounds = layer_get_bounds(layer);
+    GPoint center = GPoint(bounds.size.w / 2, bounds.size.h / 2);
+    int32_t angle = TRIG_MAX_ANGLE * _minute / 60;
+    int16_t length = bounds.size.w / 2 - 16;
+
+    graphics_context_set_stroke_color(ctx, GColorRed);
+    graphics_draw_line(ctx, center,
+                       GPoint(center.x + sin_lookup(angle) * length / TRIG_MAX_RATIO,
+                              center.y - cos_lookup(angle) * length / TRIG_MAX_RATIO));
+}
+
+static TickType_t _time_draws(void)
+{
+    TickType_t start = xTaskGetTickCount();
+    for (int i = 0; i < CACHE_DRAW_PASSES; i++)
+    {
+        _minute = i;
+        layer_mark_dirty(_hands_layer);
+        rbl_window_draw(_main_window);
+    }
+    return xTaskGetTickCount() - start;
+}
+
+bool layer_cache_test_init(Window *window)
+{
+    APP_LOG("lyrcch", APP_LOG_LEVEL_ERROR, "Init: Layer Cache Test");
+    _main_window = window;
+
+    Layer *window_layer = window_get_root_layer(window);
+    GRect bounds = layer_get_unobstructed_bounds(window_layer);
+
+    _dial_layer = layer_create(bounds);
+    layer_set_update_proc(_dial_layer, _dial_update_proc);
+    layer_add_child(window_layer, _dial_layer);
+
+    _hands_layer = layer_create(bounds);
+    layer_set_update_proc(_hands_layer, _hands_update_proc);
+    layer_add_child(window_layer, _hands_layer);
+
+    return true;
+}
+
+bool layer_cache_test_exec(void)
+{
+    APP_LOG("lyrcch", APP_LOG_LEVEL_ERROR, "Exec: Layer Cache Test");
+    uint8_t *fb = display_get_buffer();
+    /* somewhere on the dial ring, away from the hand */
+    uint32_t probe = (DISPLAY_ROWS / 2) * DISPLAY_COLS + 4;
+
+    if (!display_buffer_lock_take(pdMS_TO_TICKS(100)))
+    {
+        test_complete(false);
+        return false;
+    }
+
+    layer_set_cached(_dial_layer, false);
+    TickType_t uncached = _time_draws();
+    uint8_t uncached_px = fb[probe];
+
+    layer_set_cached(_dial_layer, true);
+    TickType_t cached = _time_draws();
+    uint8_t cached_px = fb[probe];
+    bool valid = _dial_layer->cache_valid;
+
+    /* poking the dial must throw the cache away */
+    layer_mark_dirty(_dial_layer);
+    bool invalidated = !_dial_layer->cache_valid;
+
+    display_buffer_lock_give();
+
+    APP_LOG("lyrcch", APP_LOG_LEVEL_ERROR, "%d frames: uncached %d ms, cached %d ms",
+            CACHE_DRAW_PASSES, uncached * portTICK_PERIOD_MS, cached * portTICK_PERIOD_MS);
+
+#ifndef PBL_BW
+    test_assert(valid);
+    test_assert(uncached_px == cached_px);
+#endif
+    test_assert(invalidated);
+
+    window_dirty(true);
+    test_complete(test_get_success());
+    return true;
+}
+
+bool layer_cache_test_deinit(void)
+{
+    APP_LOG("lyrcch", APP_LOG_LEVEL_ERROR, "De-Init: Layer Cache Test");
+    layer_set_cached(_dial_layer, false);
+    layer_destroy(_hands_layer);
+    layer_destroy(_dial_layer);
+    _hands_layer = NULL;
+    _dial_layer = NULL;
+    return true;
+}
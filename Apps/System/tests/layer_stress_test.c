@@ -0,0 +1,133 @@
+/* layer_stress_test.c
+ * Routines for stress testing the layer tree walk
+ * RebbleOS
+ */
+
+#include "rebbleos.h"
+#include "systemapp.h"
+#include "test_defs.h"
+
+#define STRESS_LAYER_COUNT   200
+#define STRESS_NEST_DEPTH    40 /* past the walk's own stack, see layer.c */
+#define STRESS_DRAW_PASSES   20
+#define STRESS_BOX_SIZE      8
+
+static Window *_main_window;
+static Layer *_layers[STRESS_LAYER_COUNT];
+static uint16_t _draw_count;
+
+static void _stress_layer_update_proc(Layer *layer, GContext *ctx)
+{
+    GRect bounds = layer_get_bounds(layer);
+    _draw_count++;
+    graphics_context_set_fill_color(ctx, GColorFromRGB(0, (_draw_count * 8) & 0xFF, 170));
+    graphics_fill_rect(ctx, GRect(0, 0, bounds.size.w, bounds.size.h), 0, GCornerNone);
+}
+
+static uint16_t _count_children(Layer *parent)
+{
+    uint16_t count = 0;
+    for (Layer *l = parent->child; l; l = l->sibling)
+    {
+        if (l->parent != parent)
+            return 0;
+        count++;
+    }
+    return count;
+}
+
+bool layer_stress_test_init(Window *window)
+{
+    APP_LOG("lyrtst", APP_LOG_LEVEL_ERROR, "Init: Layer Stress Test");
+    _main_window = window;
+
+    Layer *window_layer = window_get_root_layer(window);
+    int cols = DISPLAY_COLS / STRESS_BOX_SIZE;
+    int i = 0;
+
+    /* A deep chain first, each one nested inside the last */
+    Layer *parent = window_layer;
+    for (; i < STRESS_NEST_DEPTH; i++)
+    {
+        _layers[i] = layer_create(GRect(1, 1, DISPLAY_COLS - i * 2, DISPLAY_ROWS - i * 2));
+        layer_add_child(parent, _layers[i]);
+        parent = _layers[i];
+    }
+
+    /* Then a long flat list of siblings. Some of these land offscreen */
+    for (int j = 0; i < STRESS_LAYER_COUNT; i++, j++)
+    {
+        GRect frame = GRect((j % cols) * STRESS_BOX_SIZE, (j / cols) * STRESS_BOX_SIZE,
+                            STRESS_BOX_SIZE, STRESS_BOX_SIZE);
+        _layers[i] = layer_create(frame);
+        layer_set_update_proc(_layers[i], _stress_layer_update_proc);
+        layer_add_child(window_layer, _layers[i]);
+    }
+
+    return true;
+}
+
+bool layer_stress_test_exec(void)
+{
+    APP_LOG("lyrtst", APP_LOG_LEVEL_ERROR, "Exec: Layer Stress Test");
+    Layer *window_layer = window_get_root_layer(_main_window);
+
+    /* the flat list plus the head of the chain */
+    uint16_t expected = STRESS_LAYER_COUNT - STRESS_NEST_DEPTH + 1;
+    test_assert(_count_children(window_layer) == expected);
+
+    /* pull one out of the middle and the end of the list, then put one back */
+    layer_remove_from_parent(_layers[STRESS_LAYER_COUNT / 2]);
+    layer_remove_from_parent(_layers[STRESS_LAYER_COUNT - 1]);
+    test_assert(_count_children(window_layer) == expected - 2);
+    test_assert_point_is_null(_layers[STRESS_LAYER_COUNT / 2]->parent);
+
+    layer_insert_below_sibling(_layers[STRESS_LAYER_COUNT / 2], _layers[STRESS_LAYER_COUNT / 2 + 1]);
+    test_assert(_count_children(window_layer) == expected - 1);
+    test_assert(_layers[STRESS_LAYER_COUNT / 2]->sibling == _layers[STRESS_LAYER_COUNT / 2 + 1]);
+
+    if (!display_buffer_lock_take(pdMS_TO_TICKS(100)))
+    {
+        test_complete(false);
+        return false;
+    }
+
+    UBaseType_t stack_before = uxTaskGetStackHighWaterMark(NULL);
+    _draw_count = 0;
+    TickType_t start = xTaskGetTickCount();
+
+    for (int i = 0; i < STRESS_DRAW_PASSES; i++)
+        rbl_window_draw(_main_window);
+
+    TickType_t elapsed = xTaskGetTickCount() - start;
+    UBaseType_t stack_after = uxTaskGetStackHighWaterMark(NULL);
+    display_buffer_lock_give();
+
+    APP_LOG("lyrtst", APP_LOG_LEVEL_ERROR, "%d layers x %d passes: %d ms, %d update_procs per pass",
+            STRESS_LAYER_COUNT, STRESS_DRAW_PASSES, elapsed * portTICK_PERIOD_MS,
+            _draw_count / STRESS_DRAW_PASSES);
+    APP_LOG("lyrtst", APP_LOG_LEVEL_ERROR, "walk depth hwm %d, stack hwm %d words (was %d)",
+            layer_draw_get_max_depth(), stack_after, stack_before);
+
+    /* the boxes past the bottom of the screen should have been culled */
+    test_assert(_draw_count > 0);
+    test_assert(_draw_count / STRESS_DRAW_PASSES < STRESS_LAYER_COUNT - STRESS_NEST_DEPTH - 1);
+    test_assert(layer_draw_get_max_depth() >= STRESS_NEST_DEPTH);
+
+    window_dirty(true);
+    test_complete(test_get_success());
+    return true;
+}
+
+bool layer_stress_test_deinit(void)
+{
+    APP_LOG("lyrtst", APP_LOG_LEVEL_ERROR, "De-Init: Layer Stress Test");
+    for (int i = STRESS_LAYER_COUNT - 1; i >= 0; i--)
+    {
+        if (!_layers[i])
+            continue;
+        layer_destroy(_layers[i]);
+        _layers[i] = NULL;
+    }
+    return true;
+}
@@ -0,0 +1,139 @@
+/* menu_virtual_test.c
+ * Routines for timing a MenuLayer with lots of rows
+ * RebbleOS
+ */
+
+#include "rebbleos.h"
+#include "systemapp.h"
+#include "menu_layer.h"
+#include "test_defs.h"
+
+#define VIRT_SCROLL_STEPS    20
+/* 10k rows of cells don't fit in the app heap, only try those virtualised */
+#define VIRT_CLASSIC_MAX     1000
+
+static const uint16_t _row_counts[] = { 100, 1000, 10000 };
+
+static Window *_main_window;
+static MenuLayer *_menu_layer;
+static uint16_t _num_rows;
+static uint32_t _height_calls;
+static uint32_t _draw_calls;
+
+static uint16_t _get_num_rows(MenuLayer *menu_layer, uint16_t section_index, void *context)
+{
+    return _num_rows;
+}
+
+static int16_t _get_cell_height(MenuLayer *menu_layer, MenuIndex *cell_index, void *context)
+{
+    _height_calls++;
+    /* not all the same, so the lazy measuring has something to do */
+    return (cell_index->row % 3) ? 28 : 44;
+}
+
+static void _draw_row(GContext *ctx, const Layer *layer, MenuIndex *cell_index, void *context)
+{
+    _draw_calls++;
+    menu_cell_title_draw(ctx, layer, "Row");
+}
+
+static bool _run(uint16_t rows, bool virtualised)
+{
+    Layer *window_layer = window_get_root_layer(_main_window);
+    GRect bounds = layer_get_bounds(window_layer);
+
+    _num_rows = rows;
+    _menu_layer = menu_layer_create(bounds);
+    if (!_menu_layer)
+        return false;
+
+    menu_layer_set_virtualised(_menu_layer, virtualised);
+    layer_add_child(window_layer, menu_layer_get_layer(_menu_layer));
+
+    _height_calls = 0;
+    TickType_t start = xTaskGetTickCount();
+    menu_layer_set_callbacks(_menu_layer, NULL, (MenuLayerCallbacks) {
+        .get_num_rows = _get_num_rows,
+        .get_cell_height = _get_cell_height,
+        .draw_row = _draw_row,
+    });
+    TickType_t reload = xTaskGetTickCount() - start;
+    uint32_t reload_heights = _height_calls;
+
+    if (!display_buffer_lock_take(pdMS_TO_TICKS(100)))
+    {
+        menu_layer_destroy(_menu_layer);
+        _menu_layer = NULL;
+        return false;
+    }
+
+    _height_calls = 0;
+    _draw_calls = 0;
+    start = xTaskGetTickCount();
+    for (int i = 0; i < VIRT_SCROLL_STEPS; i++)
+    {
+        menu_layer_set_selected_next(_menu_layer, false, MenuRowAlignCenter, false);
+        rbl_window_draw(_main_window);
+    }
+    TickType_t scroll = xTaskGetTickCount() - start;
+
+    /* and off to the far end */
+    start = xTaskGetTickCount();
+    menu_layer_set_selected_index(_menu_layer, MenuIndex(0, rows - 1), MenuRowAlignCenter, false);
+    rbl_window_draw(_main_window);
+    TickType_t jump = xTaskGetTickCount() - start;
+
+    display_buffer_lock_give();
+
+    APP_LOG("mnutst", APP_LOG_LEVEL_ERROR, "%s %d rows: reload %d ms (%d heights), %d steps %d ms, jump %d ms",
+            virtualised ? "virtual" : "classic", rows, reload * portTICK_PERIOD_MS, reload_heights,
+            VIRT_SCROLL_STEPS, scroll * portTICK_PERIOD_MS, jump * portTICK_PERIOD_MS);
+    APP_LOG("mnutst", APP_LOG_LEVEL_ERROR, "  %d heights, %d rows drawn per frame",
+            _height_calls, _draw_calls / (VIRT_SCROLL_STEPS + 1));
+
+    test_assert(menu_layer_get_selected_index(_menu_layer).row == rows - 1);
+    if (virtualised)
+    {
+        /* only the first row is measured up front, and only what's on screen is drawn */
+        test_assert(reload_heights <= 1);
+        test_assert(_draw_calls / (VIRT_SCROLL_STEPS + 1) < 16);
+    }
+
+    menu_layer_destroy(_menu_layer);
+    _menu_layer = NULL;
+
+    return true;
+}
+
+bool menu_virtual_test_init(Window *window)
+{
+    APP_LOG("mnutst", APP_LOG_LEVEL_ERROR, "Init: Menu Virtual Test");
+    _main_window = window;
+    return true;
+}
+
+bool menu_virtual_test_exec(void)
+{
+    APP_LOG("mnutst", APP_LOG_LEVEL_ERROR, "Exec: Menu Virtual Test");
+
+    for (int i = 0; i < sizeof(_row_counts) / sizeof(_row_counts[0]); i++)
+    {
+        if (_row_counts[i] <= VIRT_CLASSIC_MAX)
+            test_assert(_run(_row_counts[i], false));
+        test_assert(_run(_row_counts[i], true));
+    }
+
+    window_dirty(true);
+    test_complete(test_get_success());
+    return true;
+}
+
+bool menu_virtual_test_deinit(void)
+{
+    APP_LOG("mnutst", APP_LOG_LEVEL_ERROR, "De-Init: Menu Virtual Test");
+    if (_menu_layer)
+        menu_layer_destroy(_menu_layer);
+    _menu_layer = NULL;
+    return true;
+}
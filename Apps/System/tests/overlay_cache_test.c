@@ -0,0 +1,236 @@
+/* overlay_cache_test.c
+ * Routines for timing app frames under an overlay
+ * RebbleOS
+ */
+
+#include "rebbleos.h"
+#include "systemapp.h"
+#include "test_defs.h"
+#include "overlay_manager.h"
+
+#define OVLC_FRAMES          30
+#define OVLC_STRIP_H         20
+#define OVLC_WAIT_MS         1000
+
+static Window *_main_window;
+static Layer *_app_layer;
+static Layer *_overlay_layer;
+static OverlayWindow *_overlay_window;
+static GFont _font;
+
+static const char *_body =
+    "The app keeps on painting underneath whatever the overlay is doing.";
+
+/* Something like an app would paint, every frame */
+static void _app_update_proc(Layer *layer, GContext *ctx)
+{
+    GRect bounds = layer_get_bounds(layer);
+    graphics_context_set_fill_color(ctx, GColorYellow);
+    graphics_fill_rect(ctx, bounds, 0, GCornerNone);
+    ctx->text_color = GColorBlack;
+    graphics_draw_text(ctx, _body, _font, bounds, GTextOverflowModeTrailingEllipsis, GTextAlignmentLeft, 0);
+}
+
+static void _overlay_update_proc(Layer *layer, GContext *ctx)
+{
+    GRect bounds = layer_get_bounds(layer);
+    graphics_context_set_fill_color(ctx, GColorRed);
+    graphics_fill_rect(ctx, GRect(0, bounds.size.h - OVLC_STRIP_H, bounds.size.w, OVLC_STRIP_H), 0, GCornerNone);
+    graphics_context_set_fill_color(ctx, GColorBlue);
+    graphics_fill_rect(ctx, GRect(10, bounds.size.h - OVLC_STRIP_H + 5, 20, 10), 0, GCornerNone);
+}
+
+/* runs on the overlay thread, so the layer goes back to the right heap */
+static void _overlay_unload(Window *window)
+{
+    layer_destroy(_overlay_layer);
+    _overlay_layer = NULL;
+}
+
+/* a toast along the bottom, the app shows through the rest */
+static void _strip_callback(OverlayWindow *overlay_window, Window *window)
+{
+    _overlay_window = overlay_window;
+    window_set_window_handlers(window, (WindowHandlers) {
+        .unload = _overlay_unload,
+    });
+    window->background_color = GColorClear;
+    window->frame = GRect(0, DISPLAY_ROWS - OVLC_STRIP_H, DISPLAY_COLS, OVLC_STRIP_H);
+
+    Layer *window_layer = window_get_root_layer(window);
+    layer_set_frame(window_layer, GRect(0, 0, DISPLAY_COLS, OVLC_STRIP_H));
+    layer_set_bounds(window_layer, GRect(0, 0, DISPLAY_COLS, OVLC_STRIP_H));
+    _overlay_layer = layer_create(GRect(0, 0, DISPLAY_COLS, OVLC_STRIP_H));
+    layer_set_update_proc(_overlay_layer, _overlay_update_proc);
+    layer_add_child(window_layer, _overlay_layer);
+
+    overlay_window_stack_push(overlay_window, false);
+}
+
+/* a notification, covering everything */
+static void _full_callback(OverlayWindow *overlay_window, Window *window)
+{
+    _overlay_window = overlay_window;
+    window_set_window_handlers(window, (WindowHandlers) {
+        .unload = _overlay_unload,
+    });
+    window->background_color = GColorWhite;
+
+    Layer *window_layer = window_get_root_layer(window);
+    _overlay_layer = layer_create(layer_get_bounds(window_layer));
+    layer_set_update_proc(_overlay_layer, _overlay_update_proc);
+    layer_add_child(window_layer, _overlay_layer);
+
+    overlay_window_stack_push(overlay_window, false);
+}
+
+/* the same over the whole screen, with the app showing through the rest.
+ * Too big to keep as a flat render, but it only paints the strip */
+static void _clear_full_callback(OverlayWindow *overlay_window, Window *window)
+{
+    _overlay_window = overlay_window;
+    window_set_window_handlers(window, (WindowHandlers) {
+        .unload = _overlay_unload,
+    });
+    window->background_color = GColorClear;
+
+    Layer *window_layer = window_get_root_layer(window);
+    _overlay_layer = layer_create(layer_get_bounds(window_layer));
+    layer_set_update_proc(_overlay_layer, _overlay_update_proc);
+    layer_add_child(window_layer, _overlay_layer);
+
+    overlay_window_stack_push(overlay_window, false);
+}
+
+static bool _wait_for_overlays(uint8_t count)
+{
+    for (int i = 0; i < OVLC_WAIT_MS / 10; i++)
+    {
+        if (overlay_window_count() == count)
+            return true;
+        vTaskDelay(pdMS_TO_TICKS(10));
+    }
+    return false;
+}
+
+static void _destroy_overlay(void)
+{
+    if (!_overlay_window)
+        return;
+    overlay_window_destroy(_overlay_window);
+    _wait_for_overlays(0);
+    _overlay_window = NULL;
+}
+
+static uint32_t _checksum(void)
+{
+    uint32_t sum = 0;
+#ifndef PBL_BW
+    uint8_t *fb = display_get_buffer();
+    for (uint32_t i = 0; i < DISPLAY_ROWS * DISPLAY_COLS; i++)
+        sum = (sum * 31) + fb[i];
+#endif
+    return sum;
+}
+
+/*
+ * One frame the way the app runloop paints it. When every_time is set
+ * the overlay is told it changed, so it gets painted again in full.
+ */
+static bool _frame(bool every_time)
+{
+    bool drew = false;
+
+    if (every_time)
+        overlay_window_dirty();
+
+    window_dirty(true);
+    if (every_time || !overlay_window_occludes_app())
+        drew = window_draw();
+
+    return overlay_window_draw(drew || every_time) || drew;
+}
+
+static TickType_t _frames(bool every_time)
+{
+    TickType_t start = xTaskGetTickCount();
+    for (int i = 0; i < OVLC_FRAMES; i++)
+        _frame(every_time);
+    return xTaskGetTickCount() - start;
+}
+
+static bool _run(const char *name, OverlayCreateCallback callback, bool occludes)
+{
+    TickType_t elapsed[2];
+
+    overlay_window_create(callback);
+    if (!_wait_for_overlays(1))
+        return false;
+
+    test_assert(overlay_window_occludes_app() == occludes);
+
+    if (!display_buffer_lock_take(pdMS_TO_TICKS(100)))
+        return false;
+
+    elapsed[0] = _frames(true);
+    uint32_t full = _checksum();
+    elapsed[1] = _frames(false);
+    uint32_t cached = _checksum();
+
+    if (!occludes)
+    {
+        /* what it paints fits, so it should have been kept and composed by us */
+        test_assert(_overlay_window->cache_valid);
+        test_assert(full == cached);
+    }
+    else
+    {
+        /* nothing changed and nothing shows through, so there's no work */
+        test_assert(!overlay_window_draw(false));
+    }
+
+    display_buffer_lock_give();
+
+    APP_LOG("ovlctst", APP_LOG_LEVEL_ERROR, "%s: %d frames, overlay redrawn %d ms, cached %d ms",
+            name, OVLC_FRAMES, elapsed[0] * portTICK_PERIOD_MS, elapsed[1] * portTICK_PERIOD_MS);
+
+    _destroy_overlay();
+    return true;
+}
+
+bool overlay_cache_test_init(Window *window)
+{
+    APP_LOG("ovlctst", APP_LOG_LEVEL_ERROR, "Init: Overlay Cache Test");
+    _main_window = window;
+    Layer *window_layer = window_get_root_layer(window);
+
+    _font = fonts_get_system_font(FONT_KEY_GOTHIC_24);
+    _app_layer = layer_create(layer_get_bounds(window_layer));
+    layer_set_update_proc(_app_layer, _app_update_proc);
+    layer_add_child(window_layer, _app_layer);
+
+    return true;
+}
+
+bool overlay_cache_test_exec(void)
+{
+    APP_LOG("ovlctst", APP_LOG_LEVEL_ERROR, "Exec: Overlay Cache Test");
+
+    test_assert(_run("toast", _strip_callback, false));
+    test_assert(_run("see-through", _clear_full_callback, false));
+    test_assert(_run("notification", _full_callback, true));
+
+    window_dirty(true);
+    test_complete(test_get_success());
+    return true;
+}
+
+bool overlay_cache_test_deinit(void)
+{
+    APP_LOG("ovlctst", APP_LOG_LEVEL_ERROR, "De-Init: Overlay Cache Test");
+    _destroy_overlay();
+    layer_remove_from_parent(_app_layer);
+    layer_destroy(_app_layer);
+    _app_layer = NULL;
+    return true;
+}
@@ -0,0 +1,89 @@
+/* partition_test.c
+ * Routines for testing how memory is shared between the app and worker
+ * RebbleOS
+ */
+
+#include "rebbleos.h"
+#include "systemapp.h"
+#include "test_defs.h"
+
+static bool _running;
+
+/* how much of what the app and worker are given the app can get at */
+static void _log_share(const char *when, size_t app, size_t total)
+{
+    APP_LOG("prttst", APP_LOG_LEVEL_ERROR, "%s: app can have %d of %d bytes (%d%%)",
+            when, app, total, (app * 100) / total);
+}
+
+/* The worker is up (it says hello once it is). See where it ended up */
+static void _worker_up(uint16_t type, AppWorkerMessage *data)
+{
+    app_running_thread *app = appmanager_get_thread(AppThreadMainApp);
+    app_running_thread *worker = appmanager_get_thread(AppThreadWorker);
+    AppPartitionStats stats;
+
+    if (!_running)
+        return;
+
+    appmanager_partition_get_stats(&stats);
+    APP_LOG("prttst", APP_LOG_LEVEL_ERROR, "with the worker: app %d bytes (%d used), worker %d (%d used)",
+            app->heap_size, qusedbytes(app->arena), worker->heap_size, qusedbytes(worker->arena));
+    APP_LOG("prttst", APP_LOG_LEVEL_ERROR, "largest app with the worker running: %d bytes", stats.largest_app);
+
+    /* it's above the app and inside the pool */
+    test_assert(stats.worker == worker->heap_size);
+    test_assert(worker->heap >= app->heap + app->heap_size);
+    test_assert(worker->heap + worker->heap_size <= app->heap + stats.pool);
+    test_assert(stats.largest_app == stats.pool - stats.worker);
+
+    app_worker_message_unsubscribe();
+    test_assert(app_worker_kill() == APP_WORKER_RESULT_SUCCESS);
+    test_complete(test_get_success());
+}
+
+bool partition_test_init(Window *window)
+{
+    APP_LOG("prttst", APP_LOG_LEVEL_ERROR, "Init: Partition Test");
+    return true;
+}
+
+bool partition_test_exec(void)
+{
+    APP_LOG("prttst", APP_LOG_LEVEL_ERROR, "Exec: Partition Test");
+    app_running_thread *app = appmanager_get_thread(AppThreadMainApp);
+    AppPartitionStats stats;
+
+    _running = true;
+    appmanager_partition_get_stats(&stats);
+
+    APP_LOG("prttst", APP_LOG_LEVEL_ERROR, "pool %d bytes: app %d (%d used), worker %d",
+            stats.pool, stats.app, qusedbytes(app->arena), stats.worker);
+    APP_LOG("prttst", APP_LOG_LEVEL_ERROR, "largest app: %d bytes fixed, %d partitioned",
+            MEMORY_SIZE_APP_HEAP, stats.largest_app);
+    _log_share("fixed", MEMORY_SIZE_APP_HEAP, stats.pool);
+    _log_share("partitioned", stats.app, stats.pool);
+
+    /* we have a worker we may launch, so there's room kept for it, but
+     * without one running any app could have the lot */
+    test_assert(stats.worker == 0);
+    test_assert(app->heap_size == stats.app);
+    test_assert(stats.app < stats.pool);
+    test_assert(stats.largest_app == stats.pool);
+    test_assert(stats.largest_app > MEMORY_SIZE_APP_HEAP);
+
+    app_worker_message_subscribe(_worker_up);
+    test_assert(app_worker_launch() == APP_WORKER_RESULT_SUCCESS);
+
+    return true;
+}
+
+bool partition_test_deinit(void)
+{
+    APP_LOG("prttst", APP_LOG_LEVEL_ERROR, "De-Init: Partition Test");
+    _running = false;
+    app_worker_message_unsubscribe();
+    if (app_worker_is_running())
+        app_worker_kill();
+    return true;
+}
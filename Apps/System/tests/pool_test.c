@@ -0,0 +1,223 @@
+/* pool_test.c
+ * Routines for testing the object pools, and what they save over the arena
+ * RebbleOS
+ */
+
+#include "rebbleos.h"
+#include "systemapp.h"
+#include "test_defs.h"
+#include "notification_manager.h"
+
+/* a menu's worth of cells, scrolled through a cell at a time */
+#define POOL_MENU_CELLS     8
+#define POOL_MENU_STEPS     2000
+/* notifications, the oldest going as each new one comes in */
+#define POOL_MSG_KEEP       5
+#define POOL_MSG_ATTRS      6
+#define POOL_MSG_COUNT      400
+
+typedef struct pool_run {
+    uint32_t ms;
+    uint32_t ops;
+    uint32_t used;
+    uint32_t free;
+    uint32_t largest;
+} pool_run;
+
+static uint32_t _seed;
+
+static uint32_t _rand(void)
+{
+    _seed = _seed * 1103515245 + 12345;
+    return _seed >> 16;
+}
+
+static void _report(const char *what, pool_run *run)
+{
+    APP_LOG("pooltst", APP_LOG_LEVEL_ERROR, "%s: %d us/op, %d used, %d free, largest %d (%d%% fragmented)",
+            what, (run->ms * 1000) / run->ops, run->used, run->free, run->largest,
+            run->free ? 100 - (run->largest * 100) / run->free : 0);
+}
+
+static void *_text_layer_pooled(void)
+{
+    return app_pool_calloc(ObjectPoolTextLayer, sizeof(TextLayer));
+}
+
+static void *_text_layer_arena(void)
+{
+    return app_calloc(1, sizeof(TextLayer));
+}
+
+/* Swap a cell's layer and text each step, as a menu does as it scrolls.
+ * The heap is looked at with the last cells still there */
+static void _menu_run(void *(*alloc)(void), pool_run *run)
+{
+    app_running_thread *thread = appmanager_get_current_thread();
+    void *cells[POOL_MENU_CELLS];
+    char *texts[POOL_MENU_CELLS];
+
+    _seed = 1;
+    for (int i = 0; i < POOL_MENU_CELLS; i++)
+    {
+        cells[i] = alloc();
+        texts[i] = app_calloc(1, 20 + (_rand() & 63));
+    }
+
+    TickType_t start = xTaskGetTickCount();
+    for (int step = 0; step < POOL_MENU_STEPS; step++)
+    {
+        int i = _rand() % POOL_MENU_CELLS;
+
+        app_free(cells[i]);
+        app_free(texts[i]);
+        cells[i] = alloc();
+        texts[i] = app_calloc(1, 20 + (_rand() & 63));
+    }
+    run->ms = (xTaskGetTickCount() - start) * portTICK_PERIOD_MS;
+    run->ops = POOL_MENU_STEPS * 4;
+    run->used = qusedbytes(thread->arena);
+    run->free = qfreebytes(thread->arena);
+    run->largest = qlargestfree(thread->arena);
+
+    for (int i = 0; i < POOL_MENU_CELLS; i++)
+    {
+        app_free(cells[i]);
+        app_free(texts[i]);
+    }
+}
+
+static void *_attribute_pooled(void)
+{
+    return noty_attribute_calloc();
+}
+
+static void *_attribute_arena(void)
+{
+    return noty_calloc(1, sizeof(cmd_phone_attribute_t));
+}
+
+/* Messages come in with their attributes and each attribute's text, and
+ * the oldest is thrown away to make room */
+static void _notification_run(void *(*alloc)(void), pool_run *run)
+{
+    qarena_t *arena = noty_get_arena();
+    cmd_phone_attribute_t *attrs[POOL_MSG_KEEP][POOL_MSG_ATTRS] = { 0 };
+
+    _seed = 2;
+    TickType_t start = xTaskGetTickCount();
+    for (int msg = 0; msg < POOL_MSG_COUNT; msg++)
+    {
+        cmd_phone_attribute_t **slot = attrs[msg % POOL_MSG_KEEP];
+
+        for (int i = 0; i < POOL_MSG_ATTRS; i++)
+        {
+            if (slot[i])
+            {
+                noty_free(slot[i]->data);
+                noty_free(slot[i]);
+            }
+            slot[i] = alloc();
+            slot[i]->data = noty_calloc(1, 8 + (_rand() & 63));
+        }
+    }
+    run->ms = (xTaskGetTickCount() - start) * portTICK_PERIOD_MS;
+    run->ops = POOL_MSG_COUNT * POOL_MSG_ATTRS * 4;
+    run->used = qusedbytes(arena);
+    run->free = qfreebytes(arena);
+    run->largest = qlargestfree(arena);
+
+    for (int msg = 0; msg < POOL_MSG_KEEP; msg++)
+        for (int i = 0; i < POOL_MSG_ATTRS; i++)
+        {
+            noty_free(attrs[msg][i]->data);
+            noty_free(attrs[msg][i]);
+        }
+}
+
+/* What each object costs, over its own size, in the arena and in a pool */
+static void _report_overhead(const char *what, size_t size, uint32_t arena, const qpool_t *pool)
+{
+    APP_LOG("pooltst", APP_LOG_LEVEL_ERROR, "%s is %d bytes: %d more in the arena, %d more in a pool",
+            what, size, arena - size, pool->size - size);
+}
+
+bool pool_test_init(Window *window)
+{
+    APP_LOG("pooltst", APP_LOG_LEVEL_ERROR, "Init: Pool Test");
+    return true;
+}
+
+bool pool_test_exec(void)
+{
+    APP_LOG("pooltst", APP_LOG_LEVEL_ERROR, "Exec: Pool Test");
+    app_running_thread *thread = appmanager_get_current_thread();
+    qpool_t *pool = &thread->pools[ObjectPoolTextLayer];
+    uint32_t used = qusedbytes(thread->arena);
+    uint32_t noty_used = qusedbytes(noty_get_arena());
+    pool_run run;
+
+    /* the menu */
+    _menu_run(_text_layer_arena, &run);
+    _report("menu, arena", &run);
+    test_assert(qusedbytes(thread->arena) == used);
+
+    _menu_run(_text_layer_pooled, &run);
+    _report("menu, pooled", &run);
+    /* the slab stays with the thread, but nothing in it does */
+    used = qusedbytes(thread->arena);
+    test_assert(pool->slab != NULL);
+
+    /* what's given back is what's handed out next */
+    void *layer = _text_layer_pooled();
+    app_free(layer);
+    test_assert(_text_layer_pooled() == layer);
+    app_free(layer);
+
+    /* and once it's full, the arena takes over, and takes them back */
+    uint16_t in_use = pool->in_use;
+    uint16_t fallbacks = pool->fallbacks;
+    void *layers[pool->count + 2];
+    int spare = pool->count - in_use;
+
+    for (int i = 0; i < spare + 2; i++)
+        layers[i] = _text_layer_pooled();
+    test_assert(pool->in_use == pool->count);
+    test_assert(pool->fallbacks == fallbacks + 2);
+    for (int i = 0; i < spare + 2; i++)
+        app_free(layers[i]);
+    test_assert(pool->in_use == in_use);
+    test_assert(qusedbytes(thread->arena) == used);
+
+    uint32_t before = qusedbytes(thread->arena);
+    layer = _text_layer_arena();
+    _report_overhead("TextLayer", sizeof(TextLayer), qusedbytes(thread->arena) - before, pool);
+    app_free(layer);
+
+    /* the notifications */
+    const qpool_t *attr_pool = noty_get_attribute_pool();
+
+    _notification_run(_attribute_arena, &run);
+    _report("notification, arena", &run);
+    test_assert(qusedbytes(noty_get_arena()) == noty_used);
+
+    _notification_run(_attribute_pooled, &run);
+    _report("notification, pooled", &run);
+    test_assert(attr_pool->slab != NULL);
+    APP_LOG("pooltst", APP_LOG_LEVEL_ERROR, "attribute pool: peak %d of %d, %d went to the arena",
+            attr_pool->peak, attr_pool->count, attr_pool->fallbacks);
+
+    before = qusedbytes(noty_get_arena());
+    void *attr = _attribute_arena();
+    _report_overhead("attribute", sizeof(cmd_phone_attribute_t), qusedbytes(noty_get_arena()) - before, attr_pool);
+    noty_free(attr);
+
+    test_complete(test_get_success());
+    return true;
+}
+
+bool pool_test_deinit(void)
+{
+    APP_LOG("pooltst", APP_LOG_LEVEL_ERROR, "De-Init: Pool Test");
+    return true;
+}
@@ -0,0 +1,153 @@
+/* scroll_shift_test.c
+ * Routines for timing framebuffer shift scrolling
+ * RebbleOS
+ */
+
+#include "rebbleos.h"
+#include "systemapp.h"
+#include "menu_layer.h"
+#include "test_defs.h"
+
+#define SHIFT_PARAGRAPHS     12
+#define SHIFT_PARAGRAPH_H    48
+#define SHIFT_MENU_ROWS      60
+#define SHIFT_FRAMES         30
+#define SHIFT_STEP           4
+
+static Window *_main_window;
+static ScrollLayer *_scroll_layer;
+static TextLayer *_paragraphs[SHIFT_PARAGRAPHS];
+static MenuLayer *_menu_layer;
+
+static const char *_body =
+    "Scrolling a long message should only paint the lines that come into view, "
+    "everything else is already on the screen.";
+
+static uint16_t _get_num_rows(MenuLayer *menu_layer, uint16_t section_index, void *context)
+{
+    return SHIFT_MENU_ROWS;
+}
+
+static void _draw_row(GContext *ctx, const Layer *layer, MenuIndex *cell_index, void *context)
+{
+    menu_cell_basic_draw(ctx, layer, "Row", "Subtitle", NULL);
+}
+
+static uint32_t _checksum(GRect rect)
+{
+    uint32_t sum = 0;
+#ifndef PBL_BW
+    uint8_t *fb = display_get_buffer();
+    for (int16_t y = rect.origin.y; y < rect.origin.y + rect.size.h; y++)
+        for (int16_t x = rect.origin.x; x < rect.origin.x + rect.size.w; x++)
+            sum = (sum * 31) + fb[y * DISPLAY_COLS + x];
+#endif
+    return sum;
+}
+
+/*
+ * Step the content up a few pixels a frame, the way the scroll animation
+ * does, and time it. Then repaint the last frame in full and make sure
+ * the shifted one came out the same.
+ */
+static bool _run(const char *name, ScrollLayer *scroll_layer, Layer *content)
+{
+    GRect rect = layer_get_frame(scroll_layer_get_layer(scroll_layer));
+    TickType_t elapsed[2];
+
+    if (!display_buffer_lock_take(pdMS_TO_TICKS(100)))
+        return false;
+
+    for (int pass = 0; pass < 2; pass++)
+    {
+        scroll_layer->fb_shift_disabled = (pass == 0);
+
+        GRect frame = layer_get_frame(&scroll_layer->content_sublayer);
+        frame.origin.y = 0;
+        layer_set_frame(&scroll_layer->content_sublayer, frame);
+        rbl_window_draw(_main_window);
+
+        TickType_t start = xTaskGetTickCount();
+        for (int i = 0; i < SHIFT_FRAMES; i++)
+        {
+            frame.origin.y -= SHIFT_STEP;
+            layer_set_frame(&scroll_layer->content_sublayer, frame);
+            rbl_window_draw(_main_window);
+        }
+        elapsed[pass] = xTaskGetTickCount() - start;
+    }
+
+    uint32_t shifted = _checksum(rect);
+    scroll_layer->fb_shift_disabled = true;
+    layer_mark_dirty(content);
+    rbl_window_draw(_main_window);
+    uint32_t full = _checksum(rect);
+
+    display_buffer_lock_give();
+
+    APP_LOG("shftst", APP_LOG_LEVEL_ERROR, "%s: %d frames, full %d ms, shifted %d ms",
+            name, SHIFT_FRAMES, elapsed[0] * portTICK_PERIOD_MS, elapsed[1] * portTICK_PERIOD_MS);
+
+    test_assert(shifted == full);
+    return true;
+}
+
+bool scroll_shift_test_init(Window *window)
+{
+    APP_LOG("shftst", APP_LOG_LEVEL_ERROR, "Init: Scroll Shift Test");
+    _main_window = window;
+    Layer *window_layer = window_get_root_layer(window);
+    GRect bounds = layer_get_bounds(window_layer);
+
+    /* a long message, a paragraph to a layer */
+    _scroll_layer = scroll_layer_create(bounds);
+    scroll_layer_set_content_size(_scroll_layer, GSize(bounds.size.w, SHIFT_PARAGRAPHS * SHIFT_PARAGRAPH_H));
+    for (int i = 0; i < SHIFT_PARAGRAPHS; i++)
+    {
+        _paragraphs[i] = text_layer_create(GRect(0, i * SHIFT_PARAGRAPH_H, bounds.size.w, SHIFT_PARAGRAPH_H));
+        text_layer_set_text(_paragraphs[i], _body);
+        scroll_layer_add_child(_scroll_layer, text_layer_get_layer(_paragraphs[i]));
+    }
+    layer_add_child(window_layer, scroll_layer_get_layer(_scroll_layer));
+
+    _menu_layer = menu_layer_create(bounds);
+    menu_layer_set_center_focused(_menu_layer, false);
+    menu_layer_set_callbacks(_menu_layer, NULL, (MenuLayerCallbacks) {
+        .get_num_rows = _get_num_rows,
+        .draw_row = _draw_row,
+    });
+
+    return true;
+}
+
+bool scroll_shift_test_exec(void)
+{
+    APP_LOG("shftst", APP_LOG_LEVEL_ERROR, "Exec: Scroll Shift Test");
+    Layer *window_layer = window_get_root_layer(_main_window);
+
+    test_assert(_run("message", _scroll_layer, text_layer_get_layer(_paragraphs[0])));
+
+    /* swap the message for the menu */
+    layer_remove_from_parent(scroll_layer_get_layer(_scroll_layer));
+    layer_add_child(window_layer, menu_layer_get_layer(_menu_layer));
+    test_assert(_run("menu", &_menu_layer->scroll_layer, &_menu_layer->layer));
+
+    window_dirty(true);
+    test_complete(test_get_success());
+    return true;
+}
+
+bool scroll_shift_test_deinit(void)
+{
+    APP_LOG("shftst", APP_LOG_LEVEL_ERROR, "De-Init: Scroll Shift Test");
+    for (int i = 0; i < SHIFT_PARAGRAPHS; i++)
+    {
+        text_layer_destroy(_paragraphs[i]);
+        _paragraphs[i] = NULL;
+    }
+    scroll_layer_destroy(_scroll_layer);
+    menu_layer_destroy(_menu_layer);
+    _scroll_layer = NULL;
+    _menu_layer = NULL;
+    return true;
+}
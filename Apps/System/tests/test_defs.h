@@ -153,3 +153,76 @@ bool action_menu_test_deinit(void);
 bool vibes_test_init(Window *window);
 bool vibes_test_exec(void);
 bool vibes_test_deinit(void);
+
+bool layer_stress_test_init(Window *window);
+bool layer_stress_test_exec(void);
+bool layer_stress_test_deinit(void);
+
+bool layer_cache_test_init(Window *window);
+bool layer_cache_test_exec(void);
+bool layer_cache_test_deinit(void);
+
+bool menu_virtual_test_init(Window *window);
+bool menu_virtual_test_exec(void);
+bool menu_virtual_test_deinit(void);
+
+bool scroll_shift_test_init(Window *window);
+bool scroll_shift_test_exec(void);
+bool scroll_shift_test_deinit(void);
+
+bool window_slide_test_init(Window *window);
+bool window_slide_test_exec(void);
+bool window_slide_test_deinit(void);
+
+bool text_layout_test_init(Window *window);
+bool text_layout_test_exec(void);
+bool text_layout_test_deinit(void);
+
+bool overlay_cache_test_init(Window *window);
+bool overlay_cache_test_exec(void);
+bool overlay_cache_test_deinit(void);
+
+bool animation_clock_test_init(Window *window);
+bool animation_clock_test_exec(void);
+bool animation_clock_test_deinit(void);
+
+bool animation_curve_test_init(Window *window);
+bool animation_curve_test_exec(void);
+bool animation_curve_test_deinit(void);
+
+bool timer_heap_test_init(Window *window);
+bool timer_heap_test_exec(void);
+bool timer_heap_test_deinit(void);
+
+bool timer_coalesce_test_init(Window *window);
+bool timer_coalesce_test_exec(void);
+bool timer_coalesce_test_deinit(void);
+
+bool tickless_test_init(Window *window);
+bool tickless_test_exec(void);
+bool tickless_test_deinit(void);
+
+bool tick_service_test_init(Window *window);
+bool tick_service_test_exec(void);
+bool tick_service_test_deinit(void);
+
+bool time_cache_test_init(Window *window);
+bool time_cache_test_exec(void);
+bool time_cache_test_deinit(void);
+
+bool worker_test_init(Window *window);
+bool worker_test_exec(void);
+bool worker_test_deinit(void);
+void worker_test_worker_main(void);
+
+bool partition_test_init(Window *window);
+bool partition_test_exec(void);
+bool partition_test_deinit(void);
+
+bool pool_test_init(Window *window);
+bool pool_test_exec(void);
+bool pool_test_deinit(void);
+
+bool heap_stats_test_init(Window *window);
+bool heap_stats_test_exec(void);
+bool heap_stats_test_deinit(void);
@@ -0,0 +1,158 @@
+/* text_layout_test.c
+ * Routines for timing cached text layout
+ * RebbleOS
+ */
+
+#include "rebbleos.h"
+#include "systemapp.h"
+#include "test_defs.h"
+
+#define LAYOUT_FRAMES        30
+#define LAYOUT_STEP          8
+
+static Window *_main_window;
+static Layer *_plain_layer;
+static TextLayer *_text_layer;
+static GFont _font;
+static GRect _body_rect;
+
+static const char *_body =
+    "Hey, are you still coming over tonight? I picked up the stuff for dinner "
+    "on the way home, so all you need to bring is yourself. Parking is a pain "
+    "around here after six so maybe take the bus, the 42 stops right outside.\n"
+    "Also, can you remember to bring back the book I lent you last month? "
+    "My sister wants to borrow it next and she keeps asking me about it. No "
+    "rush if you haven't finished it, just let me know either way.\n"
+    "Oh and the neighbours are having a party so it might be a bit loud, sorry "
+    "in advance! See you at about seven, call me if you get lost.";
+
+/* how notifications drew their bodies, wrapped from scratch every frame */
+static void _plain_update_proc(Layer *layer, GContext *ctx)
+{
+    ctx->text_color = GColorBlack;
+    graphics_draw_text(ctx, _body, _font, _body_rect, GTextOverflowModeTrailingEllipsis, GTextAlignmentLeft, 0);
+}
+
+/*
+ * Scroll the body up a few pixels a frame like the notification
+ * window does, and time the redraws.
+ */
+static TickType_t _scroll(Layer *layer)
+{
+    GRect frame = layer_get_frame(layer);
+
+    frame.origin.y = 0;
+    TickType_t start = xTaskGetTickCount();
+    for (int i = 0; i < LAYOUT_FRAMES; i++)
+    {
+        frame.origin.y -= LAYOUT_STEP;
+        layer_set_frame(layer, frame);
+        rbl_window_draw(_main_window);
+    }
+
+    return xTaskGetTickCount() - start;
+}
+
+bool text_layout_test_init(Window *window)
+{
+    APP_LOG("txttst", APP_LOG_LEVEL_ERROR, "Init: Text Layout Test");
+    _main_window = window;
+    Layer *window_layer = window_get_root_layer(window);
+    GRect bounds = layer_get_bounds(window_layer);
+
+    _font = fonts_get_system_font(FONT_KEY_GOTHIC_24);
+    _body_rect = GRect(0, 0, bounds.size.w, DISPLAY_ROWS * 3);
+
+    _plain_layer = layer_create(_body_rect);
+    layer_set_update_proc(_plain_layer, _plain_update_proc);
+
+    _text_layer = text_layer_create(_body_rect);
+    text_layer_set_font(_text_layer, _font);
+    text_layer_set_overflow_mode(_text_layer, GTextOverflowModeTrailingEllipsis);
+    text_layer_set_text(_text_layer, _body);
+
+    return true;
+}
+
+bool text_layout_test_exec(void)
+{
+    APP_LOG("txttst", APP_LOG_LEVEL_ERROR, "Exec: Text Layout Test");
+    Layer *window_layer = window_get_root_layer(_main_window);
+    TickType_t plain, cached;
+
+    /* measuring without drawing, and the cache agrees */
+    GSize size = graphics_text_layout_get_content_size(_body, _font, _body_rect,
+                                                       GTextOverflowModeTrailingEllipsis, GTextAlignmentLeft);
+    GSize layer_size = text_layer_get_content_size(_text_layer);
+    APP_LOG("txttst", APP_LOG_LEVEL_ERROR, "content %dx%d, %d lines",
+            size.w, size.h, _text_layer->layout_cache ? _text_layer->layout_cache->line_count : 0);
+    test_assert(size.h > 0 && size.w > 0);
+    test_assert(size.w <= _body_rect.size.w);
+    test_assert(size.w == layer_size.w && size.h == layer_size.h);
+
+    if (!display_buffer_lock_take(pdMS_TO_TICKS(100)))
+    {
+        test_complete(false);
+        return false;
+    }
+
+    layer_add_child(window_layer, _plain_layer);
+    plain = _scroll(_plain_layer);
+    layer_remove_from_parent(_plain_layer);
+
+    layer_add_child(window_layer, text_layer_get_layer(_text_layer));
+    GTextLayoutLine *lines = _text_layer->layout_cache->lines;
+    cached = _scroll(text_layer_get_layer(_text_layer));
+    /* moving the layer about is no reason to wrap it again */
+    test_assert(_text_layer->layout_cache->valid);
+    test_assert(_text_layer->layout_cache->lines == lines);
+
+    /* but changing the text is */
+    text_layer_set_text(_text_layer, "Short now");
+    rbl_window_draw(_main_window);
+    test_assert(_text_layer->layout_cache->line_count == 1);
+    text_layer_set_text(_text_layer, _body);
+
+    /* nor is the same length written over the same buffer, once we're told */
+    static char clock[] = "88:88";
+    text_layer_set_text(_text_layer, clock);
+    rbl_window_draw(_main_window);
+    uint16_t width = _text_layer->layout_cache->lines[0].width;
+    strcpy(clock, "11:11");
+    text_layer_set_text(_text_layer, clock);
+    rbl_window_draw(_main_window);
+    test_assert(_text_layer->layout_cache->lines[0].width != width);
+    text_layer_set_text(_text_layer, _body);
+    layer_remove_from_parent(text_layer_get_layer(_text_layer));
+
+    /* the attributes keep what they're given, even if ngfx can't use it yet */
+    GTextAttributes *attributes = graphics_text_attributes_create();
+    test_assert(attributes != NULL);
+    graphics_text_attributes_enable_screen_text_flow(attributes, 8);
+    graphics_text_attributes_enable_paging(attributes, GPoint(0, 20), GRect(0, 20, 144, 148));
+    test_assert(((GTextAttributesExt *)attributes)->flow_enabled);
+    test_assert(((GTextAttributesExt *)attributes)->flow_inset == 8);
+    test_assert(((GTextAttributesExt *)attributes)->paging_on_screen.size.h == 148);
+    graphics_text_attributes_restore_default_paging(attributes);
+    test_assert(!((GTextAttributesExt *)attributes)->paging_enabled);
+    graphics_text_attributes_destroy(attributes);
+
+    display_buffer_lock_give();
+
+    APP_LOG("txttst", APP_LOG_LEVEL_ERROR, "%d frames of a %d byte body: wrapped each time %d ms, cached %d ms",
+            LAYOUT_FRAMES, strlen(_body), plain * portTICK_PERIOD_MS, cached * portTICK_PERIOD_MS);
+
+    window_dirty(true);
+    test_complete(test_get_success());
+    return true;
+}
+
+bool text_layout_test_deinit(void)
+{
+    APP_LOG("txttst", APP_LOG_LEVEL_ERROR, "De-Init: Text Layout Test");
+    layer_destroy(_plain_layer);
+    text_layer_destroy(_text_layer);
+    _plain_layer = NULL;
+    _text_layer = NULL;
+    return true;
+}
@@ -0,0 +1,139 @@
+/* tick_service_test.c
+ * Routines for testing tick timer subscribers on more than one thread
+ * RebbleOS
+ */
+
+#include "rebbleos.h"
+#include "systemapp.h"
+#include "test_defs.h"
+#include "overlay_manager.h"
+
+#define TICK_SECONDS         5
+#define TICK_CONVERSIONS     1000
+
+static OverlayWindow *_overlay_window;
+static bool _stopping;
+static uint8_t _app_ticks;
+static uint8_t _overlay_ticks;
+static int _app_last_sec = -1;
+static int _overlay_last_sec = -1;
+static bool _skipped;
+static TickTimerStats _before;
+
+/* every second shows up, once, in order */
+static void _check_second(int *last, struct tm *tick_time)
+{
+    if (*last >= 0 && tick_time->tm_sec != (*last + 1) % 60)
+        _skipped = true;
+    *last = tick_time->tm_sec;
+}
+
+static uint32_t _cycles(TickType_t ticks)
+{
+    return (ticks * (configCPU_CLOCK_HZ / configTICK_RATE_HZ)) / TICK_CONVERSIONS;
+}
+
+/* what the shared struct tm saves each extra subscriber */
+static void _benchmark(void)
+{
+    struct tm tm;
+    time_t now;
+    rcore_time_ms(&now, NULL);
+
+    TickType_t start = xTaskGetTickCount();
+    for (int i = 0; i < TICK_CONVERSIONS; i++)
+        rcore_localtime(&tm, now + i);
+    TickType_t convert = xTaskGetTickCount() - start;
+
+    APP_LOG("tickst", APP_LOG_LEVEL_ERROR, "working out a struct tm: %d cycles", _cycles(convert));
+}
+
+/* runs on the overlay thread */
+static void _overlay_tick(struct tm *tick_time, TimeUnits units_changed)
+{
+    if (_stopping)
+    {
+        tick_timer_service_unsubscribe();
+        return;
+    }
+
+    _overlay_ticks++;
+    _check_second(&_overlay_last_sec, tick_time);
+}
+
+static void _overlay_created(OverlayWindow *overlay_window, Window *window)
+{
+    _overlay_window = overlay_window;
+    tick_timer_service_subscribe(SECOND_UNIT, _overlay_tick);
+}
+
+static void _app_tick(struct tm *tick_time, TimeUnits units_changed)
+{
+    if (_app_ticks++ < TICK_SECONDS)
+    {
+        _check_second(&_app_last_sec, tick_time);
+        return;
+    }
+
+    /* give the overlay a tick to see we're done and let go */
+    _stopping = true;
+    if (_app_ticks < TICK_SECONDS + 2)
+        return;
+
+    tick_timer_service_unsubscribe();
+
+    TickTimerStats after;
+    tick_timer_service_get_stats(&after);
+    uint32_t wakeups = after.wakeups - _before.wakeups;
+    uint32_t deliveries = after.deliveries - _before.deliveries;
+    uint32_t conversions = after.conversions - _before.conversions;
+
+    APP_LOG("tickst", APP_LOG_LEVEL_ERROR, "%d app ticks, %d overlay ticks: %d wakeups, %d deliveries, %d struct tms, at worst %d ms late",
+            _app_ticks, _overlay_ticks, wakeups, deliveries, conversions, after.worst_late * portTICK_PERIOD_MS);
+    _benchmark();
+
+    test_assert(!_skipped);
+    test_assert(_overlay_ticks >= TICK_SECONDS - 1);
+    /* both threads woke on the same ticks, and shared the time */
+    test_assert(wakeups < deliveries);
+    test_assert(conversions <= wakeups + 1);
+
+    overlay_window_destroy(_overlay_window);
+    _overlay_window = NULL;
+    test_complete(test_get_success());
+}
+
+bool tick_service_test_init(Window *window)
+{
+    APP_LOG("tickst", APP_LOG_LEVEL_ERROR, "Init: Tick Service Test");
+    return true;
+}
+
+bool tick_service_test_exec(void)
+{
+    APP_LOG("tickst", APP_LOG_LEVEL_ERROR, "Exec: Tick Service Test");
+
+    _stopping = false;
+    _skipped = false;
+    _app_ticks = _overlay_ticks = 0;
+    _app_last_sec = _overlay_last_sec = -1;
+    tick_timer_service_get_stats(&_before);
+
+    tick_timer_service_subscribe(SECOND_UNIT, _app_tick);
+    overlay_window_create(_overlay_created);
+
+    return true;
+}
+
+bool tick_service_test_deinit(void)
+{
+    APP_LOG("tickst", APP_LOG_LEVEL_ERROR, "De-Init: Tick Service Test");
+    tick_timer_service_unsubscribe();
+    if (_overlay_window)
+    {
+        _stopping = true;
+        overlay_window_destroy(_overlay_window);
+        _overlay_window = NULL;
+    }
+    return true;
+}
@@ -0,0 +1,78 @@
+/* tickless_test.c
+ * Routines for checking the tick count survives sleeping through ticks
+ * RebbleOS
+ */
+
+#include "rebbleos.h"
+#include "systemapp.h"
+#include "test_defs.h"
+#include "utils.h"
+
+/* a minute of short naps, each one long enough to stop for. Any rounding
+ * left in a sleep builds up over a few thousand of them, where one long
+ * sleep would hide it */
+#define TICKLESS_RUN_MS      60000
+#define TICKLESS_NAP_MS      10
+/* how far the ticks may drift from the RTC over the run. Each sleep is
+ * read off the RTC to a 4096th of a second, which wanders about 8 ms over
+ * that many naps, but shouldn't go one way. Rounding that does used to
+ * come to seconds */
+#define TICKLESS_TOLERANCE   40
+
+/* Block until the RTC ticks over to the next second */
+static TickType_t _wait_for_second(time_t *secs)
+{
+    time_t start = rcore_mktime(hw_get_time());
+
+    while ((*secs = rcore_mktime(hw_get_time())) == start)
+        vTaskDelay(1);
+
+    return xTaskGetTickCount();
+}
+
+bool tickless_test_init(Window *window)
+{
+    APP_LOG("tlstst", APP_LOG_LEVEL_ERROR, "Init: Tickless Test");
+    return true;
+}
+
+bool tickless_test_exec(void)
+{
+    uint32_t stop[2], sleep[2];
+    time_t secs[2];
+    TickType_t ticks[2];
+
+    APP_LOG("tlstst", APP_LOG_LEVEL_ERROR, "Exec: Tickless Test");
+
+    ticks[0] = _wait_for_second(&secs[0]);
+    hw_idle_get_stats(&stop[0], &sleep[0]);
+
+    /* nothing else wants us, so this should nearly all be spent asleep */
+    for (int i = 0; i < TICKLESS_RUN_MS / TICKLESS_NAP_MS; i++)
+        vTaskDelay(pdMS_TO_TICKS(TICKLESS_NAP_MS));
+
+    hw_idle_get_stats(&stop[1], &sleep[1]);
+    ticks[1] = _wait_for_second(&secs[1]);
+
+    uint32_t elapsed = ticks[1] - ticks[0];
+    uint32_t rtc = (secs[1] - secs[0]) * configTICK_RATE_HZ;
+    uint32_t stopped = stop[1] - stop[0];
+    uint32_t dozed = sleep[1] - sleep[0];
+
+    APP_LOG("tlstst", APP_LOG_LEVEL_ERROR, "%d ms by the ticks, %d ms by the RTC: stopped %d ms, dozed %d ms, awake %d ms",
+            elapsed * portTICK_PERIOD_MS, rtc * portTICK_PERIOD_MS, stopped * portTICK_PERIOD_MS,
+            dozed * portTICK_PERIOD_MS, (elapsed - MIN(elapsed, stopped + dozed)) * portTICK_PERIOD_MS);
+
+    /* we did sleep through ticks, and still kept time */
+    test_assert(stopped + dozed > 0);
+    test_assert(elapsed + TICKLESS_TOLERANCE >= rtc && elapsed <= rtc + TICKLESS_TOLERANCE);
+
+    test_complete(test_get_success());
+    return true;
+}
+
+bool tickless_test_deinit(void)
+{
+    APP_LOG("tlstst", APP_LOG_LEVEL_ERROR, "De-Init: Tickless Test");
+    return true;
+}
@@ -0,0 +1,145 @@
+/* time_cache_test.c
+ * Routines for checking the cached local time against musl
+ * RebbleOS
+ */
+
+#include "rebbleos.h"
+#include "systemapp.h"
+#include "test_defs.h"
+
+#define TIME_WALK_STEPS      20000
+#define TIME_RANDOM          2000
+#define TIME_CONVERSIONS     5000
+
+/* GMT0BST,M3.5.0/1,M10.5.0 */
+static const RebbleTimezone _uk = {
+    .utc_offset = 0,
+    .dst_offset = 60 * 60,
+    .dst_start = { .month = 2, .week = 5, .wday = 0, .secs = 60 * 60 },
+    .dst_end = { .month = 9, .week = 5, .wday = 0, .secs = 2 * 60 * 60 },
+};
+
+static const RebbleTimezone _utc = { 0 };
+
+static bool _same(struct tm *a, struct tm *b)
+{
+    return a->tm_sec == b->tm_sec && a->tm_min == b->tm_min && a->tm_hour == b->tm_hour &&
+           a->tm_mday == b->tm_mday && a->tm_mon == b->tm_mon && a->tm_year == b->tm_year &&
+           a->tm_wday == b->tm_wday && a->tm_yday == b->tm_yday;
+}
+
+/* Walk over a leap day and a new year, a few seconds at a time */
+static bool _equivalence(void)
+{
+    struct tm ours, theirs;
+    time_t t = 1451606400 - (60 * 24 * 60 * 60); /* two months before 2016 */
+
+    for (int i = 0; i < TIME_WALK_STEPS; i++)
+    {
+        t += rand() % 1200;
+        rcore_localtime(&ours, t);
+        localtime_r(&t, &theirs);
+        test_assert(_same(&ours, &theirs));
+    }
+
+    for (int i = 0; i < TIME_RANDOM; i++)
+    {
+        t = rand() & 0x7FFFFFFF;
+        rcore_localtime(&ours, t);
+        localtime_r(&t, &theirs);
+        test_assert(_same(&ours, &theirs));
+    }
+
+    return true;
+}
+
+static bool _local_is(time_t t, int hour, int min, int sec, int isdst)
+{
+    struct tm tm;
+    rcore_localtime(&tm, t);
+    return tm.tm_hour == hour && tm.tm_min == min && tm.tm_sec == sec && tm.tm_isdst == isdst;
+}
+
+/* Either side of the UK going on and off summer time in 2024 */
+static bool _dst(void)
+{
+    rcore_time_set_timezone(&_uk);
+
+    test_assert(_local_is(1711846799, 0, 59, 59, 0));
+    test_assert(_local_is(1711846800, 2, 0, 0, 1));
+    test_assert(_local_is(1729990799, 1, 59, 59, 1));
+    test_assert(_local_is(1729990800, 1, 0, 0, 0));
+
+    /* and back again, including the hour that happens twice */
+    struct tm tm;
+    rcore_localtime(&tm, 1729987200);
+    test_assert(rcore_mktime(&tm) == 1729987200);
+    rcore_localtime(&tm, 1729990800);
+    test_assert(rcore_mktime(&tm) == 1729990800);
+
+    /* put right on the way, over the hour that never happens */
+    rcore_localtime(&tm, 1711845000);
+    tm.tm_min += 90;
+    test_assert(rcore_mktime(&tm) == 1711846800);
+    test_assert(tm.tm_mday == 31 && tm.tm_hour == 2 && tm.tm_min == 0 && tm.tm_isdst == 1);
+
+    rcore_time_set_timezone(&_utc);
+    return true;
+}
+
+static uint32_t _cycles(TickType_t ticks)
+{
+    return (ticks * (configCPU_CLOCK_HZ / configTICK_RATE_HZ)) / TIME_CONVERSIONS;
+}
+
+static void _benchmark(void)
+{
+    struct tm tm;
+    volatile int sink = 0;
+    time_t now;
+    rcore_time_ms(&now, NULL);
+
+    TickType_t start = xTaskGetTickCount();
+    for (int i = 0; i < TIME_CONVERSIONS; i++)
+    {
+        rcore_localtime(&tm, now + i);
+        sink += tm.tm_sec;
+    }
+    TickType_t cached = xTaskGetTickCount() - start;
+
+    start = xTaskGetTickCount();
+    for (int i = 0; i < TIME_CONVERSIONS; i++)
+    {
+        time_t t = now + i;
+        localtime_r(&t, &tm);
+        sink += tm.tm_sec;
+    }
+    TickType_t musl = xTaskGetTickCount() - start;
+
+    APP_LOG("timtst", APP_LOG_LEVEL_ERROR, "a second on: cached %d cycles, musl %d cycles", _cycles(cached), _cycles(musl));
+}
+
+bool time_cache_test_init(Window *window)
+{
+    APP_LOG("timtst", APP_LOG_LEVEL_ERROR, "Init: Time Cache Test");
+    return true;
+}
+
+bool time_cache_test_exec(void)
+{
+    APP_LOG("timtst", APP_LOG_LEVEL_ERROR, "Exec: Time Cache Test");
+
+    test_assert(_equivalence());
+    test_assert(_dst());
+    _benchmark();
+
+    test_complete(test_get_success());
+    return true;
+}
+
+bool time_cache_test_deinit(void)
+{
+    APP_LOG("timtst", APP_LOG_LEVEL_ERROR, "De-Init: Time Cache Test");
+    rcore_time_set_timezone(&_utc);
+    return true;
+}
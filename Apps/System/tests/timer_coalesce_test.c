@@ -0,0 +1,134 @@
+/* timer_coalesce_test.c
+ * Routines for counting how often timers wake us up
+ * RebbleOS
+ */
+
+#include "rebbleos.h"
+#include "systemapp.h"
+#include "test_defs.h"
+#include "utils.h"
+
+#define COALESCE_RUN_MS      3000
+/* long enough for the slowest of the last lot to have gone off */
+#define COALESCE_DRAIN_MS    2000
+
+/* what a watchface with a notification up keeps going */
+typedef struct coalesce_timer {
+    const char *name;
+    uint32_t period_ms;
+    uint32_t slack_ms;
+    TickType_t due;
+    TickType_t worst_late;
+} coalesce_timer;
+
+static coalesce_timer _timers[] = {
+    /* the seconds hand doesn't get any slack */
+    { "second tick", 1000, 0 },
+    { "battery poll", 350, 250 },
+    { "notification timeout", 700, 300 },
+    { "status refresh", 450, 300 },
+};
+
+#define COALESCE_TIMERS (sizeof(_timers) / sizeof(coalesce_timer))
+
+static bool _use_slack;
+static bool _running;
+static uint8_t _pass;
+static uint32_t _wakeups_at_start;
+static TickType_t _started;
+static uint32_t _per_minute[2];
+
+static void _second_pass(void *priv);
+static void _start_pass(bool use_slack);
+static void _schedule(coalesce_timer *timer);
+
+static void _timer_fired(void *priv)
+{
+    coalesce_timer *timer = (coalesce_timer *)priv;
+    TickType_t now = xTaskGetTickCount();
+
+    if (!_running)
+        return;
+
+    /* never early, whatever the slack */
+    test_assert(!TIMER_BEFORE(now, timer->due));
+    timer->worst_late = MAX(timer->worst_late, now - timer->due);
+
+    _schedule(timer);
+}
+
+static void _schedule(coalesce_timer *timer)
+{
+    timer->due = xTaskGetTickCount() + pdMS_TO_TICKS(timer->period_ms);
+    app_timer_register_with_slack(timer->period_ms, _use_slack ? timer->slack_ms : 0, _timer_fired, timer);
+}
+
+static void _end_pass(void *priv)
+{
+    TickType_t elapsed = xTaskGetTickCount() - _started;
+    uint32_t wakeups = appmanager_get_current_thread()->timers.wakeups - _wakeups_at_start;
+
+    _running = false;
+    _per_minute[_pass] = (wakeups * 60000) / (elapsed * portTICK_PERIOD_MS);
+
+    APP_LOG("tcotst", APP_LOG_LEVEL_ERROR, "%s: %d wakeups in %d ms, %d a minute",
+            _use_slack ? "with slack" : "without slack", wakeups, elapsed * portTICK_PERIOD_MS, _per_minute[_pass]);
+    for (int i = 0; i < COALESCE_TIMERS; i++)
+        APP_LOG("tcotst", APP_LOG_LEVEL_ERROR, "  %s: up to %d ms late", _timers[i].name,
+                _timers[i].worst_late * portTICK_PERIOD_MS);
+
+    if (_pass++ == 0)
+    {
+        /* let the last of the first lot drain before starting again */
+        app_timer_register(COALESCE_DRAIN_MS, _second_pass, NULL);
+        return;
+    }
+
+    /* batching them should have saved us some */
+    test_assert(_per_minute[1] < _per_minute[0]);
+    test_complete(test_get_success());
+}
+
+static void _start_pass(bool use_slack)
+{
+    _use_slack = use_slack;
+    _running = true;
+    _started = xTaskGetTickCount();
+    _wakeups_at_start = appmanager_get_current_thread()->timers.wakeups;
+
+    for (int i = 0; i < COALESCE_TIMERS; i++)
+    {
+        _timers[i].worst_late = 0;
+        _schedule(&_timers[i]);
+    }
+
+    app_timer_register(COALESCE_RUN_MS, _end_pass, NULL);
+}
+
+static void _second_pass(void *priv)
+{
+    _start_pass(true);
+}
+
+bool timer_coalesce_test_init(Window *window)
+{
+    APP_LOG("tcotst", APP_LOG_LEVEL_ERROR, "Init: Timer Coalesce Test");
+    return true;
+}
+
+bool timer_coalesce_test_exec(void)
+{
+    APP_LOG("tcotst", APP_LOG_LEVEL_ERROR, "Exec: Timer Coalesce Test");
+
+    _pass = 0;
+    _start_pass(false);
+
+    return true;
+}
+
+bool timer_coalesce_test_deinit(void)
+{
+    APP_LOG("tcotst", APP_LOG_LEVEL_ERROR, "De-Init: Timer Coalesce Test");
+    _running = false;
+    return true;
+}
@@ -0,0 +1,142 @@
+/* timer_heap_test.c
+ * Routines for stressing and timing the timer heap
+ * RebbleOS
+ */
+
+#include "rebbleos.h"
+#include "systemapp.h"
+#include "test_defs.h"
+
+#define HEAP_TIMERS          400
+#define HEAP_ROUNDS          20
+/* start just shy of the tick count wrapping, so half of them are past it */
+#define HEAP_BASE            ((TickType_t)(0 - 5000))
+#define HEAP_SPREAD          10000
+
+static CoreTimer *_timers;
+
+/* every parent fires no later than its children, and the links agree */
+static bool _heap_valid(CoreTimer *node, uint16_t *count)
+{
+    if (!node)
+        return true;
+
+    (*count)++;
+    if (node->left && (node->left->parent != node || TIMER_BEFORE(node->left->when, node->when)))
+        return false;
+    if (node->right && (node->right->parent != node || TIMER_BEFORE(node->right->when, node->when)))
+        return false;
+
+    return _heap_valid(node->left, count) && _heap_valid(node->right, count);
+}
+
+static bool _check(CoreTimerHeap *heap)
+{
+    uint16_t count = 0;
+    return _heap_valid(heap->root, &count) && count == heap->count;
+}
+
+/*
+ * Fill it, knock random ones out, put some back somewhere else, then
+ * drain it and make sure it all came out in order.
+ */
+static bool _stress(void)
+{
+    CoreTimerHeap heap = { 0 };
+
+    for (int round = 0; round < HEAP_ROUNDS; round++)
+    {
+        for (int i = 0; i < HEAP_TIMERS; i++)
+        {
+            _timers[i] = (CoreTimer) { .when = HEAP_BASE + (rand() % HEAP_SPREAD) };
+            timer_heap_insert(&heap, &_timers[i]);
+        }
+        test_assert(_check(&heap));
+
+        for (int i = 0; i < HEAP_TIMERS / 3; i++)
+        {
+            CoreTimer *t = &_timers[rand() % HEAP_TIMERS];
+            if (!timer_heap_remove(&heap, t))
+                continue;
+            if (rand() & 1)
+            {
+                t->when = HEAP_BASE + (rand() % HEAP_SPREAD);
+                timer_heap_insert(&heap, t);
+            }
+        }
+        test_assert(_check(&heap));
+
+        /* you can't take one out twice */
+        CoreTimer *root = heap.root;
+        test_assert(timer_heap_remove(&heap, root));
+        test_assert(!timer_heap_remove(&heap, root));
+        test_assert(!timer_heap_contains(&heap, root));
+
+        TickType_t last = heap.root ? heap.root->when : 0;
+        while (heap.root)
+        {
+            CoreTimer *t = heap.root;
+            test_assert(!TIMER_BEFORE(t->when, last));
+            last = t->when;
+            timer_heap_remove(&heap, t);
+        }
+        test_assert(heap.count == 0);
+    }
+
+    return true;
+}
+
+/* time a fill and drain, and a remove from the middle, at a few sizes */
+static void _benchmark(void)
+{
+    static const uint16_t sizes[] = { 25, 100, 400 };
+
+    for (int s = 0; s < 3; s++)
+    {
+        CoreTimerHeap heap = { 0 };
+        uint16_t n = sizes[s];
+
+        TickType_t start = xTaskGetTickCount();
+        for (int round = 0; round < HEAP_ROUNDS; round++)
+        {
+            for (int i = 0; i < n; i++)
+            {
+                _timers[i].when = HEAP_BASE + ((i * 7919) % HEAP_SPREAD);
+                timer_heap_insert(&heap, &_timers[i]);
+            }
+            for (int i = 0; i < n; i++)
+                timer_heap_remove(&heap, &_timers[(i * 13) % n]);
+        }
+        TickType_t elapsed = xTaskGetTickCount() - start;
+
+        APP_LOG("heaptst", APP_LOG_LEVEL_ERROR, "%d timers: %d inserts and removes in %d ms, %d cycles each",
+                n, n * HEAP_ROUNDS * 2, elapsed * portTICK_PERIOD_MS,
+                (elapsed * (configCPU_CLOCK_HZ / configTICK_RATE_HZ)) / (n * HEAP_ROUNDS * 2));
+    }
+}
+
+bool timer_heap_test_init(Window *window)
+{
+    APP_LOG("heaptst", APP_LOG_LEVEL_ERROR, "Init: Timer Heap Test");
+    _timers = app_calloc(HEAP_TIMERS, sizeof(CoreTimer));
+    return _timers != NULL;
+}
+
+bool timer_heap_test_exec(void)
+{
+    APP_LOG("heaptst", APP_LOG_LEVEL_ERROR, "Exec: Timer Heap Test");
+
+    test_assert(_stress());
+    _benchmark();
+
+    test_complete(test_get_success());
+    return true;
+}
+
+bool timer_heap_test_deinit(void)
+{
+    APP_LOG("heaptst", APP_LOG_LEVEL_ERROR, "De-Init: Timer Heap Test");
+    app_free(_timers);
+    _timers = NULL;
+    return true;
+}
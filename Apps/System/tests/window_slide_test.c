@@ -0,0 +1,166 @@
+/* window_slide_test.c
+ * Routines for timing window push transitions
+ * RebbleOS
+ */
+
+#include "rebbleos.h"
+#include "systemapp.h"
+#include "menu_layer.h"
+#include "test_defs.h"
+#include "utils.h"
+
+#define SLIDE_STEP           6
+#define SLIDE_MENU_ROWS      20
+
+static Window *_main_window;
+static Window *_slide_window;
+static MenuLayer *_menu_layer;
+static TextLayer *_text_layer;
+
+static uint16_t _get_num_rows(MenuLayer *menu_layer, uint16_t section_index, void *context)
+{
+    return SLIDE_MENU_ROWS;
+}
+
+static void _draw_row(GContext *ctx, const Layer *layer, MenuIndex *cell_index, void *context)
+{
+    menu_cell_basic_draw(ctx, layer, "Row", "Subtitle", NULL);
+}
+
+static uint32_t _checksum(void)
+{
+    uint32_t sum = 0;
+#ifndef PBL_BW
+    uint8_t *fb = display_get_buffer();
+    for (uint32_t i = 0; i < DISPLAY_ROWS * DISPLAY_COLS; i++)
+        sum = (sum * 31) + fb[i];
+#endif
+    return sum;
+}
+
+/*
+ * Slide the window in from one side to rest at 0, a frame at a time,
+ * the way the push animation does. Returns the time taken.
+ */
+static TickType_t _slide(int16_t from, int *frames)
+{
+    int16_t step = from > 0 ? -SLIDE_STEP : SLIDE_STEP;
+    int16_t x = from;
+
+    *frames = 0;
+    TickType_t start = xTaskGetTickCount();
+    for (;;)
+    {
+        _slide_window->frame.origin.x = x;
+        rbl_window_draw(_slide_window);
+        (*frames)++;
+
+        if (x == 0)
+            break;
+        x += step;
+        if ((step < 0 && x < 0) || (step > 0 && x > 0))
+            x = 0;
+    }
+    return xTaskGetTickCount() - start;
+}
+
+/*
+ * Time the slide from each side, painting every frame in full and then
+ * pushing the framebuffer. Then repaint the last pushed frame in full
+ * and make sure they came out the same.
+ */
+static bool _run(void)
+{
+    static const int16_t from[] = { DISPLAY_COLS, -DISPLAY_COLS };
+    TickType_t elapsed[2][2];
+    int frames = 0;
+    uint32_t pushed = 0, full = 0;
+
+    for (int pass = 0; pass < 2; pass++)
+    {
+        /* only an animated push arms the framebuffer push */
+        window_stack_push(_slide_window, pass == 1);
+
+        if (!display_buffer_lock_take(pdMS_TO_TICKS(100)))
+            return false;
+
+        for (int side = 0; side < 2; side++)
+        {
+            /* start each slide from the old window */
+            rbl_window_draw(_main_window);
+            elapsed[pass][side] = _slide(from[side], &frames);
+        }
+
+        if (pass == 1)
+        {
+            pushed = _checksum();
+            /* it hasn't moved, so this one is painted in full */
+            rbl_window_draw(_slide_window);
+            full = _checksum();
+        }
+
+        display_buffer_lock_give();
+        window_stack_remove(_slide_window, false);
+    }
+
+    for (int side = 0; side < 2; side++)
+    {
+        APP_LOG("slidtst", APP_LOG_LEVEL_ERROR, "%dx%d slide %s: %d frames, full %d ms (%d fps), pushed %d ms (%d fps)",
+                DISPLAY_COLS, DISPLAY_ROWS, side ? "right" : "left", frames,
+                elapsed[0][side] * portTICK_PERIOD_MS,
+                (frames * 1000) / MAX(1, elapsed[0][side] * portTICK_PERIOD_MS),
+                elapsed[1][side] * portTICK_PERIOD_MS,
+                (frames * 1000) / MAX(1, elapsed[1][side] * portTICK_PERIOD_MS));
+    }
+
+    test_assert(pushed == full);
+    return true;
+}
+
+bool window_slide_test_init(Window *window)
+{
+    APP_LOG("slidtst", APP_LOG_LEVEL_ERROR, "Init: Window Slide Test");
+    _main_window = window;
+
+    _slide_window = window_create();
+    window_set_background_color(_slide_window, GColorBlue);
+    Layer *window_layer = window_get_root_layer(_slide_window);
+    GRect bounds = layer_get_bounds(window_layer);
+
+    _text_layer = text_layer_create(GRect(0, 0, bounds.size.w, 30));
+    text_layer_set_text(_text_layer, "Sliding in");
+    layer_add_child(window_layer, text_layer_get_layer(_text_layer));
+
+    _menu_layer = menu_layer_create(GRect(0, 30, bounds.size.w, bounds.size.h - 30));
+    menu_layer_set_center_focused(_menu_layer, false);
+    menu_layer_set_callbacks(_menu_layer, NULL, (MenuLayerCallbacks) {
+        .get_num_rows = _get_num_rows,
+        .draw_row = _draw_row,
+    });
+    layer_add_child(window_layer, menu_layer_get_layer(_menu_layer));
+
+    return true;
+}
+
+bool window_slide_test_exec(void)
+{
+    APP_LOG("slidtst", APP_LOG_LEVEL_ERROR, "Exec: Window Slide Test");
+
+    test_assert(_run());
+
+    window_dirty(true);
+    test_complete(test_get_success());
+    return true;
+}
+
+bool window_slide_test_deinit(void)
+{
+    APP_LOG("slidtst", APP_LOG_LEVEL_ERROR, "De-Init: Window Slide Test");
+    menu_layer_destroy(_menu_layer);
+    text_layer_destroy(_text_layer);
+    window_destroy(_slide_window);
+    _menu_layer = NULL;
+    _text_layer = NULL;
+    _slide_window = NULL;
+    return true;
+}
@@ -0,0 +1,257 @@
+/* worker_test.c
+ * Routines for testing app workers, and timing the messages between them
+ * RebbleOS
+ */
+
+#include "rebbleos.h"
+#include "systemapp.h"
+#include "test_defs.h"
+#include "utils.h"
+
+/* messages from the app */
+#define WORKER_CMD_FLOOD     1
+#define WORKER_CMD_LOAD      2
+/* and back from the worker */
+#define WORKER_MSG_READY     10
+#define WORKER_MSG_SEQ       11
+#define WORKER_MSG_DONE      12
+#define WORKER_MSG_LOAD_DONE 13
+
+#define WORKER_FLOOD_COUNT   2000
+#define WORKER_LOAD_MS       3000
+#define WORKER_DRAW_PASSES   20
+/* how long we watch a timer for, and how often it's meant to go */
+#define WORKER_TIMER_RUN_MS  1000
+#define WORKER_TIMER_MS      20
+
+/* What the UI looked like over one pass */
+typedef struct worker_ui_sample {
+    TickType_t draw; /* for all of the draw passes */
+    TickType_t worst_late; /* the latest our timer went off */
+} worker_ui_sample;
+
+static Window *_main_window;
+static bool _running;
+static bool _under_load;
+static uint16_t _expected;
+static uint16_t _out_of_order;
+static TickType_t _started;
+static TickType_t _timer_due;
+static TickType_t _timer_stop;
+static worker_ui_sample _idle, _loaded;
+static bool _load_done;
+static bool _sampled;
+
+static void _ui_sample_start(void);
+
+/* The worker's side of things. This runs on the worker thread */
+
+static void _worker_ready(void *priv)
+{
+    AppWorkerMessage msg = { 0 };
+    app_worker_send_message(WORKER_MSG_READY, &msg);
+}
+
+static void _worker_handler(uint16_t type, AppWorkerMessage *data)
+{
+    AppWorkerMessage msg = { 0 };
+
+    if (type == WORKER_CMD_FLOOD)
+    {
+        for (uint16_t i = 0; i < data->data0; i++)
+        {
+            msg.data0 = i;
+            app_worker_send_message(WORKER_MSG_SEQ, &msg);
+        }
+        msg.data0 = data->data0;
+        app_worker_send_message(WORKER_MSG_DONE, &msg);
+    }
+    else if (type == WORKER_CMD_LOAD)
+    {
+        /* as much CPU as we can get, for as long as we're told */
+        TickType_t until = xTaskGetTickCount() + pdMS_TO_TICKS(data->data0);
+        volatile uint32_t spin = 0;
+
+        while (TIMER_BEFORE(xTaskGetTickCount(), until))
+            spin++;
+
+        app_worker_send_message(WORKER_MSG_LOAD_DONE, &msg);
+    }
+}
+
+void worker_test_worker_main(void)
+{
+    app_worker_message_subscribe(_worker_handler);
+    /* say hello from the worker's own timers, once it's in its runloop */
+    app_timer_register(10, _worker_ready, NULL);
+    worker_event_loop();
+    app_worker_message_unsubscribe();
+}
+
+/* And the app's */
+
+static TickType_t _draw_passes(void)
+{
+    TickType_t start = xTaskGetTickCount();
+
+    if (!display_buffer_lock_take(pdMS_TO_TICKS(100)))
+        return portMAX_DELAY;
+
+    for (int i = 0; i < WORKER_DRAW_PASSES; i++)
+        rbl_window_draw(_main_window);
+    display_buffer_lock_give();
+
+    return xTaskGetTickCount() - start;
+}
+
+static void _finish(void)
+{
+    AppWorkerStats to_worker, to_app;
+
+    app_worker_get_stats(&to_worker, &to_app);
+    APP_LOG("wkrtst", APP_LOG_LEVEL_ERROR, "to worker: %d sent %d delivered %d dropped",
+            to_worker.sent, to_worker.delivered, to_worker.dropped);
+    APP_LOG("wkrtst", APP_LOG_LEVEL_ERROR, "to app: %d sent %d delivered %d dropped, worker waited %d times",
+            to_app.sent, to_app.delivered, to_app.dropped, to_app.waits);
+
+    test_assert(app_worker_kill() == APP_WORKER_RESULT_SUCCESS);
+    window_dirty(true);
+    test_complete(test_get_success());
+}
+
+static void _ui_sample_tick(void *priv)
+{
+    worker_ui_sample *sample = _under_load ? &_loaded : &_idle;
+    TickType_t now = xTaskGetTickCount();
+
+    if (!_running)
+        return;
+
+    sample->worst_late = MAX(sample->worst_late, now - _timer_due);
+
+    if (TIMER_BEFORE(now, _timer_stop))
+    {
+        _timer_due = now + pdMS_TO_TICKS(WORKER_TIMER_MS);
+        app_timer_register(WORKER_TIMER_MS, _ui_sample_tick, NULL);
+        return;
+    }
+
+    if (!_under_load)
+    {
+        /* now get a worker going */
+        test_assert(app_worker_launch() == APP_WORKER_RESULT_SUCCESS);
+        return;
+    }
+
+    APP_LOG("wkrtst", APP_LOG_LEVEL_ERROR, "%d draws: %d ms idle, %d ms with the worker busy",
+            WORKER_DRAW_PASSES, _idle.draw * portTICK_PERIOD_MS, _loaded.draw * portTICK_PERIOD_MS);
+    APP_LOG("wkrtst", APP_LOG_LEVEL_ERROR, "%d ms timer: up to %d ms late idle, %d ms with the worker busy",
+            WORKER_TIMER_MS, _idle.worst_late * portTICK_PERIOD_MS, _loaded.worst_late * portTICK_PERIOD_MS);
+
+    /* the worker runs below us, so it shouldn't cost the UI anything much */
+    test_assert(_loaded.draw <= _idle.draw * 2 + pdMS_TO_TICKS(10));
+    test_assert(_loaded.worst_late <= _idle.worst_late + pdMS_TO_TICKS(5));
+
+    _sampled = true;
+    if (_load_done)
+        _finish();
+}
+
+static void _ui_sample_start(void)
+{
+    worker_ui_sample *sample = _under_load ? &_loaded : &_idle;
+
+    sample->draw = _draw_passes();
+    sample->worst_late = 0;
+    _timer_stop = xTaskGetTickCount() + pdMS_TO_TICKS(WORKER_TIMER_RUN_MS);
+    _timer_due = xTaskGetTickCount() + pdMS_TO_TICKS(WORKER_TIMER_MS);
+    app_timer_register(WORKER_TIMER_MS, _ui_sample_tick, NULL);
+}
+
+static void _app_handler(uint16_t type, AppWorkerMessage *data)
+{
+    AppWorkerMessage msg = { 0 };
+
+    if (!_running)
+        return;
+
+    switch (type)
+    {
+        case WORKER_MSG_READY:
+            test_assert(app_worker_is_running());
+            APP_LOG("wkrtst", APP_LOG_LEVEL_ERROR, "Worker up, flooding %d messages", WORKER_FLOOD_COUNT);
+            _expected = 0;
+            _out_of_order = 0;
+            _started = xTaskGetTickCount();
+            msg.data0 = WORKER_FLOOD_COUNT;
+            app_worker_send_message(WORKER_CMD_FLOOD, &msg);
+            break;
+
+        case WORKER_MSG_SEQ:
+            if (data->data0 != _expected)
+                _out_of_order++;
+            _expected = data->data0 + 1;
+            break;
+
+        case WORKER_MSG_DONE:
+        {
+            TickType_t elapsed = MAX(xTaskGetTickCount() - _started, 1);
+
+            APP_LOG("wkrtst", APP_LOG_LEVEL_ERROR, "%d messages in %d ms, %d a second, %d out of order",
+                    _expected, elapsed * portTICK_PERIOD_MS,
+                    (_expected * 1000) / (elapsed * portTICK_PERIOD_MS), _out_of_order);
+
+            /* the worker waits for us rather than drop anything */
+            test_assert(data->data0 == WORKER_FLOOD_COUNT);
+            test_assert(_expected == WORKER_FLOOD_COUNT);
+            test_assert(_out_of_order == 0);
+
+            /* and now see what it costs us when it's busy */
+            msg.data0 = WORKER_LOAD_MS;
+            app_worker_send_message(WORKER_CMD_LOAD, &msg);
+            _under_load = true;
+            _ui_sample_start();
+            break;
+        }
+
+        case WORKER_MSG_LOAD_DONE:
+            _load_done = true;
+            if (_sampled)
+                _finish();
+            break;
+    }
+}
+
+bool worker_test_init(Window *window)
+{
+    APP_LOG("wkrtst", APP_LOG_LEVEL_ERROR, "Init: Worker Test");
+    _main_window = window;
+    return true;
+}
+
+bool worker_test_exec(void)
+{
+    APP_LOG("wkrtst", APP_LOG_LEVEL_ERROR, "Exec: Worker Test");
+
+    _running = true;
+    _under_load = false;
+    _load_done = false;
+    _sampled = false;
+    test_assert(!app_worker_is_running());
+    app_worker_message_subscribe(_app_handler);
+
+    /* what the UI is like with nothing else going on */
+    _ui_sample_start();
+
+    return true;
+}
+
+bool worker_test_deinit(void)
+{
+    APP_LOG("wkrtst", APP_LOG_LEVEL_ERROR, "De-Init: Worker Test");
+    _running = false;
+    app_worker_message_unsubscribe();
+    if (app_worker_is_running())
+        app_worker_kill();
+    return true;
+}
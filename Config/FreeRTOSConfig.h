@@ -93,7 +93,7 @@
 #define configSUPPORT_STATIC_ALLOCATION 1
 
 #define configUSE_PREEMPTION   1
-#define configUSE_IDLE_HOOK    0
+#define configUSE_IDLE_HOOK    1
 #define configUSE_TICK_HOOK    0
 #define configCPU_CLOCK_HZ    ( SystemCoreClock )
 #define configTICK_RATE_HZ    ( ( TickType_t ) 1000 )
@@ -113,8 +113,23 @@
 #define configUSE_COUNTING_SEMAPHORES 1
 #define configGENERATE_RUN_TIME_STATS 0
 #define configUSE_TASK_NOTIFICATIONS            1
+#define configUSE_TICKLESS_IDLE 1
 //#define portBYTE_ALIGNMENT 4
 
+/* Tickless idle is done by the platform, deep in STOP where it can be.
+   See hw/drivers/stm32_rtc/stm32_tickless.c */
+extern void hw_idle_sleep(uint32_t expected_idle_ticks);
+#define portSUPPRESS_TICKS_AND_SLEEP( xExpectedIdleTime ) hw_idle_sleep( xExpectedIdleTime )
+
+/* With MEMORY_TRACE, every allocation from the heap goes in the memory trace.
+   See rcore/memory_trace.c */
+#ifdef MEMORY_TRACE
+extern void memory_trace_system_alloc(void *ptr, size_t size, void *caller);
+extern void memory_trace_system_free(void *ptr, void *caller);
+#define traceMALLOC( pvAddress, uiSize ) memory_trace_system_alloc( pvAddress, uiSize, __builtin_return_address( 0 ) )
+#define traceFREE( pvAddress, uiSize ) memory_trace_system_free( pvAddress, __builtin_return_address( 0 ) )
+#endif
+
 /* Co-routine definitions. */
 #define configUSE_CO_ROUTINES   0
 #define configMAX_CO_ROUTINE_PRIORITIES ( 2 )
@@ -135,6 +150,7 @@
 #define INCLUDE_vTaskDelayUntil   1
 #define INCLUDE_vTaskDelay    1
 #define INCLUDE_xTaskGetCurrentTaskHandle 1
+#define INCLUDE_uxTaskGetStackHighWaterMark 1
 // #define INCLUDE_xSemaphoreGetMutexHolder 1
 
 /* Cortex-M specific definitions. */
@@ -0,0 +1,213 @@
+#!/usr/bin/env python
+
+"""
+Turns a memory trace dump into a report of who allocates what.
+RebbleOS
+
+Build with -DMEMORY_TRACE (see config.mk) and the firmware keeps the last
+few hundred allocations and frees from every heap, with who made them. It
+dumps them to the log when the system heap runs out, or whenever
+memory_trace_dump() is called. Hand this the log:
+
+  heap_report.py [--elf build/snowy/tintin_fw.elf] log.txt
+
+and for each heap it prints how full it is, and for each place that
+allocates: how many times, how many bytes, how many it still has and the
+most it ever had at once. Callers inside an app are shown as an offset
+into the app (app+0x...), to look up in the app's own elf.
+
+With --bench, one heap's trace is written out for Utilities/qalloc_bench.c
+to replay instead, so an allocator can be tried against what really
+happened on the watch.
+"""
+
+import argparse
+import re
+import subprocess
+import sys
+
+# as many ids as qalloc_bench takes
+BENCH_MAX_IDS = 4096
+
+LINE = re.compile(r'mtrace (\w+) ?(.*)$')
+
+class Site(object):
+  def __init__(self):
+    self.allocs = 0
+    self.failed = 0
+    self.frees = 0
+    self.bytes = 0
+    self.live = 0
+    self.live_bytes = 0
+    self.peak_bytes = 0
+
+  def grow(self, size):
+    self.live_bytes += size
+    self.peak_bytes = max(self.peak_bytes, self.live_bytes)
+
+class Dump(object):
+  def __init__(self):
+    self.total = 0
+    self.kept = 0
+    self.heaps = {}   # name: (base, size)
+    self.stats = {}   # name: (size, used, peak, largest)
+    self.events = []  # (op, heap, caller, ptr, old, size)
+
+def parse(lines):
+  """The last complete dump in the log, or whatever there is of one, with
+  the latest stats for each heap, as they're logged outside dumps too"""
+  dump, last, stats = None, None, {}
+  for line in lines:
+    m = LINE.search(line)
+    if not m:
+      continue
+    kind, rest = m.group(1), m.group(2).split()
+    if kind == 'begin':
+      dump = Dump()
+      dump.total, dump.kept = int(rest[0]), int(rest[1])
+    elif kind == 'end':
+      last, dump = dump, None
+    elif kind == 'stats':
+      stats[rest[0]] = tuple(int(x) for x in rest[1:5])
+    elif dump is None:
+      continue
+    elif kind == 'heap':
+      dump.heaps[rest[0]] = (int(rest[1], 16), int(rest[2]))
+    elif kind in ('a', 'r', 'f'):
+      heap, caller, ptr, old, size = rest[0], int(rest[1], 16), int(rest[2], 16), int(rest[3], 16), int(rest[4])
+      dump.events.append((kind, heap, caller, ptr, old, size))
+
+  dump = dump or last
+  if not dump and stats:
+    dump = Dump()
+  if dump:
+    dump.stats = stats
+  return dump
+
+class Namer(object):
+  """Says where a caller is: in an app, or (given the elf) in the firmware"""
+  def __init__(self, dump, elf, addr2line):
+    self.dump = dump
+    self.elf = elf
+    self.addr2line = addr2line
+    self.names = {}
+
+  def lookup(self, callers):
+    kernel = [c for c in callers if self._in_app(c) is None]
+    if not self.elf or not kernel:
+      return
+    # the return address is just past the call, and has the thumb bit set
+    args = [self.addr2line, '-f', '-s', '-e', self.elf] + ['0x%x' % ((c & ~1) - 1) for c in kernel]
+    try:
+      out = subprocess.check_output(args).decode().splitlines()
+    except (OSError, subprocess.CalledProcessError) as e:
+      sys.stderr.write("couldn't run %s: %s\n" % (self.addr2line, e))
+      return
+    for i, caller in enumerate(kernel):
+      self.names[caller] = '%s (%s)' % (out[i * 2], out[i * 2 + 1])
+
+  def _in_app(self, caller):
+    for name, (base, size) in self.dump.heaps.items():
+      if base <= caller < base + size:
+        return '%s+0x%x' % (name, caller - base)
+    return None
+
+  def name(self, caller):
+    return self._in_app(caller) or self.names.get(caller, '0x%08x' % caller)
+
+def report(dump, namer, out):
+  out.write('%d events, the last %d kept\n\n' % (dump.total, dump.kept))
+
+  if dump.stats:
+    out.write('%-10s %8s %8s %8s %8s %6s\n' % ('heap', 'size', 'used', 'peak', 'largest', 'frag'))
+    for name, (size, used, peak, largest) in sorted(dump.stats.items()):
+      free = size - used
+      frag = 100 - (largest * 100 // free) if free else 0
+      out.write('%-10s %8d %8d %8d %8d %5d%%\n' % (name, size, used, peak, largest, frag))
+    out.write('\n')
+
+  # who made each allocation still around, by heap and address
+  sites = {}
+  owner = {}
+
+  def site(heap, caller):
+    return sites.setdefault((heap, caller), Site())
+
+  for op, heap, caller, ptr, old, size in dump.events:
+    if op == 'f':
+      # allocated before the ring starts, so we don't know whose it was
+      if (heap, ptr) not in owner:
+        continue
+      key, size = owner.pop((heap, ptr))
+      s = sites[key]
+      s.frees += 1
+      s.live -= 1
+      s.live_bytes -= size
+      continue
+
+    if op == 'r' and (heap, old) in owner and ptr:
+      key, was = owner.pop((heap, old))
+      sites[key].live -= 1
+      sites[key].live_bytes -= was
+
+    s = site(heap, caller)
+    s.allocs += 1
+    if not ptr:
+      s.failed += 1
+      continue
+    s.bytes += size
+    s.live += 1
+    s.grow(size)
+    owner[(heap, ptr)] = ((heap, caller), size)
+
+  namer.lookup(set(caller for (heap, caller) in sites))
+
+  for heap in sorted(set(h for (h, c) in sites)):
+    out.write('%s\n' % heap)
+    out.write('  %7s %7s %7s %9s %7s %9s %9s  %s\n' % ('allocs', 'failed', 'frees', 'bytes', 'live', 'live b', 'peak b', 'caller'))
+    mine = [(key, s) for key, s in sites.items() if key[0] == heap]
+    for (h, caller), s in sorted(mine, key = lambda x: -x[1].peak_bytes):
+      out.write('  %7d %7d %7d %9d %7d %9d %9d  %s\n' % (s.allocs, s.failed, s.frees, s.bytes,
+                                                       s.live, s.live_bytes, s.peak_bytes, namer.name(caller)))
+    out.write('\n')
+
+def bench(dump, heap, out):
+  """One heap's events, as a trace for qalloc_bench to replay"""
+  ids = {}
+  spare = list(range(BENCH_MAX_IDS - 1, -1, -1))
+
+  out.write('# %s heap, from a memory trace of %d events\n' % (heap, dump.total))
+  for op, h, caller, ptr, old, size in dump.events:
+    if h != heap:
+      continue
+    if op == 'f':
+      if ptr in ids:
+        out.write('f %d\n' % ids[ptr])
+        spare.append(ids.pop(ptr))
+    elif not ptr:
+      continue
+    elif op == 'r' and old in ids:
+      ids[ptr] = ids.pop(old)
+      out.write('r %d %d\n' % (ids[ptr], size))
+    elif spare:
+      ids[ptr] = spare.pop()
+      out.write('a %d %d\n' % (ids[ptr], size))
+
+parser = argparse.ArgumentParser(description = "Memory trace report for RebbleOS.")
+parser.add_argument('log', nargs = '?', help = 'the log with a dump in it (default stdin)')
+parser.add_argument('--elf', help = 'the firmware elf, to name callers in it')
+parser.add_argument('--addr2line', default = 'arm-none-eabi-addr2line', help = 'addr2line to use with --elf')
+parser.add_argument('--bench', metavar = 'HEAP', help = "write HEAP's events as a qalloc_bench trace instead")
+args = parser.parse_args()
+
+with (open(args.log) if args.log else sys.stdin) as f:
+  dump = parse(f)
+
+if not dump:
+  sys.stderr.write("no memory trace in there\n")
+  sys.exit(1)
+
+if args.bench:
+  bench(dump, args.bench, sys.stdout)
+else:
+  report(dump, Namer(dump, args.elf, args.addr2line), sys.stdout)
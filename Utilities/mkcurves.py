@@ -0,0 +1,126 @@
+#!/usr/bin/env python
+
+"""
+Builds the animation easing lookup tables.
+RebbleOS
+
+Each curve is sampled at ANIMATION_CURVE_LUT_SIZE evenly spaced points
+over 0..ANIMATION_NORMALIZED_MAX, and the firmware interpolates linearly
+between them. Run with --check to compare what the firmware will compute
+against the real curves in floating point.
+"""
+
+import argparse
+import math
+import sys
+
+# keep in step with rwatch/ui/animation/animation_curves.h
+NORMALIZED_MAX = 65535
+LUT_SHIFT = 9
+LUT_SIZE = ((NORMALIZED_MAX + 1) >> LUT_SHIFT) + 1
+
+def ease_in(t):
+  return t * t
+
+def ease_out(t):
+  return 1 - (1 - t) * (1 - t)
+
+def ease_in_out(t):
+  if t < 0.5:
+    return 2 * t * t
+  return 1 - 2 * (1 - t) * (1 - t)
+
+def cubic_bezier(x1, y1, x2, y2):
+  """ The CSS style bezier from (0, 0) to (1, 1) through the two control points """
+  def coord(s, p1, p2):
+    return 3 * (1 - s) * (1 - s) * s * p1 + 3 * (1 - s) * s * s * p2 + s * s * s
+
+  def curve(t):
+    # x is monotonic for sane control points, so bisect for the s that gives t
+    lo, hi = 0.0, 1.0
+    for _ in range(60):
+      mid = (lo + hi) / 2
+      if coord(mid, x1, x2) < t:
+        lo = mid
+      else:
+        hi = mid
+    return coord((lo + hi) / 2, y1, y2)
+  return curve
+
+def spring(damping, frequency):
+  """ An underdamped spring let go at 0, settling on 1 """
+  omega = frequency * 2 * math.pi
+  omega_d = omega * math.sqrt(1 - damping * damping)
+  decay = damping * omega
+
+  def raw(t):
+    return 1 - math.exp(-decay * t) * (math.cos(omega_d * t) + (decay / omega_d) * math.sin(omega_d * t))
+
+  # it hasn't quite settled at the end, so lean it on to land on 1 exactly
+  miss = 1 - raw(1)
+  return lambda t: raw(t) + miss * t
+
+CURVES = [
+  ("animation_curve_ease_in", ease_in),
+  ("animation_curve_ease_out", ease_out),
+  ("animation_curve_ease_in_out", ease_in_out),
+  ("animation_curve_cubic_ease", cubic_bezier(0.25, 0.1, 0.25, 1.0)),
+  ("animation_curve_cubic_ease_in", cubic_bezier(0.42, 0.0, 1.0, 1.0)),
+  ("animation_curve_cubic_ease_out", cubic_bezier(0.0, 0.0, 0.58, 1.0)),
+  ("animation_curve_cubic_ease_in_out", cubic_bezier(0.42, 0.0, 0.58, 1.0)),
+  ("animation_curve_overshoot", cubic_bezier(0.34, 1.56, 0.64, 1.0)),
+  ("animation_curve_spring", spring(0.3, 2.0)),
+]
+
+def table(curve):
+  lut = []
+  for i in range(LUT_SIZE):
+    t = min(i << LUT_SHIFT, NORMALIZED_MAX + 1) / float(NORMALIZED_MAX + 1)
+    lut.append(int(round(curve(t) * NORMALIZED_MAX)))
+  lut[0] = 0
+  lut[-1] = NORMALIZED_MAX
+  return lut
+
+def lookup(lut, progress):
+  """ What animation.c does with the table """
+  i = progress >> LUT_SHIFT
+  frac = progress & ((1 << LUT_SHIFT) - 1)
+  return lut[i] + (((lut[i + 1] - lut[i]) * frac) >> LUT_SHIFT)
+
+def check():
+  worst = 0
+  for name, curve in CURVES:
+    lut = table(curve)
+    err = 0
+    for p in range(NORMALIZED_MAX + 1):
+      want = curve(p / float(NORMALIZED_MAX + 1)) * NORMALIZED_MAX
+      err = max(err, abs(lookup(lut, p) - want))
+    print("%-36s max error %6.1f (%.3f%%)" % (name, err, 100.0 * err / NORMALIZED_MAX))
+    worst = max(worst, err)
+  return worst
+
+def write(filename):
+  with open(filename, "w") as f:
+    f.write("/* Generated by Utilities/mkcurves.py, do not edit */\n\n")
+    f.write("#include <stdint.h>\n\n")
+    for name, curve in CURVES:
+      lut = table(curve)
+      f.write("const int32_t %s[%d] = {\n" % (name, LUT_SIZE))
+      for i in range(0, LUT_SIZE, 8):
+        f.write("    " + " ".join("%6d," % v for v in lut[i:i + 8]) + "\n")
+      f.write("};\n\n")
+
+parser = argparse.ArgumentParser(description = "Animation curve table builder for RebbleOS.")
+parser.add_argument("-c", "--check", action = "store_true", help = "check the tables against the curves and exit")
+parser.add_argument("-t", "--tolerance", type = float, default = 0.25, help = "worst error allowed by --check, in percent")
+parser.add_argument("output", nargs = "?", help = "C file to write")
+args = parser.parse_args()
+
+if args.check:
+  worst = check()
+  sys.exit(0 if 100.0 * worst / NORMALIZED_MAX <= args.tolerance else 1)
+
+if not args.output:
+  parser.error("no output file")
+
+write(args.output)
@@ -0,0 +1,369 @@
+/* qalloc_bench.c
+ * Time qalloc on the host, with the sort of allocations apps make
+ * RebbleOS
+ *
+ * Build it against whichever qalloc.c you want to measure:
+ *   cc -O2 -Ilib/minilib/inc -Ircore -o qalloc_bench \
+ *      Utilities/qalloc_bench.c lib/minilib/qalloc.c
+ *   ./qalloc_bench [-s arena_bytes] [-n runs] [trace ...]
+ *
+ * With no traces it runs its own workloads, modelled on what the apps in
+ * the tree do: a watchface allocating its path and text buffers every
+ * frame, a menu swapping cell text as it scrolls, and notifications
+ * piling up and expiring.
+ *
+ * A trace is a text file of one allocation per line:
+ *   a <id> <size>    allocate size bytes, known as id from here on
+ *   r <id> <size>    realloc id to size bytes
+ *   f <id>           free id
+ * Anything else on a line (after a #, say) is ignored.
+ *
+ * Every allocation is filled, and checked before it's freed, so a broken
+ * allocator shows up as well as a slow one.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include <qalloc.h>
+
+#define MAX_IDS   4096
+#define MAX_OPS   (1 << 20)
+
+typedef struct op {
+    char kind; /* a, r or f */
+    uint16_t id;
+    uint32_t size;
+} op;
+
+typedef struct workload {
+    const char *name;
+    op *ops;
+    uint32_t count;
+} workload;
+
+typedef struct result {
+    uint64_t ns;
+    uint64_t worst_ns;
+    uint32_t failed;
+    uint32_t peak_used;
+} result;
+
+void panic(const char *s)
+{
+    fprintf(stderr, "panic: %s\n", s);
+    abort();
+}
+
+static uint32_t _seed;
+
+static uint32_t _rand(void)
+{
+    /* xorshift, so every build sees the same workload */
+    _seed ^= _seed << 13;
+    _seed ^= _seed >> 17;
+    _seed ^= _seed << 5;
+    return _seed;
+}
+
+static uint32_t _between(uint32_t lo, uint32_t hi)
+{
+    return lo + _rand() % (hi - lo + 1);
+}
+
+static workload *_workload_new(const char *name)
+{
+    workload *w = calloc(1, sizeof(workload));
+    w->name = name;
+    w->ops = malloc(MAX_OPS * sizeof(op));
+    return w;
+}
+
+static void _emit(workload *w, char kind, uint16_t id, uint32_t size)
+{
+    if (w->count < MAX_OPS)
+        w->ops[w->count++] = (op) { kind, id, size };
+}
+
+/* Some layers and a bitmap or two for good, then a handful of path and
+ * text buffers made and thrown away every frame */
+static workload *_make_face(void)
+{
+    workload *w = _workload_new("face");
+    uint16_t id = 0;
+
+    _seed = 1;
+    for (int i = 0; i < 16; i++)
+        _emit(w, 'a', id++, _between(40, 120));
+    _emit(w, 'a', id++, _between(1000, 4000));
+    _emit(w, 'a', id++, _between(1000, 4000));
+
+    for (int frame = 0; frame < 4000; frame++)
+    {
+        uint16_t first = id;
+        int count = _between(3, 8);
+        bool backwards = (_rand() & 3) == 0;
+
+        for (int i = 0; i < count; i++)
+            _emit(w, 'a', id++, _rand() & 1 ? _between(16, 200) : _between(8, 64));
+        /* mostly freed in the order they were made, sometimes not */
+        for (int i = 0; i < count; i++)
+            _emit(w, 'f', first + (backwards ? count - 1 - i : i), 0);
+        id = first;
+    }
+
+    return w;
+}
+
+/* A long menu of cells, with their text swapped as it scrolls, and a
+ * string built up a bit at a time now and again */
+static workload *_make_menu(void)
+{
+    workload *w = _workload_new("menu");
+    uint16_t cells = 60;
+
+    _seed = 2;
+    for (uint16_t i = 0; i < cells; i++)
+    {
+        _emit(w, 'a', i * 2, _between(60, 140)); /* the cell */
+        _emit(w, 'a', i * 2 + 1, _between(20, 100)); /* its text */
+    }
+
+    for (int step = 0; step < 6000; step++)
+    {
+        uint16_t cell = _between(0, cells - 1);
+
+        _emit(w, 'f', cell * 2 + 1, 0);
+        _emit(w, 'a', cell * 2 + 1, _between(20, 100));
+
+        if (step % 50 == 0)
+        {
+            uint16_t str = cells * 2;
+            uint32_t size = 16;
+
+            _emit(w, 'a', str, size);
+            while (size < 512)
+            {
+                size += 16;
+                _emit(w, 'r', str, size);
+            }
+            _emit(w, 'f', str, 0);
+        }
+    }
+
+    for (uint16_t i = 0; i < cells * 2; i++)
+        _emit(w, 'f', i, 0);
+
+    return w;
+}
+
+/* Messages of a few attributes each, the oldest expiring once there are
+ * too many */
+static workload *_make_notification(void)
+{
+    workload *w = _workload_new("notification");
+    const int keep = 20, attrs = 6;
+    int oldest = 0, newest = 0;
+
+    _seed = 3;
+    for (int msg = 0; msg < 3000; msg++)
+    {
+        int base = (newest % keep) * (attrs + 1);
+
+        if (newest - oldest == keep)
+        {
+            int old = (oldest % keep) * (attrs + 1);
+            for (int i = 0; i <= attrs; i++)
+                _emit(w, 'f', old + i, 0);
+            oldest++;
+        }
+
+        _emit(w, 'a', base, 48); /* the message */
+        _emit(w, 'a', base + 1, _between(8, 20)); /* app name */
+        _emit(w, 'a', base + 2, _between(10, 30)); /* title */
+        _emit(w, 'a', base + 3, _between(20, 300)); /* body */
+        _emit(w, 'a', base + 4, _between(4, 16)); /* timestamp */
+        _emit(w, 'a', base + 5, _between(8, 40)); /* action */
+        _emit(w, 'a', base + 6, _between(8, 40)); /* action */
+        newest++;
+    }
+
+    for (; oldest < newest; oldest++)
+    {
+        int old = (oldest % keep) * (attrs + 1);
+        for (int i = 0; i <= attrs; i++)
+            _emit(w, 'f', old + i, 0);
+    }
+
+    return w;
+}
+
+static workload *_load_trace(const char *path)
+{
+    FILE *f = fopen(path, "r");
+    char line[128];
+    workload *w;
+
+    if (!f)
+    {
+        perror(path);
+        exit(1);
+    }
+
+    w = _workload_new(path);
+    while (fgets(line, sizeof(line), f))
+    {
+        char kind;
+        unsigned id, size = 0;
+
+        if (sscanf(line, " %c %u %u", &kind, &id, &size) < 2 || id >= MAX_IDS)
+            continue;
+        if (kind == 'a' || kind == 'r' || kind == 'f')
+            _emit(w, kind, id, size);
+    }
+    fclose(f);
+
+    return w;
+}
+
+static uint64_t _now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static void _fill(void *p, uint16_t id, uint32_t size)
+{
+    memset(p, id & 0xFF, size);
+}
+
+static void _check(void *p, uint16_t id, uint32_t size)
+{
+    uint8_t *b = p;
+
+    for (uint32_t i = 0; i < size; i++)
+        if (b[i] != (id & 0xFF))
+        {
+            fprintf(stderr, "allocation %d corrupt at byte %d\n", id, i);
+            exit(1);
+        }
+}
+
+static void _run(workload *w, uint8_t *heap, uint32_t heap_size, result *res)
+{
+    static void *ptrs[MAX_IDS];
+    static uint32_t sizes[MAX_IDS];
+    qarena_t *arena = qinit(heap, heap_size);
+
+    memset(ptrs, 0, sizeof(ptrs));
+
+    for (uint32_t i = 0; i < w->count; i++)
+    {
+        op *o = &w->ops[i];
+        void *p = NULL;
+        uint64_t start, took;
+
+        if (o->kind != 'a' && !ptrs[o->id])
+            continue;
+
+        if (o->kind == 'f')
+            _check(ptrs[o->id], o->id, sizes[o->id]);
+
+        start = _now_ns();
+        switch (o->kind)
+        {
+            case 'a':
+                p = qalloc(arena, o->size);
+                break;
+            case 'r':
+                p = qrealloc(arena, ptrs[o->id], o->size);
+                break;
+            case 'f':
+                qfree(arena, ptrs[o->id]);
+                break;
+        }
+        took = _now_ns() - start;
+
+        res->ns += took;
+        if (took > res->worst_ns)
+            res->worst_ns = took;
+
+        if (o->kind == 'f')
+        {
+            ptrs[o->id] = NULL;
+            continue;
+        }
+
+        if (!p)
+        {
+            /* a failed realloc leaves the old one where it was */
+            res->failed++;
+            continue;
+        }
+
+        if (o->kind == 'r')
+            _check(p, o->id, sizes[o->id] < o->size ? sizes[o->id] : o->size);
+        ptrs[o->id] = p;
+        sizes[o->id] = o->size;
+        _fill(p, o->id, o->size);
+
+        if (qusedbytes(arena) > res->peak_used)
+            res->peak_used = qusedbytes(arena);
+    }
+
+    for (int i = 0; i < MAX_IDS; i++)
+        if (ptrs[i])
+            qfree(arena, ptrs[i]);
+
+    if (qusedbytes(arena) != 0)
+    {
+        fprintf(stderr, "%s: %d bytes still used with everything freed\n", w->name, qusedbytes(arena));
+        exit(1);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t heap_size = 78000; /* snowy's app heap */
+    int runs = 20;
+    workload *loads[64];
+    int nloads = 0;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "-s") && i + 1 < argc)
+            heap_size = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-n") && i + 1 < argc)
+            runs = atoi(argv[++i]);
+        else if (nloads < 64)
+            loads[nloads++] = _load_trace(argv[i]);
+    }
+
+    if (nloads == 0)
+    {
+        loads[nloads++] = _make_face();
+        loads[nloads++] = _make_menu();
+        loads[nloads++] = _make_notification();
+    }
+
+    uint8_t *heap = aligned_alloc(8, (heap_size + 7) & ~7);
+
+    printf("%-16s %8s %10s %10s %8s %10s\n", "workload", "ops", "ns/op", "worst ns", "failed", "peak used");
+    for (int i = 0; i < nloads; i++)
+    {
+        result res = { 0 };
+
+        for (int run = 0; run < runs; run++)
+            _run(loads[i], heap, heap_size, &res);
+
+        printf("%-16s %8u %10.1f %10llu %8u %10u\n", loads[i]->name, loads[i]->count,
+               (double)res.ns / ((uint64_t)loads[i]->count * runs),
+               (unsigned long long)res.worst_ns, res.failed / runs, res.peak_used);
+    }
+
+    return 0;
+}
@@ -0,0 +1,315 @@
+/* qalloc_faults.c
+ * Corrupt a qalloc arena every way it's meant to notice, and check it does
+ * RebbleOS
+ *
+ * It takes qalloc.c in whole, to get at the blocks, so build just this:
+ *   cc -O2 -DHEAP_PARANOID -Ilib/minilib/inc -Ircore -o qalloc_faults \
+ *      Utilities/qalloc_faults.c
+ *   ./qalloc_faults
+ *
+ * Each fault is tried twice on an arena left with a mix of blocks in it,
+ * the way an app leaves one. Once with nothing going on but qcheck_step,
+ * which has to find it inside two passes. Then with allocations and frees
+ * going on too, and a step every few of them, as on the watch, where
+ * either is allowed to find it first, but one of them has to.
+ *
+ * Before any of that, it runs with no faults at all, checking the whole
+ * arena after every call, so we know nothing is found that isn't there.
+ */
+
+/* first, as minilib has its own idea of what string.h should say */
+#include "../lib/minilib/qalloc.c"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <setjmp.h>
+
+#define HEAP_SIZE     16384
+#define LIVE_MAX      256
+#define STEP_BLOCKS   8
+#define OPS_PER_STEP  4
+#define OPS_MAX       100000
+
+static jmp_buf _caught;
+static const char *_caught_by;
+static const char *_in = "allocator";
+
+void panic(const char *s)
+{
+    _caught_by = _in;
+    printf("  %-10s %s\n", _in, s);
+    _in = "allocator";
+    longjmp(_caught, 1);
+}
+
+static uint32_t _seed;
+
+static uint32_t _rand(void)
+{
+    _seed ^= _seed << 13;
+    _seed ^= _seed >> 17;
+    _seed ^= _seed << 5;
+    return _seed;
+}
+
+static uint8_t _heap[HEAP_SIZE + 1024] __attribute__((aligned(8)));
+static qarena_t *_arena;
+static void *_live[LIVE_MAX];
+
+/* One allocation, free or realloc, of the sort an app makes */
+static void _op(void)
+{
+    int i = _rand() % LIVE_MAX;
+    uint32_t size = _rand() & 1 ? 8 + _rand() % 64 : 16 + _rand() % 400;
+
+    if (!_live[i])
+        _live[i] = qalloc(_arena, size);
+    else if ((_rand() & 7) == 0)
+    {
+        void *p = qrealloc(_arena, _live[i], size);
+        if (p)
+            _live[i] = p;
+    }
+    else
+    {
+        qfree(_arena, _live[i]);
+        _live[i] = NULL;
+    }
+}
+
+static void _step(void)
+{
+    _in = "checker";
+    qcheck_step(_arena, STEP_BLOCKS);
+    _in = "allocator";
+}
+
+static void _setup(uint32_t seed)
+{
+    _seed = seed;
+    memset(_live, 0, sizeof(_live));
+    _arena = qinit(_heap, HEAP_SIZE);
+    for (int i = 0; i < 2000; i++)
+        _op();
+}
+
+static bool _pickable(qcontrol_t *ctrl, qblock_t *blk, bool free, unsigned long min_size)
+{
+    return !BLK_ISFREE(blk) == !free && BLK_SZ(blk) >= min_size && BLK_NEXT(blk) < ctrl->end;
+}
+
+/* Any block that's free (or not), and big enough, from anywhere in the arena */
+static qblock_t *_pick(bool free, unsigned long min_size)
+{
+    qcontrol_t *ctrl = CTRL(_arena);
+    int count = 0;
+
+    for (qblock_t *blk = CTRL_FIRST(ctrl); blk < ctrl->end; blk = BLK_NEXT(blk))
+        count += _pickable(ctrl, blk, free, min_size);
+
+    if (!count)
+    {
+        printf("nowhere to put the fault\n");
+        exit(1);
+    }
+
+    int skip = _rand() % count;
+    qblock_t *blk = CTRL_FIRST(ctrl);
+    for (;; blk = BLK_NEXT(blk))
+        if (_pickable(ctrl, blk, free, min_size) && skip-- == 0)
+            break;
+    return blk;
+}
+
+static void _alloc_cookie(void)
+{
+    _pick(false, 0)->cookie1 ^= 0x100;
+}
+
+/* a run over the end of one allocation into the next */
+static void _alloc_overrun(void)
+{
+    qblock_t *blk = _pick(false, 0);
+    memset(blk, 0x55, sizeof(qblock_t));
+}
+
+static void _alloc_size(void)
+{
+    _pick(false, 0)->szflag += 2 * QALIGN;
+}
+
+static void _free_cookie(void)
+{
+    _pick(true, 0)->cookie0 ^= 0x100;
+}
+
+static void _free_footer(void)
+{
+    qblock_t *blk = _pick(true, 0);
+    BLK_FOOTER(blk) ^= 0x100;
+}
+
+static void _free_links(void)
+{
+    qblock_t *blk = _pick(true, 0);
+    BLK_LINKS(blk)->next = CTRL_FIRST(CTRL(_arena));
+}
+
+static void _prev_free_flag(void)
+{
+    qblock_t *blk = _pick(true, 0);
+    BLK_NEXT(blk)->szflag ^= SZFLAG_FPREVFREE;
+}
+
+/* written through a pointer after it was freed */
+static void _use_after_free(void)
+{
+    qblock_t *blk = _pick(true, 4 * BLK_MINSZ);
+    unsigned long *fill = BLK_FILL(blk);
+    fill[(_rand() % (BLK_FILL_END(blk) - fill))] = 0;
+}
+
+static void _double_free(void)
+{
+    for (int i = 0; i < LIVE_MAX; i++)
+        if (_live[i])
+        {
+            qfree(_arena, _live[i]);
+            qfree(_arena, _live[i]);
+        }
+}
+
+typedef struct fault {
+    const char *name;
+    void (*inject)(void);
+    bool by_checker; /* that the checker alone can find it */
+} fault;
+
+static const fault _faults[] = {
+    { "alloc cookie",      _alloc_cookie,    true },
+    { "alloc overrun",     _alloc_overrun,   true },
+    { "alloc size",        _alloc_size,      true },
+    { "free cookie",       _free_cookie,     true },
+    { "free footer",       _free_footer,     true },
+    { "free links",        _free_links,      true },
+    { "prev free flag",    _prev_free_flag,  true },
+    { "use after free",    _use_after_free,  true },
+    { "double free",       _double_free,     false },
+};
+
+#define FAULT_COUNT (sizeof(_faults) / sizeof(fault))
+
+/* No faults, the whole arena checked after every call, and a step between */
+static bool _clean(void)
+{
+    printf("no fault\n");
+    _caught_by = NULL;
+    if (setjmp(_caught))
+        return false;
+
+    _setup(1);
+    for (int i = 0; i < 20000; i++)
+    {
+        _op();
+        _step();
+        _in = "checker";
+        qcheck_arena(_arena);
+        _in = "allocator";
+    }
+    printf("  nothing found\n");
+    return true;
+}
+
+/* Only the checker, and it has to be inside two passes */
+static bool _checker_alone(const fault *f, uint32_t seed)
+{
+    volatile int steps = 0, passes = 0;
+
+    _caught_by = NULL;
+    if (setjmp(_caught))
+        return true;
+
+    _setup(seed);
+    f->inject();
+    while (passes < 2)
+    {
+        _in = "checker";
+        passes += qcheck_step(_arena, STEP_BLOCKS);
+        _in = "allocator";
+        steps++;
+    }
+    printf("  missed, in %d steps\n", steps);
+    return false;
+}
+
+/* As it would go on the watch. Some faults can be put right by the
+ * allocator before anything sees them (a free flag set again, when it's
+ * set anyway), so if nothing is found, the arena had better be fine */
+static bool _running(const fault *f, uint32_t seed)
+{
+    volatile int ops = 0;
+    volatile bool healed = false;
+
+    _caught_by = NULL;
+    if (setjmp(_caught))
+    {
+        if (healed)
+            return false;
+        printf("  %-10s after %d ops\n", "", ops);
+        return true;
+    }
+
+    _setup(seed);
+    f->inject();
+    for (; ops < OPS_MAX; ops++)
+    {
+        _op();
+        if (ops % OPS_PER_STEP == 0)
+            _step();
+    }
+
+    healed = true;
+    qcheck_arena(_arena);
+    printf("  put right, in %d ops\n", ops);
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    int failed = 0;
+
+    /* so what it got to is there if it falls over */
+    setvbuf(stdout, NULL, _IONBF, 0);
+
+#ifndef HEAP_PARANOID
+    printf("(without HEAP_PARANOID, nothing written inside a free block can be found)\n");
+#endif
+
+    if (!_clean())
+        failed++;
+
+    for (unsigned i = 0; i < FAULT_COUNT; i++)
+    {
+        const fault *f = &_faults[i];
+
+#ifndef HEAP_PARANOID
+        if (f->inject == _use_after_free)
+            continue;
+#endif
+        for (uint32_t seed = 1; seed <= 3; seed++)
+        {
+            if (f->by_checker)
+            {
+                printf("%s, seed %u, checker alone\n", f->name, seed);
+                if (!_checker_alone(f, seed))
+                    failed++;
+            }
+            printf("%s, seed %u, running\n", f->name, seed);
+            if (!_running(f, seed))
+                failed++;
+        }
+    }
+
+    printf("%d missed\n", failed);
+    return failed ? 1 : 0;
+}
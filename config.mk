@@ -32,12 +32,15 @@ CFLAGS_all += -DNGFX_IS_CORE
 # XXX: nostdinc
 CFLAGS_all += -O0 -ggdb -Wall -ffunction-sections -fdata-sections -mthumb -mlittle-endian -finline-functions -std=gnu99 -falign-functions=16
 # CFLAGS_all += -Wno-implicit-function-declaration
+# Record who allocates what, to dump and run through Utilities/heap_report.py
+# CFLAGS_all += -DMEMORY_TRACE
 CFLAGS_all += -Wno-unused-variable -Wno-unused-function
 
 LDFLAGS_all += -nostartfiles -nostdlib
 LIBS_all += -lgcc
 
 SRCS_all += build/version.c
+SRCS_all += build/animation_curves.c
 
 SRCS_all += FreeRTOS/croutine.c
 SRCS_all += FreeRTOS/event_groups.c
@@ -55,6 +58,7 @@ SRCS_all += lib/minilib/fmt.c
 SRCS_all += lib/minilib/unfmt.c
 SRCS_all += lib/minilib/rand.c
 SRCS_all += lib/minilib/qalloc.c
+SRCS_all += lib/minilib/qpool.c
 SRCS_all += lib/musl/time/localtime.c
 SRCS_all += lib/musl/time/localtime_r.c
 SRCS_all += lib/musl/time/mktime.c
@@ -86,8 +90,11 @@ SRCS_all += rcore/ambient.c
 SRCS_all += rcore/appmanager.c
 SRCS_all += rcore/appmanager_app.c
 SRCS_all += rcore/appmanager_app_api.c
+SRCS_all += rcore/appmanager_app_cache.c
 SRCS_all += rcore/appmanager_app_runloop.c
 SRCS_all += rcore/appmanager_app_timer.c
+SRCS_all += rcore/appmanager_partition.c
+SRCS_all += rcore/appmanager_worker.c
 SRCS_all += rcore/backlight.c
 SRCS_all += rcore/bluetooth.c
 SRCS_all += rcore/buttons.c
@@ -102,6 +109,7 @@ SRCS_all += rcore/rebbleos.c
 SRCS_all += rcore/smartstrap.c
 SRCS_all += rcore/rebble_time.c
 SRCS_all += rcore/rebble_memory.c
+SRCS_all += rcore/memory_trace.c
 SRCS_all += rcore/vibrate.c
 SRCS_all += rcore/flash.c
 SRCS_all += rcore/fs.c
@@ -130,10 +138,12 @@ SRCS_all += rwatch/ui/action_menu.c
 SRCS_all += rwatch/graphics/gbitmap.c
 SRCS_all += rwatch/graphics/graphics.c
 SRCS_all += rwatch/graphics/font_loader.c
+SRCS_all += rwatch/graphics/text_layout.c
 SRCS_all += rwatch/event/tick_timer_service.c
 SRCS_all += rwatch/event/app_timer.c
 SRCS_all += rwatch/event/battery_state_service.c
 SRCS_all += rwatch/event/connection_service.c
+SRCS_all += rwatch/event/app_worker.c
 SRCS_all += rwatch/ui/layer/status_bar_layer.c
 SRCS_all += rwatch/ui/animation/animation.c
 SRCS_all += rwatch/ui/animation/property_animation.c
@@ -69,6 +69,31 @@ void stm32_power_init() {
 #endif
 }
 
+/* Clocks that can be held across STOP mode: the GPIOs keep their state and
+ * still wake us through the EXTI, and we need PWR and SYSCFG to get there.
+ * The FMC only moves when the CPU reads through it, so an app running out
+ * of NOR can hold it and still let us stop */
+static const uint32_t _stop_safe[STM32_POWER_MAX] = {
+    [STM32_POWER_AHB1] = 0x7FF /* GPIOA..K */ | RCC_AHB1Periph_BKPSRAM,
+#if defined(STM32F4XX)
+    [STM32_POWER_AHB3] = RCC_AHB3Periph_FMC,
+#endif
+    [STM32_POWER_APB1] = RCC_APB1Periph_PWR,
+    [STM32_POWER_APB2] = RCC_APB2Periph_SYSCFG,
+};
+
+/* Can we stop the clocks without pulling the rug out from under anyone?
+ * Call with interrupts off, so nobody takes a clock while we look. */
+int stm32_power_can_stop(void) {
+#define MK_CHECK(n, b) \
+    for (int i = 0; i < b; i++) \
+        if (_power_state_##n[i] && !(_stop_safe[STM32_POWER_##n] & (1 << i))) \
+            return 0;
+    STM32_POWER_EXPANDO(MK_CHECK)
+#undef MK_CHECK
+    return 1;
+}
+
 void stm32_power_incr(stm32_power_register_t reg, uint32_t domain, int incr) {
     int bits;
     uint8_t *statep;
@@ -47,6 +47,7 @@ typedef enum stm32_power_register {
 
 extern void stm32_power_init();
 extern void stm32_power_incr(stm32_power_register_t reg, uint32_t domain, int incr);
+extern int stm32_power_can_stop(void);
 
 static inline void stm32_power_request(stm32_power_register_t reg, uint32_t domain) {
     stm32_power_incr(reg, domain, 1);
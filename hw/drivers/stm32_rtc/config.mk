@@ -1,3 +1,4 @@
 CFLAGS_driver_stm32_rtc = -Ihw/drivers/stm32_rtc
 
 SRCS_driver_stm32_rtc = hw/drivers/stm32_rtc/stm32_rtc.c
+SRCS_driver_stm32_rtc += hw/drivers/stm32_rtc/stm32_tickless.c
@@ -61,9 +61,10 @@ void rtc_init(void)
     NVIC_InitStruct.NVIC_IRQChannelCmd = ENABLE;
     NVIC_Init(&NVIC_InitStruct);
 
-    // Configure the RTC WakeUp Clock source: CK_SPRE (1Hz)
-    RTC_WakeUpClockConfig(RTC_WakeUpClock_CK_SPRE_16bits);
-    RTC_SetWakeUpCounter(0x0);
+    // Configure the RTC WakeUp Clock source: RTCCLK / 16 (2048Hz)
+    // The counter is only armed when idle goes to sleep, see stm32_tickless.c
+    RTC_WakeUpCmd(DISABLE);
+    RTC_WakeUpClockConfig(RTC_WakeUpClock_RTCCLK_Div16);
 
     // Enable the RTC Wakeup Interrupt
     RTC_ITConfig(RTC_IT_WUT, ENABLE);
@@ -71,9 +72,6 @@ void rtc_init(void)
     RTC_ClearITPendingBit(RTC_IT_WUT);
     EXTI_ClearITPendingBit(EXTI_Line22);
 
-    // Enable Wakeup Counter
-    RTC_WakeUpCmd(ENABLE);
-
     stm32_power_release(STM32_POWER_APB2, RCC_APB2Periph_SYSCFG);
 }
 void rtc_config(void)
@@ -94,8 +92,8 @@ void rtc_config(void)
 
     RCC_RTCCLKConfig(RCC_RTCCLKSource_LSI);
 
-    uint32_t uwSynchPrediv = 0xFF;
-    uint32_t uwAsynchPrediv = 0x7F;
+    uint32_t uwSynchPrediv = RTC_SYNCH_PREDIV;
+    uint32_t uwAsynchPrediv = RTC_ASYNCH_PREDIV;
 
 
 // external oscilator
@@ -109,8 +107,8 @@ void rtc_config(void)
 
     RCC_RTCCLKConfig(RCC_RTCCLKSource_LSE);
 
-    uint32_t uwSynchPrediv = 0xFF;
-    uint32_t uwAsynchPrediv = 0x7F;
+    uint32_t uwSynchPrediv = RTC_SYNCH_PREDIV;
+    uint32_t uwAsynchPrediv = RTC_ASYNCH_PREDIV;
 
 #else
     #error Please select the RTC Clock source inside the main.c file
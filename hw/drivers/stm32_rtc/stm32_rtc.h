@@ -20,10 +20,23 @@
 #include <time.h>
 #include "rebble_time.h"
 
+#if defined(STM32F4XX)
+/* Finer subseconds, so we can tell how long we were stopped for */
+#    define RTC_ASYNCH_PREDIV 0x07
+#    define RTC_SYNCH_PREDIV  0xFFF
+#else
+#    define RTC_ASYNCH_PREDIV 0x7F
+#    define RTC_SYNCH_PREDIV  0xFF
+#endif
+
 void rtc_init(void);
 void rtc_config(void);
 struct tm *hw_get_time(void);
 
+/* in stm32_tickless.c */
+void hw_idle_sleep(uint32_t expected_idle_ticks);
+void hw_idle_get_stats(uint32_t *stop_ticks, uint32_t *sleep_ticks);
+
 #endif
 
 #define RTC_CLOCK_SOURCE_LSE
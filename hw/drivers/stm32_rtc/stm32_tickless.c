@@ -0,0 +1,188 @@
+/*
+ * stm32_tickless.c
+ * Tickless idle for the STM32s, stopping on the RTC wakeup timer
+ * RebbleOS
+ *
+ * When nothing wants the CPU for a while, FreeRTOS asks us to sleep
+ * through the ticks rather than waking 1000 times a second for them.
+ *
+ * On the F4 we go all the way down to STOP mode. The PLL and every
+ * peripheral clock are gone, so we only do that when the power tracker
+ * says nobody is holding a clock we would pull away. The RTC wakeup timer
+ * gets us back up, and the RTC's subsecond count tells us how long we
+ * were gone for, so the tick count (and so the wall clock) stays honest.
+ * The wall clock is never set from the RTC again after boot, so nothing
+ * may be rounded away: the part of a tick SysTick had counted before we
+ * stopped is added to the sleep, and the part of a tick left over after
+ * is carried into SysTick's first period when it starts again.
+ *
+ * The F2's RTC has no subseconds, so if a button woke us early we'd have
+ * no idea how long we'd slept. It dozes in plain sleep instead, with
+ * SysTick stretched out to the next timer by the FreeRTOS port.
+ */
+
+#if defined(STM32F4XX)
+#    include "stm32f4xx.h"
+#elif defined(STM32F2XX)
+#    include "stm32f2xx.h"
+#    include "stm32f2xx_rtc.h"
+#    include "stm32f2xx_rcc.h"
+#    include "stm32f2xx_exti.h"
+#    include "stm32f2xx_pwr.h"
+#    include "misc.h"
+#else
+#    error "I have no idea what kind of stm32 this is; sorry"
+#endif
+#include "stm32_power.h"
+#include "stm32_rtc.h"
+#include "FreeRTOS.h"
+#include "task.h"
+
+/* waking the PLL back up isn't free, so don't stop for less than this */
+#define STOP_MIN_TICKS       5
+#define RTC_WAKEUP_HZ        (32768 / 16)
+#define RTC_SUBSECOND_HZ     (RTC_SYNCH_PREDIV + 1)
+#define RTC_DAY              (24 * 60 * 60 * RTC_SUBSECOND_HZ)
+/* Sleep is counted in these, so ticks and subseconds both go in whole:
+ * a tick is RTC_SUBSECOND_HZ of them, a subsecond configTICK_RATE_HZ */
+#define SLEEP_UNITS_PER_TICK (RTC_SUBSECOND_HZ)
+
+/* the port's own, we're standing in front of it */
+extern void vPortSuppressTicksAndSleep(TickType_t xExpectedIdleTime);
+
+static uint32_t _stop_ticks;
+static uint32_t _sleep_ticks;
+
+#if defined(STM32F4XX)
+/* whole ticks slept that the kernel wouldn't take last time, in sleep units */
+static uint64_t _stop_remainder;
+
+/* How far into the day the RTC is, in subseconds */
+static uint32_t _rtc_now(void)
+{
+    RTC_TimeTypeDef time;
+
+    /* the subseconds lock the shadow time and date until the date is read */
+    uint32_t ss = RTC_GetSubSecond();
+    RTC_GetTime(RTC_Format_BIN, &time);
+    (void)RTC->DR;
+
+    uint32_t secs = time.RTC_Hours * 3600 + time.RTC_Minutes * 60 + time.RTC_Seconds;
+    return secs * RTC_SUBSECOND_HZ + (RTC_SYNCH_PREDIV - ss);
+}
+
+/* STOP leaves us running on the HSI, so put the PLL back */
+static void _restore_clocks(void)
+{
+    RCC_PLLCmd(ENABLE);
+    while (RCC_GetFlagStatus(RCC_FLAG_PLLRDY) == RESET)
+        ;
+
+    RCC_SYSCLKConfig(RCC_SYSCLKSource_PLLCLK);
+    while (RCC_GetSYSCLKSource() != 0x08)
+        ;
+}
+
+/*
+ * Returns false if we couldn't stop and should doze instead.
+ */
+static int _stop_sleep(TickType_t expected_idle_ticks)
+{
+    /* wake a tick early, the PLL takes a moment to come back */
+    uint32_t counts = ((expected_idle_ticks - 1) * RTC_WAKEUP_HZ) / configTICK_RATE_HZ;
+    if (counts > 0xFFFF)
+        counts = 0xFFFF;
+
+    /* interrupts still wake us with these masked, they just run later */
+    __disable_irq();
+    __DSB();
+    __ISB();
+
+    /* someone got in first while we were thinking about it */
+    if (eTaskConfirmSleepModeStatus() == eAbortSleep)
+    {
+        __enable_irq();
+        return 1;
+    }
+
+    if (!stm32_power_can_stop())
+    {
+        __enable_irq();
+        return 0;
+    }
+
+    stm32_power_request(STM32_POWER_APB1, RCC_APB1Periph_PWR);
+
+    /* SysTick stops as close to the RTC being read as we can get it, both
+     * ways, so what falls between the two clocks is a few cycles a sleep */
+    uint32_t before = _rtc_now();
+    SysTick->CTRL &= ~SysTick_CTRL_ENABLE_Msk;
+
+    /* how far into this tick we already were */
+    uint32_t tick_cycles = SysTick->LOAD + 1;
+    uint32_t into_tick = ((uint64_t)(SysTick->LOAD - SysTick->VAL) * SLEEP_UNITS_PER_TICK) / tick_cycles;
+
+    RTC_WakeUpCmd(DISABLE);
+    RTC_SetWakeUpCounter(counts - 1);
+    RTC_ClearITPendingBit(RTC_IT_WUT);
+    EXTI_ClearITPendingBit(EXTI_Line22);
+    RTC_WakeUpCmd(ENABLE);
+
+    PWR_EnterSTOPMode(PWR_Regulator_LowPower, PWR_STOPEntry_WFI);
+
+    _restore_clocks();
+    RTC_WakeUpCmd(DISABLE);
+    /* the shadow registers are stale until they catch up with the RTC */
+    RTC_WaitForSynchro();
+
+    uint32_t subseconds = (_rtc_now() + RTC_DAY - before) % RTC_DAY;
+    uint64_t slept = (uint64_t)subseconds * configTICK_RATE_HZ + into_tick + _stop_remainder;
+
+    /* the kernel won't have us step past the next task waking up. If we
+     * overslept, the whole ticks over get counted next time round */
+    TickType_t ticks = slept / SLEEP_UNITS_PER_TICK;
+    if (ticks > expected_idle_ticks - 1)
+        ticks = expected_idle_ticks - 1;
+    uint32_t part = slept % SLEEP_UNITS_PER_TICK;
+    _stop_remainder = slept - part - (uint64_t)ticks * SLEEP_UNITS_PER_TICK;
+
+    /* and the part of a tick already gone shortens the first one. LOAD is
+     * only read on the way round, so the one after is a whole tick again */
+    SysTick->LOAD = tick_cycles - 1 - ((uint64_t)part * tick_cycles) / SLEEP_UNITS_PER_TICK;
+    SysTick->VAL = 0;
+    SysTick->CTRL |= SysTick_CTRL_ENABLE_Msk;
+    SysTick->LOAD = tick_cycles - 1;
+
+    stm32_power_release(STM32_POWER_APB1, RCC_APB1Periph_PWR);
+    vTaskStepTick(ticks);
+    _stop_ticks += ticks;
+    __enable_irq();
+
+    return 1;
+}
+#endif
+
+/*
+ * Called from the idle task with the scheduler suspended, whenever nothing
+ * is due for at least configEXPECTED_IDLE_TIME_BEFORE_SLEEP ticks.
+ */
+void hw_idle_sleep(uint32_t expected_idle_ticks)
+{
+#if defined(STM32F4XX)
+    if (expected_idle_ticks >= STOP_MIN_TICKS && _stop_sleep(expected_idle_ticks))
+        return;
+#endif
+
+    TickType_t before = xTaskGetTickCount();
+    vPortSuppressTicksAndSleep(expected_idle_ticks);
+    _sleep_ticks += xTaskGetTickCount() - before;
+}
+
+/* How many ticks we have spent stopped, and dozing, since boot */
+void hw_idle_get_stats(uint32_t *stop_ticks, uint32_t *sleep_ticks)
+{
+    if (stop_ticks)
+        *stop_ticks = _stop_ticks;
+    if (sleep_ticks)
+        *sleep_ticks = _sleep_ticks;
+}
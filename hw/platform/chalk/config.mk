@@ -7,6 +7,8 @@ SRCS_chalk += hw/platform/chalk/chalk.c
 SRCS_chalk += hw/platform/chalk/chalk_bluetooth.c
 SRCS_chalk += Resources/chalk_fpga.bin
 
+FIXED_R9_SRCS_chalk = $(FIXED_R9_SRCS_snowy_family)
+
 LDFLAGS_chalk = $(LDFLAGS_snowy_family)
 LIBS_chalk = $(LIBS_snowy_family)
 
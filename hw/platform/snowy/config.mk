@@ -11,6 +11,8 @@ SRCS_snowy += hw/platform/snowy/snowy.c
 SRCS_snowy += hw/platform/snowy/snowy_bluetooth.c
 SRCS_snowy += Resources/snowy_fpga.bin
 
+FIXED_R9_SRCS_snowy = $(FIXED_R9_SRCS_snowy_family)
+
 LDFLAGS_snowy = $(LDFLAGS_snowy_family)
 LIBS_snowy = $(LIBS_snowy_family)
 
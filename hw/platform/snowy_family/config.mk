@@ -8,6 +8,10 @@ CFLAGS_snowy_family += $(CFLAGS_driver_stm32_power)
 CFLAGS_snowy_family += $(CFLAGS_driver_stm32_rtc)
 CFLAGS_snowy_family += $(CFLAGS_driver_stm32_backlight)
 CFLAGS_snowy_family += -Ihw/platform/snowy_family
+# apps running in place out of the NOR keep their GOT in r9. Only code that
+# calls back into an app has to leave it alone; anything else puts r9 back
+# before it returns, as the ABI has it do for any register it borrows
+FIXED_R9_SRCS_snowy_family = rcore/% rwatch/%
 
 SRCS_snowy_family = $(SRCS_stm32f4xx)
 SRCS_snowy_family += $(SRCS_driver_stm32_usart)
@@ -12,7 +12,7 @@
 
 /* Size of the stack in WORDS */
 #define MEMORY_SIZE_APP_STACK     3000
-#define MEMORY_SIZE_WORKER_STACK  250
+#define MEMORY_SIZE_WORKER_STACK  500
 #define MEMORY_SIZE_OVERLAY_STACK 350
 
 
@@ -22,7 +22,7 @@
 
 // flash regions
 #define REGION_PRF_START        0x200000
-#define REGION_PRF_SIZE         0x1000000
+#define REGION_PRF_SIZE         0x100000
 // DO NOT WRITE TO THIS REGION
 #define REGION_MFG_START        0xE0000
 #define REGION_MFG_SIZE         0x20000
@@ -38,6 +38,29 @@
 #define REGION_APP_RES_START    0xB3A000
 #define REGION_APP_RES_SIZE     0x7D000
 
+/* Between the PRF and the resources is unused. Relocated app images are
+ * cached in the start of it, one to an erase sector, so three of them */
+#define REGION_APP_CACHE_START  0x300000
+#define REGION_APP_CACHE_SIZE   0x60000
+#define REGION_APP_CACHE_SLOT   0x20000
+
+/* and the last sector of it holds what we last made of appdb */
+#define REGION_APP_MANIFEST_START 0x360000
+#define REGION_APP_MANIFEST_SIZE  0x20000
+
+#define REGION_OVERLAPS(a, b) \
+    (REGION_##a##_START < REGION_##b##_START + REGION_##b##_SIZE && \
+     REGION_##b##_START < REGION_##a##_START + REGION_##a##_SIZE)
+#define REGION_FS_SIZE          (REGION_FS_N_PAGES * REGION_FS_PAGE_SIZE)
+
+_Static_assert(!REGION_OVERLAPS(APP_CACHE, PRF), "app cache is over the PRF");
+_Static_assert(!REGION_OVERLAPS(APP_CACHE, RES), "app cache is over the resources");
+_Static_assert(!REGION_OVERLAPS(APP_CACHE, FS), "app cache is over the filesystem");
+_Static_assert(!REGION_OVERLAPS(APP_MANIFEST, PRF), "app manifest is over the PRF");
+_Static_assert(!REGION_OVERLAPS(APP_MANIFEST, RES), "app manifest is over the resources");
+_Static_assert(!REGION_OVERLAPS(APP_MANIFEST, FS), "app manifest is over the filesystem");
+_Static_assert(!REGION_OVERLAPS(APP_MANIFEST, APP_CACHE), "app manifest is over the app cache");
+
 
 /* The size of the page that holds an apps header table. This is the amount before actual app content e.g
  0x0000  Resource table header
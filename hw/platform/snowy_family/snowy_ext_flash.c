@@ -29,6 +29,8 @@ void _nor_clock_release(void);
 int _flash_test(void);
 
 static void _nor_write16(uint32_t address, uint16_t data);
+static void _nor_erase_suspend(void);
+static void _nor_erase_resume(void);
 
 /*
  * Initialise the flash hardware. 
@@ -298,11 +300,186 @@ uint16_t hw_flash_read16(uint32_t address)
 void hw_flash_read_bytes(uint32_t address, uint8_t *buffer, size_t length)
 {
     _nor_clock_request();
+    _nor_erase_suspend();
     for(size_t i = 0; i < length; i++)
     {
         buffer[i] = *(__IO uint8_t *)((Bank1_NOR_ADDR + address + i));
     }
+    _nor_erase_resume();
     _nor_clock_release();
     flash_operation_complete(0);
 }
 
+/*
+ * The NOR sits in the CPU's address space, so code can run straight out
+ * of it. Hand back where a flash address shows up, and keep the FMC
+ * clocked until hw_flash_unmap(). Nothing may erase or program the flash
+ * while it is mapped.
+ */
+void *hw_flash_map(uint32_t address)
+{
+    _nor_clock_request();
+    return (void *)(Bank1_NOR_ADDR + address);
+}
+
+void hw_flash_unmap(void)
+{
+    _nor_clock_release();
+}
+
+/* How long we'll poll for an embedded program (busy) or erase (a poll a
+ * tick) to finish. A sector erase is good for a couple of seconds */
+#define NOR_PROGRAM_TRIES    100000
+#define NOR_ERASE_TRIES      4000
+
+#define NOR_NOT_ERASING      0xFFFFFFFF
+
+/* The sector being erased, until hw_flash_erase_poll() sees it done */
+static uint32_t _erasing = NOR_NOT_ERASING;
+static uint32_t _erase_tries;
+
+/* Is an embedded program or erase still going? DQ6 flips on every read
+ * while it is */
+static int _nor_busy(uint32_t address)
+{
+    uint16_t a = *(__IO uint16_t *)(Bank1_NOR_ADDR + address);
+    uint16_t b = *(__IO uint16_t *)(Bank1_NOR_ADDR + address);
+
+    return (a ^ b) & 0x40;
+}
+
+/*
+ * Wait for an embedded program or erase to finish.
+ */
+static int _nor_wait_ready(uint32_t address, uint32_t tries, int sleep)
+{
+    while (tries--)
+    {
+        if (!_nor_busy(address))
+            return 0;
+
+        if (sleep)
+            vTaskDelay(1);
+    }
+
+    /* it's wedged. Get it back to reading */
+    _nor_reset_region(address);
+    return -1;
+}
+
+/*
+ * The unlock cycles for a command. The top address bits don't matter to
+ * the command, but they do say which bank it's for, so keep them
+ */
+static void _nor_command(uint32_t address, uint16_t command)
+{
+    uint32_t base = address & ~0xFFF;
+
+    _nor_write16(base | 0xAAA, 0xAA);
+    _nor_write16(base | 0x554, 0x55);
+    _nor_write16(base | 0xAAA, command);
+}
+
+/*
+ * While an erase goes on, the rest of the flash reads back its status, so
+ * anything else that wants the flash suspends the erase around itself.
+ * Reading or programming any sector but the one being erased is fine
+ * while it's suspended. Call with the FMC clocked.
+ */
+static void _nor_erase_suspend(void)
+{
+    if (_erasing == NOR_NOT_ERASING)
+        return;
+
+    _nor_write16(_erasing, 0xB0);
+    /* it takes a few tens of us to get there */
+    _nor_wait_ready(_erasing, NOR_PROGRAM_TRIES, 0);
+}
+
+static void _nor_erase_resume(void)
+{
+    if (_erasing == NOR_NOT_ERASING)
+        return;
+
+    _nor_write16(_erasing, 0x30);
+}
+
+/*
+ * Start erasing the sector that holds the given address, and return
+ * straight away. Poll hw_flash_erase_poll() for when it's done. One erase
+ * at a time.
+ */
+int hw_flash_erase_start(uint32_t address)
+{
+    assert(_erasing == NOR_NOT_ERASING && "NOR erases one sector at a time");
+
+    _nor_clock_request();
+    _nor_command(address, 0x80);
+    _nor_command(address, 0xAA);
+    /* the sector to erase is the last unlock cycle, in place of the 0xAA */
+    _nor_write16(address & ~0xFFF, 0x30);
+    _nor_clock_release();
+
+    _erasing = address & ~0xFFF;
+    _erase_tries = NOR_ERASE_TRIES;
+
+    return 0;
+}
+
+/*
+ * Look at how the erase is going. Returns 1 while it still is, 0 once it's
+ * done, -1 if it's been going too long and we gave up on it.
+ */
+int hw_flash_erase_poll(void)
+{
+    int rv = 1;
+
+    _nor_clock_request();
+    if (!_nor_busy(_erasing))
+        rv = 0;
+    else if (!--_erase_tries)
+    {
+        /* it's wedged. Get it back to reading */
+        _nor_reset_region(_erasing);
+        rv = -1;
+    }
+    _nor_clock_release();
+
+    if (rv <= 0)
+        _erasing = NOR_NOT_ERASING;
+
+    return rv;
+}
+
+/*
+ * Program bytes into erased flash, a 16 bit word at a time.
+ * The address and length both need to be even.
+ */
+int hw_flash_write(uint32_t address, const uint8_t *buffer, size_t length)
+{
+    assert(!(address & 1) && !(length & 1) && "NOR is programmed a word at a time");
+
+    _nor_clock_request();
+    _nor_erase_suspend();
+    for (size_t i = 0; i < length; i += 2)
+    {
+        uint16_t word = buffer[i] | (buffer[i + 1] << 8);
+
+        /* erased flash is already all ones */
+        if (word == 0xFFFF)
+            continue;
+
+        _nor_command(address + i, 0xA0);
+        _nor_write16(address + i, word);
+        if (_nor_wait_ready(address + i, NOR_PROGRAM_TRIES, 0))
+        {
+            _nor_erase_resume();
+            _nor_clock_release();
+            return -1;
+        }
+    }
+    _nor_erase_resume();
+    _nor_clock_release();
+
+    return 0;
+}
@@ -12,4 +12,9 @@ void hw_flash_init(void);
 void hw_flash_deinit(void);
 uint16_t hw_flash_read16(uint32_t address);
 void hw_flash_read_bytes(uint32_t address, uint8_t *buffer, size_t length);
+void *hw_flash_map(uint32_t address);
+void hw_flash_unmap(void);
+int hw_flash_erase_start(uint32_t address);
+int hw_flash_erase_poll(void);
+int hw_flash_write(uint32_t address, const uint8_t *buffer, size_t length);
 
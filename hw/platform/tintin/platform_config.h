@@ -16,7 +16,7 @@
 
 /* Size of the stack in WORDS */
 #define MEMORY_SIZE_APP_STACK     4000
-#define MEMORY_SIZE_WORKER_STACK  100
+#define MEMORY_SIZE_WORKER_STACK  400
 #define MEMORY_SIZE_OVERLAY_STACK 450
 
 
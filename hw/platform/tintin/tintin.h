@@ -47,6 +47,11 @@ void ss_debug_write(const unsigned char *p, size_t len);
 
 void hw_flash_init(void);
 void hw_flash_read_bytes(uint32_t addr, uint8_t *buf, size_t len);
+void *hw_flash_map(uint32_t addr);
+void hw_flash_unmap(void);
+int hw_flash_erase_start(uint32_t addr);
+int hw_flash_erase_poll(void);
+int hw_flash_write(uint32_t addr, const uint8_t *buf, size_t len);
 #define REGION_FPGA_START       0x0
 #define REGION_FPGA_SIZE        0x0
 
@@ -21,6 +21,27 @@
 #include "stm32_spi.h"
 
 static void _spi_flash_rx_done(void);
+/* SPI flash isn't memory mapped, so nothing can run from it */
+void *hw_flash_map(uint32_t addr) {
+    return NULL;
+}
+
+void hw_flash_unmap(void) {
+}
+
+/* XXX: nothing writes to the SPI flash yet */
+int hw_flash_erase_start(uint32_t addr) {
+    return -1;
+}
+
+int hw_flash_erase_poll(void) {
+    return -1;
+}
+
+int hw_flash_write(uint32_t addr, const uint8_t *buf, size_t len) {
+    return -1;
+}
+
 static void _spi_flash_tx_done(void) ;
 static const stm32_spi_config_t _spi1_config = {
     .spi                  = SPI1,
@@ -18,5 +18,9 @@ extern void *qalloc(qarena_t *arena, unsigned size);
 extern void *qrealloc(qarena_t *arena, void *ptr, unsigned size);
 extern void qfree(qarena_t *arena, void *ptr);
 uint32_t qusedbytes(qarena_t *arena);
+extern uint32_t qpeakbytes(qarena_t *arena);
 extern uint32_t qfreebytes(qarena_t *arena);
+extern uint32_t qlargestfree(qarena_t *arena);
+extern int qcheck_step(qarena_t *arena, unsigned blocks);
+extern void qcheck_arena(qarena_t *arena);
 #endif /* !QALLOC_H */
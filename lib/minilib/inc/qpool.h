@@ -0,0 +1,26 @@
+/* qpool.h
+ * Fixed-size object pools, on top of a qalloc arena
+ * RebbleOS
+ */
+
+#ifndef QPOOL_H
+#define QPOOL_H
+
+#include <qalloc.h>
+
+typedef struct _qpool_t {
+	uint8_t *slab;		/* count objects of size, NULL until first used */
+	void *free;		/* objects given back, linked through their first word */
+	uint16_t size;
+	uint16_t count;
+	uint16_t carved;	/* objects of the slab handed out at least once */
+	uint16_t in_use;
+	uint16_t peak;
+	uint16_t fallbacks;	/* allocations that went to the arena as we were full */
+} qpool_t;
+
+extern void qpool_init(qpool_t *pool, void *slab, unsigned size, unsigned count);
+extern void *qpool_alloc(qpool_t *pool, qarena_t *arena);
+extern int qpool_owns(qpool_t *pool, void *ptr);
+extern int qpool_free(qpool_t *pool, void *ptr);
+#endif /* !QPOOL_H */
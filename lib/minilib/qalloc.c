@@ -13,11 +13,51 @@
 #define HEAP_INTEGRITY
 //#define HEAP_PARANOID
 
-#define MINBSZ	4
+/*
+ * A two level segregated fit allocator (TLSF). Free blocks are kept in
+ * lists by size class: the first level splits sizes by power of two, the
+ * second splits each power of two into SL_COUNT even steps. A bitmap for
+ * each level says which lists have anything in them, so finding a block
+ * big enough is a couple of bit scans rather than a walk of the heap.
+ *
+ * Every block knows its own size, and so where the next one starts. A free
+ * block also keeps its size in its last word (its footer), and the block
+ * after it is flagged, so it can find its way back to it. That makes
+ * joining up free neighbours on qfree O(1) as well.
+ *
+ * The arena keeps a running count of what's allocated, and the most that
+ * ever has been, so asking how much is used or free doesn't need a walk
+ * either.
+ *
+ * With HEAP_INTEGRITY, qalloc, qrealloc and qfree check the headers and list
+ * links of just the blocks they touch. Everything else about a block (its
+ * size, what its neighbours think of it and, with HEAP_PARANOID, that nothing
+ * has written inside it while it was free) is left to qcheck_step, which goes
+ * over the arena a few blocks at a time whenever there's nothing better to
+ * do. The one exception is the fill of a free block being handed out, which
+ * is checked as it goes, as it's about to be written over.
+ */
 
-#define SZFLAG_SZ (~3)
+#define SZFLAG_SZ (~3UL)
 #define SZFLAG_FFREE 1
+#define SZFLAG_FPREVFREE 2
+
+#if UINTPTR_MAX > 0xFFFFFFFFu
+#  define ALIGN_LOG2	3
+#else
+#  define ALIGN_LOG2	2
+#endif
+#define QALIGN		(1 << ALIGN_LOG2)
 
+#define SL_LOG2		3
+#define SL_COUNT	(1 << SL_LOG2)
+/* below this, size classes are just linear steps of QALIGN */
+#define FL_SHIFT	(SL_LOG2 + ALIGN_LOG2)
+#define SMALL_BLOCK	(1 << FL_SHIFT)
+/* no block is as big as this. Arenas bigger have the rest left alone */
+#define FL_MAX_LOG2	20
+#define FL_COUNT	(FL_MAX_LOG2 - FL_SHIFT + 1)
+#define QMAX_BLOCK	(1UL << FL_MAX_LOG2)
 
 typedef struct qblock {
 #ifdef HEAP_INTEGRITY
@@ -29,8 +69,29 @@ typedef struct qblock {
 #endif
 } qblock_t;
 
-#define ALIGN(s)	((s + 3) & ~3)
+/* kept in the payload of a free block */
+typedef struct qlinks {
+	qblock_t *next;
+	qblock_t *prev;
+} qlinks_t;
+
+/* qarena_t is all anyone else sees of this */
+typedef struct qcontrol {
+	qarena_t arena;
+	unsigned long used; /* bytes in allocated blocks, headers and all */
+	unsigned long peak; /* the most used has been since qinit */
+	unsigned long usable; /* bytes in all blocks */
+	qblock_t *end;
+	qblock_t *check; /* where qcheck_step has got to */
+	uint32_t fl_bitmap;
+	uint8_t sl_bitmap[FL_COUNT];
+	qblock_t *blocks[FL_COUNT][SL_COUNT];
+} qcontrol_t;
+
+#define ALIGN(s)	(((s) + QALIGN - 1) & ~(QALIGN - 1))
 
+#define CTRL(arena)		((qcontrol_t *)(arena))
+#define CTRL_FIRST(ctrl)	((qblock_t *)ALIGN((uintptr_t)((ctrl) + 1)))
 #define BLK(blk)		((qblock_t *)(blk))
 #define BLK_FROMPAYLOAD(p)	(void*)((char*)(p) - sizeof(qblock_t))
 #define BLK_SZ(blk)	((blk)->szflag & SZFLAG_SZ)
@@ -39,8 +100,17 @@ typedef struct qblock {
 #define BLK_FREE(blk)	((blk)->szflag |= SZFLAG_FFREE)
 #define BLK_ALLOC(blk)	((blk)->szflag &= ~SZFLAG_FFREE)
 #define BLK_PAYLOAD(p)	(void*)((char*)(p) + sizeof(qblock_t))
-#define BLK_COOKIE(arena, blk) ((unsigned)(arena) >> 4 ^ (unsigned)(blk))
-#define BLK_ALSIZE(size) ALIGN(size) + sizeof(qblock_t);
+#define BLK_LINKS(blk)	((qlinks_t *)BLK_PAYLOAD(blk))
+#define BLK_FOOTER(blk)	(((unsigned long *)BLK_NEXT(blk))[-1])
+#define BLK_PREV(blk)	((qblock_t *)((char*)(blk) - ((unsigned long *)(blk))[-1]))
+#define BLK_COOKIE(arena, blk) ((uintptr_t)(arena) >> 4 ^ (uintptr_t)(blk))
+/* a block has to have room for its links and footer once it's freed */
+#define BLK_MINSZ	ALIGN(sizeof(qblock_t) + sizeof(qlinks_t) + sizeof(unsigned long))
+/* what's between the links and footer of a free block, filled with HEAP_PARANOID */
+#define BLK_FILL(blk)	((unsigned long *)(BLK_LINKS(blk) + 1))
+#define BLK_FILL_END(blk) (&BLK_FOOTER(blk))
+#define FILL_BYTE	0xAA
+#define FILL_WORD	(~0UL / 0xFF * FILL_BYTE)
 
 static void _cookie_set(qarena_t *arena, qblock_t *blk) {
 #ifdef HEAP_INTEGRITY
@@ -55,132 +125,281 @@ static void _cookie_unset(qarena_t *arena, qblock_t *blk) {
 #endif
 }
 
-static void qjoin(qarena_t *arena);
 static void qcheck(qarena_t *arena, qblock_t *blk);
-static void _qsplit(qarena_t *arena, qblock_t *blk, unsigned size);
+static void _qcheck_fill(qblock_t *blk, void *to);
+static void _qrelease(qarena_t *arena, qblock_t *blk, int filled);
 
-qarena_t *qinit(void *start, unsigned size) {
-	qarena_t *arena = start;
-	arena->size = size;
-	
-	qblock_t *blk = BLK(arena + 1); // start = &arena[1], so arena[0] is left alone.
-	blk->szflag = size - sizeof(*arena);
-		_cookie_unset(arena, blk);
-#ifdef HEAP_PARANOID
-	memset(BLK_PAYLOAD(blk), 0xAA, BLK_SZ(blk) - sizeof(qblock_t));
+/* index of the highest and lowest bits set */
+static inline int _fls(unsigned long x) {
+	return (int)(sizeof(long) * 8 - 1) - __builtin_clzl(x);
+}
+static inline int _ffs(uint32_t x) {
+	return __builtin_ctz(x);
+}
+
+/* which list a block of this size goes in */
+static void _qmapping(unsigned long size, int *fl, int *sl) {
+	if (size < SMALL_BLOCK) {
+		*fl = 0;
+		*sl = size >> ALIGN_LOG2;
+	} else {
+		int f = _fls(size);
+		*sl = (size >> (f - SL_LOG2)) ^ SL_COUNT;
+		*fl = f - FL_SHIFT + 1;
+	}
+}
+
+#ifdef HEAP_INTEGRITY
+static int _qinside(qcontrol_t *ctrl, qblock_t *blk) {
+	return blk >= CTRL_FIRST(ctrl) && blk < ctrl->end && !((uintptr_t)blk & (QALIGN - 1));
+}
+
+/* That the blocks either side of this one in its list say so too */
+static void _qcheck_links(qcontrol_t *ctrl, qblock_t *blk, qblock_t *head) {
+	qblock_t *next = BLK_LINKS(blk)->next;
+	qblock_t *prev = BLK_LINKS(blk)->prev;
+
+	if (prev ? !_qinside(ctrl, prev) || BLK_LINKS(prev)->next != blk : head != blk)
+		panic("qcheck: links corrupt on free blk");
+	if (next && (!_qinside(ctrl, next) || BLK_LINKS(next)->prev != blk))
+		panic("qcheck: links corrupt on free blk");
+}
 #endif
-	BLK_FREE(blk);
-	
-	return arena;
+
+static void _qinsert(qcontrol_t *ctrl, qblock_t *blk) {
+	int fl, sl;
+	_qmapping(BLK_SZ(blk), &fl, &sl);
+
+	qblock_t *head = ctrl->blocks[fl][sl];
+	BLK_LINKS(blk)->next = head;
+	BLK_LINKS(blk)->prev = NULL;
+	if (head)
+		BLK_LINKS(head)->prev = blk;
+	ctrl->blocks[fl][sl] = blk;
+	ctrl->fl_bitmap |= 1U << fl;
+	ctrl->sl_bitmap[fl] |= 1U << sl;
 }
 
-void *qalloc(qarena_t *arena, unsigned size) {
-	qblock_t *blk = BLK(arena+1);
-	qblock_t *end = BLK((char *)arena + arena->size);
-	void *n = NULL;
-	
-	if (size == 0)
-		return NULL;
+static void _qremove(qcontrol_t *ctrl, qblock_t *blk) {
+	int fl, sl;
+	_qmapping(BLK_SZ(blk), &fl, &sl);
 
-	size = BLK_ALSIZE(size);
-	
-	while (blk && blk < end) {
-		qcheck(arena, blk);
-		
-		/* We need either exactly enough room for this block, or we
-		 * need enough room for this and one more block to be
-		 * constructed at the end.  */
-		if (!BLK_ISFREE(blk) ||
-			((BLK_SZ(blk) != size) &&
-			 (BLK_SZ(blk) < size + sizeof(qblock_t)))) {
-			blk = BLK_NEXT(blk);
-			continue;
-		}
+	qblock_t *next = BLK_LINKS(blk)->next;
+	qblock_t *prev = BLK_LINKS(blk)->prev;
+#ifdef HEAP_INTEGRITY
+	_qcheck_links(ctrl, blk, ctrl->blocks[fl][sl]);
+#endif
+	if (next)
+		BLK_LINKS(next)->prev = prev;
+	if (prev) {
+		BLK_LINKS(prev)->next = next;
+		return;
+	}
 
-		if (BLK_SZ(blk) > size) {
-			_qsplit(arena, blk, size);
-		}
+	ctrl->blocks[fl][sl] = next;
+	if (!next) {
+		ctrl->sl_bitmap[fl] &= ~(1U << sl);
+		if (!ctrl->sl_bitmap[fl])
+			ctrl->fl_bitmap &= ~(1U << fl);
+	}
+}
 
-		_cookie_set(arena, blk);
-		BLK_ALLOC(blk);
-		
-		return BLK_PAYLOAD(blk);
+/* The first free block in a list where every block is at least size */
+static qblock_t *_qfind(qcontrol_t *ctrl, unsigned long size) {
+	int fl, sl;
+
+	/* round up to the next list, so anything in it will do */
+	if (size >= SMALL_BLOCK)
+		size += (1UL << (_fls(size) - SL_LOG2)) - 1;
+	_qmapping(size, &fl, &sl);
+	if (fl >= FL_COUNT)
+		return NULL;
+
+	uint32_t sl_map = ctrl->sl_bitmap[fl] & (~0U << sl);
+	if (!sl_map) {
+		uint32_t fl_map = ctrl->fl_bitmap & (~0U << (fl + 1));
+		if (!fl_map)
+			return NULL;
+		fl = _ffs(fl_map);
+		sl_map = ctrl->sl_bitmap[fl];
 	}
-	return NULL;
+	sl = _ffs(sl_map);
+
+	return ctrl->blocks[fl][sl];
+}
+
+/* The block size we'd need to hand out size bytes */
+static unsigned long _qadjust(unsigned size) {
+	unsigned long sz = ALIGN((unsigned long)size) + sizeof(qblock_t);
+	return sz < BLK_MINSZ ? BLK_MINSZ : sz;
+}
+
+/* Mark a block that's in no list as allocated */
+static void _qmark_used(qarena_t *arena, qblock_t *blk) {
+	qcontrol_t *ctrl = CTRL(arena);
+	qblock_t *next = BLK_NEXT(blk);
+
+	BLK_ALLOC(blk);
+	if (next < ctrl->end)
+		next->szflag &= ~SZFLAG_FPREVFREE;
+	_cookie_set(arena, blk);
+	ctrl->used += BLK_SZ(blk);
+}
+
+/* Once an allocation is all done, and what's spare of it given back */
+static void _qpeak(qcontrol_t *ctrl) {
+	if (ctrl->used > ctrl->peak)
+		ctrl->peak = ctrl->used;
 }
 
-/* init a new block, carving the remaining space into a new free */
-static void _qsplit(qarena_t *arena, qblock_t *blk, unsigned size) {
+/* Cut an allocated block down to size, freeing the end of it, if that
+ * leaves enough for a block. filled is if the end of it was free until now */
+static void _qtrim(qarena_t *arena, qblock_t *blk, unsigned long size, int filled) {
+	unsigned long rest = BLK_SZ(blk) - size;
+
+	if (rest < BLK_MINSZ)
+		return;
+
 	qblock_t *newblk = (qblock_t *)((char*)blk + size);
-	newblk->szflag = BLK_SZ(blk) - size;
-	blk->szflag = size;
-	_cookie_unset(arena, newblk);
-	BLK_FREE(newblk);
+	newblk->szflag = rest;
+	blk->szflag -= rest;
+	CTRL(arena)->used -= rest;
+	_qrelease(arena, newblk, filled);
+}
+
+qarena_t *qinit(void *start, unsigned size) {
+	qcontrol_t *ctrl = (qcontrol_t *)ALIGN((uintptr_t)start);
+	qblock_t *blk = CTRL_FIRST(ctrl);
+	unsigned long usable = 0;
+
+	if ((char *)blk < (char *)start + size)
+		usable = ((char *)start + size - (char *)blk) & ~(QALIGN - 1);
+	if (usable >= QMAX_BLOCK)
+		usable = QMAX_BLOCK - QALIGN;
+
+	memset(ctrl, 0, sizeof(qcontrol_t));
+	ctrl->arena.size = size;
+	ctrl->usable = usable;
+	ctrl->end = BLK((char *)blk + usable);
+	ctrl->check = blk;
+
+	if (usable >= BLK_MINSZ) {
+		blk->szflag = usable;
+		_qrelease(&ctrl->arena, blk, 0);
+	} else {
+		ctrl->end = blk;
+		ctrl->usable = 0;
+	}
+
+	return &ctrl->arena;
+}
+
+void *qalloc(qarena_t *arena, unsigned size) {
+	qcontrol_t *ctrl = CTRL(arena);
+
+	if (size == 0 || size >= QMAX_BLOCK)
+		return NULL;
+
+	unsigned long want = _qadjust(size);
+	qblock_t *blk = _qfind(ctrl, want);
+	if (!blk)
+		return NULL;
+
+	qcheck(arena, blk);
+	/* as far as the header of what's left after it */
+	_qcheck_fill(blk, (char *)blk + want + BLK_MINSZ);
+	_qremove(ctrl, blk);
+	_qmark_used(arena, blk);
+	_qtrim(arena, blk, want, 1);
+	_qpeak(ctrl);
+
+	return BLK_PAYLOAD(blk);
 }
 
 void *qrealloc(qarena_t *arena, void *ptr, unsigned size) {
-	if (size == 0)
+	qcontrol_t *ctrl = CTRL(arena);
+
+	if (size == 0 || size >= QMAX_BLOCK)
 		return NULL;
-	
-	size = BLK_ALSIZE(size);
-	
+
 	if (!ptr)
 		return qalloc(arena, size);
-	
+
 	qblock_t *blk = BLK_FROMPAYLOAD(ptr);
-	
-	/* is the new size smaller? */
-	if (size < BLK_SZ(blk)) {
-		_qsplit(arena, blk, size);
-		_cookie_unset(arena, blk);
-		qjoin(arena);
-		return BLK_PAYLOAD(blk);
-	}
-	
-	/* is there room after */
 	qblock_t *nblk = BLK_NEXT(blk);
-	uint32_t reqsize = size - BLK_SZ(blk);
-	if (BLK_SZ(nblk) >= reqsize) {
-		/* there is a free block after. Lets take what we need */
-		_qsplit(arena, nblk, reqsize);
-		blk->szflag = size;
-		return BLK_PAYLOAD(blk);
+	unsigned long want = _qadjust(size);
+	int grown = 0;
+
+	qcheck(arena, blk);
+
+	/* is there room after. Take the lot, and give back what's spare */
+	if (want > BLK_SZ(blk) && nblk < ctrl->end && BLK_ISFREE(nblk) &&
+	    BLK_SZ(blk) + BLK_SZ(nblk) >= want) {
+		qcheck(arena, nblk);
+		_qcheck_fill(nblk, (char *)blk + want + BLK_MINSZ);
+		if (ctrl->check == nblk)
+			ctrl->check = blk;
+		_qremove(ctrl, nblk);
+		ctrl->used += BLK_SZ(nblk);
+		blk->szflag += BLK_SZ(nblk);
+		nblk = BLK_NEXT(blk);
+		if (nblk < ctrl->end)
+			nblk->szflag &= ~SZFLAG_FPREVFREE;
+		grown = 1;
+	}
+
+	/* it fits where it is, now */
+	if (want <= BLK_SZ(blk)) {
+		_qtrim(arena, blk, want, grown);
+		_qpeak(ctrl);
+		return ptr;
 	}
 
 	/* There is no room after. Try malloc */
 	void *newm = qalloc(arena, size);
 	if (!newm)
 		return NULL;
-	
-	memcpy(newm, BLK_PAYLOAD(blk), BLK_SZ(blk));
-	qfree(arena, BLK_PAYLOAD(blk));
-	qjoin(arena);
-	
+
+	memcpy(newm, ptr, BLK_SZ(blk) - sizeof(qblock_t));
+	qfree(arena, ptr);
+
 	return newm;
 }
 
 uint32_t qusedbytes(qarena_t *arena) {
-	qblock_t *blk = BLK(arena+1);
-	qblock_t *end = BLK((char *)arena + arena->size);
-	uint32_t cnt = 0;
-	
-	while (blk && blk < end) {
-		if (!BLK_ISFREE(blk)) {
-			cnt += BLK_SZ(blk);
-		}
-		blk = BLK_NEXT(blk);
-	}
-	return cnt;
+	return CTRL(arena)->used;
+}
+
+uint32_t qpeakbytes(qarena_t *arena) {
+	return CTRL(arena)->peak;
 }
 
 uint32_t qfreebytes(qarena_t *arena) {
-	return arena->size - qusedbytes(arena);
+	return CTRL(arena)->usable - CTRL(arena)->used;
+}
+
+/* The payload of the biggest free block. Against qfreebytes, it says how
+ * fragmented the arena is */
+uint32_t qlargestfree(qarena_t *arena) {
+	qcontrol_t *ctrl = CTRL(arena);
+	unsigned long largest = 0;
+
+	if (!ctrl->fl_bitmap)
+		return 0;
+
+	int fl = _fls(ctrl->fl_bitmap);
+	int sl = _fls(ctrl->sl_bitmap[fl]);
+	for (qblock_t *blk = ctrl->blocks[fl][sl]; blk; blk = BLK_LINKS(blk)->next)
+		if (BLK_SZ(blk) > largest)
+			largest = BLK_SZ(blk);
+
+	return largest - sizeof(qblock_t);
 }
 
 void qfree(qarena_t *arena, void *ptr) {
 	if (!ptr)
 		return;
-		
+
 	qblock_t *blk = BLK_FROMPAYLOAD(ptr);
 
 #ifdef HEAP_INTEGRITY
@@ -188,33 +407,86 @@ void qfree(qarena_t *arena, void *ptr) {
 	if (BLK_ISFREE(blk))
 		panic("qfree: double free");	/* XXX: this "panic" needs to not panic if we are in an app */
 #endif
+
+	CTRL(arena)->used -= BLK_SZ(blk);
+	_qrelease(arena, blk, 0);
+}
+
+#ifdef HEAP_PARANOID
+static void _qfill(unsigned long *from, unsigned long *to) {
+	if (to > from)
+		memset(from, FILL_BYTE, (char *)to - (char *)from);
+}
+#endif
+
+/* Free a block that's in no list, joining it up with any free neighbours.
+ * Its flags have to be right about the block before it. filled is if it's
+ * been free until now, and what's inside it is still fill */
+static void _qrelease(qarena_t *arena, qblock_t *blk, int filled) {
+	qcontrol_t *ctrl = CTRL(arena);
+	qblock_t *nblk = BLK_NEXT(blk);
+#ifdef HEAP_PARANOID
+	/* Only what wasn't fill before needs filling: the block, unless it's
+	 * been free all along, and the seams where it meets its neighbours */
+	unsigned long *fill = BLK_FILL(blk), *fill_end = BLK_FILL_END(blk);
+	unsigned long *seam = fill_end, *seam_end = seam;
+
+	if (filled)
+		fill_end = fill;
+#endif
+
+	if (blk->szflag & SZFLAG_FPREVFREE) {
+		qblock_t *pblk = BLK_PREV(blk);
+#ifdef HEAP_INTEGRITY
+		if (pblk < CTRL_FIRST(ctrl) || pblk >= blk)
+			panic("qfree: footer corrupt on free blk");
+#endif
+		qcheck(arena, pblk);
+#ifdef HEAP_INTEGRITY
+		if (!BLK_ISFREE(pblk) || BLK_NEXT(pblk) != blk)
+			panic("qfree: footer corrupt on free blk");
+#endif
+		_qremove(ctrl, pblk);
+#ifdef HEAP_PARANOID
+		fill = BLK_FILL_END(pblk);
+#endif
+		pblk->szflag += BLK_SZ(blk);
+		if (ctrl->check == blk)
+			ctrl->check = pblk;
+		blk = pblk;
+	}
+
+	if (nblk < ctrl->end && BLK_ISFREE(nblk)) {
+		qcheck(arena, nblk);
+		_qremove(ctrl, nblk);
 #ifdef HEAP_PARANOID
-	memset(BLK_PAYLOAD(blk), 0xAA, BLK_SZ(blk) - sizeof(qblock_t));
+		if (filled)
+			seam_end = BLK_FILL(nblk);
+		else
+			fill_end = BLK_FILL(nblk);
 #endif
+		blk->szflag += BLK_SZ(nblk);
+		if (ctrl->check == nblk)
+			ctrl->check = blk;
+	}
 
 	BLK_FREE(blk);
 	_cookie_unset(arena, blk);
-	qjoin(arena);
-}
-
-static void qjoin(qarena_t *arena) {
-	qblock_t *blk = BLK(arena+1);
-	qblock_t *end = (qblock_t *)((char *)arena + arena->size);
-	
-	while (blk && blk < end) {
-		qcheck(arena, blk);
-		if (BLK_NEXT(blk) < end && BLK_ISFREE(blk) && BLK_ISFREE(BLK_NEXT(blk))) {
-			qblock_t *nblk = BLK_NEXT(blk);
-			blk->szflag += BLK_SZ(nblk);
 #ifdef HEAP_PARANOID
-			memset(nblk, 0xAA, sizeof(qblock_t));
+	_qfill(fill, fill_end);
+	_qfill(seam, seam_end);
 #endif
-		} else {
-			blk = BLK_NEXT(blk);
-		}
-	}
+	BLK_FOOTER(blk) = BLK_SZ(blk);
+
+	nblk = BLK_NEXT(blk);
+	if (nblk < ctrl->end)
+		nblk->szflag |= SZFLAG_FPREVFREE;
+
+	_qinsert(ctrl, blk);
 }
 
+/* Just the header (and footer) of a block. What's checked of the blocks
+ * being allocated or freed */
 static void qcheck(qarena_t *arena, qblock_t *blk) {
 #ifdef HEAP_INTEGRITY
 	if (BLK_ISFREE(blk)) {
@@ -222,6 +494,8 @@ static void qcheck(qarena_t *arena, qblock_t *blk) {
 			panic("qcheck: cookie0 corrupt on free blk");
 		if (blk->cookie1 != ~BLK_COOKIE(arena, blk))
 			panic("qcheck: cookie1 corrupt on free blk");
+		if (BLK_NEXT(blk) > CTRL(arena)->end || BLK_FOOTER(blk) != BLK_SZ(blk))
+			panic("qcheck: footer corrupt on free blk");
 	} else {
 		if (blk->cookie0 != ~BLK_COOKIE(arena, blk))
 			panic("qcheck: cookie0 corrupt on alloc blk");
@@ -229,16 +503,84 @@ static void qcheck(qarena_t *arena, qblock_t *blk) {
 			panic("qcheck: cookie1 corrupt on alloc blk");
 	}
 #endif
+}
+
+/* That nothing has written into a free block, as far as to */
+static void _qcheck_fill(qblock_t *blk, void *to) {
 #ifdef HEAP_PARANOID
-	if (BLK_ISFREE(blk)) {
-		unsigned i;
-		uint8_t *p = BLK_PAYLOAD(blk);
-		
-		for (i = 0; i < BLK_SZ(blk) - sizeof(qblock_t); i++)
-			if (p[i] != 0xAA) {
-				printf("%08x %08x %08x %02x\n", p, i, &p[i], p[i]);
-				panic("qcheck: paranoia pays off -- heap corruption deep inside free block");
-			}
+	unsigned long *p = BLK_FILL(blk);
+	unsigned long *end = BLK_FILL_END(blk);
+
+	if ((unsigned long *)to < end)
+		end = to;
+	for (; p < end; p++)
+		if (*p != FILL_WORD) {
+			printf("qcheck: free blk %p written to at %p (now %lx)\n", blk, p, *p);
+			panic("qcheck: paranoia pays off -- heap corruption deep inside free block");
+		}
+#endif
+}
+
+#ifdef HEAP_INTEGRITY
+/* Everything about a block that can be checked from it and its neighbours */
+static void _qverify(qarena_t *arena, qblock_t *blk) {
+	qcontrol_t *ctrl = CTRL(arena);
+
+	if (BLK_SZ(blk) < BLK_MINSZ || (BLK_SZ(blk) & (QALIGN - 1)) || BLK_NEXT(blk) > ctrl->end)
+		panic("qcheck: size corrupt");
+	qcheck(arena, blk);
+
+	qblock_t *nblk = BLK_NEXT(blk);
+	if (nblk < ctrl->end && !!(nblk->szflag & SZFLAG_FPREVFREE) != !!BLK_ISFREE(blk))
+		panic("qcheck: next blk is wrong about this one being free");
+
+	if (!BLK_ISFREE(blk))
+		return;
+
+	if (blk->szflag & SZFLAG_FPREVFREE)
+		panic("qcheck: free blk after a free blk");
+
+	int fl, sl;
+	_qmapping(BLK_SZ(blk), &fl, &sl);
+	_qcheck_links(ctrl, blk, ctrl->blocks[fl][sl]);
+
+	_qcheck_fill(blk, BLK_FILL_END(blk));
+}
+#endif
+
+/*
+ * Check the next few blocks of the arena, everything about them, carrying
+ * on from where the last call got to. Returns 1 when that finishes a pass
+ * over the whole arena.
+ *
+ * It can be called from another thread than the one using the arena, so
+ * long as that one can't run meanwhile, and isn't part way through an
+ * allocation or free.
+ */
+int qcheck_step(qarena_t *arena, unsigned blocks) {
+#ifdef HEAP_INTEGRITY
+	qcontrol_t *ctrl = CTRL(arena);
+
+	while (blocks--) {
+		if (ctrl->check >= ctrl->end) {
+			ctrl->check = CTRL_FIRST(ctrl);
+			return 1;
+		}
+		_qverify(arena, ctrl->check);
+		ctrl->check = BLK_NEXT(ctrl->check);
 	}
+	return 0;
+#else
+	return 1;
+#endif
+}
+
+/* The whole arena, all at once */
+void qcheck_arena(qarena_t *arena) {
+#ifdef HEAP_INTEGRITY
+	qcontrol_t *ctrl = CTRL(arena);
+
+	for (qblock_t *blk = CTRL_FIRST(ctrl); blk < ctrl->end; blk = BLK_NEXT(blk))
+		_qverify(arena, blk);
 #endif
 }
@@ -0,0 +1,92 @@
+/* qpool.c
+ * Fixed-size object pools, on top of a qalloc arena
+ * RebbleOS
+ */
+
+#include <minilib.h>
+#include <qpool.h>
+#include <debug.h>
+
+/*
+ * A pool hands out objects of one size from a slab, so making and throwing
+ * away lots of the same thing costs a pointer swap rather than a trip
+ * through the allocator, and doesn't chop the arena up as it goes.
+ *
+ * The slab is either given to qpool_init, or taken from the arena the first
+ * time anything is allocated, so a pool nobody uses costs nothing. Objects
+ * given back go on a free list, threaded through the objects themselves.
+ * Once the slab is all in use, allocations go to the arena like any other,
+ * as they all do if there wasn't room in the arena for the slab.
+ */
+
+#define POOL_SIZE(size)	(((size) + sizeof(void *) - 1) & ~(sizeof(void *) - 1))
+
+/* A slab given here has to be an array of count objects of size, and the
+ * objects have to have a pointer in them, for them to be aligned for it */
+void qpool_init(qpool_t *pool, void *slab, unsigned size, unsigned count) {
+	memset(pool, 0, sizeof(qpool_t));
+	pool->slab = slab;
+	/* room for the free list link, and aligned for it */
+	pool->size = POOL_SIZE(size);
+	pool->count = count;
+}
+
+/* A zeroed object. Falls back to the arena if the pool is full, and gives
+ * up if there's no arena to fall back on */
+void *qpool_alloc(qpool_t *pool, qarena_t *arena) {
+	void *obj = NULL;
+
+	if (!pool->slab && arena && pool->count) {
+		pool->slab = qalloc(arena, pool->size * pool->count);
+		/* no room for it now means no room for it next time either, so
+		 * don't go looking every time. The pool is just the arena from here */
+		if (!pool->slab)
+			pool->count = 0;
+	}
+
+	if (pool->free) {
+		obj = pool->free;
+		pool->free = *(void **)obj;
+	} else if (pool->slab && pool->carved < pool->count) {
+		obj = pool->slab + pool->size * pool->carved++;
+	}
+
+	if (!obj) {
+		if (!arena)
+			return NULL;
+		obj = qalloc(arena, pool->size);
+		if (obj) {
+			pool->fallbacks++;
+			memset(obj, 0, pool->size);
+		}
+		return obj;
+	}
+
+	if (++pool->in_use > pool->peak)
+		pool->peak = pool->in_use;
+	memset(obj, 0, pool->size);
+
+	return obj;
+}
+
+int qpool_owns(qpool_t *pool, void *ptr) {
+	uint8_t *p = ptr;
+
+	return pool->slab && p >= pool->slab && p < pool->slab + pool->size * pool->count;
+}
+
+/* Give an object back to the pool. Returns 0 if it isn't one of ours, and
+ * should go back to wherever else it came from */
+int qpool_free(qpool_t *pool, void *ptr) {
+	if (!qpool_owns(pool, ptr))
+		return 0;
+
+	if (((uint8_t *)ptr - pool->slab) % pool->size)
+		panic("qpool: free of the middle of an object");
+
+	*(void **)ptr = pool->free;
+	pool->free = ptr;
+	pool->in_use--;
+
+	return 1;
+}
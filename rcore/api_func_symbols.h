@@ -87,7 +87,6 @@ UNIMPL(_graphics_context_set_fill_color_2bit);
 UNIMPL(_graphics_context_set_stroke_color_2bit);
 UNIMPL(_graphics_context_set_text_color_2bit);
 UNIMPL(_graphics_draw_round_rect);
-UNIMPL(_graphics_text_layout_get_max_used_size);
 UNIMPL(_window_set_background_color_2bit);
 UNIMPL(_inverter_layer_create);
 UNIMPL(_inverter_layer_destroy);
@@ -159,21 +158,12 @@ UNIMPL(_persist_read_data);
 UNIMPL(_persist_read_string);
 UNIMPL(_persist_write_data);
 UNIMPL(_dict_size);
-UNIMPL(_graphics_text_layout_get_content_size);
 UNIMPL(_accel_data_service_subscribe);
 UNIMPL(_menu_layer_legacy2_set_callbacks);
 UNIMPL(_number_window_get_window);
 UNIMPL(_gbitmap_create_blank_2bit);
 UNIMPL(_click_recognizer_is_repeating);
 UNIMPL(_accel_raw_data_service_subscribe);
-UNIMPL(_app_worker_is_running);
-UNIMPL(_app_worker_kill);
-UNIMPL(_app_worker_launch);
-UNIMPL(_app_worker_message_subscribe);
-UNIMPL(_app_worker_message_unsubscribe);
-UNIMPL(_app_worker_send_message);
-UNIMPL(_worker_event_loop);
-UNIMPL(_worker_launch_app);
 UNIMPL(_compass_service_peek);
 UNIMPL(_compass_service_set_heading_filter);
 UNIMPL(_compass_service_subscribe);
@@ -238,13 +228,6 @@ UNIMPL(_gpoint_from_polar);
 UNIMPL(_graphics_draw_arc);
 UNIMPL(_graphics_fill_radial);
 UNIMPL(_grect_centered_from_polar);
-UNIMPL(_graphics_text_attributes_create);
-UNIMPL(_graphics_text_attributes_destroy);
-UNIMPL(_graphics_text_attributes_enable_paging);
-UNIMPL(_graphics_text_attributes_enable_screen_text_flow);
-UNIMPL(_graphics_text_attributes_restore_default_paging);
-UNIMPL(_graphics_text_attributes_restore_default_text_flow);
-UNIMPL(_graphics_text_layout_get_content_size_with_attributes);
 UNIMPL(_layer_convert_rect_to_screen);
 UNIMPL(_text_layer_enable_screen_text_flow_and_paging);
 UNIMPL(_health_service_activities_iterate);
@@ -331,6 +314,7 @@ const VoidFunc sym[] = {
                                                                                             
     [122] = (VoidFunc)graphics_fill_circle,                                                    // graphics_fill_circle@000001e8
     [123] = (VoidFunc)graphics_fill_rect,                                                      // graphics_fill_rect@000001ec
+    [125] = (VoidFunc)graphics_text_layout_get_max_used_size,                                  // graphics_text_layout_get_max_used_size@000001f4
                                                                                             
     [126] = (VoidFunc)grect_align,                                                             // grect_align@000001f8
     [127] = (VoidFunc)n_grect_center_point,                                                    // grect_center_point@000001fc
@@ -463,6 +447,7 @@ const VoidFunc sym[] = {
     [307] = (VoidFunc)window_single_click_subscribe,                                           // window_single_click_subscribe@000004cc
     [308] = (VoidFunc)window_single_repeating_click_subscribe,                                 // window_single_repeating_click_subscribe@000004d0
     [309] = (VoidFunc)graphics_draw_text,                                                      // graphics_draw_text@000004d4
+    [315] = (VoidFunc)graphics_text_layout_get_content_size,                                   // graphics_text_layout_get_content_size@000004ec
 
     [316] = (VoidFunc)simple_menu_layer_get_menu_layer,                                        // simple_menu_layer_get_menu_layer@000004f0
 
@@ -471,6 +456,14 @@ const VoidFunc sym[] = {
                                                                                                
     [321] = (VoidFunc)window_get_click_config_context,                                         // window_get_click_config_context@00000504
     [323] = (VoidFunc)app_realloc,                                                             // realloc@0000050c
+    [327] = (VoidFunc)app_worker_is_running,                                                   // app_worker_is_running@0000051c
+    [328] = (VoidFunc)app_worker_kill,                                                         // app_worker_kill@00000520
+    [329] = (VoidFunc)app_worker_launch,                                                       // app_worker_launch@00000524
+    [330] = (VoidFunc)app_worker_message_subscribe,                                            // app_worker_message_subscribe@00000528
+    [331] = (VoidFunc)app_worker_message_unsubscribe,                                          // app_worker_message_unsubscribe@0000052c
+    [332] = (VoidFunc)app_worker_send_message,                                                 // app_worker_send_message@00000530
+    [333] = (VoidFunc)worker_event_loop,                                                       // worker_event_loop@00000534
+    [334] = (VoidFunc)worker_launch_app,                                                       // worker_launch_app@00000538
     [335] = (VoidFunc)app_heap_bytes_free,                                                     // heap_bytes_free@0000053c
     [336] = (VoidFunc)app_heap_bytes_used,                                                     // heap_bytes_used@00000540
     [343] = (VoidFunc)gpath_fill_app,                                                          // gpath_draw_filled@0000055c
@@ -479,7 +472,7 @@ const VoidFunc sym[] = {
     [350] = (VoidFunc)graphics_release_frame_buffer,                                           // graphics_release_frame_buffer@00000578
     [351] = (VoidFunc)clock_to_timestamp,                                                      // clock_to_timestamp@0000057c    
                                                                                                
-    [363] = (VoidFunc)mktime,                                                                  // mktime@000005ac
+    [363] = (VoidFunc)rcore_mktime,                                                            // mktime@000005ac
     [364] = (VoidFunc)gcolor_equal,                                                            // gcolor_equal@000005b0
                                                                                                
     [370] = (VoidFunc)bitmap_layer_set_background_color,                                       // bitmap_layer_set_background_color@000005c8
@@ -489,7 +482,7 @@ const VoidFunc sym[] = {
                                                                                                
     [377] = (VoidFunc)window_set_background_color,                                             // window_set_background_color@000005e4
                                                                                                
-    [379] = (VoidFunc)localtime,                                                               // localtime@000005ec
+    [379] = (VoidFunc)rcore_pbl_localtime,                                                     // localtime@000005ec
     [380] = (VoidFunc)animation_create,                                                        // animation_create@000005f0
     [381] = (VoidFunc)animation_destroy,                                                       // animation_destroy@000005f4
     [382] = (VoidFunc)animation_get_context,                                                // animation_get_context@000005f8
@@ -666,6 +659,13 @@ const VoidFunc sym[] = {
     [578] = (VoidFunc)menu_layer_get_center_focused,                                           // menu_layer_get_center_focused@00000908
     [579] = (VoidFunc)menu_layer_set_center_focused,                                           // menu_layer_set_center_focused@0000090c
     [580] = (VoidFunc)grect_inset,                                                          // grect_inset@00000910
+    [585] = (VoidFunc)graphics_text_attributes_create,                                         // graphics_text_attributes_create@00000924
+    [586] = (VoidFunc)graphics_text_attributes_destroy,                                        // graphics_text_attributes_destroy@00000928
+    [587] = (VoidFunc)graphics_text_attributes_enable_paging,                                  // graphics_text_attributes_enable_paging@0000092c
+    [588] = (VoidFunc)graphics_text_attributes_enable_screen_text_flow,                        // graphics_text_attributes_enable_screen_text_flow@00000930
+    [589] = (VoidFunc)graphics_text_attributes_restore_default_paging,                         // graphics_text_attributes_restore_default_paging@00000934
+    [590] = (VoidFunc)graphics_text_attributes_restore_default_text_flow,                      // graphics_text_attributes_restore_default_text_flow@00000938
+    [591] = (VoidFunc)graphics_text_layout_get_content_size_with_attributes,                   // graphics_text_layout_get_content_size_with_attributes@0000093c
                                                                                                
     [592] = (VoidFunc)layer_convert_point_to_screen,                                           // layer_convert_point_to_screen@00000940
                                                                                                
@@ -757,7 +757,6 @@ const VoidFunc sym[] = {
     [114] = (UnimplFunc)_graphics_context_set_stroke_color_2bit,                               // graphics_context_set_stroke_color_2bit@000001c8
     [115] = (UnimplFunc)_graphics_context_set_text_color_2bit,                                 // graphics_context_set_text_color_2bit@000001cc
     [121] = (UnimplFunc)_graphics_draw_round_rect,                                             // graphics_draw_round_rect@000001e4
-    [125] = (UnimplFunc)_graphics_text_layout_get_max_used_size,                               // graphics_text_layout_get_max_used_size@000001f4
     
     [135] = (UnimplFunc)_inverter_layer_create,                                                // inverter_layer_create@0000021c
     [136] = (UnimplFunc)_inverter_layer_destroy,                                               // inverter_layer_destroy@00000220
@@ -830,7 +829,6 @@ const VoidFunc sym[] = {
     [312] = (UnimplFunc)_persist_read_string,                                                  // persist_read_string@000004e0
     [313] = (UnimplFunc)_persist_write_data,                                                   // persist_write_data@000004e4
     [314] = (UnimplFunc)_dict_size,                                                            // dict_size@000004e8
-    [315] = (UnimplFunc)_graphics_text_layout_get_content_size,                                // graphics_text_layout_get_content_size@000004ec
     [317] = (UnimplFunc)_accel_data_service_subscribe,                                         // accel_data_service_subscribe@000004f4
     [320] = (UnimplFunc)_menu_layer_legacy2_set_callbacks,                                     // menu_layer_legacy2_set_callbacks@00000500
     [322] = (UnimplFunc)_number_window_get_window,                                             // number_window_get_window@00000508
@@ -838,14 +836,6 @@ const VoidFunc sym[] = {
     [324] = (UnimplFunc)_gbitmap_create_blank_2bit,                                            // gbitmap_create_blank_2bit@00000510
     [325] = (UnimplFunc)_click_recognizer_is_repeating,                                        // click_recognizer_is_repeating@00000514
     [326] = (UnimplFunc)_accel_raw_data_service_subscribe,                                     // accel_raw_data_service_subscribe@00000518
-    [327] = (UnimplFunc)_app_worker_is_running,                                                // app_worker_is_running@0000051c
-    [328] = (UnimplFunc)_app_worker_kill,                                                      // app_worker_kill@00000520
-    [329] = (UnimplFunc)_app_worker_launch,                                                    // app_worker_launch@00000524
-    [330] = (UnimplFunc)_app_worker_message_subscribe,                                         // app_worker_message_subscribe@00000528
-    [331] = (UnimplFunc)_app_worker_message_unsubscribe,                                       // app_worker_message_unsubscribe@0000052c
-    [332] = (UnimplFunc)_app_worker_send_message,                                              // app_worker_send_message@00000530
-    [333] = (UnimplFunc)_worker_event_loop,                                                    // worker_event_loop@00000534
-    [334] = (UnimplFunc)_worker_launch_app,                                                    // worker_launch_app@00000538
     [337] = (UnimplFunc)_compass_service_peek,                                                 // compass_service_peek@00000544
     [338] = (UnimplFunc)_compass_service_set_heading_filter,                                   // compass_service_set_heading_filter@00000548
     [339] = (UnimplFunc)_compass_service_subscribe,                                            // compass_service_subscribe@0000054c
@@ -914,13 +904,6 @@ const VoidFunc sym[] = {
     [582] = (UnimplFunc)_graphics_draw_arc,                                                    // graphics_draw_arc@00000918
     [583] = (UnimplFunc)_graphics_fill_radial,                                                 // graphics_fill_radial@0000091c
     [584] = (UnimplFunc)_grect_centered_from_polar,                                            // grect_centered_from_polar@00000920
-    [585] = (UnimplFunc)_graphics_text_attributes_create,                                      // graphics_text_attributes_create@00000924
-    [586] = (UnimplFunc)_graphics_text_attributes_destroy,                                     // graphics_text_attributes_destroy@00000928
-    [587] = (UnimplFunc)_graphics_text_attributes_enable_paging,                               // graphics_text_attributes_enable_paging@0000092c
-    [588] = (UnimplFunc)_graphics_text_attributes_enable_screen_text_flow,                     // graphics_text_attributes_enable_screen_text_flow@00000930
-    [589] = (UnimplFunc)_graphics_text_attributes_restore_default_paging,                      // graphics_text_attributes_restore_default_paging@00000934
-    [590] = (UnimplFunc)_graphics_text_attributes_restore_default_text_flow,                   // graphics_text_attributes_restore_default_text_flow@00000938
-    [591] = (UnimplFunc)_graphics_text_layout_get_content_size_with_attributes,                // graphics_text_layout_get_content_size_with_attributes@0000093c
     [593] = (UnimplFunc)_layer_convert_rect_to_screen,                                         // layer_convert_rect_to_screen@00000944
     [596] = (UnimplFunc)_text_layer_enable_screen_text_flow_and_paging,                        // text_layer_enable_screen_text_flow_and_paging@00000950
     [599] = (UnimplFunc)_health_service_activities_iterate,                                    // health_service_activities_iterate@0000095c
@@ -16,6 +16,7 @@
 #include "notification.h"
 #include "api_func_symbols.h"
 #include "qalloc.h"
+#include "utils.h"
 
 /* Configure Logging */
 #define MODULE_NAME "appman"
@@ -31,51 +32,65 @@
 // extern  GFont *fonts_load_custom_font(ResHandle*, struct file *file);
 
 static void _app_management_thread(void *parameters);
+static void _appmanager_release_app(app_running_thread *thread);
 static TaskHandle_t _app_thread_manager_task_handle;
 static xQueueHandle _app_thread_queue;
 static StaticTask_t _app_thread_manager_task;
 static void _appmanager_thread_init(void *pvParameters);
 
 static void _running_app_loop(void);
+static bool _appmanager_is_guest(App *app);
+static bool _appmanager_can_suspend(app_running_thread *thread, char *next);
+static void _appmanager_park(app_running_thread *thread);
+static void _appmanager_resume(app_running_thread *thread);
+static void _appmanager_discard_suspended(app_running_thread *thread);
 
 /* The manager thread needs only a small stack */
 #define APP_THREAD_MANAGER_STACK_SIZE 450
 static StackType_t _app_thread_manager_stack[APP_THREAD_MANAGER_STACK_SIZE];  // stack + heap for app (in words)
 
-/* Our pre allocated heaps for the different threads 
- * it's tempting to over engineer this and make it a node list
- * or at least add dynamicness to it. But honestly we have 3 threads
- * max at the moment, so if we get there, maybe */
-static uint8_t _heap_app[MEMORY_SIZE_APP_HEAP];
-static CCRAM uint8_t _heap_worker[MEMORY_SIZE_WORKER_HEAP];
-static CCRAM uint8_t _heap_overlay[MEMORY_SIZE_OVERLAY_HEAP];
+/* The overlay's pre allocated heap. The app and worker share theirs, and
+ * get their share as they launch (see appmanager_partition.c) */
+static CCRAM uint8_t _heap_overlay[MEMORY_SIZE_OVERLAY_HEAP] __attribute__((aligned(8)));
 
 /* keep these stacks off CCRAM */
 static StackType_t _stack_app[MEMORY_SIZE_APP_STACK];
 static StackType_t _stack_worker[MEMORY_SIZE_WORKER_STACK];
 static StackType_t _stack_overlay[MEMORY_SIZE_OVERLAY_STACK];
 
+/* and their tasks. There's a spare for an app to run in while a face is
+ * suspended, as the face's task is still there, just parked */
+static StaticTask_t _task_app;
+static StaticTask_t _task_worker;
+static StaticTask_t _task_overlay;
+static StaticTask_t _task_guest;
+
+/* How many reloc entries we pull off flash at a time while loading.
+ * Only the manager thread loads apps, so one buffer does */
+#define APP_RELOC_CHUNK 32
+static uint32_t _reloc_chunk[APP_RELOC_CHUNK];
+
 /* Initialise everything we know about the different threads */
 static app_running_thread _app_threads[MAX_APP_THREADS] = {
     {
         .thread_type = AppThreadMainApp,
         .thread_name = "MainApp",
-        .heap_size = MEMORY_SIZE_APP_HEAP,
-        .heap = _heap_app,
         .stack_size = MEMORY_SIZE_APP_STACK,
         .stack = _stack_app,
+        .static_task = &_task_app,
         .thread_entry = &appmanager_app_main_entry,
         .thread_priority = 6UL,
     },
     {
         .thread_type = AppThreadWorker,
         .thread_name = "Worker",
-        .heap_size = MEMORY_SIZE_WORKER_HEAP,
-        .heap = _heap_worker,
         .stack_size = MEMORY_SIZE_WORKER_STACK,
         .stack = _stack_worker,
-        /*.thread_entry = &appmanager_worker_main_entry */
-        .thread_priority = 8UL,
+        .static_task = &_task_worker,
+        .thread_entry = &appmanager_worker_main_entry,
+        /* only background work, so below everything but idle. A busy
+         * worker mustn't hold up the UI, bluetooth or even the backlight */
+        .thread_priority = 1UL,
     },
     {
         .thread_type = AppThreadOverlay,
@@ -84,15 +99,56 @@ static app_running_thread _app_threads[MAX_APP_THREADS] = {
         .heap = _heap_overlay,
         .stack_size = MEMORY_SIZE_OVERLAY_STACK,
         .stack = _stack_overlay,
+        .static_task = &_task_overlay,
         .thread_priority = 9UL,
     }
 };
 
+/*
+ * Going from a watchface to the menu and back would mean throwing the face
+ * away and loading it all over again. Instead, if the face has enough of
+ * its heap spare, it parks where it is, and the internal app (the guest)
+ * runs in a block taken from the face's own arena:
+ *   [ the frame the face left on screen | guest stack | guest heap ]
+ * The face's state is moved out of the thread slot meanwhile. Ask for the
+ * face again and it all goes back: the face puts its old frame straight
+ * up and carries on with its runloop. Ask for anything else but another
+ * guest and the face is woken only to quit after all.
+ */
+#ifdef PBL_BW
+/* each row is padded out to 160 bits */
+#define APP_SUSPEND_FRAME_SIZE  (DISPLAY_ROWS * 20)
+#else
+#define APP_SUSPEND_FRAME_SIZE  (DISPLAY_ROWS * DISPLAY_COLS)
+#endif
+#define APP_SUSPEND_GUEST_STACK MEMORY_SIZE_APP_STACK /* in words */
+/* the guest gets whatever the face has spare, but no less than this */
+#define APP_SUSPEND_GUEST_HEAP_MIN 24576
+#define APP_SUSPEND_BLOCK_HEAD  (APP_SUSPEND_FRAME_SIZE + APP_SUSPEND_GUEST_STACK * sizeof(StackType_t))
+#define APP_SUSPEND_BLOCK_MIN   (APP_SUSPEND_BLOCK_HEAD + APP_SUSPEND_GUEST_HEAP_MIN)
+
+/*
+ * The least that takes is 60768 bytes on snowy and 68976 on chalk, out of
+ * a 78000 byte app heap, so only a face using less than about 17 or 9 KB
+ * can park. Tintin can't suspend at all: 43936 bytes against its 24000 byte
+ * app heap. Faces there always quit
+ */
+#define APP_SUSPEND_POSSIBLE    (APP_SUSPEND_BLOCK_MIN <= (MEMORY_SIZE_APP_HEAP))
+
+static struct {
+    app_running_thread thread; /* the face's. No app if nothing is suspended */
+    uint8_t *block;
+    uint32_t block_size;
+    WindowStackState windows;
+    bool discard; /* woken to quit, not to carry on */
+} _suspended;
+
 
 uint8_t appmanager_init(void)
 {
     appmanager_app_loader_init();
     appmanager_app_runloop_init();
+    appmanager_worker_runloop_init();
 
     _app_thread_queue = xQueueCreate(3, sizeof(struct AppMessage));
 
@@ -220,8 +276,12 @@ static void _app_management_thread(void *parms)
     
     for( ;; )
     {
-        /* Sleep waiting for work to do */
-        if (xQueueReceive(_app_thread_queue, &am, pdMS_TO_TICKS(1000)))
+        /* Sleep waiting for work to do. If there's an app image to write
+         * out to the cache, get a bit of that done and come straight back.
+         * It waits for the app just launched to get going, and we look
+         * again at most a second later */
+        TickType_t wait = appmanager_app_cache_step() ? 0 : pdMS_TO_TICKS(1000);
+        if (xQueueReceive(_app_thread_queue, &am, wait))
         {
             switch(am.command)
             {
@@ -242,8 +302,22 @@ static void _app_management_thread(void *parms)
                          * we should track that or use a better mechanism.
                          * in reality this isn't a big issue. A concern maybe
                          */
-                        LOG_INFO("Quitting...");
-                        appmanager_app_quit();
+                        if (_this_thread->thread_type == AppThreadWorker)
+                        {
+                            LOG_INFO("Quitting worker...");
+                            appmanager_worker_quit();
+                        }
+                        else if (_appmanager_can_suspend(_this_thread, app_name))
+                        {
+                            AppMessage suspend = { .command = APP_SUSPEND };
+                            LOG_INFO("Suspending...");
+                            appmanager_post_generic_app_message(&suspend, 10);
+                        }
+                        else
+                        {
+                            LOG_INFO("Quitting...");
+                            appmanager_app_quit();
+                        }
                         xQueueSendToBack(_app_thread_queue, &am, (TickType_t)100);
                         continue;
                     }
@@ -263,9 +337,9 @@ static void _app_management_thread(void *parms)
                     
                     LOG_INFO("Starting app %s", app_name);
                     _this_thread->status = AppThreadLoading;
+                    _this_thread->launch = (AppLaunchTimes) { .requested = xTaskGetTickCount() };
                         
                     /*  TODO reset clicks */
-                    tick_timer_service_unsubscribe();
                     
                     if (app_manager_get_apps_head() == NULL)
                     {
@@ -275,6 +349,7 @@ static void _app_management_thread(void *parms)
                     }
                     
                     App *app = appmanager_get_app(app_name);
+                    _this_thread->launch.found = xTaskGetTickCount();
                     
                     if (app == NULL)
                     {
@@ -283,9 +358,46 @@ static void _app_management_thread(void *parms)
                         continue;
                     }
 
+                    if (_this_thread->thread_type == AppThreadWorker &&
+                            app->worker_main == NULL && app->worker_file.size == 0)
+                    {
+                        LOG_ERROR("App %s has no worker", app_name);
+                        _this_thread->status = AppThreadUnloaded;
+                        continue;
+                    }
+
+                    /* the face we parked is wanted back, or we're moving on */
+                    if (_this_thread->thread_type == AppThreadMainApp && _suspended.thread.app)
+                    {
+                        if (_suspended.thread.app == app)
+                        {
+                            _appmanager_resume(_this_thread);
+                            break;
+                        }
+                        if (!_appmanager_is_guest(app))
+                        {
+                            /* it quits for real first, then we come back round */
+                            _appmanager_discard_suspended(_this_thread);
+                            xQueueSendToBack(_app_thread_queue, &am, (TickType_t)100);
+                            continue;
+                        }
+                    }
+
+                    /* carve out its share of memory. A guest has the face's */
+                    if (!(_this_thread->thread_type == AppThreadMainApp && _suspended.thread.app) &&
+                        !appmanager_partition_thread(_this_thread, app))
+                    {
+                        assert(_this_thread->thread_type != AppThreadMainApp && "No room for the app");
+                        _this_thread->status = AppThreadUnloaded;
+                        continue;
+                    }
+
                     /* We have an app that's at least known. push on with loading it */
                     _this_thread->app = app;
-                    _this_thread->timer_head = NULL;
+                    _this_thread->timers = (CoreTimerHeap) { 0 };
+                    _this_thread->animation_clock = NULL;
+                    _this_thread->tick_timer = NULL;
+                    _this_thread->fb_scroll_layer = NULL;
                     
                     /* At this point the existing task should be gone already
                      * If it isn't we kill it. Lets complain though, becuase it's
@@ -295,17 +407,19 @@ static void _app_management_thread(void *parms)
                         _this_thread->task_handle = NULL;
                         LOG_ERROR("The previous task was still running. FIXME");
                     }
+                    _appmanager_release_app(_this_thread);
                     
                     /* If the app is running off RAM (i.e it's a PIC loaded app...) 
                     * and not system, we need to patch it */
                     if (!app->is_internal)
                     {
-                        appmanager_load_app(_this_thread, &header);
-                        total_app_size = header.virtual_size;
+                        total_app_size = appmanager_load_app(_this_thread, &header);
                     }
                     else
                     {
                         total_app_size = 0;
+                        _this_thread->main = _this_thread->thread_type == AppThreadWorker ? app->worker_main : app->main;
+                        _this_thread->launch.read = _this_thread->launch.relocated = _this_thread->launch.found;
                     }
                     
                     /* Execute the app we just loaded */
@@ -324,9 +438,14 @@ static void _app_management_thread(void *parms)
                     vTaskDelete(_this_thread->task_handle);
                     _this_thread->task_handle = NULL;
                     _this_thread->shutdown_at_tick = 0;
+                    _appmanager_release_app(_this_thread);
                     _this_thread->app = NULL;
                     _this_thread->status = AppThreadUnloaded;
                     break;
+                case THREAD_MANAGER_APP_SUSPENDED:
+                    /* the face has parked itself, the slot is free */
+                    _appmanager_park(&_app_threads[am.thread_id]);
+                    break;
             }        
         }
         else
@@ -343,6 +462,7 @@ static void _app_management_thread(void *parms)
                     
                     vTaskDelete(_this_thread->task_handle);
                     _this_thread->shutdown_at_tick = 0;
+                    _appmanager_release_app(_this_thread);
                     _this_thread->status = AppThreadUnloaded;
                 }
                 /* app really should have died by now */
@@ -410,31 +530,72 @@ static void _app_management_thread(void *parms)
     
     Steps:
     * Find app on flash
-    * Load app into lower stack
-    * Set symbol table address
-    * load relocs and reloc the GOT + DATA
+    * Load app into lower stack (or, if it can run in place, just its data)
     * zero BSS
+    * stream relocs in and reloc the GOT + DATA
+    * Set symbol table address
     * fork
         
     */
-void appmanager_load_app(app_running_thread *thread, ApplicationHeader *header)
-{   
-    struct fd fd;
-    
-    /* de-fluff */
-    memset(thread->heap, 0, thread->heap_size);
+/* Where each offset into the app image lives once it's loaded. The text
+ * may have been left in flash to run in place, everything from data_start
+ * up is in RAM */
+typedef struct AppImage {
+    uintptr_t text;
+    uintptr_t ram;
+    uint32_t data_start;
+} AppImage;
+
+/* The register holds the offset from the app base to the data.
+ * Swap it for the absolute address, wherever that offset ended up */
+static void _relocate(AppImage *image, uint32_t reg_to_reloc)
+{
+    uint32_t *reg = (uint32_t *)(image->ram + reg_to_reloc);
+    uint32_t rel_off = *reg;
 
-    fs_open(&fd, &thread->app->app_file);
-    fs_read(&fd, header, sizeof(ApplicationHeader));
+    *reg = (uint32_t)(rel_off < image->data_start ? image->text + rel_off : image->ram + rel_off);
+}
 
-    /* load the app from flash
-     *  and any reloc entries too. */
-    fs_seek(&fd, 0, FS_SEEK_SET);
-    fs_read(&fd, thread->heap, header->app_size + (header->reloc_entries_count * 4));
+/*
+ * Copy the whole app into the thread's heap. Always works.
+ * Returns how much of the heap the app takes.
+ */
+static uint32_t _load_app_copy(app_running_thread *thread, ApplicationHeader *header, struct fd *fd)
+{
+    AppImage image = {
+        .text = (uintptr_t)thread->heap,
+        .ram = (uintptr_t)thread->heap,
+        .data_start = 0,
+    };
+
+    /* if we've had this app before, it may already be relocated for us.
+     * The cache only keeps apps, not their workers */
+    bool is_app = thread->thread_type == AppThreadMainApp;
+    bool cached = is_app && appmanager_app_cache_load(thread, header);
+
+    /* load the app from flash straight into place. We already have the
+     * header, so just copy that in rather than reading it again */
+    if (!cached)
+    {
+        memcpy(thread->heap, header, sizeof(ApplicationHeader));
+        fs_read(fd, thread->heap + sizeof(ApplicationHeader), header->app_size - sizeof(ApplicationHeader));
+    }
+    thread->launch.read = xTaskGetTickCount();
     
     /* apps get loaded into heap like so
      * [App Header | App Binary | App Heap | App Stack]
      */
+    
+    /* init bss to 0. Nothing past the binary needs to be any particular
+     * value, so the rest of the heap (and the stack) is left as it is */
+    memset(thread->heap + header->app_size, 0, header->virtual_size - header->app_size);
+
+    if (cached)
+    {
+        thread->launch.relocated = xTaskGetTickCount();
+        thread->main = (AppMainHandler)((image.text + header->offset) | 1);
+        return header->virtual_size;
+    }
        
     /* re-allocate the GOT for -fPIC
      * A normal ELF dyn loader would look at the ELF header and relocate
@@ -443,9 +604,8 @@ void appmanager_load_app(app_running_thread *thread, ApplicationHeader *header)
      * This table has the offset from app bin start to the register to reloc
      * Some of the reloc will be from the .DATA section, some will be .GOT
      * (global offset table) entries
-     * The reloc table actually sits in BSS section, so once we have done
-     * we wipe the BSS again. */
-    uint8_t *reloc_table_addr = thread->heap + header->app_size;
+     * The table is streamed in a chunk at a time and applied as it comes
+     * in, so it never lands in the BSS and there is nothing to wipe after. */
     
     /* Now we have the relocs to do, we are in standard ELF dyn loader mode 
      * (albeit without having to deal with relocating PLTs)
@@ -453,40 +613,123 @@ void appmanager_load_app(app_running_thread *thread, ApplicationHeader *header)
      * To make it all work we:
      * address with relative offset = address of app bin + relative offset
      */    
-    if (header->reloc_entries_count > 0)
-    {                
+    uint32_t relocs_left = header->reloc_entries_count;
+    while (relocs_left > 0)
+    {
+        uint32_t count = MIN(relocs_left, APP_RELOC_CHUNK);
+        fs_read(fd, _reloc_chunk, count * sizeof(uint32_t));
+        relocs_left -= count;
+
         /* go through all of the reloc entries and do the reloc dance */
-        for (uint32_t i = 0; i < header->reloc_entries_count; i++)
+        for (uint32_t i = 0; i < count; i++)
         {
-            uint32_t reloc_idx = i * 4;
-            /* get the offset from app base to the register to relocate */
-            uint32_t reg_to_reloc = read_32(&reloc_table_addr[reloc_idx]);          
-            assert(reg_to_reloc < header->virtual_size && "Reloc entry beyond app bounds");
-            
-            /* Get the value from the register we are relocating.
-             * This will contain the offset from the app base to the data */
-            uint32_t rel_off = read_32(thread->heap + reg_to_reloc);
-            
-            /* Add the app base absolute memory register address to the offset
-             * Write this absolute value back into the register to relocate */
-            write_32(thread->heap + reg_to_reloc, (uint32_t)((uintptr_t)(thread->heap + rel_off)));
+            assert(_reloc_chunk[i] < header->virtual_size && "Reloc entry beyond app bounds");
+            _relocate(&image, _reloc_chunk[i]);
         }
     }
     
-    /* init bss to 0. We already zeros all of the heap, so only reset the reloc table */
-    uint32_t bss_size = header->virtual_size - header->app_size;
-    
-    memset(thread->heap + header->app_size, 0, header->reloc_entries_count * 4);
-    memset(thread->stack, 0, thread->stack_size * 4);
-    
     /* load the address of our lookup table into the 
      * special register in the app. */
-    write_32(&thread->heap[header->sym_table_addr], (int32_t)sym);
+    *(uint32_t *)(image.ram + header->sym_table_addr) = (uint32_t)sym;
+    thread->launch.relocated = xTaskGetTickCount();
 
-    assert(read_32(&thread->heap[header->sym_table_addr]) == (int32_t)sym && "PLT rewrite failed");
+    /* and save ourselves the trouble next time */
+    if (is_app)
+        appmanager_app_cache_queue(thread, header);
      
     /* Patch the app's entry point... make sure its THUMB bit set! */
-    thread->app->main = (AppMainHandler)((uint32_t)&thread->heap[header->offset] | 1);
+    thread->main = (AppMainHandler)((image.text + header->offset) | 1);
+
+    return header->virtual_size;
+}
+
+/*
+ * Leave the app's text in memory mapped flash and run it from there, so
+ * only the data, GOT and BSS take up the app's heap.
+ *
+ * The app has to have been built for it (see APP_FLAG_XIP): normal Pebble
+ * apps find their GOT relative to the pc, so the GOT has to sit right
+ * after the text, and we can't patch it in flash. It also has to be in
+ * one unbroken run of flash, which fs_map() knows about.
+ * Returns how much of the heap the app takes, or 0 if it has to be copied
+ * in after all.
+ */
+static uint32_t _load_app_xip(app_running_thread *thread, ApplicationHeader *header)
+{
+    /* only the app gets the flash mapped, a worker is copied in */
+    if (!(header->flags & APP_FLAG_XIP) || thread->thread_type != AppThreadMainApp)
+        return 0;
+
+    uint32_t relocs_size = header->reloc_entries_count * sizeof(uint32_t);
+    const uint8_t *flash = fs_map(&thread->app->app_file, header->app_size + relocs_size);
+
+    if (!flash)
+        return 0;
+
+    /* literal pools and doubles in the text expect the image to be aligned,
+     * and the RAM copy has to be aligned the same way */
+    uint32_t data_start = header->sym_table_addr & ~7;
+    const uint32_t *relocs = (const uint32_t *)(flash + header->app_size);
+
+    if (((uintptr_t)flash & 7) || data_start >= header->app_size)
+        goto fallback;
+
+    /* anything that needs patching had better not still be in flash */
+    for (uint32_t i = 0; i < header->reloc_entries_count; i++)
+        if (relocs[i] < data_start || relocs[i] >= header->virtual_size)
+            goto fallback;
+
+    AppImage image = {
+        .text = (uintptr_t)flash,
+        .ram = (uintptr_t)thread->heap - data_start,
+        .data_start = data_start,
+    };
+
+    /* [Jump table pointer | GOT | .data] copied in, then BSS */
+    memcpy(thread->heap, flash + data_start, header->app_size - data_start);
+    memset(thread->heap + header->app_size - data_start, 0, header->virtual_size - header->app_size);
+    thread->launch.read = xTaskGetTickCount();
+
+    /* the table is right there in flash, no need to stream it */
+    for (uint32_t i = 0; i < header->reloc_entries_count; i++)
+        _relocate(&image, relocs[i]);
+
+    *(uint32_t *)(image.ram + header->sym_table_addr) = (uint32_t)sym;
+    thread->launch.relocated = xTaskGetTickCount();
+
+    thread->main = (AppMainHandler)((image.text + header->offset) | 1);
+    /* the GOT comes straight after the jump table pointer */
+    thread->pic_base = (void *)(image.ram + header->sym_table_addr + sizeof(uint32_t));
+    thread->xip_text = flash;
+
+    LOG_INFO("Running in place: %d bytes of text left in flash at 0x%x", data_start, flash);
+
+    return header->virtual_size - data_start;
+
+fallback:
+    fs_unmap();
+    return 0;
+}
+
+/*
+ * Load the app for this thread, in place if it can run that way.
+ * Returns how much of the thread's heap the app image takes.
+ */
+uint32_t appmanager_load_app(app_running_thread *thread, ApplicationHeader *header)
+{   
+    struct fd fd;
+    uint32_t image_size;
+    
+    if (thread->thread_type == AppThreadWorker)
+        fs_open(&fd, &thread->app->worker_file);
+    else
+        fs_open(&fd, &thread->app->app_file);
+    fs_read(&fd, header, sizeof(ApplicationHeader));
+    assert(header->virtual_size <= thread->heap_size && "App too big for its heap");
+
+    image_size = _load_app_xip(thread, header);
+    if (!image_size)
+        image_size = _load_app_copy(thread, header, &fd);
     
     LOG_DEBUG("== App signature ==");
     LOG_DEBUG("Header  : %s",    header->header);
@@ -505,8 +748,24 @@ void appmanager_load_app(app_running_thread *thread, ApplicationHeader *header)
     LOG_DEBUG("Reloc   : %d",    header->reloc_entries_count);
     LOG_DEBUG("== Memory signature ==");
     LOG_DEBUG("VSize   : 0x%x",  header->virtual_size);
-    LOG_DEBUG("Bss Size: %d",    bss_size);
-    LOG_DEBUG("Heap    : 0x%x",  thread->heap + header->virtual_size);
+    LOG_DEBUG("Bss Size: %d",    header->virtual_size - header->app_size);
+    LOG_DEBUG("In RAM  : %d",    image_size);
+    LOG_DEBUG("Heap    : 0x%x",  thread->heap + image_size);
+
+    return image_size;
+}
+
+/*
+ * Let go of anything the last app on this thread still holds
+ */
+static void _appmanager_release_app(app_running_thread *thread)
+{
+    if (thread->xip_text)
+    {
+        fs_unmap();
+        thread->xip_text = NULL;
+    }
+    thread->pic_base = NULL;
 }
 
 /* 
@@ -528,6 +787,7 @@ void appmanager_execute_app(app_running_thread *thread, uint32_t total_app_size)
     
     /* heap is all uint8_t */
     thread->arena = qinit(heap_entry, heap_size);
+    app_pools_init(thread);
     
     /* Load the app in a vTask */
     xTaskCreateStatic(_appmanager_thread_init, 
@@ -536,7 +796,211 @@ void appmanager_execute_app(app_running_thread *thread, uint32_t total_app_size)
                         (void *)thread, 
                         tskIDLE_PRIORITY + thread->thread_priority, 
                         thread->stack, 
-                        (StaticTask_t*)&thread->static_task);
+                        thread->static_task);
+}
+
+/*
+ * The app has drawn for the first time. If that's the first since it was
+ * launched, say how long each step of getting here took
+ */
+void appmanager_app_first_frame(app_running_thread *thread)
+{
+    AppLaunchTimes *launch = &thread->launch;
+
+    if (launch->first_frame)
+        return;
+
+    launch->first_frame = xTaskGetTickCount();
+
+    if (launch->resumed)
+    {
+        LOG_INFO("Resumed %s in %d ms", thread->app->name,
+                 (launch->first_frame - launch->requested) * portTICK_PERIOD_MS);
+        return;
+    }
+
+    LOG_INFO("Launched %s%s in %d ms: lookup %d, read %d, reloc %d, init %d, first frame %d",
+             thread->app->name, thread->xip_text ? " in place" : "",
+             (launch->first_frame - launch->requested) * portTICK_PERIOD_MS,
+             (launch->found - launch->requested) * portTICK_PERIOD_MS,
+             (launch->read - launch->found) * portTICK_PERIOD_MS,
+             (launch->relocated - launch->read) * portTICK_PERIOD_MS,
+             (launch->initialised - launch->relocated) * portTICK_PERIOD_MS,
+             (launch->first_frame - launch->initialised) * portTICK_PERIOD_MS);
+}
+
+/* Internal apps that aren't faces can run in a suspended face's heap */
+static bool _appmanager_is_guest(App *app)
+{
+    return app->is_internal && app->type != APP_TYPE_FACE;
+}
+
+/*
+ * Should the app on this thread be suspended to make way for next, rather
+ * than quit? The face still gets the final say, if it's short of room.
+ */
+static bool _appmanager_can_suspend(app_running_thread *thread, char *next)
+{
+    if (!APP_SUSPEND_POSSIBLE ||
+        thread->thread_type != AppThreadMainApp || thread->status != AppThreadRunloop ||
+        thread->app->type != APP_TYPE_FACE || _suspended.thread.app)
+        return false;
+
+    App *app = appmanager_get_app(next);
+    return app && _appmanager_is_guest(app);
+}
+
+/*
+ * Called on the face's own thread when it's asked to make way. If there's
+ * room in its arena for a guest, hand the manager our state and park until
+ * we are wanted again (returns true). Returns false if there's no room,
+ * or if we were only woken to be thrown away, and the face should quit.
+ */
+bool appmanager_app_suspend(app_running_thread *thread)
+{
+    /* lend out all we can. The good-fit search can turn down a request
+     * for the whole of the largest free block, so settle for the least */
+    uint32_t size = qlargestfree(thread->arena);
+    uint8_t *block = NULL;
+
+    if (size >= APP_SUSPEND_BLOCK_MIN)
+        block = qalloc(thread->arena, size);
+    if (block == NULL && size >= APP_SUSPEND_BLOCK_MIN)
+    {
+        size = APP_SUSPEND_BLOCK_MIN;
+        block = qalloc(thread->arena, size);
+    }
+
+    if (block == NULL)
+    {
+        LOG_INFO("No room to keep %s suspended, quitting it", thread->app->name);
+        return false;
+    }
+
+    thread->status = AppThreadUnloading;
+
+    /* keep what we last drew, to put straight back up */
+    display_buffer_lock_take(portMAX_DELAY);
+    memcpy(block, display_get_buffer(), APP_SUSPEND_FRAME_SIZE);
+    display_buffer_lock_give();
+
+    window_stack_suspend(&_suspended.windows);
+    _suspended.block = block;
+    _suspended.block_size = size;
+
+    AppMessage am = {
+        .thread_id = thread->thread_type,
+        .command = THREAD_MANAGER_APP_SUSPENDED,
+    };
+    appmanager_post_generic_thread_message(&am, portMAX_DELAY);
+
+    /* the manager gives us a nudge once the slot is ours again */
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+    /* our windows go back either way, so quitting takes them down */
+    window_stack_resume(&_suspended.windows);
+
+    if (_suspended.discard)
+    {
+        _suspended.discard = false;
+        qfree(thread->arena, block);
+        return false;
+    }
+
+    display_buffer_lock_take(portMAX_DELAY);
+    memcpy(display_get_buffer(), block, APP_SUSPEND_FRAME_SIZE);
+    display_draw();
+    display_buffer_lock_give();
+    appmanager_app_first_frame(thread);
+
+    qfree(thread->arena, block);
+    return true;
+}
+
+/*
+ * Move the parked face out of the thread slot, and set the slot up for a
+ * guest in the block the face gave up
+ */
+static void _appmanager_park(app_running_thread *thread)
+{
+    uint8_t *guest = _suspended.block + APP_SUSPEND_FRAME_SIZE;
+    uint32_t heap_size = _suspended.block_size - APP_SUSPEND_BLOCK_HEAD;
+
+    _suspended.thread = *thread;
+    _suspended.thread.status = AppThreadSuspended;
+
+    thread->app = NULL;
+    thread->status = AppThreadUnloaded;
+    thread->task_handle = NULL;
+    thread->static_task = &_task_guest;
+    thread->shutdown_at_tick = 0;
+    thread->stack = (StackType_t *)guest;
+    thread->stack_size = APP_SUSPEND_GUEST_STACK;
+    thread->heap = guest + APP_SUSPEND_GUEST_STACK * sizeof(StackType_t);
+    thread->heap_size = heap_size;
+    thread->timers = (CoreTimerHeap) { 0 };
+    thread->animation_clock = NULL;
+    thread->tick_timer = NULL;
+    thread->fb_scroll_layer = NULL;
+    /* the face keeps its mapping, it's still running from it */
+    thread->xip_text = NULL;
+    thread->pic_base = NULL;
+    thread->arena = NULL;
+    thread->graphics_context = NULL;
+
+    LOG_INFO("Suspended %s, %d bytes lent out, %d of them heap",
+             _suspended.thread.app->name, _suspended.block_size, heap_size);
+}
+
+/*
+ * Is any app running its text straight from flash? A parked face counts,
+ * as it will be again as soon as it's woken
+ */
+bool appmanager_app_in_place(void)
+{
+    for (uint8_t i = 0; i < MAX_APP_THREADS; i++)
+        if (_app_threads[i].xip_text)
+            return true;
+
+    return _suspended.thread.app && _suspended.thread.xip_text;
+}
+
+/*
+ * Put the face back in the slot and wake it. The guest is long gone. The
+ * face opens its runloop up to messages once it has cleared out the
+ * guest's leftovers
+ */
+static void _appmanager_resume(app_running_thread *thread)
+{
+    AppLaunchTimes launch = thread->launch;
+
+    *thread = _suspended.thread;
+    thread->status = AppThreadLoaded;
+    thread->launch = launch;
+    thread->launch.read = thread->launch.relocated = thread->launch.initialised = launch.found;
+    thread->launch.resumed = true;
+    _suspended.thread.app = NULL;
+
+    LOG_INFO("Resuming %s", thread->app->name);
+    xTaskNotifyGive(thread->task_handle);
+}
+
+/*
+ * Something is wanted that won't fit alongside the face. Put the face back
+ * in the slot and wake it to quit, so its deinit runs and its windows,
+ * timers and animations go the way any quitting app's do. It gets the
+ * usual time to finish before it's killed
+ */
+static void _appmanager_discard_suspended(app_running_thread *thread)
+{
+    LOG_INFO("Dropping suspended %s", _suspended.thread.app->name);
+    *thread = _suspended.thread;
+    thread->status = AppThreadUnloading;
+    thread->shutdown_at_tick = xTaskGetTickCount() + pdMS_TO_TICKS(5000);
+    _suspended.thread.app = NULL;
+    _suspended.discard = true;
+
+    xTaskNotifyGive(thread->task_handle);
 }
 
 static void _appmanager_thread_init(void *thread_handle)
@@ -13,20 +13,37 @@
 #include "FreeRTOS.h"
 #include "task.h"
 #include "qalloc.h"
+#include "qpool.h"
+#include "rebble_memory.h"
 #include "node_list.h"
 #include <stdbool.h>
 
-// TODO     Make this dynamic. hacky 
-#define NUM_APPS 3
 #define MAX_APP_STR_LEN 32
 
 typedef struct CoreTimer
 {
     TickType_t when; /* ticks when this should fire, in ticks since boot */
+    TickType_t slack; /* how many ticks late it may fire, to share a wakeup */
     void (*callback)(struct CoreTimer *); /* always called back on the app thread */
-    struct CoreTimer *next;
+    /* where this sits in the thread's timer heap */
+    struct CoreTimer *parent;
+    struct CoreTimer *left;
+    struct CoreTimer *right;
 } CoreTimer;
 
+/* An intrusive binary min-heap of timers, soonest at the root.
+ * The timers are the nodes, so adding one never allocates */
+typedef struct CoreTimerHeap
+{
+    CoreTimer *root;
+    uint16_t count;
+    uint32_t wakeups; /* separate ticks we have fired timers on */
+    TickType_t last_fired;
+} CoreTimerHeap;
+
+/* a fires before b, allowing for the tick count wrapping */
+#define TIMER_BEFORE(a, b) ((int32_t)((a) - (b)) < 0)
+
 typedef struct AppMessage
 {
     uint8_t thread_id;
@@ -90,15 +107,29 @@ typedef struct ApplicationHeader {
 
 
 
+/* Not one of Pebble's. The app was built to run its text straight out of
+ * flash (-msingle-pic-base -mno-pic-data-is-text-relative, so the GOT is
+ * found through r9 rather than the pc). Everything writable comes after
+ * all of the text and rodata, starting with the jump table pointer, then
+ * the GOT, then .data */
+#define APP_FLAG_XIP     (1UL << 31)
+
 typedef struct App {
     uint8_t type; // this will be in flags I presume <-- it is. TODO. Hook flags up
     bool is_internal; // is the app baked into flash
     struct file app_file;
     struct file resource_file; // the file where we are keeping the resources for this app
+    struct file worker_file; // the app's background worker, if size isn't 0
     char *name;
+    Uuid uuid; // zero for the baked in apps
+    uint32_t application_id; // what its files in the fs are named after
+    uint32_t name_hash;
     ApplicationHeader *header;
     AppMainHandler main; // A shortcut to main
+    AppMainHandler worker_main; // and to the worker's, for baked in apps
     list_node node; 
+    struct App *next_by_name; // chains in the registry's hash tables
+    struct App *next_by_uuid;
 } App;
 
 typedef struct AppTypeHeader {
@@ -113,6 +144,8 @@ typedef struct AppTypeHeader {
 #define APP_QUIT         1
 #define APP_TICK         2
 #define APP_DRAW         3
+#define APP_SUSPEND      4
+#define APP_WORKER_MESSAGE 5
 
 #define APP_TYPE_SYSTEM  0
 #define APP_TYPE_FACE    1
@@ -128,6 +161,7 @@ typedef enum AppThreadState {
     AppThreadLoaded,
     AppThreadRunloop,
     AppThreadUnloading,
+    AppThreadSuspended, /* a face parked while an internal app borrows its heap */
 } AppThreadState;
 
 /* We have App
@@ -145,6 +179,27 @@ typedef enum AppThreadType {
 
 #define THREAD_MANAGER_APP_LOAD       0
 #define THREAD_MANAGER_APP_QUIT_CLEAN 1
+#define THREAD_MANAGER_APP_SUSPENDED  2
+
+/* When each step of getting an app up on screen finished, in ticks.
+ * Logged once the app's first frame is out */
+typedef struct AppLaunchTimes {
+    TickType_t requested;   /* the manager picked up the load */
+    TickType_t found;       /* lookup: we know where the app is */
+    TickType_t read;        /* read: the binary is in RAM */
+    TickType_t relocated;   /* reloc: the binary is patched up to run */
+    TickType_t initialised; /* init: the app's init is done, into the runloop */
+    TickType_t first_frame; /* first frame: something is on screen */
+    bool resumed;           /* it was suspended, so all but the frame is free */
+} AppLaunchTimes;
+
+/* How the memory the app and worker share is carved up, in bytes */
+typedef struct AppPartitionStats {
+    size_t pool;        /* all there is to share */
+    size_t app;         /* the app's share */
+    size_t worker;      /* the running worker's, 0 if there isn't one */
+    size_t largest_app; /* the biggest app that would launch right now */
+} AppPartitionStats;
 
 /* This struct hold all information about the task that is executing
  * There are many runing apps, such as main app, worker or background.
@@ -158,14 +213,22 @@ typedef struct app_running_thread_t {
     const char *thread_name;    
     uint8_t thread_priority;
     TaskHandle_t task_handle;
-    StaticTask_t static_task;
+    StaticTask_t *static_task;
     size_t stack_size;
     size_t heap_size;
     StackType_t *stack;
     uint8_t *heap;
-    struct CoreTimer *timer_head;
+    AppMainHandler main; /* where the app or worker on this thread starts */
+    CoreTimerHeap timers;
+    struct AnimationClock *animation_clock;
+    struct TickTimerState *tick_timer;
+    AppLaunchTimes launch;
+    const void *xip_text; /* the app's text, if it's running from flash */
+    void *pic_base; /* where r9 points for an app running in place */
     qarena_t *arena;
+    qpool_t pools[ObjectPoolMax]; /* carved from the arena as they're used */
     struct n_GContext *graphics_context;
+    struct ScrollLayer *fb_scroll_layer; /* kept its last frame to shift, see scroll_layer.c */
 } app_running_thread;
 
 /* in appmanager.c */
@@ -180,10 +243,18 @@ bool appmanager_is_thread_system(void);
 bool appmanager_is_thread_worker(void);
 bool appmanager_is_thread_app(void);
 bool appmanager_is_thread_overlay(void);
-void appmanager_load_app(app_running_thread *thread, ApplicationHeader *header);
+uint32_t appmanager_load_app(app_running_thread *thread, ApplicationHeader *header);
 void appmanager_execute_app(app_running_thread *thread, uint32_t total_app_size);
 app_running_thread *appmanager_get_thread(AppThreadType type);
 AppThreadType appmanager_get_thread_type(void);
+void appmanager_app_first_frame(app_running_thread *thread);
+bool appmanager_app_suspend(app_running_thread *thread);
+bool appmanager_app_in_place(void);
+
+/* in appmanager_app_cache.c */
+bool appmanager_app_cache_load(app_running_thread *thread, ApplicationHeader *header);
+void appmanager_app_cache_queue(app_running_thread *thread, ApplicationHeader *header);
+bool appmanager_app_cache_step(void);
 
 /* in appmanager_app_runloop.c */
 void appmanager_app_runloop_init(void);
@@ -198,13 +269,31 @@ void appmanager_app_quit(void);
 void appmanager_app_display_done(void);
 bool appmanager_is_app_shutting_down(void);
 
-void appmanager_post_generic_app_message(AppMessage *am, TickType_t timeout);
+bool appmanager_post_generic_app_message(AppMessage *am, TickType_t timeout);
 void appmanager_timer_expired(app_running_thread *thread);
 TickType_t appmanager_timer_get_next_expiry(app_running_thread *thread);
+
+/* in appmanager_worker.c */
+void appmanager_worker_runloop_init(void);
+void appmanager_worker_main_entry(void);
+bool appmanager_post_generic_worker_message(AppMessage *am, TickType_t timeout);
+void appmanager_worker_start(char *name);
+void appmanager_worker_quit(void);
+
+/* in appmanager_partition.c */
+bool appmanager_partition_thread(app_running_thread *thread, App *app);
+void appmanager_partition_get_stats(AppPartitionStats *stats);
+
 /* in appmanager_app.c */
 App *appmanager_get_app(char *app_name);
+App *appmanager_get_app_by_uuid(const Uuid *uuid);
+uint16_t appmanager_get_app_count(void);
 void appmanager_app_loader_init(void);
 
 void rocky_event_loop_with_resource(uint16_t resource_id);
 
 void timer_init(void);
+void timer_heap_insert(CoreTimerHeap *heap, CoreTimer *timer);
+bool timer_heap_remove(CoreTimerHeap *heap, CoreTimer *timer);
+bool timer_heap_contains(CoreTimerHeap *heap, CoreTimer *timer);
+CoreTimer *timer_heap_find(CoreTimerHeap *heap, bool (*match)(CoreTimer *timer, void *context), void *context);
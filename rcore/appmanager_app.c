@@ -14,11 +14,14 @@
 #include "notification.h"
 #include "test_defs.h"
 #include "node_list.h"
+#include "flash.h"
 
 static App *_appmanager_create_app(char *name, uint8_t type, void *entry_point, bool is_internal,
                                    const struct file *app_file, const struct file *resource_file);
 static void _appmanager_flash_load_app_manifest();
 static void _appmanager_add_to_manifest(App *app);
+static bool _appmanager_snapshot_load(const struct file *appdb, uint32_t appdb_hash);
+static void _appmanager_snapshot_save(const struct file *appdb, uint32_t appdb_hash);
 
 /* simple doesn't have an include, so cheekily forward declare here */
 void simple_main(void);
@@ -53,7 +56,32 @@ struct appdb
     uint8_t unk_arr[32]; // always blank
 } __attribute__((__packed__));
 
+/*
+ * The registry. Every app we know of is on the manifest list, in the order
+ * we found them, for anyone who wants to go through them all. To find just
+ * one, they are also chained into two hash tables, by name and by UUID.
+ * The tables double whenever there are more apps than buckets, so a
+ * lookup only ever walks a chain or two however many are installed.
+ */
+#define APP_REGISTRY_MIN_BUCKETS 16
+
 static list_head _app_manifest_head = LIST_HEAD(_app_manifest_head);
+static App **_apps_by_name;
+static App **_apps_by_uuid;
+static uint16_t _app_buckets;
+static uint16_t _app_count;
+
+static uint32_t _appmanager_uuid_hash(const Uuid *uuid)
+{
+    return fnv1a_hash(FNV1A_INIT, uuid, sizeof(Uuid));
+}
+
+static bool _appmanager_uuid_is_zero(const Uuid *uuid)
+{
+    static const Uuid zero;
+    return !memcmp(uuid, &zero, sizeof(Uuid));
+}
+
 /*
  * Load any pre-existing apps into the manifest, search for any new ones and then start up
  */
@@ -67,7 +95,10 @@ void appmanager_app_loader_init()
     _appmanager_add_to_manifest(_appmanager_create_app("NiVZ", APP_TYPE_FACE, nivz_main, true, &empty, &empty));
     _appmanager_add_to_manifest(_appmanager_create_app("Settings", APP_TYPE_SYSTEM, test_main, true, &empty, &empty));
     _appmanager_add_to_manifest(_appmanager_create_app("Notification", APP_TYPE_SYSTEM, notif_main, true, &empty, &empty));
-    _appmanager_add_to_manifest(_appmanager_create_app("TestApp", APP_TYPE_SYSTEM, testapp_main, true, &empty, &empty));
+    App *testapp = _appmanager_create_app("TestApp", APP_TYPE_SYSTEM, testapp_main, true, &empty, &empty);
+    if (testapp)
+        testapp->worker_main = worker_test_worker_main;
+    _appmanager_add_to_manifest(testapp);
     
     /* now load the ones on flash */
     _appmanager_flash_load_app_manifest();
@@ -92,6 +123,7 @@ static App *_appmanager_create_app(char *name, uint8_t type, void *entry_point,
         return NULL;
     
     strcpy(app->name, name);
+    app->name_hash = fnv1a_hash(FNV1A_INIT, app->name, strlen(app->name));
     app->main = (void*)entry_point;
     app->type = type;
     app->header = NULL;
@@ -103,35 +135,59 @@ static App *_appmanager_create_app(char *name, uint8_t type, void *entry_point,
 }
 
 
+/*
+ * Run through appdb the way the loader does, and hash every entry up to
+ * the end marker. If this comes out the same as last boot, so does the
+ * list of apps.
+ */
+static uint32_t _appmanager_appdb_hash(const struct file *file)
+{
+    uint32_t hash = FNV1A_INIT;
+    struct appdb appdb;
+    struct fd fd;
+
+    /* not the struct itself, it has padding */
+    hash = fnv1a_hash(hash, &file->startpage, sizeof(file->startpage));
+    hash = fnv1a_hash(hash, &file->size, sizeof(file->size));
+
+    fs_open(&fd, file);
+    fs_seek(&fd, 8, FS_SEEK_SET);
+    for (int i = 0; i < file->size / sizeof(struct appdb); ++i) {
+        if (fs_read(&fd, &appdb, sizeof(appdb)) != sizeof(appdb))
+            break;
+
+        if (APPDB_IS_EOF(appdb))
+            break;
+
+        hash = fnv1a_hash(hash, &appdb, sizeof(appdb));
+    }
+
+    return hash;
+}
+
 /*
  * Load the list of apps and faces from flash
  * The app manifest is a list of all known applications we found in flash
  * We load all entries from `appdb` file.
  * TODO: appdb seems to have duplicates (in my case), maybe we should use `pmap`, but it was missing some entries for me
  */
-static void _appmanager_flash_load_app_manifest(void)
+static void _appmanager_flash_scan_appdb(const struct file *file)
 {
-    struct file file;
-
-    if (fs_find_file(&file, "appdb") < 0)
-    {
-        KERN_LOG("app", APP_LOG_LEVEL_ERROR, "APPDB file not found");
-        return;
-    }
-
     char buffer[14];
+    char name[MAX_APP_STR_LEN + 1];
     struct appdb appdb;
     struct fd fd;
     struct file app_file;
     struct file res_file;
+    struct file wrk_file;
     struct fd app_fd;
     ApplicationHeader header;
 
-    fs_open(&fd, &file);
+    fs_open(&fd, file);
 
     /* skipping 8 bytes for appdb file header */
     fs_seek(&fd, 8, FS_SEEK_SET);
-    for (int i = 0; i < file.size / sizeof(struct appdb); ++i) {
+    for (int i = 0; i < file->size / sizeof(struct appdb); ++i) {
         if (fs_read(&fd, &appdb, sizeof(appdb)) != sizeof(appdb))
             break;
 
@@ -162,6 +218,11 @@ static void _appmanager_flash_load_app_manifest(void)
         if (fs_find_file(&res_file, buffer) < 0)
             continue;
 
+        /* not every app has a worker */
+        snprintf(buffer, 14, "@%08lx/wrk", appdb.application_id);
+        if (fs_find_file(&wrk_file, buffer) < 0)
+            wrk_file = (struct file) { 0, 0, 0 };
+
         fs_open(&app_fd, &app_file);
 
         if (fs_read(&app_fd, &header, sizeof(ApplicationHeader)) != sizeof(ApplicationHeader))
@@ -182,28 +243,304 @@ static void _appmanager_flash_load_app_manifest(void)
         KERN_LOG("app", APP_LOG_LEVEL_INFO, "appdb: app \"%s\" found, flags %08x, icon %08x", header.name, appdb.flags, appdb.icon);
 
         /* main gets set later */
-        _appmanager_add_to_manifest(_appmanager_create_app(header.name,
-                                                            APP_TYPE_FACE,
-                                                            NULL,
-                                                            false,
-                                                            &app_file,
-                                                            &res_file));
+        strncpy(name, header.name, MAX_APP_STR_LEN);
+        name[MAX_APP_STR_LEN] = 0;
+        App *app = _appmanager_create_app(name, APP_TYPE_FACE, NULL, false, &app_file, &res_file);
+        if (app == NULL)
+            break;
+
+        app->uuid = appdb.app_uuid;
+        app->application_id = appdb.application_id;
+        app->worker_file = wrk_file;
+        _appmanager_add_to_manifest(app);
+    }
+}
+
+/*
+ * Finding every app's files means searching the whole filesystem twice
+ * for each one, which adds up at boot with plenty installed. So what we
+ * found is kept in flash, and used instead as long as appdb is the same.
+ */
+static void _appmanager_flash_load_app_manifest(void)
+{
+    struct file file;
+    TickType_t start = xTaskGetTickCount();
+    uint16_t internal = _app_count;
+
+    if (fs_find_file(&file, "appdb") < 0)
+    {
+        KERN_LOG("app", APP_LOG_LEVEL_ERROR, "APPDB file not found");
+        return;
+    }
+
+    uint32_t appdb_hash = _appmanager_appdb_hash(&file);
+
+    if (_appmanager_snapshot_load(&file, appdb_hash))
+    {
+        KERN_LOG("app", APP_LOG_LEVEL_INFO, "appdb: %d apps from the snapshot in %d ms",
+                 _app_count - internal, (xTaskGetTickCount() - start) * portTICK_PERIOD_MS);
+        return;
+    }
+
+    _appmanager_flash_scan_appdb(&file);
+    KERN_LOG("app", APP_LOG_LEVEL_INFO, "appdb: %d apps scanned in %d ms",
+             _app_count - internal, (xTaskGetTickCount() - start) * portTICK_PERIOD_MS);
+
+    _appmanager_snapshot_save(&file, appdb_hash);
+}
+
+#ifdef REGION_APP_MANIFEST_START
+
+/*
+ * The snapshot is a header, then an entry for each app on flash, in the
+ * order they went into the manifest. The header's complete flag is
+ * programmed last, so a snapshot we were cut off writing is never used.
+ */
+#define APP_SNAPSHOT_MAGIC 0x33415242 /* RBA3, entries grew their appdb id */
+
+typedef struct AppSnapshotFile {
+    uint16_t startpage;
+    uint16_t startpofs;
+    uint32_t size;
+} AppSnapshotFile;
+
+typedef struct AppSnapshotEntry {
+    Uuid uuid;
+    uint32_t application_id; /* what its files are named after */
+    char name[MAX_APP_STR_LEN];
+    AppSnapshotFile app_file;
+    AppSnapshotFile resource_file;
+    AppSnapshotFile worker_file; /* size 0 if the app has no worker */
+} AppSnapshotEntry;
+
+typedef struct AppSnapshotHeader {
+    uint32_t magic;
+    uint32_t appdb_hash;
+    uint16_t count;
+    uint16_t complete; /* programmed to 0 once the entries are all there */
+} AppSnapshotHeader;
+
+#define APP_SNAPSHOT_MAX ((REGION_APP_MANIFEST_SIZE - sizeof(AppSnapshotHeader)) / sizeof(AppSnapshotEntry))
+
+static uint32_t _snapshot_entry_addr(uint16_t i)
+{
+    return REGION_APP_MANIFEST_START + sizeof(AppSnapshotHeader) + i * sizeof(AppSnapshotEntry);
+}
+
+static void _snapshot_read_entry(uint16_t i, AppSnapshotEntry *entry, struct file *app_file, struct file *res_file,
+                                 struct file *wrk_file)
+{
+    flash_read_bytes(_snapshot_entry_addr(i), (uint8_t *)entry, sizeof(AppSnapshotEntry));
+    *app_file = (struct file) { entry->app_file.startpage, entry->app_file.startpofs, entry->app_file.size };
+    *res_file = (struct file) { entry->resource_file.startpage, entry->resource_file.startpofs, entry->resource_file.size };
+    *wrk_file = (struct file) { entry->worker_file.startpage, entry->worker_file.startpofs, entry->worker_file.size };
+}
+
+/* Are an app's files still where the snapshot says, and still its files? */
+static bool _snapshot_entry_valid(const AppSnapshotEntry *entry, const struct file *app_file,
+                                  const struct file *res_file, const struct file *wrk_file)
+{
+    char name[14];
+
+    snprintf(name, sizeof(name), "@%08lx/app", entry->application_id);
+    if (!fs_file_valid(app_file, name))
+        return false;
+
+    snprintf(name, sizeof(name), "@%08lx/res", entry->application_id);
+    if (!fs_file_valid(res_file, name))
+        return false;
+
+    snprintf(name, sizeof(name), "@%08lx/wrk", entry->application_id);
+    return !wrk_file->size || fs_file_valid(wrk_file, name);
+}
+
+/*
+ * If the snapshot was made from this appdb, and the files it points at are
+ * all still there, add its apps to the manifest. Returns true if we did.
+ */
+static bool _appmanager_snapshot_load(const struct file *appdb, uint32_t appdb_hash)
+{
+    AppSnapshotHeader snap;
+    AppSnapshotEntry entry;
+    struct file app_file, res_file, wrk_file;
+    char name[MAX_APP_STR_LEN + 1];
+
+    flash_read_bytes(REGION_APP_MANIFEST_START, (uint8_t *)&snap, sizeof(AppSnapshotHeader));
+    if (snap.magic != APP_SNAPSHOT_MAGIC || snap.complete != 0 ||
+        snap.appdb_hash != appdb_hash || snap.count > APP_SNAPSHOT_MAX)
+        return false;
+
+    /* check them all before adding any, so it's all or nothing */
+    for (uint16_t i = 0; i < snap.count; i++)
+    {
+        _snapshot_read_entry(i, &entry, &app_file, &res_file, &wrk_file);
+        if (!_snapshot_entry_valid(&entry, &app_file, &res_file, &wrk_file))
+        {
+            KERN_LOG("app", APP_LOG_LEVEL_WARNING, "appdb: snapshot is stale, rescanning");
+            return false;
+        }
+    }
+
+    for (uint16_t i = 0; i < snap.count; i++)
+    {
+        _snapshot_read_entry(i, &entry, &app_file, &res_file, &wrk_file);
+        memcpy(name, entry.name, MAX_APP_STR_LEN);
+        name[MAX_APP_STR_LEN] = 0;
+
+        App *app = _appmanager_create_app(name, APP_TYPE_FACE, NULL, false, &app_file, &res_file);
+        if (app == NULL)
+            break;
+
+        app->uuid = entry.uuid;
+        app->application_id = entry.application_id;
+        app->worker_file = wrk_file;
+        _appmanager_add_to_manifest(app);
     }
+
+    return true;
+}
+
+/*
+ * Write out the apps we just found on flash, for next boot. Costs a sector
+ * erase, but only when appdb has changed.
+ */
+static void _appmanager_snapshot_save(const struct file *appdb, uint32_t appdb_hash)
+{
+    AppSnapshotHeader snap = {
+        .magic = APP_SNAPSHOT_MAGIC,
+        .appdb_hash = appdb_hash,
+        .count = _app_count,
+        .complete = 0xFFFF,
+    };
+    AppSnapshotEntry entry;
+    uint16_t complete = 0;
+    uint16_t i = 0;
+    App *app;
+
+    list_foreach(app, &_app_manifest_head, App, node)
+        if (app->is_internal)
+            snap.count--;
+
+    if (snap.count > APP_SNAPSHOT_MAX)
+        return;
+
+    if (flash_erase_sector(REGION_APP_MANIFEST_START) ||
+        flash_write_bytes(REGION_APP_MANIFEST_START, (uint8_t *)&snap, sizeof(AppSnapshotHeader)))
+    {
+        KERN_LOG("app", APP_LOG_LEVEL_ERROR, "appdb: couldn't start the snapshot");
+        return;
+    }
+
+    list_foreach(app, &_app_manifest_head, App, node)
+    {
+        if (app->is_internal)
+            continue;
+
+        memset(&entry, 0, sizeof(AppSnapshotEntry));
+        entry.uuid = app->uuid;
+        entry.application_id = app->application_id;
+        strncpy(entry.name, app->name, MAX_APP_STR_LEN);
+        entry.app_file = (AppSnapshotFile) { app->app_file.startpage, app->app_file.startpofs, app->app_file.size };
+        entry.resource_file = (AppSnapshotFile) { app->resource_file.startpage, app->resource_file.startpofs, app->resource_file.size };
+        entry.worker_file = (AppSnapshotFile) { app->worker_file.startpage, app->worker_file.startpofs, app->worker_file.size };
+
+        if (flash_write_bytes(_snapshot_entry_addr(i++), (uint8_t *)&entry, sizeof(AppSnapshotEntry)))
+        {
+            KERN_LOG("app", APP_LOG_LEVEL_ERROR, "appdb: snapshot write failed");
+            return;
+        }
+    }
+
+    flash_write_bytes(REGION_APP_MANIFEST_START + offsetof(AppSnapshotHeader, complete), (uint8_t *)&complete, sizeof(complete));
+    KERN_LOG("app", APP_LOG_LEVEL_INFO, "appdb: snapshot of %d apps saved", snap.count);
+}
+
+#else
+
+/* Nowhere to keep a snapshot on this platform, so always scan */
+static bool _appmanager_snapshot_load(const struct file *appdb, uint32_t appdb_hash)
+{
+    return false;
+}
+
+static void _appmanager_snapshot_save(const struct file *appdb, uint32_t appdb_hash)
+{
+}
+
+#endif
+
+
+/*
+ * Chain an app into the hash tables. Only apps from flash have a UUID
+ */
+static void _appmanager_registry_index(App *app)
+{
+    uint32_t mask = _app_buckets - 1;
+    App **bucket = &_apps_by_name[app->name_hash & mask];
+
+    app->next_by_name = *bucket;
+    *bucket = app;
+
+    app->next_by_uuid = NULL;
+    if (_appmanager_uuid_is_zero(&app->uuid))
+        return;
+
+    bucket = &_apps_by_uuid[_appmanager_uuid_hash(&app->uuid) & mask];
+    app->next_by_uuid = *bucket;
+    *bucket = app;
+}
+
+/*
+ * Double the tables and chain everything back in. If there's no memory
+ * for it we keep the old ones, and the chains just get longer
+ */
+static bool _appmanager_registry_grow(void)
+{
+    uint16_t buckets = _app_buckets ? _app_buckets * 2 : APP_REGISTRY_MIN_BUCKETS;
+    App **by_name = calloc(buckets, sizeof(App *));
+    App **by_uuid = calloc(buckets, sizeof(App *));
+    App *app;
+
+    if (by_name == NULL || by_uuid == NULL)
+    {
+        free(by_name);
+        free(by_uuid);
+        return false;
+    }
+
+    free(_apps_by_name);
+    free(_apps_by_uuid);
+    _apps_by_name = by_name;
+    _apps_by_uuid = by_uuid;
+    _app_buckets = buckets;
+
+    list_foreach(app, &_app_manifest_head, App, node)
+        _appmanager_registry_index(app);
+
+    return true;
 }
 
 /* 
- * App manifest is a linked list. Just slot it in 
+ * App manifest is a linked list. Just slot it in, and index it
  */
 static void _appmanager_add_to_manifest(App *app)
 {  
+    if (app == NULL)
+        return;
+
     list_init_node(&app->node);
     if (list_get_head(&_app_manifest_head) == NULL)
-    {
         list_insert_head(&_app_manifest_head, &app->node);
+    else
+        list_insert_tail(&_app_manifest_head, &app->node);
+    _app_count++;
+
+    /* growing chains in everything, this one included */
+    if (_app_count > _app_buckets && _appmanager_registry_grow())
         return;
-    }
-    
-    list_insert_tail(&_app_manifest_head,&app->node);
+
+    if (_app_buckets)
+        _appmanager_registry_index(app);
 }
 
 /*
@@ -214,22 +551,55 @@ list_head *app_manager_get_apps_head()
     return &_app_manifest_head;
 }
 
+uint16_t appmanager_get_app_count(void)
+{
+    return _app_count;
+}
+
 /*
  * Get an application by name. NULL if invalid
  */
 App *appmanager_get_app(char *app_name)
 {
-   // find the app
-   App * app;
-   // now find the matching
-   list_foreach(app, &_app_manifest_head, App, node)
-   {
-        if (!strncmp(app->name, (char *)app_name, strlen(app->name)))
-        {
-            // match!
+    uint32_t hash = fnv1a_hash(FNV1A_INIT, app_name, strlen(app_name));
+    App *app;
+
+    /* no tables if we never had the memory for them */
+    if (!_app_buckets)
+    {
+        list_foreach(app, &_app_manifest_head, App, node)
+            if (!strcmp(app->name, app_name))
+                return app;
+    }
+    else
+    {
+        for (app = _apps_by_name[hash & (_app_buckets - 1)]; app; app = app->next_by_name)
+            if (app->name_hash == hash && !strcmp(app->name, app_name))
+                return app;
+    }
+
+    KERN_LOG("app", APP_LOG_LEVEL_ERROR, "NO App Found %s", app_name);
+    return NULL;
+}
+
+/*
+ * Get an application on flash by its UUID. NULL if we don't have it
+ */
+App *appmanager_get_app_by_uuid(const Uuid *uuid)
+{
+    App *app;
+
+    if (!_app_buckets)
+    {
+        list_foreach(app, &_app_manifest_head, App, node)
+            if (!app->is_internal && !memcmp(&app->uuid, uuid, sizeof(Uuid)))
+                return app;
+        return NULL;
+    }
+
+    for (app = _apps_by_uuid[_appmanager_uuid_hash(uuid) & (_app_buckets - 1)]; app; app = app->next_by_uuid)
+        if (!memcmp(&app->uuid, uuid, sizeof(Uuid)))
             return app;
-        }
-   }
-   KERN_LOG("app", APP_LOG_LEVEL_ERROR, "NO App Found %s", app_name);
-   return NULL;
+
+    return NULL;
 }
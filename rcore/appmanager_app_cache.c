@@ -0,0 +1,346 @@
+/* appmanager_app_cache.c
+ * A cache in flash of app images that are already relocated
+ * RebbleOS
+ */
+
+#include "rebbleos.h"
+#include "appmanager.h"
+#include "flash.h"
+#include "utils.h"
+
+/* Configure Logging */
+#define MODULE_NAME "appcache"
+#define MODULE_TYPE "KERN"
+#define LOG_LEVEL RBL_LOG_LEVEL_DEBUG //RBL_LOG_LEVEL_ERROR
+
+/* the jump table apps get pointed at, in api_func_symbols.h */
+extern void (* const sym[])(void);
+
+/*
+ * An app always loads to the same place, so once it's relocated it comes
+ * out the same every time. Rather than redo the work on every launch, we
+ * keep the relocated image in flash and just read it back in next time.
+ *
+ * Each image gets an erase sector of its own (a slot), with a header
+ * saying which app it is, where it was relocated to and which jump table
+ * it points at. If any of those change, it's no use to us.
+ *
+ * Writing one out means an erase and a lot of programming, so it's not
+ * done while anyone waits on a launch, nor until the app is running. The manager thread builds it a
+ * chunk at a time in between its other work, straight from the app on
+ * flash, so it doesn't matter what the app has done to its RAM since.
+ * The header's complete flag goes down last, so half a write is ignored.
+ */
+
+#ifdef REGION_APP_CACHE_START
+
+#define APP_CACHE_MAGIC      0x41435242 /* RBCA */
+#define APP_CACHE_SLOTS      (REGION_APP_CACHE_SIZE / REGION_APP_CACHE_SLOT)
+#define APP_CACHE_IMAGE      64 /* header, then the image from here */
+#define APP_CACHE_CHUNK      512
+#define APP_CACHE_RELOCS     32
+
+typedef struct AppCacheHeader {
+    uint32_t magic;
+    uint32_t generation; /* the highest was written last */
+    Uuid uuid;
+    uint32_t crc; /* the app's, from its header */
+    uint32_t heap; /* where it was relocated to */
+    uint32_t sym; /* and the jump table poked into it */
+    uint32_t size;
+    uint16_t complete; /* programmed to 0 once the image is all there */
+    uint16_t pad;
+} AppCacheHeader;
+
+typedef enum AppCacheState {
+    AppCacheIdle,
+    AppCacheErase,
+    AppCacheWrite,
+    AppCacheFinish,
+} AppCacheState;
+
+/* The image we are part way through writing out. The app's relocations
+ * come in ascending order, so we go through them once alongside the image,
+ * a buffer of them at a time */
+static struct {
+    AppCacheState state;
+    App *app;
+    ApplicationHeader header;
+    AppCacheHeader cache;
+    uint32_t slot;
+    uint32_t offset;
+    struct fd image_fd;
+    struct fd reloc_fd;
+    uint32_t relocs_left; /* still to be read from the file */
+    uint32_t reloc_count; /* in the buffer */
+    uint32_t reloc_next; /* in the buffer */
+} _job;
+
+static uint8_t _chunk[APP_CACHE_CHUNK] __attribute__((aligned(4)));
+static uint32_t _relocs[APP_CACHE_RELOCS];
+
+static uint32_t _slot_addr(uint32_t slot)
+{
+    return REGION_APP_CACHE_START + slot * REGION_APP_CACHE_SLOT;
+}
+
+static void _cache_header_for(AppCacheHeader *cache, app_running_thread *thread, ApplicationHeader *header)
+{
+    memset(cache, 0xFF, sizeof(AppCacheHeader));
+    cache->magic = APP_CACHE_MAGIC;
+    cache->uuid = header->uuid;
+    cache->crc = header->crc;
+    cache->heap = (uint32_t)thread->heap;
+    cache->sym = (uint32_t)sym;
+    cache->size = header->app_size;
+}
+
+static bool _cache_matches(AppCacheHeader *found, AppCacheHeader *want)
+{
+    return found->magic == APP_CACHE_MAGIC && found->complete == 0 &&
+           !memcmp(&found->uuid, &want->uuid, sizeof(Uuid)) &&
+           found->crc == want->crc && found->heap == want->heap &&
+           found->sym == want->sym && found->size == want->size;
+}
+
+/*
+ * If we have this app relocated for this thread already, read it straight
+ * into the heap. Returns true if we did.
+ */
+bool appmanager_app_cache_load(app_running_thread *thread, ApplicationHeader *header)
+{
+    AppCacheHeader want, found;
+
+    /* half written. Could be ours, but it's no good to us yet */
+    if (_job.state != AppCacheIdle && _job.app == thread->app)
+        return false;
+
+    _cache_header_for(&want, thread, header);
+
+    for (uint32_t slot = 0; slot < APP_CACHE_SLOTS; slot++)
+    {
+        flash_read_bytes(_slot_addr(slot), (uint8_t *)&found, sizeof(AppCacheHeader));
+        if (!_cache_matches(&found, &want))
+            continue;
+
+        flash_read_bytes(_slot_addr(slot) + APP_CACHE_IMAGE, thread->heap, header->app_size);
+        LOG_INFO("%s loaded relocated from slot %d", thread->app->name, slot);
+        return true;
+    }
+
+    return false;
+}
+
+/*
+ * Remember to write out the app we just relocated. It goes in the slot
+ * this app had before, an empty one, or failing that the oldest.
+ */
+void appmanager_app_cache_queue(app_running_thread *thread, ApplicationHeader *header)
+{
+    AppCacheHeader found;
+    uint32_t newest = 0, oldest = UINT32_MAX;
+    int32_t slot = -1;
+
+    if (_job.state != AppCacheIdle || header->app_size > REGION_APP_CACHE_SLOT - APP_CACHE_IMAGE)
+        return;
+
+    /* oldest goes to 0 once we've found somewhere better than the oldest */
+    for (uint32_t i = 0; i < APP_CACHE_SLOTS; i++)
+    {
+        flash_read_bytes(_slot_addr(i), (uint8_t *)&found, sizeof(AppCacheHeader));
+        if (found.magic != APP_CACHE_MAGIC)
+        {
+            if (oldest)
+                slot = i;
+            oldest = 0;
+            continue;
+        }
+
+        newest = MAX(newest, found.generation);
+        if (!memcmp(&found.uuid, &header->uuid, sizeof(Uuid)))
+        {
+            slot = i;
+            oldest = 0;
+        }
+        else if (found.generation < oldest)
+        {
+            slot = i;
+            oldest = found.generation;
+        }
+    }
+
+    _job.app = thread->app;
+    memcpy(&_job.header, header, sizeof(ApplicationHeader));
+    _cache_header_for(&_job.cache, thread, header);
+    _job.cache.generation = newest + 1;
+    _job.slot = slot;
+    _job.offset = 0;
+
+    fs_open(&_job.image_fd, &thread->app->app_file);
+    fs_open(&_job.reloc_fd, &thread->app->app_file);
+    fs_seek(&_job.reloc_fd, header->app_size, FS_SEEK_SET);
+    _job.relocs_left = header->reloc_entries_count;
+    _job.reloc_count = _job.reloc_next = 0;
+
+    _job.state = AppCacheErase;
+}
+
+/*
+ * Relocate whatever of the image is in the chunk at offset, carrying on
+ * through the relocations from where the last chunk left off. False if
+ * one can't be done from here, and the app will just have to be
+ * relocated each time it loads.
+ */
+static bool _relocate_chunk(uint32_t offset, uint32_t length)
+{
+    ApplicationHeader *header = &_job.header;
+
+    for (;;)
+    {
+        if (_job.reloc_next == _job.reloc_count)
+        {
+            if (!_job.relocs_left)
+                break;
+
+            _job.reloc_count = MIN(_job.relocs_left, APP_CACHE_RELOCS);
+            _job.reloc_next = 0;
+            fs_read(&_job.reloc_fd, _relocs, _job.reloc_count * sizeof(uint32_t));
+            _job.relocs_left -= _job.reloc_count;
+        }
+
+        uint32_t reg_to_reloc = _relocs[_job.reloc_next];
+
+        /* the loader puts BSS relocs right, but we only hold the
+         * image. Not that any app has them */
+        if (reg_to_reloc + 4 > header->app_size || (reg_to_reloc & 3))
+            return false;
+
+        /* out of order, and in a chunk we've already written */
+        if (reg_to_reloc < offset)
+            return false;
+
+        /* the next chunk's */
+        if (reg_to_reloc >= offset + length)
+            break;
+
+        uint32_t *reg = (uint32_t *)(_chunk + reg_to_reloc - offset);
+        *reg += _job.cache.heap;
+        _job.reloc_next++;
+    }
+
+    if (header->sym_table_addr >= offset && header->sym_table_addr < offset + length)
+        *(uint32_t *)(_chunk + header->sym_table_addr - offset) = _job.cache.sym;
+
+    return true;
+}
+
+static void _cache_abandon(const char *why)
+{
+    LOG_ERROR("Not caching %s: %s", _job.app->name, why);
+    _job.state = AppCacheIdle;
+}
+
+/*
+ * Do the next bit of writing out the image. Call from the manager thread
+ * whenever it has nothing better to do.
+ * Returns true if there's more to do.
+ */
+bool appmanager_app_cache_step(void)
+{
+    uint32_t addr = _slot_addr(_job.slot);
+
+    if (_job.state == AppCacheIdle)
+        return false;
+
+    /* we'd pull the flash out from under an app running from it */
+    if (appmanager_app_in_place())
+        return false;
+
+    for (uint8_t i = 0; i < MAX_APP_THREADS; i++)
+    {
+        app_running_thread *thread = appmanager_get_thread(i);
+
+        /* and an app still starting up gets the flash to itself. The
+         * launch is what we're trying to make quicker. We'll be back once
+         * it's reached its runloop */
+        if (thread->status == AppThreadLoading || thread->status == AppThreadLoaded)
+            return false;
+    }
+
+    switch (_job.state)
+    {
+        case AppCacheErase:
+            if (flash_erase_sector(addr))
+            {
+                _cache_abandon("erase failed");
+                break;
+            }
+            if (flash_write_bytes(addr, (uint8_t *)&_job.cache, sizeof(AppCacheHeader)))
+            {
+                _cache_abandon("header write failed");
+                break;
+            }
+            _job.state = AppCacheWrite;
+            break;
+
+        case AppCacheWrite:
+        {
+            /* keep it even, NOR programs a word at a time */
+            uint32_t length = MIN(APP_CACHE_CHUNK, _job.header.app_size - _job.offset);
+            uint32_t padded = (length + 1) & ~1;
+
+            fs_read(&_job.image_fd, _chunk, length);
+            if (length & 1)
+                _chunk[length] = 0xFF;
+
+            if (!_relocate_chunk(_job.offset, length))
+            {
+                _cache_abandon("relocs outside the image, or out of order");
+                break;
+            }
+            if (flash_write_bytes(addr + APP_CACHE_IMAGE + _job.offset, _chunk, padded))
+            {
+                _cache_abandon("write failed");
+                break;
+            }
+
+            _job.offset += length;
+            if (_job.offset >= _job.header.app_size)
+                _job.state = AppCacheFinish;
+            break;
+        }
+
+        case AppCacheFinish:
+        {
+            uint16_t complete = 0;
+            flash_write_bytes(addr + offsetof(AppCacheHeader, complete), (uint8_t *)&complete, sizeof(complete));
+            LOG_INFO("Cached %s relocated in slot %d", _job.app->name, _job.slot);
+            _job.state = AppCacheIdle;
+            break;
+        }
+
+        default:
+            break;
+    }
+
+    return _job.state != AppCacheIdle;
+}
+
+#else
+
+/* Nowhere to keep a cache on this platform */
+bool appmanager_app_cache_load(app_running_thread *thread, ApplicationHeader *header)
+{
+    return false;
+}
+
+void appmanager_app_cache_queue(app_running_thread *thread, ApplicationHeader *header)
+{
+}
+
+bool appmanager_app_cache_step(void)
+{
+    return false;
+}
+
+#endif
@@ -9,6 +9,7 @@
 #include "rebbleos.h"
 #include "appmanager.h"
 #include "overlay_manager.h"
+#include "app_worker.h"
 #include "notification_manager.h"
 #include "timers.h"
 #include "ngfxwrap.h"
@@ -35,12 +36,33 @@ void appmanager_app_runloop_init(void)
 /* 
  * Send a message to an app 
  */
-void appmanager_post_generic_app_message(AppMessage *am, TickType_t timeout)
+bool appmanager_post_generic_app_message(AppMessage *am, TickType_t timeout)
 {
     app_running_thread *_thread = appmanager_get_thread(AppThreadMainApp);
-    if (_thread->status == AppThreadRunloop)
-        if (!xQueueSendToBack(_app_message_queue, am, timeout))
-            LOG_ERROR("Not posting. App not running");
+    if (_thread->status != AppThreadRunloop)
+        return false;
+
+    if (!xQueueSendToBack(_app_message_queue, am, timeout))
+    {
+        LOG_ERROR("Not posting. App not running");
+        return false;
+    }
+    return true;
+}
+
+/*
+ * Call into an app that runs in place, with its GOT in r9. rcore and
+ * rwatch, the only code that calls back into an app, are built to leave
+ * r9 alone, so it's still there when they do.
+ */
+__attribute__((naked)) static void _call_with_pic_base(AppMainHandler main, void *pic_base)
+{
+    __asm__ volatile (
+        "push {r9, lr}  \n"
+        "mov  r9, r1    \n"
+        "blx  r0        \n"
+        "pop  {r9, pc}  \n"
+    );
 }
 
 /*
@@ -64,8 +86,14 @@ void appmanager_app_main_entry(void)
     /* not a memory leak. Context was erased on app load */
     rwatch_neographics_init(_this_thread);
     
+    /* and anything the worker sent the last app was never going to be read */
+    app_worker_message_reset();
+
     /* Call into the apps main runtime */
-    _this_thread->app->main();
+    if (_this_thread->pic_base)
+        _call_with_pic_base(_this_thread->main, _this_thread->pic_base);
+    else
+        _this_thread->main();
     _this_thread->status = AppThreadUnloading;
     
     AppMessage am = {
@@ -99,44 +127,31 @@ static void _draw(uint8_t force_draw)
         if (force_draw)
             window_dirty(true);
         
-        bool force = window_draw();
+        bool force = false;
         
-        if (overlay_window_count() > 0)
-        {
-            overlay_window_draw(true);
+        /* no point painting the app under an overlay that hides it all */
+        if (!overlay_window_occludes_app())
+            force = window_draw();
+        
+        if (overlay_window_count() > 0 && overlay_window_draw(force))
             force = true;
-        }
         
         if (force)
         {
             display_draw();
+            appmanager_app_first_frame(appmanager_get_current_thread());
         }
         display_buffer_lock_give();
     }
 }
 
 /*
- * Once an application is spawned, it calls into app_event_loop
- * This function is a busy loop, but with the benefit that it is also a task
- * In here we are the main event handler, for buttons quits etc etc.
+ * Hook the buttons up to the top window, with our defaults around it
  */
-void app_event_loop(void)
+static void _configure_buttons(App *app)
 {
-    AppMessage data;
-    app_running_thread *_this_thread = appmanager_get_current_thread();
-    App *_running_app = _this_thread->app;
-    bool draw_requested = false;
-    
-    if (_this_thread->thread_type != AppThreadMainApp)
-    {
-        LOG_ERROR("Runloop: You are not an app");
-        return;
-    }
-    
-    LOG_INFO("App entered mainloop");
-    
     /* Do this before window load, that way they have a chance to override */
-    if (_running_app->type != APP_TYPE_FACE &&
+    if (app->type != APP_TYPE_FACE &&
         overlay_window_count() == 0)
     {
         /* Enables default closing of windows, and through that, apps */
@@ -149,11 +164,33 @@ void app_event_loop(void)
      * window_long_click_subscribe(BUTTON_ID_BACK, 1100, back_long_click_handler, back_long_click_release_handler);
      */
     
-    if (_running_app->type != APP_TYPE_SYSTEM)
+    if (app->type != APP_TYPE_SYSTEM)
     {
         window_single_click_subscribe(BUTTON_ID_SELECT, app_select_single_click_handler);
     }
+}
+
+/*
+ * Once an application is spawned, it calls into app_event_loop
+ * This function is a busy loop, but with the benefit that it is also a task
+ * In here we are the main event handler, for buttons quits etc etc.
+ */
+void app_event_loop(void)
+{
+    AppMessage data;
+    app_running_thread *_this_thread = appmanager_get_current_thread();
+    App *_running_app = _this_thread->app;
+    bool draw_requested = false;
     
+    if (_this_thread->thread_type != AppThreadMainApp)
+    {
+        LOG_ERROR("Runloop: You are not an app");
+        return;
+    }
+    
+    LOG_INFO("App entered mainloop");
+    
+    _configure_buttons(_running_app);
     
     /* clear the queue of any work from the previous app
     * ... such as an errant quit */
@@ -169,6 +206,10 @@ void app_event_loop(void)
 
     TickType_t next_timer;
     _this_thread->status = AppThreadRunloop;
+    _this_thread->launch.initialised = xTaskGetTickCount();
+
+    /* anything the worker sent while we were starting up */
+    app_worker_message_deliver();
 
     next_timer = portMAX_DELAY;
     /* App is now fully initialised and inside the runloop. */
@@ -204,12 +245,27 @@ void app_event_loop(void)
                 ButtonMessage *message = (ButtonMessage *)data.data;
                 ((ClickHandler)(message->callback))((ClickRecognizerRef)(message->clickref), message->context);
             }
+            /* We're a face and someone wants the screen for a moment.
+             * If we can stay put while they have it, this comes back
+             * once we're wanted again. Otherwise we quit, below */
+            else if (data.command == APP_SUSPEND &&
+                     !appmanager_is_app_shutting_down() &&
+                     appmanager_app_suspend(_this_thread))
+            {
+                /* anything queued since was for the app that had the
+                 * screen, and so were the buttons and font cache */
+                xQueueReset(_app_message_queue);
+                fonts_resetcache();
+                _configure_buttons(_running_app);
+                _this_thread->status = AppThreadRunloop;
+                appmanager_post_draw_message(1);
+            }
             /* Someone has requested the application close.
              * We will attempt graceful shutdown by unsubscribing timers
              * Any app timers will fire and be nulled, or get erased.
              * XXX could do with a timer mutex to wait on
              */
-            else if (data.command == APP_QUIT)
+            else if (data.command == APP_QUIT || data.command == APP_SUSPEND)
             {
                 /* Set the shutdown time for this app. We will kill it then */
                 if (!appmanager_is_app_shutting_down())
@@ -244,6 +300,14 @@ void app_event_loop(void)
 
                 _draw((uint32_t)data.data);
             }
+            /* The worker has sent us something */
+            else if (data.command == APP_WORKER_MESSAGE)
+            {
+                if (appmanager_is_app_shutting_down())
+                    continue;
+
+                app_worker_message_deliver();
+            }
         } else {
             if (appmanager_is_app_shutting_down())
                 continue;
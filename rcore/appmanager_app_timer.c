@@ -17,18 +17,231 @@ void timer_init(void)
 
 }
 
+/*
+ * The timers live in a binary min-heap per thread, made out of the timers
+ * themselves. Node n (counting from 1 at the root) has children 2n and
+ * 2n + 1, so the bits of n below the top one spell out the way down to it:
+ * 0 for left, 1 for right. That's how we find the last node to add after
+ * or to fill a hole with, and everything is O(log n).
+ * Comparisons are done on the difference in ticks, so the order survives
+ * the tick count wrapping as long as no two timers are 24 days apart.
+ */
+
+/* The node that is, or would be, the parent of node n */
+static CoreTimer *_heap_parent_of(CoreTimerHeap *heap, uint16_t n)
+{
+    CoreTimer *node = heap->root;
+
+    for (int bit = 30 - __builtin_clz(n); bit > 0; bit--)
+        node = ((n >> bit) & 1) ? node->right : node->left;
+
+    return node;
+}
+
+/* Trade places with our parent */
+static void _heap_swap_with_parent(CoreTimerHeap *heap, CoreTimer *node)
+{
+    CoreTimer *parent = node->parent;
+    CoreTimer *grandparent = parent->parent;
+    CoreTimer *left = node->left;
+    CoreTimer *right = node->right;
+
+    if (parent->left == node)
+    {
+        node->left = parent;
+        node->right = parent->right;
+        if (node->right)
+            node->right->parent = node;
+    }
+    else
+    {
+        node->right = parent;
+        node->left = parent->left;
+        if (node->left)
+            node->left->parent = node;
+    }
+
+    node->parent = grandparent;
+    if (!grandparent)
+        heap->root = node;
+    else if (grandparent->left == parent)
+        grandparent->left = node;
+    else
+        grandparent->right = node;
+
+    parent->parent = node;
+    parent->left = left;
+    parent->right = right;
+    if (left)
+        left->parent = parent;
+    if (right)
+        right->parent = parent;
+}
+
+static void _heap_sift_up(CoreTimerHeap *heap, CoreTimer *node)
+{
+    while (node->parent && TIMER_BEFORE(node->when, node->parent->when))
+        _heap_swap_with_parent(heap, node);
+}
+
+static void _heap_sift_down(CoreTimerHeap *heap, CoreTimer *node)
+{
+    for (;;)
+    {
+        CoreTimer *child = node->left;
+
+        if (node->right && TIMER_BEFORE(node->right->when, node->left->when))
+            child = node->right;
+
+        if (!child || !TIMER_BEFORE(child->when, node->when))
+            return;
+
+        _heap_swap_with_parent(heap, child);
+    }
+}
+
+void timer_heap_insert(CoreTimerHeap *heap, CoreTimer *timer)
+{
+    timer->left = timer->right = NULL;
+    heap->count++;
+
+    if (heap->count == 1)
+    {
+        timer->parent = NULL;
+        heap->root = timer;
+        return;
+    }
+
+    CoreTimer *parent = _heap_parent_of(heap, heap->count);
+    if (heap->count & 1)
+        parent->right = timer;
+    else
+        parent->left = timer;
+    timer->parent = parent;
+
+    _heap_sift_up(heap, timer);
+}
+
+/* Climb to the root to be sure. A timer left over from a dead app can
+ * still have a stale parent, so don't climb further than the heap is deep */
+bool timer_heap_contains(CoreTimerHeap *heap, CoreTimer *timer)
+{
+    CoreTimer *node = timer;
+
+    for (int depth = 0; node->parent && depth < 16; depth++)
+        node = node->parent;
+
+    return node == heap->root && heap->root != NULL;
+}
+
+bool timer_heap_remove(CoreTimerHeap *heap, CoreTimer *timer)
+{
+    if (!timer_heap_contains(heap, timer))
+        return false;
+
+    /* unhook the last node... */
+    CoreTimer *last = heap->root;
+    if (heap->count > 1)
+    {
+        CoreTimer *parent = _heap_parent_of(heap, heap->count);
+        if (heap->count & 1)
+        {
+            last = parent->right;
+            parent->right = NULL;
+        }
+        else
+        {
+            last = parent->left;
+            parent->left = NULL;
+        }
+    }
+    heap->count--;
+
+    /* ...and drop it in the hole, then let it find its level */
+    if (last != timer)
+    {
+        last->parent = timer->parent;
+        last->left = timer->left;
+        last->right = timer->right;
+        if (last->left)
+            last->left->parent = last;
+        if (last->right)
+            last->right->parent = last;
+
+        if (!last->parent)
+            heap->root = last;
+        else if (last->parent->left == timer)
+            last->parent->left = last;
+        else
+            last->parent->right = last;
+
+        if (last->parent && TIMER_BEFORE(last->when, last->parent->when))
+            _heap_sift_up(heap, last);
+        else
+            _heap_sift_down(heap, last);
+    }
+    else if (heap->count == 0)
+    {
+        heap->root = NULL;
+    }
+
+    timer->parent = timer->left = timer->right = NULL;
+    return true;
+}
+
+static CoreTimer *_heap_find(CoreTimer *node, bool (*match)(CoreTimer *timer, void *context), void *context)
+{
+    if (!node)
+        return NULL;
+    if (match(node, context))
+        return node;
+
+    CoreTimer *found = _heap_find(node->left, match, context);
+    return found ? found : _heap_find(node->right, match, context);
+}
+
+/* Not ordered, just a walk over everything */
+CoreTimer *timer_heap_find(CoreTimerHeap *heap, bool (*match)(CoreTimer *timer, void *context), void *context)
+{
+    return _heap_find(heap->root, match, context);
+}
+
+/*
+ * The latest we can sleep until without making anyone late. Only timers
+ * due before that point can pull it in, and nothing under a node is due
+ * before it, so we only visit those.
+ */
+static void _heap_deadline(CoreTimer *node, TickType_t *deadline)
+{
+    if (!node || TIMER_BEFORE(*deadline, node->when))
+        return;
+
+    if (TIMER_BEFORE(node->when + node->slack, *deadline))
+        *deadline = node->when + node->slack;
+
+    _heap_deadline(node->left, deadline);
+    _heap_deadline(node->right, deadline);
+}
+
 /* Timer util */
 TickType_t appmanager_timer_get_next_expiry(app_running_thread *thread)
 {
     TickType_t next_timer;
 
-    if (thread->timer_head) {
+    if (thread->timers.root) {
         TickType_t curtime = xTaskGetTickCount();
-        if (curtime > thread->timer_head->when) {
+        CoreTimer *root = thread->timers.root;
+        if (!TIMER_BEFORE(curtime, root->when)) {
+            /* we're awake anyway, so anything that may fire now does */
             next_timer = 0;
         }
-        else
-            next_timer = thread->timer_head->when - curtime;
+        else {
+            /* sleep as long as the slack allows, so timers due close
+             * together all go off on the one wakeup */
+            TickType_t deadline = root->when + root->slack;
+            _heap_deadline(root, &deadline);
+            next_timer = deadline - curtime;
+        }
     } else {
         next_timer = -1; /* Just block forever. */
     }
@@ -42,20 +255,24 @@ void appmanager_timer_expired(app_running_thread *thread)
      * then invoke -- otherwise someone else could insert themselves
      * at the head, and we would wrongfully dequeue them!  */
     assert(thread);
-    CoreTimer *timer = thread->timer_head;
+    CoreTimer *timer = thread->timers.root;
     assert(timer);
 
+    timer_heap_remove(&thread->timers, timer);
+
+    TickType_t now = xTaskGetTickCount();
+    if (thread->timers.wakeups == 0 || now != thread->timers.last_fired)
+        thread->timers.wakeups++;
+    thread->timers.last_fired = now;
+
     if (!timer->callback) {
         /* assert(!"BAD"); // actually this is pretty bad. I've seen this 
          * happen only once before when the app draw was happening while the
          * ovelay thread was coming up. The ov thread memory was memset to 0. */
         KERN_LOG("app", APP_LOG_LEVEL_ERROR, "Bad Callback!");
-        thread->timer_head = timer->next;
         return;
     }
 
-    thread->timer_head = timer->next;
-
     if (!appmanager_is_app_shutting_down())
         timer->callback(timer);
 }
@@ -68,34 +285,14 @@ void appmanager_timer_expired(app_running_thread *thread)
 void appmanager_timer_add(CoreTimer *timer)
 {
     app_running_thread *_this_thread = appmanager_get_current_thread();
-    CoreTimer **tnext = &_this_thread->timer_head;
-
-    /* until either the next pointer is null (i.e., we have hit the end of
-     * the list), or the thing that the next pointer points to is further in
-     * the future than we are (i.e., we want to insert before the thing that
-     * the next pointer points to)
-     */
-    while (*tnext && (timer->when > (*tnext)->when)) {
-        tnext = &((*tnext)->next);
-    }
 
-    timer->next = *tnext;
-    *tnext = timer;
+    timer_heap_insert(&_this_thread->timers, timer);
 }
 
 void appmanager_timer_remove(CoreTimer *timer)
 {
     app_running_thread *_this_thread = appmanager_get_current_thread();
-    CoreTimer **tnext = &_this_thread->timer_head;
 
-    while (*tnext) {
-        if (*tnext == timer) {
-            *tnext = timer->next;
-            return;
-        }
-        tnext = &(*tnext)->next;
-    }
-
-    assert(!"appmanager_timer_remove did not find timer in list");
+    if (!timer_heap_remove(&_this_thread->timers, timer))
+        assert(!"appmanager_timer_remove did not find timer in list");
 }
-
@@ -0,0 +1,146 @@
+/* appmanager_partition.c
+ * Sharing memory out between the app and its worker
+ * RebbleOS
+ */
+
+#include "rebbleos.h"
+#include "appmanager.h"
+#include "utils.h"
+
+/* Configure Logging */
+#define MODULE_NAME "partn"
+#define MODULE_TYPE "KERN"
+#define LOG_LEVEL RBL_LOG_LEVEL_DEBUG //RBL_LOG_LEVEL_ERROR
+
+/*
+ * The app and the worker share one pool, carved up each time either of
+ * them launches:
+ *   [ app ->                          | <- worker ]
+ * The app always starts at the bottom, so it relocates to the same place
+ * every time (the app cache relies on that), and gets all of the pool that
+ * isn't kept for a worker. Room is only kept for a worker if one is
+ * running, or the app has one it may launch, and then only as much as the
+ * worker's header says it needs. So without a worker the app gets the lot,
+ * rather than the worker's share sitting idle.
+ *
+ * The overlay starts at boot and never goes away, so there's no launch to
+ * size it at. It keeps its own heap.
+ */
+
+#define PARTITION_SIZE        (((MEMORY_SIZE_APP_HEAP) + (MEMORY_SIZE_WORKER_HEAP)) & ~7)
+/* what a worker gets to allocate from, on top of its image */
+#define PARTITION_WORKER_FREE 4096
+/* and the least an app does, before we stop keeping room for its worker */
+#define PARTITION_APP_FREE    8192
+
+#define PARTITION_ALIGN(x)    (((x) + 7) & ~7)
+
+static uint8_t _pool[PARTITION_SIZE] __attribute__((aligned(8)));
+static size_t _app_size; /* the app's share, from the bottom */
+
+/* How much of its heap the image in this file takes */
+static size_t _image_size(const struct file *file)
+{
+    struct fd fd;
+    uint16_t virtual_size = 0;
+
+    fs_open(&fd, file);
+    fs_seek(&fd, offsetof(ApplicationHeader, virtual_size), FS_SEEK_SET);
+    fs_read(&fd, &virtual_size, sizeof(virtual_size));
+
+    return virtual_size;
+}
+
+/* How much the app's worker needs, 0 if it has none */
+static size_t _worker_need(App *app)
+{
+    if (app->worker_main)
+        return PARTITION_ALIGN(MEMORY_SIZE_WORKER_HEAP);
+    if (app->worker_file.size)
+        return PARTITION_ALIGN(_image_size(&app->worker_file) + PARTITION_WORKER_FREE);
+    return 0;
+}
+
+/* Anything still on the worker thread holds its share, even on its way out */
+static bool _worker_running(void)
+{
+    return appmanager_get_thread(AppThreadWorker)->status != AppThreadUnloaded;
+}
+
+static bool _partition_app(app_running_thread *thread, App *app)
+{
+    app_running_thread *worker = appmanager_get_thread(AppThreadWorker);
+    size_t need = app->is_internal ? 0 : PARTITION_ALIGN(_image_size(&app->app_file));
+    size_t keep;
+
+    if (_worker_running())
+    {
+        keep = worker->heap_size;
+    }
+    else
+    {
+        keep = _worker_need(app);
+        /* a big app comes before its worker */
+        if (keep && need + PARTITION_APP_FREE > PARTITION_SIZE - keep)
+        {
+            LOG_INFO("No room for %s's worker alongside it", app->name);
+            keep = 0;
+        }
+    }
+
+    if (need > PARTITION_SIZE - keep)
+    {
+        LOG_ERROR("%s needs %d bytes, only %d to give it", app->name, need, PARTITION_SIZE - keep);
+        return false;
+    }
+
+    _app_size = PARTITION_SIZE - keep;
+    thread->heap = _pool;
+    thread->heap_size = _app_size;
+
+    LOG_INFO("%s gets %d bytes, %d kept for a worker", app->name, _app_size, keep);
+    return true;
+}
+
+static bool _partition_worker(app_running_thread *thread, App *app)
+{
+    size_t need = _worker_need(app);
+
+    if (need > PARTITION_SIZE - _app_size)
+    {
+        LOG_ERROR("No room for %s's worker: needs %d bytes, %d spare", app->name, need,
+                  PARTITION_SIZE - _app_size);
+        return false;
+    }
+
+    thread->heap = _pool + PARTITION_SIZE - need;
+    thread->heap_size = need;
+
+    LOG_INFO("%s's worker gets %d bytes", app->name, need);
+    return true;
+}
+
+/*
+ * Give the thread its share of memory for the app about to launch on it.
+ * Returns false if there's no room for it.
+ */
+bool appmanager_partition_thread(app_running_thread *thread, App *app)
+{
+    switch (thread->thread_type)
+    {
+        case AppThreadMainApp:
+            return _partition_app(thread, app);
+        case AppThreadWorker:
+            return _partition_worker(thread, app);
+        default:
+            return true;
+    }
+}
+
+void appmanager_partition_get_stats(AppPartitionStats *stats)
+{
+    stats->pool = PARTITION_SIZE;
+    stats->app = _app_size;
+    stats->worker = _worker_running() ? appmanager_get_thread(AppThreadWorker)->heap_size : 0;
+    stats->largest_app = PARTITION_SIZE - stats->worker;
+}
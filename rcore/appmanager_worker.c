@@ -0,0 +1,153 @@
+/* appmanager_worker.c
+ * The entrypoint and runloop for an app's background worker
+ * RebbleOS
+ */
+
+#include "rebbleos.h"
+#include "librebble.h"
+#include "appmanager.h"
+#include "app_worker.h"
+
+/* Configure Logging */
+#define MODULE_NAME "worker"
+#define MODULE_TYPE "KERN"
+#define LOG_LEVEL RBL_LOG_LEVEL_DEBUG //RBL_LOG_LEVEL_ERROR
+
+/*
+ * A worker is loaded by the manager just like an app, only onto the
+ * worker thread with its own heap, stack and timers. It runs below the
+ * app and the overlay, so however hard it works, the UI gets the CPU
+ * whenever it wants it. It has no windows or buttons: its runloop only
+ * fires its timers, hands over messages from the app, and waits to be
+ * told to quit.
+ */
+
+static xQueueHandle _worker_message_queue;
+
+void appmanager_worker_runloop_init(void)
+{
+    _worker_message_queue = xQueueCreate(5, sizeof(struct AppMessage));
+}
+
+/*
+ * Send a message to the worker
+ */
+bool appmanager_post_generic_worker_message(AppMessage *am, TickType_t timeout)
+{
+    app_running_thread *_thread = appmanager_get_thread(AppThreadWorker);
+    if (_thread->status != AppThreadRunloop)
+        return false;
+
+    if (!xQueueSendToBack(_worker_message_queue, am, timeout))
+    {
+        LOG_ERROR("Not posting. Worker busy");
+        return false;
+    }
+    return true;
+}
+
+/*
+ * Start the named app's worker, replacing any worker already running
+ */
+void appmanager_worker_start(char *name)
+{
+    AppMessage am = (AppMessage) {
+        .command = THREAD_MANAGER_APP_LOAD,
+        .thread_id = AppThreadWorker,
+        .data = name
+    };
+    appmanager_post_generic_thread_message(&am, 100);
+}
+
+void appmanager_worker_quit(void)
+{
+    AppMessage am = (AppMessage) {
+        .command = APP_QUIT,
+        .data = NULL
+    };
+    appmanager_post_generic_worker_message(&am, 10);
+}
+
+/*
+ * The worker thread starts here, and tells the manager once the worker
+ * has returned
+ */
+void appmanager_worker_main_entry(void)
+{
+    app_running_thread *_this_thread = appmanager_get_current_thread();
+
+    _this_thread->status = AppThreadLoaded;
+    app_worker_message_reset();
+
+    _this_thread->main();
+    _this_thread->status = AppThreadUnloading;
+
+    AppMessage am = {
+        .thread_id = _this_thread->thread_type,
+        .command = THREAD_MANAGER_APP_QUIT_CLEAN,
+    };
+
+    appmanager_post_generic_thread_message(&am, 100);
+    LOG_DEBUG("Worker Finished.");
+
+    /* Block until we are killed */
+    vTaskDelay(portMAX_DELAY);
+}
+
+void worker_event_loop(void)
+{
+    AppMessage data;
+    app_running_thread *_this_thread = appmanager_get_current_thread();
+
+    if (_this_thread->thread_type != AppThreadWorker)
+    {
+        LOG_ERROR("Runloop: You are not a worker");
+        return;
+    }
+
+    LOG_INFO("Worker entered mainloop");
+
+    /* clear the queue of any work for the last worker */
+    xQueueReset(_worker_message_queue);
+    _this_thread->status = AppThreadRunloop;
+
+    /* and pick up anything the app sent while we were starting */
+    app_worker_message_deliver();
+
+    for ( ;; )
+    {
+        TickType_t next_timer = appmanager_timer_get_next_expiry(_this_thread);
+
+        if (next_timer == 0)
+        {
+            appmanager_timer_expired(_this_thread);
+            next_timer = appmanager_timer_get_next_expiry(_this_thread);
+        }
+        if (next_timer < 0)
+            next_timer = portMAX_DELAY;
+
+        if (!xQueueReceive(_worker_message_queue, &data, next_timer))
+            continue;
+
+        if (data.command == APP_WORKER_MESSAGE)
+        {
+            if (appmanager_is_app_shutting_down())
+                continue;
+
+            app_worker_message_deliver();
+        }
+        else if (data.command == APP_QUIT)
+        {
+            /* Set the shutdown time for this worker. We will kill it then */
+            if (!appmanager_is_app_shutting_down())
+            {
+                _this_thread->shutdown_at_tick = xTaskGetTickCount() + pdMS_TO_TICKS(5000);
+                _this_thread->status = AppThreadUnloading;
+            }
+
+            tick_timer_service_unsubscribe();
+            LOG_INFO("Worker Quit");
+            break;
+        }
+    }
+}
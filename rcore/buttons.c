@@ -43,6 +43,9 @@ static void _button_update(ButtonId button_id, uint8_t press);
 static void _button_released(ButtonHolder *button);
 static uint8_t _button_check_time(void);
 static ButtonHolder *_button_holders[NUM_BUTTONS];
+/* one holder a button, so they never need the heap */
+static ButtonHolder _button_holder_slab[NUM_BUTTONS];
+static qpool_t _button_holder_pool;
 
 void button_send_app_click(void *callback, void *recognizer, void *context);
 
@@ -58,6 +61,8 @@ uint8_t rcore_buttons_init(void)
 
     hw_button_set_isr(_button_isr);
 
+    qpool_init(&_button_holder_pool, _button_holder_slab, sizeof(ButtonHolder), NUM_BUTTONS);
+
     // Initialise the button click configs
     for (uint8_t i = 0; i < NUM_BUTTONS; i++)
     {
@@ -109,7 +114,14 @@ ButtonHolder *button_add_click_config(ButtonId button_id, ClickConfig click_conf
     if (button_id >= NUM_BUTTONS)
         return NULL;
     
-    ButtonHolder *button_holder = calloc(1, sizeof(ButtonHolder));
+    /* a new config replaces the old one */
+    if (_button_holders[button_id] && !qpool_free(&_button_holder_pool, _button_holders[button_id]))
+        free(_button_holders[button_id]);
+    _button_holders[button_id] = NULL;
+
+    ButtonHolder *button_holder = qpool_alloc(&_button_holder_pool, NULL);
+    if (!button_holder)
+        button_holder = calloc(1, sizeof(ButtonHolder));
 
     if (!button_holder) // could not malloc
         return NULL;
@@ -12,11 +12,19 @@
 
 extern void hw_flash_init(void);
 extern void hw_flash_read_bytes(uint32_t, uint8_t*, size_t);
+extern void *hw_flash_map(uint32_t);
+extern void hw_flash_unmap(void);
+extern int hw_flash_erase_start(uint32_t);
+extern int hw_flash_erase_poll(void);
+extern int hw_flash_write(uint32_t, const uint8_t *, size_t);
 
 static SemaphoreHandle_t _flash_mutex;
 static StaticSemaphore_t _flash_mutex_buf;
 static SemaphoreHandle_t _flash_wait_semaphore;
 static StaticSemaphore_t _flash_wait_semaphore_buf;
+/* held for the whole of an erase, as there can only be one at a time */
+static SemaphoreHandle_t _flash_erase_mutex;
+static StaticSemaphore_t _flash_erase_mutex_buf;
 
 uint8_t flash_init()
 {
@@ -25,6 +33,7 @@ uint8_t flash_init()
     
     _flash_mutex = xSemaphoreCreateMutexStatic(&_flash_mutex_buf);
     _flash_wait_semaphore = xSemaphoreCreateBinaryStatic(&_flash_wait_semaphore_buf);
+    _flash_erase_mutex = xSemaphoreCreateMutexStatic(&_flash_erase_mutex_buf);
     fs_init();
     
     return 0;
@@ -44,6 +53,61 @@ void flash_read_bytes(uint32_t address, uint8_t *buffer, size_t num_bytes)
         panic("Got stuck behind a wait lock in flash.c");
 }
 
+/*
+ * Get a pointer straight into the flash, if the platform maps it into
+ * memory. NULL if it doesn't. Call flash_unmap() once you are done with it
+ */
+void *flash_map(uint32_t address)
+{
+    return hw_flash_map(address);
+}
+
+void flash_unmap(void)
+{
+    hw_flash_unmap();
+}
+
+/*
+ * Erase the sector holding the address, or program bytes into flash that
+ * has been erased. Both block until the flash is done, and return 0 if it
+ * worked. Nothing can be running from the flash (see flash_map) meanwhile.
+ *
+ * An erase takes seconds, so the flash is only held to start it and to
+ * look in on it each tick. Anyone else's reads and writes go on in between,
+ * with the erase suspended while they do.
+ */
+int flash_erase_sector(uint32_t address)
+{
+    xSemaphoreTake(_flash_erase_mutex, portMAX_DELAY);
+
+    xSemaphoreTake(_flash_mutex, portMAX_DELAY);
+    int rv = hw_flash_erase_start(address);
+    xSemaphoreGive(_flash_mutex);
+
+    if (rv == 0)
+    {
+        do {
+            vTaskDelay(1);
+            xSemaphoreTake(_flash_mutex, portMAX_DELAY);
+            rv = hw_flash_erase_poll();
+            xSemaphoreGive(_flash_mutex);
+        } while (rv > 0);
+    }
+
+    xSemaphoreGive(_flash_erase_mutex);
+
+    return rv;
+}
+
+int flash_write_bytes(uint32_t address, const uint8_t *buffer, size_t num_bytes)
+{
+    xSemaphoreTake(_flash_mutex, portMAX_DELAY);
+    int rv = hw_flash_write(address, buffer, num_bytes);
+    xSemaphoreGive(_flash_mutex);
+
+    return rv;
+}
+
 void flash_dump(void)
 {
     uint8_t buffer[1025];
@@ -28,6 +28,10 @@ typedef struct ResourceHeader {
 uint8_t flash_init(void);
 void flash_test(uint16_t resource_id);
 void flash_read_bytes(uint32_t address, uint8_t *buffer, size_t num_bytes);
+void *flash_map(uint32_t address);
+void flash_unmap(void);
+int flash_erase_sector(uint32_t address);
+int flash_write_bytes(uint32_t address, const uint8_t *buffer, size_t num_bytes);
 void flash_dump(void);
 void flash_operation_complete(uint8_t cmd);
 void flash_operation_complete_isr(uint8_t cmd);
@@ -243,6 +243,27 @@ int fs_find_file(struct file *file, const char *name)
     return -1;
 }
 
+/*
+ * Is the file called name still where we found it earlier, and the same
+ * size? A page that starts a file might since have been given to another,
+ * so it's the header that says, not just what fs_init learnt of the page.
+ */
+int fs_file_valid(const struct file *file, const char *name)
+{
+    struct file_hdr_with_name buffer;
+    struct file_hdr *hdr = &buffer.hdr;
+
+    if (!_fs_valid || file->startpage >= REGION_FS_N_PAGES ||
+        _fs_get_page_state(file->startpage) != PageStateFileStart)
+        return 0;
+
+    _fs_read_file_hdr(file->startpage, &buffer);
+
+    return !strcmp(name, buffer.name) &&
+           hdr->file_size == file->size &&
+           sizeof(struct file_hdr) + hdr->filename_len == file->startpofs;
+}
+
 void fs_open(struct fd *fd, const struct file *file)
 {
     fd->file = *file;
@@ -288,6 +309,25 @@ int fs_read(struct fd *fd, void *p, size_t bytes)
     return bytes;
 }
 
+/*
+ * Every page starts with a header, so only what fits in a file's first
+ * page sits in one unbroken run of flash. If the first bytes of the file
+ * do, and the flash is memory mapped, return where they are. Otherwise
+ * NULL. Pair with fs_unmap().
+ */
+const void *fs_map(const struct file *file, size_t bytes)
+{
+    if (bytes > file->size || file->startpofs + bytes > REGION_FS_PAGE_SIZE)
+        return NULL;
+
+    return flash_map(REGION_FS_START + file->startpage * REGION_FS_PAGE_SIZE + file->startpofs);
+}
+
+void fs_unmap(void)
+{
+    flash_unmap();
+}
+
 long fs_seek(struct fd *fd, long ofs, enum seek whence)
 {
     size_t newoffset;
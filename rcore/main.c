@@ -58,6 +58,11 @@ void vApplicationTickHook(void) {
    provide information on how the remaining heap might be fragmented). */
 void vApplicationMallocFailedHook(void) {
     KERN_LOG("malloc", APP_LOG_LEVEL_ERROR, "Malloc Failed!");
+#ifdef MEMORY_TRACE
+    memory_trace_dump();
+#else
+    memory_heap_log_stats();
+#endif
     taskDISABLE_INTERRUPTS();
     for(;;);
 }
@@ -72,6 +77,7 @@ void vApplicationMallocFailedHook(void) {
    function, because it is the responsibility of the idle task to clean up
    memory allocated by the kernel to any task that has since been deleted. */
 void vApplicationIdleHook(void) {
+    memory_heap_check();
 }
 
 void vApplicationStackOverflowHook(xTaskHandle pxTask, signed char *pcTaskName) {
@@ -0,0 +1,229 @@
+/* memory_trace.c
+ * How full each heap is, whether it's intact, and (with MEMORY_TRACE) who has been filling it
+ * RebbleOS
+ */
+
+#include "rebbleos.h"
+#include "notification_manager.h"
+#include "memory_trace.h"
+
+/* Configure Logging */
+#define MODULE_NAME "mtrace"
+#define MODULE_TYPE "KERN"
+#define LOG_LEVEL RBL_LOG_LEVEL_INFO //RBL_LOG_LEVEL_NONE
+
+static const char * const _heap_names[MemoryHeapMax] = {
+    [MemoryHeapSystem]   = "system",
+    [MemoryHeapApp]      = "app",
+    [MemoryHeapWorker]   = "worker",
+    [MemoryHeapOverlay]  = "overlay",
+    [MemoryHeapMessages] = "messages",
+};
+
+/* How many blocks of each heap the idle task checks, and how often */
+#define MEMORY_CHECK_BLOCKS      8
+#define MEMORY_CHECK_INTERVAL_MS 100
+
+/* Only while there's an app on the thread. Before it's started, or once it's
+ * gone, what was its arena is anyone's */
+static qarena_t *_heap_arena(MemoryHeap heap)
+{
+    if (heap == MemoryHeapMessages)
+        return noty_get_arena();
+
+    app_running_thread *thread = appmanager_get_thread(heap - MemoryHeapApp);
+    if (thread->status != AppThreadLoaded && thread->status != AppThreadRunloop &&
+        thread->status != AppThreadUnloading)
+        return NULL;
+
+    return thread->arena;
+}
+
+/*
+ * How the heap is doing right now. Returns false if it isn't there, such as
+ * the worker's when there's no worker running
+ */
+bool memory_heap_get_stats(MemoryHeap heap, MemoryHeapStats *stats)
+{
+    if (heap == MemoryHeapSystem)
+    {
+        HeapStats_t heap_stats;
+
+        vPortGetHeapStats(&heap_stats);
+        stats->size = configTOTAL_HEAP_SIZE;
+        stats->used = configTOTAL_HEAP_SIZE - heap_stats.xAvailableHeapSpaceInBytes;
+        stats->peak = configTOTAL_HEAP_SIZE - heap_stats.xMinimumEverFreeBytesRemaining;
+        stats->largest = heap_stats.xSizeOfLargestFreeBlockInBytes;
+        return true;
+    }
+
+    /* the arenas are only ever touched by their own thread, so keep it
+     * from changing the one we're looking at under us */
+    vTaskSuspendAll();
+    qarena_t *arena = _heap_arena(heap);
+    if (arena)
+    {
+        stats->used = qusedbytes(arena);
+        stats->size = stats->used + qfreebytes(arena);
+        stats->peak = qpeakbytes(arena);
+        stats->largest = qlargestfree(arena);
+    }
+    xTaskResumeAll();
+
+    return arena != NULL;
+}
+
+void memory_heap_log_stats(void)
+{
+    MemoryHeapStats stats;
+
+    for (MemoryHeap heap = 0; heap < MemoryHeapMax; heap++)
+        if (memory_heap_get_stats(heap, &stats))
+            LOG_INFO("mtrace stats %s %d %d %d %d", _heap_names[heap],
+                     stats.size, stats.used, stats.peak, stats.largest);
+}
+
+/*
+ * From the idle task. Checks a few more blocks of each heap, so corruption
+ * is found in memory that nobody is allocating or freeing, which the
+ * allocator never looks at. The idle task only runs when every other thread
+ * is waiting, so none of them is part way through changing a heap, and
+ * holding the scheduler keeps it that way until we're done
+ */
+void memory_heap_check(void)
+{
+    static TickType_t next_check;
+    TickType_t now = xTaskGetTickCount();
+
+    if ((int32_t)(now - next_check) < 0)
+        return;
+    next_check = now + MEMORY_CHECK_INTERVAL_MS / portTICK_PERIOD_MS;
+
+    vTaskSuspendAll();
+    for (MemoryHeap heap = MemoryHeapApp; heap < MemoryHeapMax; heap++)
+    {
+        qarena_t *arena = _heap_arena(heap);
+        if (arena)
+            qcheck_step(arena, MEMORY_CHECK_BLOCKS);
+    }
+    xTaskResumeAll();
+}
+
+#ifdef MEMORY_TRACE
+
+/*
+ * Every allocation and free from every heap goes in a ring, oldest
+ * overwritten first, along with who asked for it. Dump it over the log and
+ * Utilities/heap_report.py will say who has what, and what they did with it.
+ *
+ * Callers inside an app's image are left as they are here, as the dump
+ * also says where each thread's heap is, so the report can tell them apart.
+ */
+
+static MemoryTraceEvent _events[MEMORY_TRACE_EVENTS];
+static uint32_t _event_count; /* ever, so _events[_event_count % MEMORY_TRACE_EVENTS] is next */
+static void *_system_caller;
+
+static void _trace(MemoryHeap heap, MemoryTraceOp op, void *caller, void *old, void *ptr, size_t size)
+{
+    taskENTER_CRITICAL();
+    MemoryTraceEvent *event = &_events[_event_count++ % MEMORY_TRACE_EVENTS];
+    event->caller = caller;
+    event->ptr = ptr;
+    event->old = old;
+    event->size = size;
+    event->op = op;
+    event->heap = heap;
+    taskEXIT_CRITICAL();
+}
+
+void memory_trace_alloc(MemoryHeap heap, void *caller, void *ptr, size_t size)
+{
+    _trace(heap, MemoryTraceAlloc, caller, NULL, ptr, size);
+}
+
+void memory_trace_realloc(MemoryHeap heap, void *caller, void *old, void *ptr, size_t size)
+{
+    _trace(heap, MemoryTraceRealloc, caller, old, ptr, size);
+}
+
+void memory_trace_free(MemoryHeap heap, void *caller, void *ptr)
+{
+    if (ptr)
+        _trace(heap, MemoryTraceFree, caller, NULL, ptr, 0);
+}
+
+/*
+ * malloc and calloc are wrappers, so the heap sees them as the caller.
+ * They say who called them just before they call into the heap, with the
+ * scheduler held so nobody else's allocation gets the credit
+ */
+void memory_trace_set_caller(void *caller)
+{
+    _system_caller = caller;
+}
+
+/* From the heap's own trace hooks. The size is of the whole block */
+void memory_trace_system_alloc(void *ptr, size_t size, void *caller)
+{
+    if (_system_caller)
+        caller = _system_caller;
+    _system_caller = NULL;
+    _trace(MemoryHeapSystem, MemoryTraceAlloc, caller, NULL, ptr, size);
+}
+
+void memory_trace_system_free(void *ptr, void *caller)
+{
+    _trace(MemoryHeapSystem, MemoryTraceFree, caller, NULL, ptr, 0);
+}
+
+/* The event back from the newest (0 is the newest). False once it's gone */
+bool memory_trace_get_event(uint32_t back, MemoryTraceEvent *event)
+{
+    bool found = false;
+
+    taskENTER_CRITICAL();
+    if (back < _event_count && back < MEMORY_TRACE_EVENTS)
+    {
+        *event = _events[(_event_count - 1 - back) % MEMORY_TRACE_EVENTS];
+        found = true;
+    }
+    taskEXIT_CRITICAL();
+
+    return found;
+}
+
+/*
+ * Log everything in the ring, oldest first, and where each heap is
+ */
+void memory_trace_dump(void)
+{
+    static const char _ops[] = { 'a', 'r', 'f' };
+    uint32_t count = _event_count;
+    uint32_t kept = count < MEMORY_TRACE_EVENTS ? count : MEMORY_TRACE_EVENTS;
+    MemoryTraceEvent event;
+
+    LOG_INFO("mtrace begin %d %d", count, kept);
+
+    for (AppThreadType type = 0; type < MAX_APP_THREADS; type++)
+    {
+        app_running_thread *thread = appmanager_get_thread(type);
+        if (thread->heap)
+            LOG_INFO("mtrace heap %s 0x%x %d", _heap_names[MEMORY_HEAP_FOR_THREAD(type)],
+                     thread->heap, thread->heap_size);
+    }
+    memory_heap_log_stats();
+
+    /* new events while we're dumping are left for next time */
+    for (uint32_t back = kept; back > 0; back--)
+    {
+        if (!memory_trace_get_event(back - 1 + (_event_count - count), &event))
+            continue;
+        LOG_INFO("mtrace %c %s 0x%x 0x%x 0x%x %d", _ops[event.op], _heap_names[event.heap],
+                 event.caller, event.ptr, event.old, event.size);
+    }
+
+    LOG_INFO("mtrace end");
+}
+
+#endif
@@ -0,0 +1,74 @@
+#pragma once
+/* memory_trace.h
+ * How full each heap is, whether it's intact, and (with MEMORY_TRACE) who has been filling it
+ * RebbleOS
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Every heap we hand memory out of. The app threads' arenas are in
+ * AppThreadType order */
+typedef enum MemoryHeap {
+    MemoryHeapSystem,   /* FreeRTOS's own heap, behind malloc and calloc */
+    MemoryHeapApp,
+    MemoryHeapWorker,
+    MemoryHeapOverlay,
+    MemoryHeapMessages, /* the notification store */
+    MemoryHeapMax
+} MemoryHeap;
+
+#define MEMORY_HEAP_FOR_THREAD(thread_type) ((MemoryHeap)(MemoryHeapApp + (thread_type)))
+
+/* All in bytes */
+typedef struct MemoryHeapStats {
+    size_t size;    /* what there is to hand out */
+    size_t used;
+    size_t peak;    /* the most there's been used at once */
+    size_t largest; /* the biggest free block, so the biggest we could hand out */
+} MemoryHeapStats;
+
+bool memory_heap_get_stats(MemoryHeap heap, MemoryHeapStats *stats);
+void memory_heap_log_stats(void);
+void memory_heap_check(void);
+
+#ifdef MEMORY_TRACE
+
+#ifndef MEMORY_TRACE_EVENTS
+#define MEMORY_TRACE_EVENTS 256
+#endif
+
+typedef enum MemoryTraceOp {
+    MemoryTraceAlloc,
+    MemoryTraceRealloc,
+    MemoryTraceFree,
+} MemoryTraceOp;
+
+typedef struct MemoryTraceEvent {
+    void *caller;   /* the return address of whoever asked */
+    void *ptr;      /* what they got, NULL if it failed */
+    void *old;      /* for a realloc, what they had */
+    uint32_t size;  /* what they asked for */
+    uint8_t op;
+    uint8_t heap;
+} MemoryTraceEvent;
+
+void memory_trace_alloc(MemoryHeap heap, void *caller, void *ptr, size_t size);
+void memory_trace_realloc(MemoryHeap heap, void *caller, void *old, void *ptr, size_t size);
+void memory_trace_free(MemoryHeap heap, void *caller, void *ptr);
+void memory_trace_set_caller(void *caller);
+void memory_trace_system_alloc(void *ptr, size_t size, void *caller);
+void memory_trace_system_free(void *ptr, void *caller);
+bool memory_trace_get_event(uint32_t back, MemoryTraceEvent *event);
+void memory_trace_dump(void);
+
+#else
+
+#define memory_trace_alloc(heap, caller, ptr, size) do { } while (0)
+#define memory_trace_realloc(heap, caller, old, ptr, size) do { } while (0)
+#define memory_trace_free(heap, caller, ptr) do { } while (0)
+#define memory_trace_set_caller(caller) do { } while (0)
+#define memory_trace_dump() do { } while (0)
+
+#endif
@@ -162,8 +162,9 @@ static void _notification_window_creating(OverlayWindow *overlay_window, Window
         app_timer_cancel(nm->data.timer);
     nm->data.timer = 0;
     if (nm->data.timeout_ms)
-        nm->data.timer = app_timer_register(nm->data.timeout_ms, 
-                                            (AppTimerCallback)_notif_timeout_cb, nm);
+        /* nobody will notice if it hangs around a little longer */
+        nm->data.timer = app_timer_register_with_slack(nm->data.timeout_ms, nm->data.timeout_ms / 10,
+                                                       (AppTimerCallback)_notif_timeout_cb, nm);
     
     overlay_window_stack_push(overlay_window, false);
 }
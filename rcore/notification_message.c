@@ -17,9 +17,12 @@
  * 
  */
 #define MSG_HEAP_SIZE 10000
+/* attributes pooled, a handful of messages' worth */
+#define MSG_ATTRIBUTE_POOL 32
 
 static uint8_t _notification_messages_heap[MSG_HEAP_SIZE] CCRAM;
 static qarena_t *_notification_arena;
+static qpool_t _attribute_pool;
 static list_head _messages_head = LIST_HEAD(_messages_head);
 
 static full_msg_t *_fake_message(char *text, char *action);
@@ -28,6 +31,7 @@ static full_msg_t *_fake_message(char *text, char *action);
 void messages_init(void)
 {
     _notification_arena = qinit(_notification_messages_heap, MSG_HEAP_SIZE);
+    qpool_init(&_attribute_pool, NULL, sizeof(cmd_phone_attribute_t), MSG_ATTRIBUTE_POOL);
 
     /* create three samples */
 //     message_add(_fake_message("RebbleOS is here!", "To Moon"));
@@ -43,7 +47,7 @@ static full_msg_t *_fake_message(char *text, char *action)
     m->header->attr_count = 1;
     m->header->action_count = 1;
     
-    cmd_phone_attribute_t *new_attr = noty_calloc(1, sizeof(cmd_phone_attribute_t));
+    cmd_phone_attribute_t *new_attr = noty_attribute_calloc();
     cmd_phone_action_t *new_act = noty_calloc(1, sizeof(cmd_phone_action_t));
     new_attr->data = (uint8_t *)text;
     new_act->data = (uint8_t *)action;
@@ -87,13 +91,33 @@ void *noty_calloc(size_t count, size_t size)
 {
     /* uses a special qarena */
     void *x = qalloc(_notification_arena, count * size);
+    memory_trace_alloc(MemoryHeapMessages, __builtin_return_address(0), x, count * size);
     if (x != NULL)
         memset(x, 0, count * size);
     return x;
 }
 
+cmd_phone_attribute_t *noty_attribute_calloc(void)
+{
+    cmd_phone_attribute_t *x = qpool_alloc(&_attribute_pool, _notification_arena);
+    memory_trace_alloc(MemoryHeapMessages, __builtin_return_address(0), x, sizeof(cmd_phone_attribute_t));
+    return x;
+}
+
 void noty_free(void *mem)
 {
-    qfree(_notification_arena, mem);
+    memory_trace_free(MemoryHeapMessages, __builtin_return_address(0), mem);
+    if (!qpool_free(&_attribute_pool, mem))
+        qfree(_notification_arena, mem);
+}
+
+qarena_t *noty_get_arena(void)
+{
+    return _notification_arena;
+}
+
+const qpool_t *noty_get_attribute_pool(void)
+{
+    return &_attribute_pool;
 }
 
@@ -20,6 +20,13 @@ list_head *message_get_head(void);
  */
 void *noty_calloc(size_t count, size_t size);
 
+/**
+ * @brief Allocate a message attribute, from the attribute pool if it has room
+ * 
+ * @return a zeroed attribute, to be freed with \ref noty_free
+ */
+cmd_phone_attribute_t *noty_attribute_calloc(void);
+
 /**
  * @brief Free memory on the message heap
  * 
@@ -27,6 +34,12 @@ void *noty_calloc(size_t count, size_t size);
  */
 void noty_free(void *mem);
 
+/**
+ * @brief The message heap and its attribute pool, to see how they are doing
+ */
+qarena_t *noty_get_arena(void);
+const qpool_t *noty_get_attribute_pool(void);
+
 /**
  * @brief Return a count of the messages in the list
  * 
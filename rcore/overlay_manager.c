@@ -8,6 +8,7 @@
 #include "ngfxwrap.h"
 #include "overlay_manager.h"
 #include "ngfxwrap.h"
+#include "utils.h"
 
 /* A message to talk to the overlay thread */
 typedef struct OverlayMessage {
@@ -27,14 +28,45 @@ static list_head _overlay_window_list_head = LIST_HEAD(_overlay_window_list_head
 static void _overlay_window_draw(bool window_is_dirty);
 static void _overlay_window_create(OverlayCreateCallback create_callback, void *context);
 static void _overlay_window_destroy(OverlayWindow *overlay_window, bool animated);
+static GRect _overlay_window_screen_rect(Window *window);
+static bool _overlay_window_compose_cached(void);
+static void _overlay_cache_blit(OverlayWindow *overlay_window);
+static void _overlay_cache_render(OverlayWindow *overlay_window);
+static void _overlay_cache_free(OverlayWindow *overlay_window);
 
 /* Semaphore to start drawing */
 static SemaphoreHandle_t _ovl_done_sem;
 static StaticSemaphore_t _ovl_done_sem_buf;
 
+/* Held over anything that walks the window list or touches a kept render,
+ * as the app thread composes from them while the overlay thread can be
+ * destroying a window. Recursive, as drawing can get back to us */
+static SemaphoreHandle_t _ovl_list_mutex;
+static StaticSemaphore_t _ovl_list_mutex_buf;
+
+/* Most of the overlay heap a kept render may take, leaving the rest to
+ * the overlays themselves. A render only holds the pixels an overlay
+ * painted, so a toast, or a full screen overlay the app shows through,
+ * fits. One that paints the whole screen (24192 bytes on snowy, 32400 on
+ * chalk) never would, in a heap of 16600 either way. It's nearly always
+ * opaque though, so it hides the app, and the framebuffer is left holding
+ * it: nothing is painted again until it changes */
+#define OVERLAY_CACHE_MAX  (MEMORY_SIZE_OVERLAY_HEAP / 2)
+
+/* The top two bits of a framebuffer pixel are its alpha, and ngfx only
+ * writes opaque colours. Clear them and paint, and the ones set again are
+ * the overlay's */
+#define OVERLAY_ALPHA      0xC0
+
+/* The overlay thread ran something that may have changed an overlay */
+static volatile bool _ovl_dirty = true;
+/* The framebuffer still holds the last composition, untouched since */
+static volatile bool _ovl_fb_intact = false;
+
 uint8_t overlay_window_init(void)
 {   
     _ovl_done_sem = xSemaphoreCreateBinaryStatic(&_ovl_done_sem_buf);
+    _ovl_list_mutex = xSemaphoreCreateRecursiveMutexStatic(&_ovl_list_mutex_buf);
 
     // XXX make static
     _overlay_queue = xQueueCreate(1, sizeof(struct OverlayMessage));
@@ -75,8 +107,28 @@ void overlay_window_create_with_context(OverlayCreateCallback creation_callback,
     xQueueSendToBack(_overlay_queue, &om, 0);
 }
 
-void overlay_window_draw(bool window_is_dirty)
+bool overlay_window_draw(bool window_is_dirty)
 {
+    if (overlay_window_count() == 0)
+        return false;
+
+    if (window_is_dirty)
+        _ovl_fb_intact = false;
+
+    if (!_ovl_dirty)
+    {
+        /* nobody has painted since, what's there is still right */
+        if (_ovl_fb_intact)
+            return false;
+
+        /* everything has a render we can reuse, no need to wait */
+        if (_overlay_window_compose_cached())
+        {
+            _ovl_fb_intact = true;
+            return true;
+        }
+    }
+
     OverlayMessage om = (OverlayMessage) {
         .command = OVERLAY_DRAW,
         .data = (void *)window_is_dirty,
@@ -84,6 +136,40 @@ void overlay_window_draw(bool window_is_dirty)
     xQueueSendToBack(_overlay_queue, &om, 1000);
     
     xSemaphoreTake(_ovl_done_sem, portMAX_DELAY);
+    return true;
+}
+
+/*
+ * An overlay with a solid background over the whole screen leaves
+ * nothing of the app to see.
+ */
+bool overlay_window_occludes_app(void)
+{
+    OverlayWindow *ow;
+    bool occludes = false;
+
+    xSemaphoreTakeRecursive(_ovl_list_mutex, portMAX_DELAY);
+    list_foreach(ow, &_overlay_window_list_head, OverlayWindow, node)
+    {
+        Window *window = &ow->window;
+        if (window->load_state == WindowLoadStateLoaded &&
+            (window->background_color.argb & 0xC0) == 0xC0 &&
+            window->frame.origin.x <= 0 && window->frame.origin.y <= 0 &&
+            window->frame.origin.x + window->frame.size.w >= DISPLAY_COLS &&
+            window->frame.origin.y + window->frame.size.h >= DISPLAY_ROWS)
+        {
+            occludes = true;
+            break;
+        }
+    }
+    xSemaphoreGiveRecursive(_ovl_list_mutex);
+
+    return occludes;
+}
+
+void overlay_window_dirty(void)
+{
+    _ovl_dirty = true;
 }
 
 
@@ -134,17 +220,22 @@ uint8_t overlay_window_count(void)
         return 0;
 
     OverlayWindow *w;
+    xSemaphoreTakeRecursive(_ovl_list_mutex, portMAX_DELAY);
     list_foreach(w, &_overlay_window_list_head, OverlayWindow, node)
     {
         count++;
     }
+    xSemaphoreGiveRecursive(_ovl_list_mutex);
     return count;
 }
 
 void overlay_window_stack_push(OverlayWindow *overlay_window, bool animated)
 {
     list_init_node(&overlay_window->node);
+    xSemaphoreTakeRecursive(_ovl_list_mutex, portMAX_DELAY);
     list_insert_head(&_overlay_window_list_head, &overlay_window->node);
+    _ovl_dirty = true;
+    xSemaphoreGiveRecursive(_ovl_list_mutex);
     
     overlay_window->window.is_render_scheduled = true;
     window_dirty(true);
@@ -231,10 +322,18 @@ static void _overlay_window_create(OverlayCreateCallback create_callback, void *
 
 static void _overlay_window_destroy(OverlayWindow *overlay_window, bool animated)
 {
+    /* before anything goes, so the app thread stops composing from it */
+    xSemaphoreTakeRecursive(_ovl_list_mutex, portMAX_DELAY);
+    _ovl_dirty = true;
+    _overlay_cache_free(overlay_window);
+    xSemaphoreGiveRecursive(_ovl_list_mutex);
+
     _window_unload_proc(&overlay_window->window);
     window_dtor(&overlay_window->window);
         
+    xSemaphoreTakeRecursive(_ovl_list_mutex, portMAX_DELAY);
     list_remove(&_overlay_window_list_head, &overlay_window->node);
+    xSemaphoreGiveRecursive(_ovl_list_mutex);
     app_free(overlay_window);
     
     Window *top_window = overlay_window_get_next_window_with_click_config();
@@ -253,15 +352,25 @@ static void _overlay_window_destroy(OverlayWindow *overlay_window, bool animated
     window_dirty(true);
 }
 
+/*
+ * Paint the overlays over the app.
+ * Overlays that changed are painted live, as they are likely to change
+ * again next frame (an animation, say). Ones that have settled get a
+ * render kept, and from then on are just copied back over the app, which
+ * the app thread can do without us.
+ */
 static void _overlay_window_draw(bool window_is_dirty)
 {
-    app_running_thread *appthread = appmanager_get_thread(AppThreadMainApp);
-    
     if (appmanager_get_thread_type() != AppThreadOverlay)
     {
         SYS_LOG("ov win", APP_LOG_LEVEL_ERROR, "Someone not overlay thread is trying to draw. Tsk.");
         return;
     }
+
+    xSemaphoreTakeRecursive(_ovl_list_mutex, portMAX_DELAY);
+    bool changed = _ovl_dirty;
+    _ovl_dirty = false;
+
     OverlayWindow *ow;
     list_foreach(ow, &_overlay_window_list_head, OverlayWindow, node)
     {
@@ -270,14 +379,193 @@ static void _overlay_window_draw(bool window_is_dirty)
         /* we would normally check render scheduled here, but if
          * the main app has forced a redraw, then we have to do painting
          * regardless. So we paint. */
-        rbl_window_draw(window);
+        if (changed)
+        {
+            ow->cache_valid = false;
+            rbl_window_draw(window);
+        }
+        else if (ow->cache_valid && RECT_EQ(ow->cache_rect, _overlay_window_screen_rect(window)))
+        {
+            _overlay_cache_blit(ow);
+        }
+        else
+        {
+            _overlay_cache_render(ow);
+        }
         
         window->is_render_scheduled = false;
     }
+    xSemaphoreGiveRecursive(_ovl_list_mutex);
     
+    _ovl_fb_intact = true;
     xSemaphoreGive(_ovl_done_sem);     
 }
 
+/* Where the window lands on the screen, clipped to it */
+static GRect _overlay_window_screen_rect(Window *window)
+{
+    int16_t x0 = CLAMP(window->frame.origin.x, 0, DISPLAY_COLS);
+    int16_t y0 = CLAMP(window->frame.origin.y, 0, DISPLAY_ROWS);
+    int16_t x1 = CLAMP(window->frame.origin.x + window->frame.size.w, 0, DISPLAY_COLS);
+    int16_t y1 = CLAMP(window->frame.origin.y + window->frame.size.h, 0, DISPLAY_ROWS);
+
+    return GRect(x0, y0, x1 - x0, y1 - y0);
+}
+
+/*
+ * Composite every overlay from its kept render, if they all have one.
+ * Called from the app thread with the display held. Nothing changed since
+ * the caller looked is checked again under the lock, as a window being
+ * destroyed says so before its render goes.
+ */
+static bool _overlay_window_compose_cached(void)
+{
+    OverlayWindow *ow;
+    bool composed = false;
+
+    xSemaphoreTakeRecursive(_ovl_list_mutex, portMAX_DELAY);
+    if (_ovl_dirty)
+        goto out;
+
+    list_foreach(ow, &_overlay_window_list_head, OverlayWindow, node)
+    {
+        if (!ow->cache_valid || !RECT_EQ(ow->cache_rect, _overlay_window_screen_rect(&ow->window)))
+            goto out;
+    }
+
+    list_foreach(ow, &_overlay_window_list_head, OverlayWindow, node)
+    {
+        _overlay_cache_blit(ow);
+        ow->window.is_render_scheduled = false;
+    }
+    composed = true;
+
+out:
+    xSemaphoreGiveRecursive(_ovl_list_mutex);
+    return composed;
+}
+
+/*
+ * A kept render is, for each row of its rect, a count of the runs of
+ * pixels the overlay painted, then each run as its x, its length and its
+ * pixels. Copying it back is a memcpy a run.
+ */
+static void _overlay_cache_blit(OverlayWindow *overlay_window)
+{
+#ifndef PBL_BW
+    GRect rect = overlay_window->cache_rect;
+    uint8_t *fb = display_get_buffer();
+    uint8_t *p = overlay_window->cache;
+
+    for (int16_t y = 0; y < rect.size.h; y++)
+    {
+        uint8_t *dst = &fb[((rect.origin.y + y) * DISPLAY_COLS) + rect.origin.x];
+
+        for (uint8_t runs = *p++; runs; runs--)
+        {
+            uint8_t x = *p++;
+            uint8_t len = *p++;
+            memcpy(&dst[x], p, len);
+            p += len;
+        }
+    }
+#endif
+}
+
+/* The painted runs of a row, from x on: where the next starts and its length */
+static int16_t _overlay_cache_next_run(uint8_t *row, int16_t x, int16_t w, int16_t *len)
+{
+    while (x < w && !(row[x] & OVERLAY_ALPHA))
+        x++;
+
+    int16_t end = x;
+    while (end < w && (row[end] & OVERLAY_ALPHA))
+        end++;
+
+    *len = end - x;
+    return x;
+}
+
+/*
+ * Paint an overlay, once, and keep what it painted.
+ * The alpha is cleared from the framebuffer under it first, so whatever
+ * comes back with any alpha is the overlay's. Anything it wrote with none
+ * (a bitmap's clear pixels, copied as they are) is left out of the render,
+ * the same as if it hadn't painted there. Then everything gets its alpha
+ * back: the framebuffer is opaque colour, so the app's pixels are just as
+ * they were.
+ */
+static void _overlay_cache_render(OverlayWindow *overlay_window)
+{
+#ifdef PBL_BW
+    /* XXX: PBL_BW framebuffer is packed 1bpp, no cache support */
+    rbl_window_draw(&overlay_window->window);
+#else
+    Window *window = &overlay_window->window;
+    GRect rect = _overlay_window_screen_rect(window);
+    uint8_t *fb = display_get_buffer();
+    int16_t len;
+
+    _overlay_cache_free(overlay_window);
+
+    for (int16_t y = 0; y < rect.size.h; y++)
+    {
+        uint8_t *row = &fb[((rect.origin.y + y) * DISPLAY_COLS) + rect.origin.x];
+        for (int16_t x = 0; x < rect.size.w; x++)
+            row[x] &= ~OVERLAY_ALPHA;
+    }
+    rbl_window_draw(window);
+
+    /* what it would take to keep */
+    size_t bytes = rect.size.h;
+    for (int16_t y = 0; y < rect.size.h && bytes <= OVERLAY_CACHE_MAX; y++)
+    {
+        uint8_t *row = &fb[((rect.origin.y + y) * DISPLAY_COLS) + rect.origin.x];
+        for (int16_t x = 0; (x = _overlay_cache_next_run(row, x, rect.size.w, &len)) < rect.size.w; x += len)
+            bytes += 2 + len;
+    }
+
+    uint8_t *p = NULL;
+    if (rect.size.w && rect.size.h && bytes <= OVERLAY_CACHE_MAX)
+        p = overlay_window->cache = app_calloc(1, bytes);
+
+    for (int16_t y = 0; y < rect.size.h; y++)
+    {
+        uint8_t *row = &fb[((rect.origin.y + y) * DISPLAY_COLS) + rect.origin.x];
+
+        if (p)
+        {
+            uint8_t *runs = p++;
+            for (int16_t x = 0; (x = _overlay_cache_next_run(row, x, rect.size.w, &len)) < rect.size.w; x += len)
+            {
+                (*runs)++;
+                *p++ = x;
+                *p++ = len;
+                memcpy(p, &row[x], len);
+                p += len;
+            }
+        }
+
+        for (int16_t x = 0; x < rect.size.w; x++)
+            row[x] |= OVERLAY_ALPHA;
+    }
+
+    if (!p)
+        return;
+
+    overlay_window->cache_rect = rect;
+    overlay_window->cache_valid = true;
+#endif
+}
+
+static void _overlay_cache_free(OverlayWindow *overlay_window)
+{
+    if (overlay_window->cache)
+        app_free(overlay_window->cache);
+    overlay_window->cache = NULL;
+    overlay_window->cache_valid = false;
+}
+
 static void _overlay_thread(void *pvParameters)
 {
     OverlayMessage data;
@@ -297,6 +585,7 @@ static void _overlay_thread(void *pvParameters)
         if(next_timer == 0) 
         {
             appmanager_timer_expired(_this_thread);
+            _ovl_dirty = true;
             /* When we need to update draw, we post it to the main app. This way
              * we guarantee the background is drawn first.
              * App thread will then defer back to this thread to draw any overlays */
@@ -329,6 +618,7 @@ static void _overlay_thread(void *pvParameters)
                     /* execute the button's callback */
                     ButtonMessage *message = (ButtonMessage *)data.data;
                     ((ClickHandler)(message->callback))((ClickRecognizerRef)(message->clickref), message->context);
+                    _ovl_dirty = true;
                     break;
                 default:
                     assert(!"I don't know this command!");
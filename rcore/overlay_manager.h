@@ -40,6 +40,10 @@ typedef struct OverlayWindow {
     Window window;
     void *context;
     list_node node;
+    /* the last render: each row's runs of painted pixels */
+    uint8_t *cache;
+    GRect cache_rect;
+    bool cache_valid;
 } OverlayWindow;
 
 
@@ -80,11 +84,26 @@ void overlay_window_create_with_context(OverlayCreateCallback creation_callback,
 /** 
  * @brief Directly draw an \ref OverlayWindow.
  * 
- * This will also cause a full redraw of all \ref Window objects
+ * Overlays that haven't changed are composited from their last render
+ * without waiting on the overlay thread.
  * @param window_is_dirty When set the existing window we are overlaying 
- * is already dirty
+ * has been repainted underneath us
+ * @return bool if the framebuffer was changed
+ */
+bool overlay_window_draw(bool window_is_dirty);
+
+/**
+ * @brief Check if an \ref OverlayWindow hides the app completely
+ * 
+ * @return bool if there is no point painting the app underneath
+ */
+bool overlay_window_occludes_app(void);
+
+/**
+ * @brief Flag the \ref OverlayWindow objects as changed, so the next
+ * draw renders them again rather than reusing the last render
  */
-void overlay_window_draw(bool window_is_dirty);
+void overlay_window_dirty(void);
 
 /**
  * @brief Clean up an \ref OverlayWindow.
@@ -48,7 +48,7 @@ void notification_packet_push(uint8_t *data, full_msg_t **message)
         cmd_phone_attribute_hdr_t *att = (cmd_phone_attribute_hdr_t *)p;
         uint8_t *data = p + sizeof(cmd_phone_attribute_hdr_t);
         SYS_LOG("PHPKT", APP_LOG_LEVEL_INFO, "X ATTR ID:%d L:%d", att->attr_idx, att->str_len);
-        cmd_phone_attribute_t *new_attr = noty_calloc(1, sizeof(cmd_phone_attribute_t));
+        cmd_phone_attribute_t *new_attr = noty_attribute_calloc();
         /* copy the head to the new attribute */
         memcpy(new_attr, att, sizeof(cmd_phone_attribute_hdr_t));
         /* copy the data in now */
@@ -19,6 +19,8 @@ void process_version_packet(uint8_t *data)
 }
 
 
+/* XXX the UTC offset wants to go to rcore_time_set_timezone, once the
+ * time itself is set from here too */
 void process_set_time_packet(uint8_t *data)
 {
     cmd_set_time_t *time = (cmd_set_time_t *)data;
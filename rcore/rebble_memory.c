@@ -13,16 +13,46 @@
 #define MODULE_TYPE "KERN"
 #define LOG_LEVEL RBL_LOG_LEVEL_ERROR //RBL_LOG_LEVEL_NONE
 
+/*
+ * How many of each pooled object a thread keeps, by thread type. The worker
+ * has no windows, so it only gets timers. A pool's slab comes out of the
+ * thread's arena the first time one is made, and once it's full the rest
+ * come from the arena one at a time, as everything else does.
+ */
+static const uint8_t _pool_counts[ObjectPoolMax][MAX_APP_THREADS] = {
+    /*                               app  worker  overlay */
+    [ObjectPoolLayer]             = { 8,   0,      4 },
+    [ObjectPoolTextLayer]         = { 8,   0,      4 },
+    [ObjectPoolScrollLayer]       = { 2,   0,      1 },
+    [ObjectPoolAnimation]         = { 4,   0,      2 },
+    [ObjectPoolPropertyAnimation] = { 4,   0,      2 },
+    [ObjectPoolAppTimer]          = { 8,   4,      4 },
+};
+
 void rblos_memory_init(void)
 {
 }
 
+/* pvPortMalloc, but with the trace (if there is one) saying who asked */
+static void *_system_alloc(size_t size, void *caller)
+{
+#ifdef MEMORY_TRACE
+    vTaskSuspendAll();
+    memory_trace_set_caller(caller);
+    void *x = pvPortMalloc(size);
+    xTaskResumeAll();
+    return x;
+#else
+    return pvPortMalloc(size);
+#endif
+}
+
 void *system_calloc(size_t count, size_t size)
 {
     if (!appmanager_is_thread_system())
         LOG_ERROR("XXX System Calloc. Check who did this");
 
-    void *x = pvPortMalloc(count * size);
+    void *x = _system_alloc(count * size, __builtin_return_address(0));
     if (x != NULL)
         memset(x, 0, count * size);
     return x;
@@ -32,42 +62,107 @@ void *system_malloc(size_t size)
 {
     if (appmanager_is_thread_system())
         LOG_ERROR("XXX System Malloc. Check who did this");
-    return pvPortMalloc(size);
+    return _system_alloc(size, __builtin_return_address(0));
+}
+
+static void *_app_calloc(size_t size, void *caller)
+{
+    app_running_thread *thread = appmanager_get_current_thread();
+    assert(thread && "invalid thread");
+    void *x = qalloc(thread->arena, size);
+    memory_trace_alloc(MEMORY_HEAP_FOR_THREAD(thread->thread_type), caller, x, size);
+    if (x == NULL)
+    {
+        LOG_ERROR("!!! NO MEM!\n");
+        return NULL;
+    }
+
+    memset(x, 0, size);
+    return x;
 }
 
 void *app_malloc(size_t size)
 {
-    return app_calloc(1, size);    
+    return _app_calloc(size, __builtin_return_address(0));
 }
 
 void *app_calloc(size_t count, size_t size)
+{
+    return _app_calloc(count * size, __builtin_return_address(0));
+}
+
+/*
+ * A zeroed object from the thread's pool for type, or the arena if the pool
+ * is full. All of a type have to be the same size; the first one made sets
+ * it. Give it back with app_free, as with anything else
+ */
+void *app_pool_calloc(ObjectPoolType type, size_t size)
 {
     app_running_thread *thread = appmanager_get_current_thread();
     assert(thread && "invalid thread");
-    void *x = qalloc(thread->arena, count * size);
+    qpool_t *pool = &thread->pools[type];
+
+    if (!pool->size)
+        qpool_init(pool, NULL, size, _pool_counts[type][thread->thread_type]);
+    assert(size <= pool->size && "pooled objects are all one size");
+
+    void *x = qpool_alloc(pool, thread->arena);
+    memory_trace_alloc(MEMORY_HEAP_FOR_THREAD(thread->thread_type), __builtin_return_address(0), x, size);
     if (x == NULL)
-    {
         LOG_ERROR("!!! NO MEM!\n");
-        return NULL;
-    }
 
-    memset(x, 0, count * size);
     return x;
 }
 
+/* Called with the thread's arena fresh, so its pools are all empty */
+void app_pools_init(app_running_thread *thread)
+{
+    memset(thread->pools, 0, sizeof(thread->pools));
+}
+
+/* The pool mem came from, if it did */
+static qpool_t *_app_pool_of(app_running_thread *thread, void *mem)
+{
+    for (int i = 0; i < ObjectPoolMax; i++)
+        if (qpool_owns(&thread->pools[i], mem))
+            return &thread->pools[i];
+
+    return NULL;
+}
+
 void app_free(void *mem)
 {
     LOG_DEBUG("Free 0x%x", mem);
     app_running_thread *thread = appmanager_get_current_thread();
-    qfree(thread->arena, mem);
+    qpool_t *pool = _app_pool_of(thread, mem);
+
+    memory_trace_free(MEMORY_HEAP_FOR_THREAD(thread->thread_type), __builtin_return_address(0), mem);
+    if (pool)
+        qpool_free(pool, mem);
+    else
+        qfree(thread->arena, mem);
 }
 
 void *app_realloc(void *mem, size_t new_size)
 {
     app_running_thread *thread = appmanager_get_current_thread();
     assert(thread && "invalid thread");
+    qpool_t *pool = _app_pool_of(thread, mem);
+    void *x;
+
+    if (!pool)
+    {
+        x = qrealloc(thread->arena, mem, new_size);
+    }
+    /* it's leaving the pool, as it's not the pool's size any more */
+    else if ((x = qalloc(thread->arena, new_size)))
+    {
+        memcpy(x, mem, new_size < pool->size ? new_size : pool->size);
+        qpool_free(pool, mem);
+    }
 
-    return qrealloc(thread->arena, mem, new_size);
+    memory_trace_realloc(MEMORY_HEAP_FOR_THREAD(thread->thread_type), __builtin_return_address(0), mem, x, new_size);
+    return x;
 }
 
 uint32_t app_heap_bytes_free(void)
@@ -16,6 +16,20 @@
 #define calloc system_calloc
 #define free vPortFree
 
+/* The objects apps make and throw away most, which each thread keeps a
+ * pool of. How many of each is in rebble_memory.c */
+typedef enum ObjectPoolType {
+    ObjectPoolLayer,
+    ObjectPoolTextLayer,
+    ObjectPoolScrollLayer,
+    ObjectPoolAnimation,
+    ObjectPoolPropertyAnimation,
+    ObjectPoolAppTimer,
+    ObjectPoolMax
+} ObjectPoolType;
+
+struct app_running_thread_t;
+
 void *system_calloc(size_t count, size_t size);
 void rblos_memory_init(void);
 void *system_malloc(size_t size);
@@ -26,3 +40,5 @@ void *app_realloc(void *mem, size_t new_size);
 void app_free(void *mem);
 uint32_t app_heap_bytes_free(void);
 uint32_t app_heap_bytes_used(void);
+void *app_pool_calloc(ObjectPoolType type, size_t size);
+void app_pools_init(struct app_running_thread_t *thread);
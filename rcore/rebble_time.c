@@ -14,18 +14,162 @@
 #define LOG_LEVEL RBL_LOG_LEVEL_ERROR //RBL_LOG_LEVEL_ERROR
 
 
+/* from musl's time_impl.h */
+long long __year_to_secs(long long year, int *is_leap);
+int __month_to_secs(int month, int is_leap);
+long long __tm_to_secs(const struct tm *tm);
+int __secs_to_tm(long long t, struct tm *tm);
+
 static TickType_t _boot_ticks;
 static time_t _boot_time_t;
 
 static struct tm _global_tm;
 struct tm *boot_time_tm;
 
+/*
+ * Working a time_t out into a struct tm from scratch is a pile of
+ * divides, and almost everyone wants "now", which has only moved on a
+ * second or so since last time. So we keep the last one we worked out,
+ * and wind it forwards, only carrying into the next field when one rolls
+ * over. Anything further away than an hour, or in the past, is done the
+ * long way.
+ *
+ * The timezone offset is only worked out again when we cross a DST
+ * transition, so it costs nothing per tick either.
+ */
+#define TIME_ADVANCE_MAX     (60 * 60)
+
+static struct {
+    time_t time; /* UTC */
+    int32_t offset; /* the one it was worked out with */
+    struct tm tm; /* local */
+    bool valid;
+} _now;
+
+static RebbleTimezone _tz;
+static int32_t _tz_offset;
+static int _tz_isdst;
+/* the offset above holds from _tz_from until just before _tz_until,
+ * or forever if there's no DST */
+static time_t _tz_from;
+static time_t _tz_until;
+static bool _tz_forever;
+static bool _tz_valid;
+
+static const uint8_t _days_in_month[] = { 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+
+static int _month_days(int mon, int year)
+{
+    if (mon == 1 && !(year & 3) && ((year + 1900) % 100 || !((year + 1900) % 400)))
+        return 29;
+    return _days_in_month[mon];
+}
+
+/* Wind tm forwards by secs, which is less than TIME_ADVANCE_MAX */
+static void _tm_advance(struct tm *tm, uint32_t secs)
+{
+    tm->tm_sec += secs;
+    if (tm->tm_sec < 60)
+        return;
+    tm->tm_min += tm->tm_sec / 60;
+    tm->tm_sec %= 60;
+    if (tm->tm_min < 60)
+        return;
+    tm->tm_hour += tm->tm_min / 60;
+    tm->tm_min %= 60;
+    if (tm->tm_hour < 24)
+        return;
+
+    /* under an hour, so we can only have gone over one midnight */
+    tm->tm_hour -= 24;
+    tm->tm_wday = (tm->tm_wday + 1) % 7;
+    tm->tm_yday++;
+    if (++tm->tm_mday <= _month_days(tm->tm_mon, tm->tm_year))
+        return;
+    tm->tm_mday = 1;
+    if (++tm->tm_mon < 12)
+        return;
+    tm->tm_mon = 0;
+    tm->tm_yday = 0;
+    tm->tm_year++;
+}
+
+/* When the rule kicks in during the given year, in local seconds */
+static time_t _tz_rule_local(const RebbleDstRule *rule, int year)
+{
+    int leap;
+    long long month = __year_to_secs(year, &leap) + __month_to_secs(rule->month, leap);
+
+    /* 1970-01-01 was a Thursday */
+    int first_wday = ((month / 86400) % 7 + 11) % 7;
+    int mday = 1 + (rule->wday - first_wday + 7) % 7 + (rule->week - 1) * 7;
+    /* week 5 means the last one, which might be the 4th */
+    while (mday > _month_days(rule->month, year))
+        mday -= 7;
+
+    return month + (mday - 1) * 86400 + rule->secs;
+}
+
+/* Find what the offset is at time, and how long it stays that way */
+static void _tz_update(time_t time)
+{
+    struct tm tm;
+
+    _tz_valid = true;
+    _tz_offset = _tz.utc_offset;
+    _tz_isdst = 0;
+    _tz_forever = !_tz.dst_offset;
+
+    if (_tz_forever)
+        return;
+
+    __secs_to_tm((long long)time + _tz.utc_offset, &tm);
+
+    /* the transitions either side of us are in this year or the next
+     * or previous one. Starts are in standard time, ends in daylight */
+    time_t edges[6];
+    for (int i = 0; i < 3; i++)
+    {
+        int year = tm.tm_year - 1 + i;
+        edges[i * 2] = _tz_rule_local(&_tz.dst_start, year) - _tz.utc_offset;
+        edges[i * 2 + 1] = _tz_rule_local(&_tz.dst_end, year) - _tz.utc_offset - _tz.dst_offset;
+    }
+
+    /* the last one before us says which we're in, starts being even */
+    _tz_from = edges[0];
+    _tz_until = edges[5];
+    for (int i = 0; i < 6; i++)
+    {
+        if (edges[i] <= time && edges[i] >= _tz_from)
+        {
+            _tz_from = edges[i];
+            _tz_isdst = !(i & 1);
+        }
+        if (edges[i] > time && edges[i] < _tz_until)
+            _tz_until = edges[i];
+    }
+
+    if (_tz_isdst)
+        _tz_offset += _tz.dst_offset;
+}
+
+static int32_t _tz_offset_at(time_t time, int *isdst)
+{
+    if (!_tz_valid || (!_tz_forever && (time < _tz_from || time >= _tz_until)))
+        _tz_update(time);
+
+    if (isdst)
+        *isdst = _tz_isdst;
+    return _tz_offset;
+}
+
 void rcore_time_init(void)
 {
     struct tm *tm;
 
     /* Read the time out of the RTC, then convert to a time_t (ugh!), then
      * begin offsetting ticks in ms from there.  */
+    _now.valid = false;
     _boot_ticks = xTaskGetTickCount();
     boot_time_tm = tm = hw_get_time();
     _boot_time_t = rcore_mktime(tm);
@@ -33,14 +177,87 @@ void rcore_time_init(void)
     _boot_ticks = rcore_time_to_ticks(_boot_time_t, 0);
 }
 
+/* Local time in, UTC out. As with mktime, the tm is put right on the way:
+ * a tm_min of 90 comes back as the next hour and half past, with tm_wday,
+ * tm_yday and tm_isdst filled in. Not through rcore_localtime, as a time
+ * next week would take the place of now in its cache */
 time_t rcore_mktime(struct tm *tm)
 {
-    return mktime(tm);
+    long long local = __tm_to_secs(tm);
+    int isdst;
+
+    taskENTER_CRITICAL();
+    int32_t offset = _tz_offset_at(local - _tz.utc_offset, &isdst);
+    /* the hour that happens twice when DST ends: take their word for it */
+    if (tm->tm_isdst >= 0 && (tm->tm_isdst > 0) != isdst)
+    {
+        int32_t theirs = _tz.utc_offset + (tm->tm_isdst > 0 ? _tz.dst_offset : 0);
+        int32_t check = _tz_offset_at(local - theirs, &isdst);
+        if ((tm->tm_isdst > 0) == isdst)
+            offset = check;
+    }
+    time_t time = local - offset;
+    offset = _tz_offset_at(time, &isdst);
+    taskEXIT_CRITICAL();
+
+    __secs_to_tm((long long)time + offset, tm);
+    tm->tm_isdst = isdst;
+
+    return time;
 }
 
 void rcore_localtime(struct tm *tm, time_t time)
 {
-    localtime_r(&time, tm);
+    int isdst;
+
+    taskENTER_CRITICAL();
+    int32_t offset = _tz_offset_at(time, &isdst);
+    if (_now.valid && _now.offset == offset &&
+        time >= _now.time && time - _now.time < TIME_ADVANCE_MAX)
+    {
+        _tm_advance(&_now.tm, time - _now.time);
+        _now.time = time;
+        memcpy(tm, &_now.tm, sizeof(struct tm));
+        taskEXIT_CRITICAL();
+        return;
+    }
+    taskEXIT_CRITICAL();
+
+    __secs_to_tm((long long)time + offset, tm);
+    tm->tm_isdst = isdst;
+
+    /* only keep it if it's the new now, a look at the past doesn't count */
+    taskENTER_CRITICAL();
+    if (!_now.valid || time >= _now.time)
+    {
+        _now.time = time;
+        _now.offset = offset;
+        memcpy(&_now.tm, tm, sizeof(struct tm));
+        _now.valid = true;
+    }
+    taskEXIT_CRITICAL();
+}
+
+struct tm *rcore_pbl_localtime(time_t *time)
+{
+    static struct tm tm;
+    rcore_localtime(&tm, *time);
+    return &tm;
+}
+
+/*
+ * XXX Only the time cache test calls this for now. Until the phone's set
+ * time packet is decoded (process_set_time_packet) and the clock is kept
+ * in UTC, there is no timezone to set, and the RTC's time is taken as
+ * local with no offset, as it always was.
+ */
+void rcore_time_set_timezone(const RebbleTimezone *tz)
+{
+    taskENTER_CRITICAL();
+    memcpy(&_tz, tz, sizeof(RebbleTimezone));
+    _tz_valid = false;
+    _now.valid = false;
+    taskEXIT_CRITICAL();
 }
 
 uint16_t rcore_time_ms(time_t *tutc, uint16_t *ms)
@@ -116,21 +333,26 @@ int pbl_clock_is_24h_style()
 
 time_t clock_to_timestamp(WeekDay day, int hour, int minute)
 {
-    struct tm *time_now = rebble_time_get_tm();
-    uint8_t wday = time_now->tm_wday;
-    uint8_t dd = day - 1 - wday;
+    struct tm tm = *rebble_time_get_tm();
+    int now_min = tm.tm_hour * 60 + tm.tm_min;
+    int dd = 0;
 
-    if (dd < 0)
-        dd = 7 - dd;
+    /* the next one of that day, or today if it's that day */
+    if (day != TODAY)
+        dd = (day - 1 - tm.tm_wday + 7) % 7;
 
-    if (((int)day == 0 && hour < time_now->tm_hour) || // set to TODAY
-         (!dd && hour < time_now->tm_hour)) // logically today
-        dd += 7;
+    /* and if the time's been and gone, the next one after that */
+    if (dd == 0 && hour * 60 + minute <= now_min)
+        dd = day == TODAY ? 1 : 7;
 
-    uint32_t secs = (minute * 60) + (hour * 360) + (dd * 86400);
+    /* rcore_mktime carries it over the end of the month, and the DST change */
+    tm.tm_mday += dd;
+    tm.tm_hour = hour;
+    tm.tm_min = minute;
+    tm.tm_sec = 0;
+    tm.tm_isdst = -1;
 
-    time_now->tm_sec += secs;
-    return mktime(time_now);
+    return rcore_mktime(&tm);
 }
 
 double difftime(time_t end, time_t beginning)
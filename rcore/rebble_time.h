@@ -34,10 +34,26 @@ typedef enum {
 } TimeUnits;
 typedef void(*TickHandler)(struct tm *tick_time, TimeUnits units_changed);
 
+/* When DST starts or ends, as in a POSIX TZ "Mm.w.d/time" */
+typedef struct RebbleDstRule {
+    uint8_t month; /* 0 - 11 */
+    uint8_t week; /* 1 - 5, 5 being the last in the month */
+    uint8_t wday; /* 0 is Sunday */
+    uint32_t secs; /* after local midnight */
+} RebbleDstRule;
+
+typedef struct RebbleTimezone {
+    int32_t utc_offset; /* seconds east of UTC, in standard time */
+    int32_t dst_offset; /* added while DST is on, 0 if there isn't any */
+    RebbleDstRule dst_start; /* in local standard time */
+    RebbleDstRule dst_end; /* in local daylight time */
+} RebbleTimezone;
+
 void rcore_time_init(void);
 time_t rcore_mktime(struct tm *tm);
 void rcore_localtime(struct tm *tm, time_t time);
 struct tm *rcore_pbl_localtime(time_t *time);
+void rcore_time_set_timezone(const RebbleTimezone *tz);
 
 uint16_t rcore_time_ms(time_t *tutc, uint16_t *ms);
 TickType_t rcore_time_to_ticks(time_t t, uint16_t ms);
@@ -41,3 +41,15 @@ uint32_t map_range(uint32_t input, uint32_t input_start, uint32_t input_end, uin
         output = output_end;
     return output;
 }
+
+uint32_t fnv1a_hash(uint32_t hash, const void *data, size_t len)
+{
+    const uint8_t *p = data;
+
+    while (len--)
+    {
+        hash ^= *p++;
+        hash *= 16777619u;
+    }
+    return hash;
+}
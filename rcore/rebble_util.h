@@ -1,7 +1,14 @@
 #pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+/* FNV-1a. Start with FNV1A_INIT, or a hash so far to carry on from it */
+#define FNV1A_INIT 2166136261u
+
 void write_32(uint8_t *addr, int32_t val);
 int32_t read_32(uint8_t *addr);
 void delay_ms(uint32_t ms);
 uint32_t map_range(uint32_t input, uint32_t input_start, uint32_t input_end, uint32_t output_start, uint32_t output_end);
+uint32_t fnv1a_hash(uint32_t hash, const void *data, size_t len);
 
 #define MK_THUMB_CB(f) f = (void *)(((uint32_t)f) | 1);
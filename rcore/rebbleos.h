@@ -13,6 +13,7 @@
 #include <inttypes.h>
 #include "FreeRTOS.h"
 #include "rebble_memory.h"
+#include "memory_trace.h"
 #include "platform.h"
 #include "appmanager.h"
 #include "ambient.h"
@@ -41,12 +41,18 @@ void _app_timer_callback(CoreTimer *_timer)
 
 AppTimerHandle app_timer_register(uint32_t ms, AppTimerCallback cb, void *priv)
 {
-    AppTimer *timer = app_calloc(1, sizeof(AppTimer));
+    return app_timer_register_with_slack(ms, 0, cb, priv);
+}
+
+AppTimerHandle app_timer_register_with_slack(uint32_t ms, uint32_t slack_ms, AppTimerCallback cb, void *priv)
+{
+    AppTimer *timer = app_pool_calloc(ObjectPoolAppTimer, sizeof(AppTimer));
     
     if (!timer)
         return 0;
    
     timer->timer.when = xTaskGetTickCount() + pdMS_TO_TICKS(ms);
+    timer->timer.slack = pdMS_TO_TICKS(slack_ms);
     timer->timer.callback = _app_timer_callback;
     timer->cb = cb;
     timer->priv = priv;
@@ -85,36 +91,22 @@ void app_timer_cancel(AppTimerHandle timer_handle)
 }
 
 
+/* Only ours are AppTimers, everything else in the heap is someone else's */
+static bool _app_timer_match_id(CoreTimer *timer, void *context)
+{
+    return timer->callback == _app_timer_callback &&
+           ((AppTimer *)timer)->id == *(AppTimerHandle *)context;
+}
+
 AppTimer *_app_timer_get_by_id(AppTimerHandle id)
 {
     app_running_thread *_this_thread = appmanager_get_current_thread();
-    CoreTimer **tnext = &_this_thread->timer_head;
-
-    while (*tnext) {
-        if (((AppTimer *)(*tnext))->id == id) {
-            return (AppTimer *)*tnext;
-        }
-        tnext = &(*tnext)->next;
-    }
-    
-    return NULL;
+
+    return (AppTimer *)timer_heap_find(&_this_thread->timers, _app_timer_match_id, &id);
 }
 
 static uint16_t _timer = 0;
 uint16_t _app_timer_next_free_id(void)
 {
     return _timer++;
-    
-    app_running_thread *_this_thread = appmanager_get_current_thread();
-    CoreTimer **tnext = &_this_thread->timer_head;
-    uint16_t high = 0;
-    while (*tnext) {
-        if (((AppTimer *)(*tnext))->id > high)
-        {
-            high = ((AppTimer *)(*tnext))->id;
-        }
-        tnext = &(*tnext)->next;
-    }
-    
-    return high++;
 }
@@ -15,5 +15,7 @@ typedef uint16_t AppTimerHandle;
 typedef void (*AppTimerCallback)(void *priv);
 
 AppTimerHandle app_timer_register(uint32_t ms, AppTimerCallback cb, void *priv);
+/* As above, but it may fire up to slack_ms late if that lets it share a wakeup */
+AppTimerHandle app_timer_register_with_slack(uint32_t ms, uint32_t slack_ms, AppTimerCallback cb, void *priv);
 bool app_timer_reschedule(AppTimerHandle timer, uint32_t ms);
 void app_timer_cancel(AppTimerHandle timer);
@@ -0,0 +1,265 @@
+/* app_worker.c
+ * implementation of PebbleOS app workers, and the messages between them
+ * and their app
+ * libRebbleOS
+ */
+
+#include "librebble.h"
+#include "appmanager.h"
+#include "app_worker.h"
+
+/*
+ * The app and its worker talk through a channel each way: a ring of
+ * message slots with one thread putting messages in and the other taking
+ * them out, so neither needs a lock. A message is written straight into
+ * its slot, and the handler on the other side is handed the slot itself,
+ * so it is never copied on the way through.
+ *
+ * The receiving thread just gets a doorbell on its queue, and empties the
+ * ring when it answers it. Only one doorbell is ever outstanding, however
+ * many messages are waiting, so a chatty worker can't fill up the app's
+ * queue and crowd out its buttons and draws.
+ *
+ * The ring is bounded. The app never waits on a full one, its UI comes
+ * first, so anything it sends then is dropped. The worker waits for the
+ * app to catch up, a tick at a time, for a while before it drops too.
+ */
+
+#define WORKER_CHANNEL_SLOTS 16 /* a power of 2 */
+#define WORKER_CHANNEL_WAIT  pdMS_TO_TICKS(100)
+
+typedef struct WorkerChannelSlot {
+    uint16_t type;
+    AppWorkerMessage data;
+} WorkerChannelSlot;
+
+typedef struct WorkerChannel {
+    WorkerChannelSlot slots[WORKER_CHANNEL_SLOTS];
+    volatile uint32_t head; /* only the sender moves this on */
+    volatile uint32_t tail; /* only the receiver moves this on */
+    volatile bool doorbell; /* the receiver has one on its queue */
+    AppWorkerMessageHandler handler;
+    AppThreadType receiver;
+    AppWorkerStats stats;
+} WorkerChannel;
+
+static WorkerChannel _to_worker = { .receiver = AppThreadWorker };
+static WorkerChannel _to_app = { .receiver = AppThreadMainApp };
+
+/* The channel this thread reads from, NULL if it's neither app nor worker */
+static WorkerChannel *_channel_in(void)
+{
+    app_running_thread *thread = appmanager_get_current_thread();
+
+    if (thread && thread->thread_type == AppThreadMainApp)
+        return &_to_app;
+    if (thread && thread->thread_type == AppThreadWorker)
+        return &_to_worker;
+    return NULL;
+}
+
+/* and the one it sends on */
+static WorkerChannel *_channel_out(void)
+{
+    WorkerChannel *in = _channel_in();
+
+    if (in == NULL)
+        return NULL;
+    return in == &_to_app ? &_to_worker : &_to_app;
+}
+
+/* Is anyone there to read it, or about to be? */
+static bool _thread_running(app_running_thread *thread)
+{
+    return thread->status == AppThreadLoading ||
+           thread->status == AppThreadLoaded ||
+           thread->status == AppThreadRunloop;
+}
+
+static WorkerChannelSlot *_channel_reserve(WorkerChannel *channel)
+{
+    if (channel->head - channel->tail >= WORKER_CHANNEL_SLOTS)
+        return NULL;
+
+    return &channel->slots[channel->head & (WORKER_CHANNEL_SLOTS - 1)];
+}
+
+static void _channel_commit(WorkerChannel *channel)
+{
+    /* what's in the slot has to be there before the receiver can see it */
+    __sync_synchronize();
+    channel->head++;
+    channel->stats.sent++;
+}
+
+static void _channel_ring(WorkerChannel *channel)
+{
+    AppMessage am = { .command = APP_WORKER_MESSAGE };
+    bool posted;
+
+    if (channel->doorbell)
+        return;
+
+    channel->doorbell = true;
+    if (channel->receiver == AppThreadMainApp)
+        posted = appmanager_post_generic_app_message(&am, 0);
+    else
+        posted = appmanager_post_generic_worker_message(&am, 0);
+
+    /* they aren't in their runloop yet. They empty it when they get there */
+    if (!posted)
+        channel->doorbell = false;
+}
+
+/*
+ * Hand everything waiting for this thread to its handler. Called from the
+ * app's and worker's runloops when the doorbell goes
+ */
+void app_worker_message_deliver(void)
+{
+    WorkerChannel *channel = _channel_in();
+
+    if (channel == NULL)
+        return;
+
+    /* down first, so anything sent from here on rings again */
+    channel->doorbell = false;
+    __sync_synchronize();
+
+    while (channel->tail != channel->head)
+    {
+        WorkerChannelSlot *slot = &channel->slots[channel->tail & (WORKER_CHANNEL_SLOTS - 1)];
+
+        if (channel->handler)
+        {
+            channel->handler(slot->type, &slot->data);
+            channel->stats.delivered++;
+        }
+
+        /* finished with the slot, the sender can have it back */
+        __sync_synchronize();
+        channel->tail++;
+    }
+}
+
+/*
+ * A new app or worker is starting on this thread. Anything that was
+ * waiting for the last one goes, and so does its handler
+ */
+void app_worker_message_reset(void)
+{
+    WorkerChannel *channel = _channel_in();
+
+    if (channel == NULL)
+        return;
+
+    channel->handler = NULL;
+    channel->tail = channel->head;
+    channel->doorbell = false;
+}
+
+bool app_worker_message_subscribe(AppWorkerMessageHandler handler)
+{
+    WorkerChannel *channel = _channel_in();
+
+    if (channel == NULL)
+        return false;
+
+    channel->handler = handler;
+    return true;
+}
+
+bool app_worker_message_unsubscribe(void)
+{
+    return app_worker_message_subscribe(NULL);
+}
+
+void app_worker_send_message(uint8_t type, AppWorkerMessage *data)
+{
+    WorkerChannel *channel = _channel_out();
+    TickType_t give_up = xTaskGetTickCount() + WORKER_CHANNEL_WAIT;
+    WorkerChannelSlot *slot;
+
+    if (channel == NULL || data == NULL)
+        return;
+
+    /* nobody to send it to */
+    if (!_thread_running(appmanager_get_thread(channel->receiver)))
+        return;
+
+    while ((slot = _channel_reserve(channel)) == NULL)
+    {
+        if (channel->receiver == AppThreadWorker ||
+            TIMER_BEFORE(give_up, xTaskGetTickCount()))
+        {
+            channel->stats.dropped++;
+            return;
+        }
+
+        channel->stats.waits++;
+        _channel_ring(channel);
+        vTaskDelay(1);
+    }
+
+    slot->type = type;
+    slot->data = *data;
+    _channel_commit(channel);
+    _channel_ring(channel);
+}
+
+bool app_worker_is_running(void)
+{
+    app_running_thread *worker = appmanager_get_thread(AppThreadWorker);
+
+    return _thread_running(worker) && worker->app == appmanager_get_current_app();
+}
+
+/*
+ * Start the current app's worker. If another app's is running, Pebble
+ * would ask first. We don't have anything to ask with, so it's replaced
+ */
+AppWorkerResult app_worker_launch(void)
+{
+    App *app = appmanager_get_current_app();
+
+    if (app->worker_main == NULL && app->worker_file.size == 0)
+        return APP_WORKER_RESULT_NO_WORKER;
+
+    if (app_worker_is_running())
+        return APP_WORKER_RESULT_ALREADY_RUNNING;
+
+    appmanager_worker_start(app->name);
+    return APP_WORKER_RESULT_SUCCESS;
+}
+
+AppWorkerResult app_worker_kill(void)
+{
+    app_running_thread *worker = appmanager_get_thread(AppThreadWorker);
+
+    if (!_thread_running(worker))
+        return APP_WORKER_RESULT_NOT_RUNNING;
+
+    if (worker->app != appmanager_get_current_app())
+        return APP_WORKER_RESULT_DIFFERENT_APP;
+
+    appmanager_worker_quit();
+    return APP_WORKER_RESULT_SUCCESS;
+}
+
+/*
+ * From the worker, bring its app up in the foreground
+ */
+void worker_launch_app(void)
+{
+    appmanager_app_start(appmanager_get_current_app()->name);
+}
+
+void app_worker_get_stats(AppWorkerStats *to_worker, AppWorkerStats *to_app)
+{
+    taskENTER_CRITICAL();
+    if (to_worker)
+        memcpy(to_worker, &_to_worker.stats, sizeof(AppWorkerStats));
+    if (to_app)
+        memcpy(to_app, &_to_app.stats, sizeof(AppWorkerStats));
+    taskEXIT_CRITICAL();
+}
@@ -0,0 +1,43 @@
+#pragma once
+/* app_worker.h
+ * routines for launching an app's background worker, and talking to it
+ * libRebbleOS
+ */
+
+typedef struct AppWorkerMessage {
+    uint16_t data0;
+    uint16_t data1;
+    uint16_t data2;
+} AppWorkerMessage;
+
+typedef void (*AppWorkerMessageHandler)(uint16_t type, AppWorkerMessage *data);
+
+typedef enum AppWorkerResult {
+    APP_WORKER_RESULT_SUCCESS = 0,
+    APP_WORKER_RESULT_NO_WORKER = 1,
+    APP_WORKER_RESULT_DIFFERENT_APP = 2,
+    APP_WORKER_RESULT_NOT_RUNNING = 3,
+    APP_WORKER_RESULT_ALREADY_RUNNING = 4,
+    APP_WORKER_RESULT_ASKING_CONFIRMATION = 5,
+} AppWorkerResult;
+
+/* What the channel each way has carried, since boot */
+typedef struct AppWorkerStats {
+    uint32_t sent; /* messages put in the channel */
+    uint32_t delivered; /* messages handed to a handler */
+    uint32_t dropped; /* messages the channel was too full for */
+    uint32_t waits; /* times the worker had to wait for the app to catch up */
+} AppWorkerStats;
+
+AppWorkerResult app_worker_launch(void);
+AppWorkerResult app_worker_kill(void);
+bool app_worker_is_running(void);
+bool app_worker_message_subscribe(AppWorkerMessageHandler handler);
+bool app_worker_message_unsubscribe(void);
+void app_worker_send_message(uint8_t type, AppWorkerMessage *data);
+void worker_launch_app(void);
+void worker_event_loop(void);
+
+void app_worker_message_deliver(void);
+void app_worker_message_reset(void);
+void app_worker_get_stats(AppWorkerStats *to_worker, AppWorkerStats *to_app);
@@ -8,62 +8,75 @@
 #include "librebble.h"
 #include "appmanager.h"
 
+/*
+ * Each thread (app, overlay, worker) gets its own subscription, with its
+ * timer in its own queue so the handler runs on the right thread. They all
+ * aim for the same tick, right on the wall clock's second (or minute, or
+ * hour), so they share the one wakeup. The wall clock runs off the tick
+ * count, so working the boundary out in ticks means there is nothing to
+ * drift.
+ */
+
 typedef struct TickTimerState {
     CoreTimer timer; /* must be at the start of the struct! */
     int onqueue;
     TimeUnits units;
     TickHandler handler;
+    time_t last;
     struct tm lasttm;
 } TickTimerState;
 
-/* XXX: this should probably be per-app.  oh, well */
-static TickTimerState _state = {.onqueue = 0};
+/* The broken-down time for the last second anyone ticked over on. Whoever
+ * gets there first works it out, everyone else copies it */
+static time_t _tick_time = -1;
+static struct tm _tick_tm;
+static TickTimerStats _stats;
+static TickType_t _last_when;
 
 static void _tick_timer_callback(CoreTimer *timer);
 
-/* Updates the timer interval to fire for the next smallest requested unit,
- * then add to the timer queue.  */
+static void _tick_timer_get_tm(time_t time, struct tm *tm)
+{
+    bool cached;
+
+    taskENTER_CRITICAL();
+    cached = (time == _tick_time);
+    if (cached)
+        memcpy(tm, &_tick_tm, sizeof(struct tm));
+    taskEXIT_CRITICAL();
+
+    if (cached)
+        return;
+
+    rcore_localtime(tm, time);
+
+    taskENTER_CRITICAL();
+    _tick_time = time;
+    memcpy(&_tick_tm, tm, sizeof(struct tm));
+    _stats.conversions++;
+    taskEXIT_CRITICAL();
+}
+
+/* Queues the timer for the start of the next smallest requested unit */
 static void _tick_timer_update_next(TickTimerState *state)
 {
+    uint32_t secs;
+
     if (state->onqueue) {
         appmanager_timer_remove(&state->timer);
     }
-    
-    /* Figure out the desired time. */
-    time_t dtime;
-    struct tm nexttm;
-    
-    dtime = rcore_mktime(&state->lasttm);
 
     if (state->units & SECOND_UNIT) {
-        dtime = dtime + 1;
+        secs = 1;
     } else if (state->units & MINUTE_UNIT) {
-        dtime = dtime + 60;
-
-        rcore_localtime(&nexttm, dtime);
-        nexttm.tm_sec = 0;
-        dtime = rcore_mktime(&nexttm);
-    } else if (state->units & (HOUR_UNIT | DAY_UNIT | MONTH_UNIT | YEAR_UNIT)) {
+        secs = 60 - state->lasttm.tm_sec;
+    } else {
         /* Everyone else gets woken up hourly, and we'll just cancel it
          * later if it wasn't requested.  */
-        dtime = dtime + 60 * 60;
-
-        rcore_localtime(&nexttm, dtime);
-        nexttm.tm_min = nexttm.tm_sec = 0;
-        dtime = rcore_mktime(&nexttm);
+        secs = 60 * 60 - (state->lasttm.tm_min * 60 + state->lasttm.tm_sec);
     }
-    uint32_t when = rcore_time_to_ticks(dtime, 0);
-TickType_t now = xTaskGetTickCount();
-    SYS_LOG("tick", APP_LOG_LEVEL_INFO, "dtime %ld, when %d, now %d", dtime, when, now);
-    /* if it seems like we need to add no time, its likely becuase
-     * this timer is slight ms offset with wall rtc time.
-     * To stop it spamming the timer by repeatedly adding itself to the front
-     * until it catches it, increment by 2ms 
-     * TODO if we drift a lot, 1) why 2) resync rtc
-     */
-    if (when == 0)
-        when = 2;
-    state->timer.when = when;
+
+    state->timer.when = rcore_time_to_ticks(state->last + secs, 0);
     state->timer.callback = _tick_timer_callback;
     appmanager_timer_add(&state->timer);
     state->onqueue = 1;
@@ -72,15 +85,25 @@ TickType_t now = xTaskGetTickCount();
 static void _tick_timer_callback(CoreTimer *timer)
 {
     TickTimerState *state = (TickTimerState *) timer;
-    
+    TickType_t late = xTaskGetTickCount() - timer->when;
+
     time_t time;
     struct tm tm;
-    
+
     state->onqueue = 0;
-    
+
+    taskENTER_CRITICAL();
+    _stats.deliveries++;
+    if (timer->when != _last_when)
+        _stats.wakeups++;
+    _last_when = timer->when;
+    if (late > _stats.worst_late)
+        _stats.worst_late = late;
+    taskEXIT_CRITICAL();
+
     rcore_time_ms(&time, NULL);
-    rcore_localtime(&tm, time);
-    
+    _tick_timer_get_tm(time, &tm);
+
     TimeUnits units = 0;
     /* XXX: Does a real pebbleos return a bitmask, or only the MSB? */
     if (tm.tm_sec != state->lasttm.tm_sec) units |= SECOND_UNIT;
@@ -92,36 +115,55 @@ static void _tick_timer_callback(CoreTimer *timer)
 
     /* Update before we call in -- otherwise, they could unsubscribe, and
      * we'd just blissfully readd ourselves to the queue.  */
+    state->last = time;
     memcpy(&state->lasttm, &tm, sizeof(tm));
     _tick_timer_update_next(state);
-    
+
     if (units & state->units)
         state->handler(&tm, units);
 }
 
 void tick_timer_service_subscribe(TimeUnits tick_units, TickHandler handler)
 {
-    TickTimerState *state = &_state;
+    app_running_thread *thread = appmanager_get_current_thread();
+    TickTimerState *state = thread->tick_timer;
+
+    if (!state)
+    {
+        state = app_calloc(1, sizeof(TickTimerState));
+        if (!state)
+            return;
+        thread->tick_timer = state;
+    }
+
+    rcore_time_ms(&state->last, NULL);
+    _tick_timer_get_tm(state->last, &state->lasttm);
 
-    time_t time;
-    
-    rcore_time_ms(&time, NULL);
-    rcore_localtime(&state->lasttm, time);
-    
     state->units = tick_units;
     state->handler = handler;
-    
+
     _tick_timer_update_next(state);
 }
 
 void tick_timer_service_unsubscribe(void)
 {
-    TickTimerState *state = &_state;
-    
+    app_running_thread *thread = appmanager_get_current_thread();
+    TickTimerState *state = thread->tick_timer;
+
+    if (!state)
+        return;
+
     if (state->onqueue) {
         appmanager_timer_remove(&state->timer);
-        state->onqueue = 0;
     }
-}
 
+    thread->tick_timer = NULL;
+    app_free(state);
+}
 
+void tick_timer_service_get_stats(TickTimerStats *stats)
+{
+    taskENTER_CRITICAL();
+    memcpy(stats, &_stats, sizeof(TickTimerStats));
+    taskEXIT_CRITICAL();
+}
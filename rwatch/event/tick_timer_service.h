@@ -6,5 +6,14 @@
  * Author: Barry Carter <barry.carter@gmail.com>
  */
 
+/* What every thread's subscription has cost, since boot */
+typedef struct TickTimerStats {
+    uint32_t wakeups; /* separate ticks anyone was called back on */
+    uint32_t deliveries; /* times any subscriber was called back */
+    uint32_t conversions; /* times we had to work out a struct tm */
+    TickType_t worst_late; /* furthest a callback has been behind its boundary */
+} TickTimerStats;
+
 void tick_timer_service_subscribe(TimeUnits tick_units, TickHandler handler);
 void tick_timer_service_unsubscribe(void);
+void tick_timer_service_get_stats(TickTimerStats *stats);
@@ -0,0 +1,449 @@
+/* text_layout.c
+ * routines for laying out text once and drawing it many times
+ * libRebbleOS
+ */
+
+#include "librebble.h"
+#include "utils.h"
+#include "rebble_util.h"
+
+/* Configure Logging */
+#define MODULE_NAME "txtlay"
+#define MODULE_TYPE "SYS"
+#define LOG_LEVEL RBL_LOG_LEVEL_ERROR
+
+/* a box big enough that measuring a single word never wraps it */
+#define TEXT_LAYOUT_MEASURE_BOX GRect(0, 0, 1000, 1000)
+/* longest run of text measured or drawn in one go, and so the longest line */
+#define TEXT_LAYOUT_RUN_MAX 128
+/* lines are grown this many at a time */
+#define TEXT_LAYOUT_LINE_CHUNK 8
+/* extra room on each line's box, so ngfx never decides to wrap it again */
+#define TEXT_LAYOUT_WRAP_SLACK 16
+
+static uint32_t _text_layout_hash(const char *text, size_t length);
+static int16_t _text_layout_measure(const char *text, uint16_t length, GFont font);
+static bool _text_layout_add_line(GTextLayoutCache *layout, uint16_t start, uint16_t length,
+                                  int16_t width, bool store);
+static bool _text_layout_build(GTextLayoutCache *layout, const char *text, GFont font,
+                               GSize box_size, bool store);
+static bool _text_layout_update(GTextLayoutCache *layout, const char *text, GFont font,
+                                GSize box_size, GTextOverflowMode overflow_mode);
+
+void text_layout_cache_ctor(GTextLayoutCache *layout)
+{
+    memset(layout, 0, sizeof(GTextLayoutCache));
+}
+
+void text_layout_cache_dtor(GTextLayoutCache *layout)
+{
+    if (layout->lines)
+        app_free(layout->lines);
+    layout->lines = NULL;
+    layout->line_alloc = 0;
+    layout->valid = false;
+}
+
+GTextLayoutCache *text_layout_cache_create(void)
+{
+    GTextLayoutCache *layout = app_calloc(1, sizeof(GTextLayoutCache));
+    if (layout == NULL)
+    {
+        LOG_ERROR("No memory for text layout");
+        return NULL;
+    }
+
+    text_layout_cache_ctor(layout);
+    return layout;
+}
+
+void text_layout_cache_destroy(GTextLayoutCache *layout)
+{
+    if (!layout)
+        return;
+
+    text_layout_cache_dtor(layout);
+    app_free(layout);
+}
+
+/*
+ * Throw the lines away next time round, for when something the key
+ * doesn't cover (a font reloaded at the same address) has changed.
+ */
+void text_layout_cache_invalidate(GTextLayoutCache *layout)
+{
+    if (layout)
+        layout->valid = false;
+}
+
+GSize text_layout_cache_get_content_size(GTextLayoutCache *layout, const char *text, GFont font,
+                                         GRect box, GTextOverflowMode overflow_mode)
+{
+    if (!text || !font)
+        return GSize(0, 0);
+
+    if (!layout)
+        return graphics_text_layout_get_content_size(text, font, box, overflow_mode, GTextAlignmentLeft);
+
+    _text_layout_update(layout, text, font, box.size, overflow_mode);
+    return layout->content_size;
+}
+
+/*
+ * Draw the text from its cached lines. Only lines that land on the
+ * screen are drawn, each as a single line that ngfx has nothing left
+ * to wrap, so a long body scrolled mostly out of view costs a couple
+ * of lines rather than the whole lot.
+ */
+void text_layout_cache_draw(GContext *ctx, GTextLayoutCache *layout, const char *text, GFont font,
+                            GRect box, GTextOverflowMode overflow_mode,
+                            GTextAlignment alignment, GTextAttributes *text_attributes)
+{
+    char run[TEXT_LAYOUT_RUN_MAX + 1];
+
+    if (!text || !font)
+        return;
+
+    if (!layout || !_text_layout_update(layout, text, font, box.size, overflow_mode))
+    {
+        /* no layout to be had, let ngfx do the lot */
+        graphics_draw_text(ctx, text, font, box, overflow_mode, alignment, text_attributes);
+        return;
+    }
+
+    int16_t line_height = layout->line_height;
+
+    for (uint16_t i = 0; i < layout->line_count; i++)
+    {
+        GTextLayoutLine *line = &layout->lines[i];
+        int16_t y = box.origin.y + i * line_height;
+        int16_t screen_y = ctx->offset.origin.y + y;
+
+        if (screen_y + line_height <= 0)
+            continue;
+        if (screen_y >= DISPLAY_ROWS)
+            break;
+
+        if (layout->truncated && i == layout->line_count - 1 &&
+            overflow_mode == GTextOverflowModeTrailingEllipsis)
+        {
+            /* ngfx knows where the ellipsis goes on the last line */
+            graphics_draw_text(ctx, text + line->start, font,
+                               GRect(box.origin.x, y, box.size.w, line_height),
+                               overflow_mode, alignment, text_attributes);
+            continue;
+        }
+
+        if (line->length == 0)
+            continue;
+
+        int16_t x = box.origin.x;
+        if (alignment == GTextAlignmentCenter)
+            x += (box.size.w - line->width) / 2;
+        else if (alignment == GTextAlignmentRight)
+            x += box.size.w - line->width;
+
+        memcpy(run, text + line->start, line->length);
+        run[line->length] = '\0';
+        graphics_draw_text(ctx, run, font,
+                           GRect(x, y, line->width + TEXT_LAYOUT_WRAP_SLACK, line_height),
+                           GTextOverflowModeWordWrap, GTextAlignmentLeft, text_attributes);
+    }
+}
+
+GSize graphics_text_layout_get_content_size(const char *text, GFont font, GRect box,
+                                            GTextOverflowMode overflow_mode,
+                                            GTextAlignment alignment)
+{
+    GTextLayoutCache layout;
+
+    if (!text || !font)
+        return GSize(0, 0);
+
+    /* just the size, no need to keep the lines */
+    text_layout_cache_ctor(&layout);
+    _text_layout_build(&layout, text, font, box.size, false);
+    return layout.content_size;
+}
+
+GSize graphics_text_layout_get_content_size_with_attributes(const char *text, GFont font, GRect box,
+                                                            GTextOverflowMode overflow_mode,
+                                                            GTextAlignment alignment,
+                                                            GTextAttributes *text_attributes)
+{
+    return graphics_text_layout_get_content_size(text, font, box, overflow_mode, alignment);
+}
+
+/* SDK 2 name for the above, optionally with a cache to reuse */
+GSize graphics_text_layout_get_max_used_size(GContext *ctx, const char *text, GFont font, GRect box,
+                                             GTextOverflowMode overflow_mode,
+                                             GTextAlignment alignment, GTextLayoutCacheRef layout)
+{
+    return text_layout_cache_get_content_size(layout, text, font, box, overflow_mode);
+}
+
+/*
+ * Text attributes.
+ * ngfx doesn't flow text around the round display or page it yet, so the
+ * settings are kept for when it does, and the text is drawn wrapped to
+ * its box. Every GTextAttributes an app has came from
+ * graphics_text_attributes_create, so it's always a GTextAttributesExt.
+ */
+GTextAttributes *graphics_text_attributes_create(void)
+{
+    GTextAttributesExt *ext = app_calloc(1, sizeof(GTextAttributesExt));
+    if (ext == NULL)
+    {
+        LOG_ERROR("No memory for text attributes");
+        return NULL;
+    }
+
+    return &ext->attributes;
+}
+
+void graphics_text_attributes_destroy(GTextAttributes *text_attributes)
+{
+    if (text_attributes)
+        app_free(text_attributes);
+}
+
+void graphics_text_attributes_restore_default_text_flow(GTextAttributes *text_attributes)
+{
+    GTextAttributesExt *ext = (GTextAttributesExt *)text_attributes;
+
+    if (!ext)
+        return;
+
+    ext->flow_enabled = false;
+    ext->flow_inset = 0;
+}
+
+void graphics_text_attributes_enable_screen_text_flow(GTextAttributes *text_attributes, uint8_t inset)
+{
+    GTextAttributesExt *ext = (GTextAttributesExt *)text_attributes;
+
+    if (!ext)
+        return;
+
+    ext->flow_enabled = true;
+    ext->flow_inset = inset;
+}
+
+void graphics_text_attributes_restore_default_paging(GTextAttributes *text_attributes)
+{
+    GTextAttributesExt *ext = (GTextAttributesExt *)text_attributes;
+
+    if (!ext)
+        return;
+
+    ext->paging_enabled = false;
+    ext->content_origin_on_screen = GPoint(0, 0);
+    ext->paging_on_screen = GRect(0, 0, 0, 0);
+}
+
+void graphics_text_attributes_enable_paging(GTextAttributes *text_attributes,
+                                           GPoint content_origin_on_screen, GRect paging_on_screen)
+{
+    GTextAttributesExt *ext = (GTextAttributesExt *)text_attributes;
+
+    if (!ext)
+        return;
+
+    ext->paging_enabled = true;
+    ext->content_origin_on_screen = content_origin_on_screen;
+    ext->paging_on_screen = paging_on_screen;
+}
+
+/* Private functions */
+
+/* Catches the same text turning up somewhere else */
+static uint32_t _text_layout_hash(const char *text, size_t length)
+{
+    return fnv1a_hash(FNV1A_INIT, text, length);
+}
+
+static int16_t _text_layout_measure(const char *text, uint16_t length, GFont font)
+{
+    char run[TEXT_LAYOUT_RUN_MAX + 1];
+
+    if (length == 0)
+        return 0;
+
+    length = MIN(length, TEXT_LAYOUT_RUN_MAX);
+    memcpy(run, text, length);
+    run[length] = '\0';
+
+    return n_graphics_text_layout_get_content_size(run, font, TEXT_LAYOUT_MEASURE_BOX,
+                                                   GTextOverflowModeWordWrap, GTextAlignmentLeft).w;
+}
+
+static bool _text_layout_add_line(GTextLayoutCache *layout, uint16_t start, uint16_t length,
+                                  int16_t width, bool store)
+{
+    if (store)
+    {
+        if (layout->line_count == layout->line_alloc)
+        {
+            GTextLayoutLine *lines = app_realloc(layout->lines,
+                (layout->line_alloc + TEXT_LAYOUT_LINE_CHUNK) * sizeof(GTextLayoutLine));
+            if (!lines)
+            {
+                LOG_ERROR("No memory for text layout lines");
+                return false;
+            }
+            layout->lines = lines;
+            layout->line_alloc += TEXT_LAYOUT_LINE_CHUNK;
+        }
+
+        layout->lines[layout->line_count] = (GTextLayoutLine) {
+            .start = start,
+            .length = length,
+            .width = width,
+        };
+    }
+
+    layout->line_count++;
+    layout->content_size.w = MAX(layout->content_size.w, width);
+    return true;
+}
+
+/*
+ * Break the text into lines that fit the box, measuring a word at a
+ * time. Words that don't fit go to the next line, and a word wider than
+ * the whole box is broken wherever it fills the line. Explicit newlines
+ * always start a new line. Lines past the bottom of the box are dropped
+ * and the layout is marked truncated.
+ * With store unset only the size is worked out.
+ */
+static bool _text_layout_build(GTextLayoutCache *layout, const char *text, GFont font,
+                               GSize box_size, bool store)
+{
+    int16_t x_w = _text_layout_measure("x", 1, font);
+    int16_t space_w = _text_layout_measure("x x", 3, font) - (2 * x_w);
+    uint8_t line_height = font->line_height;
+    uint16_t max_lines = line_height ? MAX(1, box_size.h / line_height) : 1;
+    uint16_t pos = 0;
+
+    layout->line_height = line_height;
+    layout->line_count = 0;
+    layout->truncated = false;
+    layout->content_size = GSize(0, 0);
+
+    while (text[pos])
+    {
+        if (layout->line_count == max_lines)
+        {
+            layout->truncated = true;
+            break;
+        }
+
+        uint16_t start = pos;
+        uint16_t end = pos;
+        int16_t width = 0;
+        bool has_word = false;
+
+        for (;;)
+        {
+            uint16_t spaces = pos;
+            while (text[pos] == ' ')
+                pos++;
+            spaces = pos - spaces;
+
+            if (text[pos] == '\n')
+            {
+                pos++;
+                break;
+            }
+            if (text[pos] == '\0')
+                break;
+
+            uint16_t word = pos;
+            while (text[pos] && text[pos] != ' ' && text[pos] != '\n')
+                pos++;
+
+            int16_t gap = spaces * space_w;
+            int16_t word_w = (pos - word > TEXT_LAYOUT_RUN_MAX) ?
+                                INT16_MAX : _text_layout_measure(text + word, pos - word, font);
+
+            if (word_w != INT16_MAX && width + gap + word_w <= box_size.w &&
+                pos - start <= TEXT_LAYOUT_RUN_MAX)
+            {
+                width += gap + word_w;
+                end = pos;
+                has_word = true;
+                continue;
+            }
+
+            if (has_word)
+            {
+                /* starts the next line, less the spaces before it */
+                pos = word;
+                break;
+            }
+
+            /* too wide for a line of its own, take as much as fits */
+            width += gap;
+            pos = word;
+            while (text[pos] && text[pos] != ' ' && text[pos] != '\n')
+            {
+                uint16_t next = pos + 1;
+                while ((text[next] & 0xC0) == 0x80)
+                    next++;
+
+                int16_t char_w = _text_layout_measure(text + pos, next - pos, font);
+                /* always at least one character, or we never get anywhere */
+                if (pos > word && (width + char_w > box_size.w || next - start > TEXT_LAYOUT_RUN_MAX))
+                    break;
+
+                width += char_w;
+                pos = next;
+            }
+            end = pos;
+            break;
+        }
+
+        if (!_text_layout_add_line(layout, start, end - start, width, store))
+            return false;
+    }
+
+    layout->content_size.h = layout->line_count * line_height;
+    return true;
+}
+
+/*
+ * Only hashes the text when its pointer or length has changed, so a long
+ * body drawn over and over costs a strlen, not a pass of FNV each time.
+ * The same text at a new address keeps its lines.
+ */
+static bool _text_layout_update(GTextLayoutCache *layout, const char *text, GFont font,
+                                GSize box_size, GTextOverflowMode overflow_mode)
+{
+    size_t length = strlen(text);
+    bool same_key = layout->valid &&
+                    layout->font == font &&
+                    layout->box_size.w == box_size.w &&
+                    layout->box_size.h == box_size.h &&
+                    layout->overflow_mode == overflow_mode;
+
+    if (same_key && layout->text == text && layout->text_length == length)
+        return true;
+
+    uint32_t hash = _text_layout_hash(text, length);
+    if (same_key && layout->text_length == length && layout->text_hash == hash)
+    {
+        layout->text = text;
+        return true;
+    }
+
+    LOG_DEBUG("relayout %d bytes", length);
+
+    layout->text = text;
+    layout->text_length = length;
+    layout->text_hash = hash;
+    layout->font = font;
+    layout->box_size = box_size;
+    layout->overflow_mode = overflow_mode;
+    layout->valid = _text_layout_build(layout, text, font, box_size, true);
+
+    return layout->valid;
+}
@@ -0,0 +1,90 @@
+#pragma once
+/* text_layout.h
+ * routines for laying out text once and drawing it many times
+ * libRebbleOS
+ */
+
+/* One wrapped line, as a byte range of the text it was laid out from */
+typedef struct GTextLayoutLine
+{
+    uint16_t start;
+    uint16_t length;
+    int16_t width;
+} GTextLayoutLine;
+
+/*
+ * The line breaks for a piece of text in a given font and box.
+ * Kept until any of the text (pointer or length), font, box size or
+ * overflow mode change, so redrawing or moving the text doesn't have
+ * to measure and wrap it all over again. Text rewritten in place to
+ * the same length isn't noticed: call text_layout_cache_invalidate
+ * (text_layer_set_text does).
+ */
+typedef struct GTextLayoutCache
+{
+    /* what the lines were laid out for */
+    const char *text;
+    size_t text_length;
+    uint32_t text_hash;
+    GFont font;
+    GSize box_size;
+    GTextOverflowMode overflow_mode;
+    bool valid;
+
+    /* and what came out */
+    GSize content_size;
+    uint8_t line_height;
+    bool truncated;
+    uint16_t line_count;
+    uint16_t line_alloc;
+    GTextLayoutLine *lines;
+} GTextLayoutCache;
+
+typedef GTextLayoutCache *GTextLayoutCacheRef;
+
+/*
+ * What graphics_text_attributes_create hands out: ngfx's attributes, then
+ * the screen text flow and paging settings, which ngfx has nowhere to keep.
+ * ngfx doesn't flow or page text yet, so for now they are only kept.
+ */
+typedef struct GTextAttributesExt
+{
+    GTextAttributes attributes;
+
+    bool flow_enabled;
+    uint8_t flow_inset;
+
+    bool paging_enabled;
+    GPoint content_origin_on_screen;
+    GRect paging_on_screen;
+} GTextAttributesExt;
+
+void text_layout_cache_ctor(GTextLayoutCache *layout);
+void text_layout_cache_dtor(GTextLayoutCache *layout);
+GTextLayoutCache *text_layout_cache_create(void);
+void text_layout_cache_destroy(GTextLayoutCache *layout);
+void text_layout_cache_invalidate(GTextLayoutCache *layout);
+GSize text_layout_cache_get_content_size(GTextLayoutCache *layout, const char *text, GFont font,
+                                         GRect box, GTextOverflowMode overflow_mode);
+void text_layout_cache_draw(GContext *ctx, GTextLayoutCache *layout, const char *text, GFont font,
+                            GRect box, GTextOverflowMode overflow_mode,
+                            GTextAlignment alignment, GTextAttributes *text_attributes);
+
+GSize graphics_text_layout_get_content_size(const char *text, GFont font, GRect box,
+                                            GTextOverflowMode overflow_mode,
+                                            GTextAlignment alignment);
+GSize graphics_text_layout_get_content_size_with_attributes(const char *text, GFont font, GRect box,
+                                                            GTextOverflowMode overflow_mode,
+                                                            GTextAlignment alignment,
+                                                            GTextAttributes *text_attributes);
+GSize graphics_text_layout_get_max_used_size(GContext *ctx, const char *text, GFont font, GRect box,
+                                             GTextOverflowMode overflow_mode,
+                                             GTextAlignment alignment, GTextLayoutCacheRef layout);
+
+GTextAttributes *graphics_text_attributes_create(void);
+void graphics_text_attributes_destroy(GTextAttributes *text_attributes);
+void graphics_text_attributes_restore_default_text_flow(GTextAttributes *text_attributes);
+void graphics_text_attributes_enable_screen_text_flow(GTextAttributes *text_attributes, uint8_t inset);
+void graphics_text_attributes_restore_default_paging(GTextAttributes *text_attributes);
+void graphics_text_attributes_enable_paging(GTextAttributes *text_attributes,
+                                           GPoint content_origin_on_screen, GRect paging_on_screen);
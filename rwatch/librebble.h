@@ -31,6 +31,7 @@
 #include "graphics_context.h"
 #include "graphics_resource.h"
 #include "graphics_wrapper.h"
+#include "text_layout.h"
 #include "bitmap_layer.h"
 #include "text_layer.h"
 #include "scroll_layer.h"
@@ -51,6 +52,7 @@
 #include "app_timer.h"
 #include "font_loader.h"
 #include "connection_service.h"
+#include "app_worker.h"
 
 void rbl_draw(void);
 struct tm *rbl_get_tm(void);
@@ -70,7 +70,9 @@
 
 // text redefines
 #define GTextOverflowMode n_GTextOverflowMode
+#define GTextOverflowModeWordWrap n_GTextOverflowModeWordWrap
 #define GTextOverflowModeTrailingEllipsis n_GTextOverflowModeTrailingEllipsis
+#define GTextOverflowModeFill n_GTextOverflowModeFill
 #define GFont n_GFont
 #define GTextAlignment n_GTextAlignment
 #define GTextAlignmentLeft n_GTextAlignmentLeft
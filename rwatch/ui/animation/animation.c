@@ -30,6 +30,13 @@
  * We save the few bytes of memory by not requiring this, and instead 
  * traversing the linked list to the head/tail.
  * 
+ * Running animations don't get a timer each. Every thread has one
+ * animation clock, and every animation running on that thread hangs off
+ * it. Once a frame the clock steps them all, and because that is only one
+ * timer expiry, the runloop only asks for one redraw for the lot.
+ * anim->timer.when is still when the animation is next due, the clock
+ * just looks at it instead of the thread's timer list.
+ * 
  * TODO
  * Infinite counts dont really work. No time spent on infinite sequences
  * Set elapsed on complex sequence spawns is not implemented
@@ -39,6 +46,7 @@
 #include "appmanager.h"
 #include "FreeRTOS.h"
 #include "property_animation.h"
+#include "animation_curves.h"
 
 /* Configure Logging */
 #define MODULE_NAME "anim"
@@ -51,6 +59,30 @@
 
 static Animation *_animation_play_next(Animation *anim);
 static void _animation_update(Animation *anim);
+static void _animation_clock_add(Animation *anim);
+static void _animation_clock_remove(Animation *anim);
+
+/* One per thread, it steps every animation running on it */
+typedef struct AnimationClock
+{
+    CoreTimer timer;
+    list_head animations;
+    bool armed;
+    bool ticking;
+} AnimationClock;
+
+/* The eased curves, sampled at build time. Anything not in here is linear */
+static const int32_t *const _curve_tables[] = {
+    [AnimationCurveEaseIn] = animation_curve_ease_in,
+    [AnimationCurveEaseOut] = animation_curve_ease_out,
+    [AnimationCurveEaseInOut] = animation_curve_ease_in_out,
+    [AnimationCurveCubicEase] = animation_curve_cubic_ease,
+    [AnimationCurveCubicEaseIn] = animation_curve_cubic_ease_in,
+    [AnimationCurveCubicEaseOut] = animation_curve_cubic_ease_out,
+    [AnimationCurveCubicEaseInOut] = animation_curve_cubic_ease_in_out,
+    [AnimationCurveOvershoot] = animation_curve_overshoot,
+    [AnimationCurveSpring] = animation_curve_spring,
+};
 
 /* XXX: The memory allocation story here is kind of a mess.  We do an
  * app_malloc on this, and store a bunch of state in the application's
@@ -67,7 +99,7 @@ static void _animation_update(Animation *anim);
 
 Animation *animation_create()
 {
-    Animation *anim = app_calloc(1, sizeof(Animation));
+    Animation *anim = app_pool_calloc(ObjectPoolAnimation, sizeof(Animation));
     if (!anim) {
         LOG_ERROR("No Memory");
         return NULL;
@@ -82,6 +114,7 @@ void animation_ctor(Animation* animation)
 {
     list_init_node(&animation->sequence_node);
     list_init_node(&animation->sequence_head);
+    list_init_node(&animation->clock_node);
     animation->playcount = 1;
     animation->playcount_count = 0;
     animation->curve = AnimationCurveEaseInOut;
@@ -103,6 +136,7 @@ bool animation_destroy(Animation *anim)
 
 void animation_dtor(Animation* animation)
 {
+    _animation_clock_remove(animation);
 }
 
 /* We use a double linked list from nose_list.h, but only the structure.
@@ -290,12 +324,11 @@ static void _animation_complete(Animation *anim)
 /* Update logic. This deals with a timer that has expired, or needs to be executed */
 static void _animation_update(Animation *anim)
 {
-    if (anim->onqueue)
-        appmanager_timer_remove(&anim->timer);
+    _animation_clock_remove(anim);
 
-    anim->onqueue = 0;
     TickType_t now = xTaskGetTickCount();
-    TickType_t progress = now - anim->startticks;
+    /* the clock may step us a touch before a delay is up */
+    TickType_t elapsed = TIMER_BEFORE(now, anim->startticks) ? 0 : now - anim->startticks;
 
     if (anim->duration == ANIMATION_DURATION_INFINITE) 
     {
@@ -305,11 +338,11 @@ static void _animation_update(Animation *anim)
             return;
         }
         anim->timer.when = now + ANIMATION_TICKS;
-        appmanager_timer_add(&anim->timer);
+        _animation_clock_add(anim);
         return;
     }
 
-    if (progress > anim->duration) {
+    if (elapsed > anim->duration) {
         /* We are done */
         LOG_DEBUG("[%x] Animation Progress Done", anim);
 
@@ -317,8 +350,9 @@ static void _animation_update(Animation *anim)
         return;
     }
     anim->timer.when = now + ANIMATION_TICKS;
-    progress *= ANIMATION_NORMALIZED_MAX;
-    progress /= anim->duration;
+    /* elapsed <= duration, so this can't overflow. The divide was done
+     * once, when the duration was set */
+    AnimationProgress progress = ((uint32_t)elapsed * anim->progress_scale) >> 16;
 
     /* deal with the animation being reversed */
     /* If the sequence is reversed, then the child elements are reversed
@@ -335,49 +369,143 @@ static void _animation_update(Animation *anim)
     }
     progress = reverse ? ANIMATION_NORMALIZED_MAX - progress  : progress;
 
-    switch(anim->curve) {
-        case AnimationCurveDefault:
-        case AnimationCurveLinear:
-            break;
-        case AnimationCurveEaseIn:
-            progress = ((progress * progress) / ANIMATION_NORMALIZED_MAX);
-            break;
-        case AnimationCurveEaseOut:
-            progress -= ANIMATION_NORMALIZED_MAX;
-            progress = -(progress * progress / ANIMATION_NORMALIZED_MAX) + ANIMATION_NORMALIZED_MAX;
-            break;
-        case AnimationCurveEaseInOut:
-            if (progress < ANIMATION_NORMALIZED_MAX / 2){
-                progress = ((progress * progress) / (ANIMATION_NORMALIZED_MAX / 2));
-            }
-            else {
-                progress -= ANIMATION_NORMALIZED_MAX;
-                progress = -((progress * progress) / (ANIMATION_NORMALIZED_MAX / 2)) + ANIMATION_NORMALIZED_MAX;
-            }
-            break;
-        case AnimationCurveCustomFunction:
-            if (anim->curve_function)
-                progress = anim->curve_function(progress);
-            break;
-        case AnimationCurveCustomInterpolationFunction:
-        case AnimationCurve_Reserved1:
-        case AnimationCurve_Reserved2:
-            break;
+    if (anim->curve == AnimationCurveCustomFunction) {
+        if (anim->curve_function)
+            progress = anim->curve_function(progress);
+    }
+    else {
+        /* custom interpolation gets the linear progress, and does the
+         * easing itself as it interpolates */
+        progress = animation_curve_evaluate(anim->curve, progress);
     }
 
     if (anim->impl.update)
         anim->impl.update(anim, (uint32_t) progress);
 
+    _animation_clock_add(anim);
+}
+
+/* Make sure the clock ticks by when */
+static void _animation_clock_arm(AnimationClock *clock, TickType_t when)
+{
+    /* it works out the next tick itself once it's done */
+    if (clock->ticking)
+        return;
+
+    if (clock->armed)
+    {
+        if (!TIMER_BEFORE(when, clock->timer.when))
+            return;
+        appmanager_timer_remove(&clock->timer);
+    }
+
+    clock->timer.when = when;
+    clock->armed = true;
+    appmanager_timer_add(&clock->timer);
+}
+
+/*
+ * A frame. Step every animation that is due, or will be within half a
+ * frame, so anything started between ticks falls in line with the rest
+ * rather than needing a tick of its own.
+ */
+static void _animation_clock_tick(CoreTimer *timer)
+{
+    AnimationClock *clock = container_of(timer, AnimationClock, timer);
+    TickType_t now = xTaskGetTickCount();
+    TickType_t due = now + (ANIMATION_TICKS / 2);
+    list_head stepping = LIST_HEAD(stepping);
+    Animation *anim;
+
+    clock->armed = false;
+    clock->ticking = true;
+
+    /* take the due ones off first; stepping one can add, remove or
+     * destroy any of the others */
+    list_node *node = list_get_head(&clock->animations);
+    while (node)
+    {
+        list_node *next = list_get_next(&clock->animations, node);
+        anim = list_elem(node, Animation, clock_node);
+        if (!TIMER_BEFORE(due, anim->timer.when))
+        {
+            list_remove(&clock->animations, node);
+            list_insert_tail(&stepping, node);
+        }
+        node = next;
+    }
+
+    while ((node = list_get_head(&stepping)))
+    {
+        anim = list_elem(node, Animation, clock_node);
+        list_remove(&stepping, node);
+        anim->onqueue = 0;
+        _animation_update(anim);
+    }
+
+    clock->ticking = false;
+
+    /* and sleep until the next one is due */
+    node = list_get_head(&clock->animations);
+    if (!node)
+        return;
+
+    TickType_t when = list_elem(node, Animation, clock_node)->timer.when;
+    list_foreach(anim, &clock->animations, Animation, clock_node)
+    {
+        if (TIMER_BEFORE(anim->timer.when, when))
+            when = anim->timer.when;
+    }
+    if (TIMER_BEFORE(when, now + 1))
+        when = now + 1;
+
+    _animation_clock_arm(clock, when);
+}
+
+/* The clock lives in the thread's own heap, so it goes with the app */
+static AnimationClock *_animation_clock_get(void)
+{
+    app_running_thread *thread = appmanager_get_current_thread();
+
+    if (thread->animation_clock)
+        return thread->animation_clock;
+
+    AnimationClock *clock = app_calloc(1, sizeof(AnimationClock));
+    if (!clock) {
+        LOG_ERROR("No Memory");
+        return NULL;
+    }
+    list_init_head(&clock->animations);
+    clock->timer.callback = _animation_clock_tick;
+    thread->animation_clock = clock;
+
+    return clock;
+}
+
+/* Hang the animation on the clock to be stepped at anim->timer.when */
+static void _animation_clock_add(Animation *anim)
+{
+    AnimationClock *clock = _animation_clock_get();
+
+    if (!clock)
+        return;
+
+    if (anim->onqueue)
+        list_remove(&clock->animations, &anim->clock_node);
+
     anim->onqueue = 1;
-    appmanager_timer_add(&anim->timer);
+    list_insert_tail(&clock->animations, &anim->clock_node);
+    _animation_clock_arm(clock, anim->timer.when);
 }
 
-static void _anim_callback(CoreTimer *timer)
+/* The clock keeps its timer; if there's nothing left it just won't re-arm */
+static void _animation_clock_remove(Animation *anim)
 {
-    Animation *anim = (Animation *) timer;
+    if (!anim->onqueue)
+        return;
 
+    list_remove(NULL, &anim->clock_node);
     anim->onqueue = 0;
-    _animation_update(anim);
 }
 
 /* Anims added to a sequence are not allowed to be changed.
@@ -401,14 +529,11 @@ static bool _animation_schedule_one(Animation *anim)
 
     _animation_started(anim);
 
-    if (anim->onqueue)
-        appmanager_timer_remove(&anim->timer);
+    _animation_clock_remove(anim);
 
     anim->startticks = xTaskGetTickCount();
     anim->scheduled = 1;
-    anim->onqueue = 0;
     anim->timer.when = 0;
-    anim->timer.callback = _anim_callback;
 
     /* If we are delaying, add the timer to the queue.
        when it times out it will call update*/
@@ -416,8 +541,7 @@ static bool _animation_schedule_one(Animation *anim)
         LOG_INFO("[%x] Delay %d", anim, anim->delay);
         anim->timer.when = anim->startticks + anim->delay;
         anim->startticks = anim->timer.when;
-        anim->onqueue = 1;
-        appmanager_timer_add(&anim->timer);
+        _animation_clock_add(anim);
         return true;
     }
 
@@ -471,6 +595,7 @@ bool animation_unschedule(Animation *anim)
         return true;
 
     anim->scheduled = 0;
+    _animation_clock_remove(anim);
 
     if (anim->anim_handlers.stopped)
         anim->anim_handlers.stopped(anim, false, anim->context);
@@ -539,10 +664,16 @@ bool animation_set_duration(Animation *anim, uint32_t ms)
     if (_is_immutable(anim))
         return false;
 
-    if (ms == ANIMATION_DURATION_INFINITE)
+    if (ms == ANIMATION_DURATION_INFINITE) {
         anim->duration = ANIMATION_DURATION_INFINITE;
-    else
-        anim->duration = pdMS_TO_TICKS(ms);
+        anim->progress_scale = 0;
+        return true;
+    }
+
+    anim->duration = pdMS_TO_TICKS(ms);
+    /* Only divide the once, each step is then a multiply and shift */
+    anim->progress_scale = anim->duration ?
+        ((uint32_t)ANIMATION_NORMALIZED_MAX << 16) / anim->duration : 0;
     return true;
 }
 
@@ -642,7 +773,9 @@ bool animation_set_custom_curve(Animation * anim, AnimationCurveFunction curve_f
     if (_is_immutable(anim))
         return false;
 
+    anim->curve_function = curve_function;
     MK_THUMB_CB(anim->curve_function);
+    anim->curve = AnimationCurveCustomFunction;
 
     return true;
 }
@@ -655,6 +788,65 @@ AnimationCurveFunction animation_get_custom_curve(Animation *anim)
     return anim->curve_function;
 }
 
+/* Have the property animation ask us for every value, rather than lerp */
+bool animation_set_custom_interpolation(Animation *anim, InterpolateInt64Function interpolate_function)
+{
+    if (!anim || !interpolate_function)
+        return false;
+
+    if (_is_immutable(anim))
+        return false;
+
+    anim->interpolate_function = interpolate_function;
+    MK_THUMB_CB(anim->interpolate_function);
+    anim->curve = AnimationCurveCustomInterpolationFunction;
+
+    return true;
+}
+
+InterpolateInt64Function animation_get_custom_interpolation(Animation *anim)
+{
+    if (!anim)
+        return NULL;
+
+    return anim->interpolate_function;
+}
+
+/*
+ * Ease a linear progress along one of the stock curves.
+ * A table lookup and a lerp between neighbouring samples, no divides.
+ */
+AnimationProgress animation_curve_evaluate(AnimationCurve curve, AnimationProgress progress)
+{
+    const int32_t *lut = NULL;
+
+    if (curve < sizeof(_curve_tables) / sizeof(_curve_tables[0]))
+        lut = _curve_tables[curve];
+
+    if (!lut)
+        return progress;
+
+    if (progress <= ANIMATION_NORMALIZED_MIN)
+        return ANIMATION_NORMALIZED_MIN;
+    if (progress >= ANIMATION_NORMALIZED_MAX)
+        return ANIMATION_NORMALIZED_MAX;
+
+    uint32_t i = (uint32_t)progress >> ANIMATION_CURVE_LUT_SHIFT;
+    int32_t frac = progress & ((1 << ANIMATION_CURVE_LUT_SHIFT) - 1);
+
+    return lut[i] + (((lut[i + 1] - lut[i]) * frac) >> ANIMATION_CURVE_LUT_SHIFT);
+}
+
+/* The value between from and to at progress, for property animations. In 64
+ * bits, so a uint32 property goes all the way up without wrapping */
+int64_t animation_interpolate(Animation *anim, AnimationProgress progress, int64_t from, int64_t to)
+{
+    if (anim && anim->curve == AnimationCurveCustomInterpolationFunction && anim->interpolate_function)
+        return anim->interpolate_function(progress, from, to);
+
+    return ANIM_LERP(from, to, progress);
+}
+
 
 bool animation_set_implementation(Animation *anim, const AnimationImplementation *impl)
 {
@@ -686,10 +878,11 @@ const AnimationImplementation *animation_get_implementation(Animation *anim)
 Animation *animation_clone(Animation *from)
 {
     /* TODO sequences */
-    Animation *newanim = app_calloc(1, sizeof(Animation));
+    Animation *newanim = app_pool_calloc(ObjectPoolAnimation, sizeof(Animation));
     memcpy(newanim, from, sizeof(Animation));
     newanim->scheduled = 0;
     newanim->onqueue = 0;
+    list_init_node(&newanim->clock_node);
     newanim->playcount_count = 0;
     return newanim;
 }
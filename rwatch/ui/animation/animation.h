@@ -19,14 +19,17 @@
 #define ANIMATION_NORMALIZED_MIN 0 
 #define ANIMATION_NORMALIZED_MAX 65535
 
-/* Use to easily calculate changes */
-#define ANIM_LERP(a, b, progress)  ((a) + ((b) - (a)) * progress / ANIMATION_NORMALIZED_MAX)
+/* Use to easily calculate changes. Signed, so curves can overshoot either end,
+ * and in 64 bits, as anything over 32767 apart times the progress won't fit in 32 */
+#define ANIM_LERP(a, b, progress)  ((a) + (((int64_t)(b) - (int64_t)(a)) * (int64_t)(progress)) / ANIMATION_NORMALIZED_MAX)
 
 struct Animation;
 typedef struct PropertyAnimation PropertyAnimation;
 
-typedef uint32_t AnimationProgress;
+/* Can go past either end of 0..ANIMATION_NORMALIZED_MAX on curves that overshoot */
+typedef int32_t AnimationProgress;
 typedef AnimationProgress(* AnimationCurveFunction)(AnimationProgress linear_distance);
+typedef int64_t (*InterpolateInt64Function)(int32_t normalized, int64_t from, int64_t to);
 
 typedef enum {
     AnimationCurveLinear,
@@ -37,7 +40,16 @@ typedef enum {
     AnimationCurveCustomFunction,
     AnimationCurveCustomInterpolationFunction,
     AnimationCurve_Reserved1,
-    AnimationCurve_Reserved2
+    AnimationCurve_Reserved2,
+    /* cubic-bezier presets, as CSS has them */
+    AnimationCurveCubicEase,
+    AnimationCurveCubicEaseIn,
+    AnimationCurveCubicEaseOut,
+    AnimationCurveCubicEaseInOut,
+    /* runs past the end and settles back */
+    AnimationCurveOvershoot,
+    /* bounces around the end a couple of times */
+    AnimationCurveSpring,
 } AnimationCurve;
 
 typedef void (*AnimationSetupImplementation)(struct Animation *animation);
@@ -87,8 +99,11 @@ typedef struct Animation
     AnimationImplementation impl;
     AnimationHandlers anim_handlers;
     AnimationCurveFunction curve_function;
+    InterpolateInt64Function interpolate_function;
+    uint32_t progress_scale; /* ANIMATION_NORMALIZED_MAX / duration, in 16.16 */
     list_node sequence_node;
     list_node sequence_head;
+    list_node clock_node; /* on the thread's animation clock while onqueue */
     void *context; /* for generic use */
 } Animation;
 
@@ -125,4 +140,8 @@ bool animation_unschedule(Animation *animation);
 void animation_unschedule_all(void);
 bool animation_is_scheduled(Animation *animation);
 bool animation_set_custom_curve(Animation * anim, AnimationCurveFunction curve_function);
+bool animation_set_custom_interpolation(Animation *anim, InterpolateInt64Function interpolate_function);
+InterpolateInt64Function animation_get_custom_interpolation(Animation *anim);
+AnimationProgress animation_curve_evaluate(AnimationCurve curve, AnimationProgress progress);
+int64_t animation_interpolate(Animation *anim, AnimationProgress progress, int64_t from, int64_t to);
 Animation *animation_clone(Animation *from);
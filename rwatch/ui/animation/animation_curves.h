@@ -0,0 +1,22 @@
+#pragma once
+/* animation_curves.h
+ * precomputed easing curves
+ * libRebbleOS
+ */
+
+#include <stdint.h>
+
+/* The tables are generated into build/animation_curves.c by
+ * Utilities/mkcurves.py, which must agree with these */
+#define ANIMATION_CURVE_LUT_SHIFT 9
+#define ANIMATION_CURVE_LUT_SIZE  ((65536 >> ANIMATION_CURVE_LUT_SHIFT) + 1)
+
+extern const int32_t animation_curve_ease_in[ANIMATION_CURVE_LUT_SIZE];
+extern const int32_t animation_curve_ease_out[ANIMATION_CURVE_LUT_SIZE];
+extern const int32_t animation_curve_ease_in_out[ANIMATION_CURVE_LUT_SIZE];
+extern const int32_t animation_curve_cubic_ease[ANIMATION_CURVE_LUT_SIZE];
+extern const int32_t animation_curve_cubic_ease_in[ANIMATION_CURVE_LUT_SIZE];
+extern const int32_t animation_curve_cubic_ease_out[ANIMATION_CURVE_LUT_SIZE];
+extern const int32_t animation_curve_cubic_ease_in_out[ANIMATION_CURVE_LUT_SIZE];
+extern const int32_t animation_curve_overshoot[ANIMATION_CURVE_LUT_SIZE];
+extern const int32_t animation_curve_spring[ANIMATION_CURVE_LUT_SIZE];
@@ -11,6 +11,10 @@
 #include "property_animation.h"
 #include "animation.h"
 
+/* Lerp, unless the animation wants to interpolate things itself */
+#define PROP_LERP(from, to, distance) \
+    animation_interpolate(&property_animation->animation, distance, from, to)
+
 void property_animation_update_grect(PropertyAnimation * property_animation, const uint32_t distance_normalized)
 {
     if (property_animation->impl.accessors.getter.grect != NULL && property_animation->impl.accessors.setter.grect != NULL)
@@ -18,12 +22,12 @@ void property_animation_update_grect(PropertyAnimation * property_animation, con
         GRect *from = (GRect *) property_animation->values.from;
         GRect *to = (GRect *) property_animation->values.to;
         
-        GRect new_rect = GRect(ANIM_LERP(from->origin.x, 
+        GRect new_rect = GRect(PROP_LERP(from->origin.x, 
                                to->origin.x, 
                                distance_normalized), 
-                               ANIM_LERP(from->origin.y, to->origin.y, distance_normalized), 
-                               ANIM_LERP(from->size.w, to->size.w, distance_normalized), 
-                               ANIM_LERP(from->size.h, to->size.h, distance_normalized));
+                               PROP_LERP(from->origin.y, to->origin.y, distance_normalized), 
+                               PROP_LERP(from->size.w, to->size.w, distance_normalized), 
+                               PROP_LERP(from->size.h, to->size.h, distance_normalized));
         property_animation->impl.accessors.setter.grect(property_animation->subject, new_rect);
     }
 }
@@ -35,8 +39,8 @@ void property_animation_update_gpoint(PropertyAnimation * property_animation, co
         GPoint *from = (GPoint *) property_animation->values.from;
         GPoint *to = (GPoint *) property_animation->values.to;
         
-        GPoint new_origin = GPoint(ANIM_LERP(from->x, from->x, distance_normalized), 
-                                   ANIM_LERP(from->y, to->y, distance_normalized));
+        GPoint new_origin = GPoint(PROP_LERP(from->x, to->x, distance_normalized), 
+                                   PROP_LERP(from->y, to->y, distance_normalized));
         property_animation->impl.accessors.setter.gpoint(property_animation->subject, new_origin);
     }
 }
@@ -48,7 +52,7 @@ void property_animation_update_int16(PropertyAnimation * property_animation, con
         int16_t *from = (int16_t *) property_animation->values.from;
         int16_t *to = (int16_t *) property_animation->values.to;
         
-        property_animation->impl.accessors.setter.int16(property_animation->subject, ANIM_LERP(*from, *to, distance_normalized));
+        property_animation->impl.accessors.setter.int16(property_animation->subject, PROP_LERP(*from, *to, distance_normalized));
     }
 }
 
@@ -59,7 +63,7 @@ void property_animation_update_uint32(PropertyAnimation * property_animation, co
         uint32_t *from = (uint32_t *) property_animation->values.from;
         uint32_t *to = (uint32_t *) property_animation->values.to;
         
-        property_animation->impl.accessors.setter.uint32(property_animation->subject, ANIM_LERP(*from, *to, distance_normalized));
+        property_animation->impl.accessors.setter.uint32(property_animation->subject, (uint32_t)PROP_LERP(*from, *to, distance_normalized));
     }
 }
 
@@ -71,10 +75,10 @@ void property_animation_update_gcolor8(PropertyAnimation * property_animation, c
         GColor8 *to = (GColor8 *) property_animation->values.to;
         
         GColor8 new_gcolor = *from;
-        new_gcolor.r = ANIM_LERP(from->r, to->r, distance_normalized);
-        new_gcolor.g = ANIM_LERP(from->g, to->g, distance_normalized);
-        new_gcolor.b = ANIM_LERP(from->b, to->b, distance_normalized);
-        new_gcolor.a = ANIM_LERP(from->a, to->a, distance_normalized);
+        new_gcolor.r = PROP_LERP(from->r, to->r, distance_normalized);
+        new_gcolor.g = PROP_LERP(from->g, to->g, distance_normalized);
+        new_gcolor.b = PROP_LERP(from->b, to->b, distance_normalized);
+        new_gcolor.a = PROP_LERP(from->a, to->a, distance_normalized);
         
         property_animation->impl.accessors.setter.gcolor(property_animation->subject, new_gcolor);
     }
@@ -124,7 +128,7 @@ PropertyAnimation * property_animation_create(const PropertyAnimationImplementat
 {
     SYS_LOG("property_animation", APP_LOG_LEVEL_INFO, "property_animation_create");
     
-    PropertyAnimation *property_animation = app_calloc(1, sizeof(PropertyAnimation));
+    PropertyAnimation *property_animation = app_pool_calloc(ObjectPoolPropertyAnimation, sizeof(PropertyAnimation));
     animation_ctor(&property_animation->animation);
     
     property_animation->animation.impl = implementation->base;
@@ -11,13 +11,32 @@
 static void _layer_remove_node(Layer *to_be_removed);
 static void _layer_insert_node(Layer *layer_to_insert, Layer *sibling_layer, bool below);
 static void _layer_delete_tree(Layer *layer);
-static Layer *_layer_find_parent(Layer *orig_layer, Layer *layer);
-static void _layer_walk(const Layer *layer, GContext *context);
+static Layer *_layer_find_prev_sibling(Layer *layer);
+static bool _layer_is_visible(const Layer *layer, const GContext *context);
+static bool _layer_in_columns(const Layer *layer, const GRect *offset, int16_t x, int16_t w);
+static void _layer_walk_from(const Layer *layer, GContext *context, int16_t clip_x, int16_t clip_w,
+                             uint8_t base);
+static GRect _layer_cache_rect(const Layer *layer, const GRect *parent_offset);
+static bool _layer_cache_blit(Layer *layer, const GRect *parent_offset);
+static void _layer_cache_capture(Layer *layer, const GRect *parent_offset);
+static void _layer_cache_free(Layer *layer);
+
+/* How much layer nesting the walker keeps on its own stack. Each level
+ * costs one layer_walk_frame on the drawing thread's stack. Anything
+ * deeper gets a walk of its own, and so another of these stacks */
+#define LAYER_WALK_MAX_DEPTH 16
+
+typedef struct layer_walk_frame_t {
+    const Layer *layer;
+    GRect offset;
+} layer_walk_frame;
+
+static uint8_t _layer_walk_depth_hwm;
 
 // Layer Functions
 Layer *layer_create(GRect frame)
 {
-    Layer* layer = app_calloc(1, sizeof(Layer));
+    Layer* layer = app_pool_calloc(ObjectPoolLayer, sizeof(Layer));
     if (layer == NULL)
     {
         SYS_LOG("layer", APP_LOG_LEVEL_ERROR, "NO MEMORY FOR LAYER!");
@@ -49,6 +68,7 @@ void layer_ctor(Layer* layer, GRect frame)
 void layer_destroy(Layer* layer)
 {
     layer_dtor(layer);
+    app_free(layer);
 }
 
 void layer_dtor(Layer *layer)
@@ -56,6 +76,7 @@ void layer_dtor(Layer *layer)
     // remove our node
     SYS_LOG("layer", APP_LOG_LEVEL_ERROR, "Layer DTOR");
     _layer_remove_node(layer);
+    _layer_cache_free(layer);
     // free the children too...
     /* @ginge Actually, Pebble doesn't do this so we dont either */
     /*_layer_delete_tree(layer);
@@ -115,6 +136,13 @@ void layer_add_child(Layer *parent_layer, Layer *child_layer)
 
 void layer_mark_dirty(Layer *layer)
 {
+    /* Anything cached that contains this layer is now stale */
+    for (Layer *l = layer; l; l = l->parent)
+    {
+        l->cache_valid = false;
+        l->dirty = true;
+    }
+
     //layer->window
     window_dirty(true);
 }
@@ -206,7 +234,17 @@ bool layer_get_hidden(const Layer *layer)
 
 void layer_draw(const Layer *layer, GContext *context)
 {
-    _layer_walk(layer, context);
+    _layer_walk_from(layer, context, 0, DISPLAY_COLS, 0);
+}
+
+void layer_draw_columns(const Layer *layer, GContext *context, int16_t x, int16_t w)
+{
+    _layer_walk_from(layer, context, x, w, 0);
+}
+
+uint8_t layer_draw_get_max_depth(void)
+{
+    return _layer_walk_depth_hwm;
 }
 
 void layer_apply_frame_offset(const Layer *layer, GContext *context)
@@ -233,103 +271,340 @@ bool layer_get_clips(const Layer *layer)
     return layer->clip;
 }
 
+void layer_set_cached(Layer *layer, bool cached)
+{
+    if (!layer)
+        return;
+
+#ifdef PBL_BW
+    /* XXX: PBL_BW framebuffer is packed 1bpp, no cache support */
+    cached = false;
+#endif
+
+    if (!cached)
+        _layer_cache_free(layer);
+
+    layer->cache_enabled = cached;
+    layer->cache_valid = false;
+}
+
+bool layer_get_cached(const Layer *layer)
+{
+    if (!layer)
+        return false;
+
+    return layer->cache_enabled;
+}
+
 /* Private functions */
 
 static void _layer_insert_node(Layer *layer_to_insert, Layer *sibling_layer, bool below)
 {
+    Layer *parent = sibling_layer->parent;
+
+    if (parent == NULL)
+    {
+        SYS_LOG("layer", APP_LOG_LEVEL_ERROR, "Sibling layer has no parent");
+        return;
+    }
+
     if (below)
     {
-        // first find the sibling that points to parent
-        Layer *parent = _layer_find_parent(sibling_layer, sibling_layer);
-        layer_to_insert->parent = parent->parent;
-        layer_to_insert->sibling = parent->sibling;
-        parent->sibling = layer_to_insert;
+        // slot the node in before the sibling, so it draws first
+        Layer *prev = _layer_find_prev_sibling(sibling_layer);
+        if (prev)
+            prev->sibling = layer_to_insert;
+        else
+            parent->child = layer_to_insert;
+        layer_to_insert->sibling = sibling_layer;
     }
     else
     {
         // slot the node in after
-        layer_to_insert->parent = sibling_layer->parent;
         layer_to_insert->sibling = sibling_layer->sibling;
         sibling_layer->sibling = layer_to_insert;
     }
+    layer_to_insert->parent = parent;
     layer_to_insert->window = sibling_layer->window;
 }
 
 static void _layer_remove_node(Layer *to_be_removed)
 {
-    if (to_be_removed->parent == NULL)
-        return;
-    
-    Layer *parent = _layer_find_parent(to_be_removed, to_be_removed->parent);
-    // remove our node by pointing next to parents next, jumping over us
+    Layer *parent = to_be_removed->parent;
+
     if (parent == NULL)
     {
-        SYS_LOG("window", APP_LOG_LEVEL_INFO, "ROOT layers rem %d %d %d %d", to_be_removed, parent, parent->sibling, parent->child);
-        
-        /* we are the root node */
+        /* we are the root node, or already detached */
         return;
     }
     
-    if (parent->sibling == to_be_removed)
-    {
-        parent->sibling = to_be_removed->sibling;
-    }
+    // remove our node by pointing the previous node at our next, jumping over us
+    Layer *prev = _layer_find_prev_sibling(to_be_removed);
+    if (prev)
+        prev->sibling = to_be_removed->sibling;
     else if (parent->child == to_be_removed)
-    {
-        parent->child = NULL;
-    }
-    to_be_removed->parent = NULL;   
+        parent->child = to_be_removed->sibling;
+
+    to_be_removed->sibling = NULL;
+    to_be_removed->parent = NULL;
 }
 
 /*
- * Recurse through the btree.
+ * Check the layer could paint something we can see.
+ * Drawing is not clipped to the frame, and plenty of layers (the menu
+ * and scroll content for one) paint well outside it, up and to the left
+ * of the frame once they are scrolled. So a layer is only culled once its
+ * origin is past the right or bottom of the drawable area or the screen,
+ * and only culled for being above or to the left when it asked to clip.
+ */
+static bool _layer_is_visible(const Layer *layer, const GContext *context)
+{
+    const GRect *frame = &layer->frame;
+    const GRect *offset = &context->offset;
+
+    /* past the right or bottom of the drawable area */
+    if (frame->origin.x >= offset->size.w ||
+        frame->origin.y >= offset->size.h ||
+        offset->origin.x + frame->origin.x >= DISPLAY_COLS ||
+        offset->origin.y + frame->origin.y >= DISPLAY_ROWS)
+        return false;
+
+    if (!layer->clip)
+        return true;
+
+    /* before the left or top of the drawable area */
+    int16_t right = frame->origin.x + frame->size.w;
+    int16_t bottom = frame->origin.y + frame->size.h;
+
+    if (right <= 0 || bottom <= 0 ||
+        offset->origin.x + right <= 0 ||
+        offset->origin.y + bottom <= 0)
+        return false;
+
+    return true;
+}
+
+/*
+ * Check the layer's own frame covers some of the screen columns x to x + w.
+ * This only decides whether the update_proc is worth calling; the children
+ * are still walked, as they are free to sit outside their parent's frame.
+ */
+static bool _layer_in_columns(const Layer *layer, const GRect *offset, int16_t x, int16_t w)
+{
+    int16_t left = offset->origin.x + layer->frame.origin.x;
+
+    return left < x + w && left + layer->frame.size.w > x;
+}
+
+/*
+ * Walk the btree.
  * As we are storing layers as a btree where each sibling
  * is the next layer of the same child as layer->parent
  * layer->child is the head of a new list of siblings where layer->child == new parent
- * This will recurse the children, the siblings of children in a layer
- * When exhaused it will walk the siblings of the parent, etc etc until
- * either 1) no more ram 2) completion
+ * This will walk the children, the siblings of children in a layer
+ * When exhaused it will walk the siblings of the parent, etc etc until completion
+ *
+ * The walk is iterative. Every level we descend pushes the layer and
+ * the context offset to restore onto a small fixed stack, so a long list
+ * of siblings costs nothing. Past LAYER_WALK_MAX_DEPTH levels, which no
+ * real app gets near, the children are walked by a call of their own.
+ * base is how deep that call starts.
  */
-static void _layer_walk(const Layer *layer, GContext *context)
+static void _layer_walk_from(const Layer *layer, GContext *context, int16_t clip_x, int16_t clip_w,
+                             uint8_t base)
 {
-    if (layer)
+    layer_walk_frame stack[LAYER_WALK_MAX_DEPTH];
+    uint8_t depth = 0;
+    /* a partial walk leaves stale pixels around, so never cache one */
+    bool capture = (clip_x <= 0 && clip_x + clip_w >= DISPLAY_COLS);
+
+    while (layer)
     {
-        if (layer->hidden == false) // we don't draw hidden layers or their children
+        // we don't draw hidden, skipped or offscreen layers or their children
+        if (layer->hidden == false && !layer->skip_draw && _layer_is_visible(layer, context) &&
+            !(layer->cache_enabled && _layer_cache_blit((Layer *)layer, &context->offset)))
         {
             GRect previous_offset = context->offset;
             layer_apply_frame_offset(layer, context);
 
-            if (layer->update_proc)
+            if (layer->update_proc &&
+                (capture || _layer_in_columns(layer, &previous_offset, clip_x, clip_w)))
                 layer->update_proc((Layer *)layer, context);
 
-            // walk this elements sub elements recursively before moving on to the next element
-            _layer_walk(layer->child, context);
+            // walk this elements sub elements before moving on to the next element
+            if (layer->child && depth < LAYER_WALK_MAX_DEPTH)
+            {
+                stack[depth].layer = layer;
+                stack[depth].offset = previous_offset;
+                depth++;
+                if (base + depth > _layer_walk_depth_hwm)
+                    _layer_walk_depth_hwm = MIN(base + depth, UINT8_MAX);
+
+                layer = layer->child;
+                continue;
+            }
+            else if (layer->child)
+            {
+                _layer_walk_from(layer->child, context, clip_x, clip_w, MIN(base + depth + 1, UINT8_MAX));
+            }
 
             context->offset = previous_offset; // restore offset
+
+            if (layer->cache_enabled && capture)
+                _layer_cache_capture((Layer *)layer, &context->offset);
         }
-        _layer_walk(layer->sibling, context);
+
+        // out of siblings at this level? climb back up to the parent
+        while (layer->sibling == NULL && depth > 0)
+        {
+            depth--;
+            layer = stack[depth].layer;
+            context->offset = stack[depth].offset;
+
+            // the whole subtree is painted now, so grab it
+            if (layer->cache_enabled && capture)
+                _layer_cache_capture((Layer *)layer, &context->offset);
+        }
+
+        layer = layer->sibling;
     }
 }
 
-static Layer *_layer_find_parent(Layer *orig_layer, Layer *layer)
+/*
+ * Layer caching.
+ * A cached layer is painted normally once, children and all, and then
+ * the pixels it covers are copied out of the framebuffer into a bitmap
+ * in the app's arena. Subsequent frames copy the rows straight back in
+ * and skip the update_procs entirely, until layer_mark_dirty() is called
+ * on the layer (or any child) or it moves.
+ *
+ * The capture is a snapshot of the framebuffer, so it is only useful for
+ * layers that paint their whole frame, or sit on a background that does
+ * not change (dial backgrounds, tick marks, bitmap art).
+ */
+static GRect _layer_cache_rect(const Layer *layer, const GRect *parent_offset)
 {
-    if (layer)
-    {       
-        if (layer->sibling == orig_layer || layer->child == orig_layer)
+    return GRect(parent_offset->origin.x + layer->frame.origin.x,
+                 parent_offset->origin.y + layer->frame.origin.y,
+                 layer->frame.size.w,
+                 layer->frame.size.h);
+}
+
+static bool _layer_cache_blit(Layer *layer, const GRect *parent_offset)
+{
+    if (!layer->cache_valid || !layer->cache)
+        return false;
+
+    GRect rect = _layer_cache_rect(layer, parent_offset);
+    if (!RECT_EQ(rect, layer->cache_rect))
+    {
+        layer->cache_valid = false;
+        return false;
+    }
+
+    uint8_t *fb = display_get_buffer();
+    uint8_t *src = layer->cache->addr;
+    uint8_t *dst = &fb[(rect.origin.y * DISPLAY_COLS) + rect.origin.x];
+
+    for (int16_t y = 0; y < rect.size.h; y++)
+    {
+        memcpy(dst, src, rect.size.w);
+        src += layer->cache->row_size_bytes;
+        dst += DISPLAY_COLS;
+    }
+
+    return true;
+}
+
+static void _layer_cache_capture(Layer *layer, const GRect *parent_offset)
+{
+    if (layer->cache_valid)
+        return;
+
+    GRect rect = _layer_cache_rect(layer, parent_offset);
+
+    /* Only cache when we can see all of it. Mid-slide, just draw */
+    if (rect.origin.x < 0 || rect.origin.y < 0 ||
+        rect.size.w <= 0 || rect.size.h <= 0 ||
+        rect.origin.x + rect.size.w > DISPLAY_COLS ||
+        rect.origin.y + rect.size.h > DISPLAY_ROWS)
+        return;
+
+    if (layer->cache &&
+        (layer->cache->raw_bitmap_size.w != rect.size.w ||
+         layer->cache->raw_bitmap_size.h != rect.size.h))
+        _layer_cache_free(layer);
+
+    if (!layer->cache)
+    {
+        GBitmap *bitmap = app_calloc(1, sizeof(GBitmap));
+        uint8_t *data = bitmap ? app_calloc(rect.size.h, rect.size.w) : NULL;
+
+        if (!data)
         {
-            return layer;
+            SYS_LOG("layer", APP_LOG_LEVEL_ERROR, "No memory for layer cache, disabling");
+            if (bitmap)
+                app_free(bitmap);
+            layer->cache_enabled = false;
+            return;
         }
-        
-        // walk this elements sub elements recursively before moving on to the next element
-        Layer *found_layer = NULL;
-        found_layer = _layer_find_parent(orig_layer, layer->child);
-        if (found_layer)
-            return found_layer;
-        
-        found_layer = _layer_find_parent(orig_layer, layer->sibling);
-        if (found_layer)
-            return found_layer;
+
+        bitmap->addr = data;
+        bitmap->raw_bitmap_size.w = rect.size.w;
+        bitmap->raw_bitmap_size.h = rect.size.h;
+        bitmap->row_size_bytes = rect.size.w;
+        bitmap->bounds = GRect(0, 0, rect.size.w, rect.size.h);
+        bitmap->format = n_GBitmapFormat8Bit;
+        layer->cache = bitmap;
+    }
+
+    uint8_t *fb = display_get_buffer();
+    uint8_t *src = &fb[(rect.origin.y * DISPLAY_COLS) + rect.origin.x];
+    uint8_t *dst = layer->cache->addr;
+
+    for (int16_t y = 0; y < rect.size.h; y++)
+    {
+        memcpy(dst, src, rect.size.w);
+        src += DISPLAY_COLS;
+        dst += layer->cache->row_size_bytes;
+    }
+
+    layer->cache_rect = rect;
+    layer->cache_valid = true;
+}
+
+static void _layer_cache_free(Layer *layer)
+{
+    if (layer->cache)
+    {
+        app_free(layer->cache->addr);
+        app_free(layer->cache);
+    }
+    layer->cache = NULL;
+    layer->cache_valid = false;
+}
+
+/*
+ * Find the sibling that comes before this layer in its parent's child list.
+ * Returns NULL if the layer is the first child (or has no parent).
+ */
+static Layer *_layer_find_prev_sibling(Layer *layer)
+{
+    if (layer->parent == NULL)
+        return NULL;
+
+    Layer *node = layer->parent->child;
+
+    if (node == layer)
+        return NULL;
+
+    while (node)
+    {
+        if (node->sibling == layer)
+            return node;
+        node = node->sibling;
     }
+
     return NULL;
 }
 
@@ -31,6 +31,12 @@ typedef struct Layer
     LayerUpdateProc update_proc;
     void *callback_data;
     bool hidden;
+    bool cache_enabled;
+    bool cache_valid;
+    GBitmap *cache; // retained render of this layer and its children
+    GRect cache_rect; // where on screen the cache was captured from
+    bool dirty; // marked dirty since a ScrollLayer holding it kept a frame
+    bool skip_draw; // left out of this frame only, by a ScrollLayer that shifted it
 } Layer;
 
 
@@ -65,8 +71,15 @@ void layer_set_hidden(Layer *layer, bool hidden);
 bool layer_get_hidden(const Layer *layer);
 void layer_set_clips(Layer *layer, bool clips);  //TODO
 bool layer_get_clips(const Layer *layer); //TODO
+// opt in to rendering this layer (and children) once and blitting it after
+void layer_set_cached(Layer *layer, bool cached);
+bool layer_get_cached(const Layer *layer);
 void *layer_get_data(const Layer *layer); //TODO
 void layer_draw(const Layer *layer, GContext *context);
+// as layer_draw, but only call update_procs whose frame touches screen columns x to x + w
+void layer_draw_columns(const Layer *layer, GContext *context, int16_t x, int16_t w);
+// deepest nesting layer_draw has walked so far (for profiling)
+uint8_t layer_draw_get_max_depth(void);
 // updates context offset based on layer frame, used to properly adjust layer drawing calls
 void layer_apply_frame_offset(const Layer *layer, GContext *context);
 
@@ -18,6 +18,53 @@ static void menu_layer_update_proc(Layer *layer, GContext *nGContext);
 #define BUTTON_LONG_CLICK_DELAY_MS 500
 #define ANIMATE_ON_CLICK true
 
+/* Virtualised menus keep positions in 32 bits. The scroll layer only has
+ * 16 bits, so its content starts at base_y, which is moved along whenever
+ * the selection strays more than this far from it */
+#define MENU_VIRTUAL_REBASE_LIMIT 16384
+/* extra lines measured and drawn either side of the screen */
+#define MENU_VIRTUAL_MARGIN_LINES 1
+#define MENU_VIRTUAL_NO_CHUNK ((uint32_t) ~0)
+
+typedef struct MenuVirtualSection
+{
+    uint16_t num_rows;
+    int16_t header_height;
+    uint32_t first_line;
+} MenuVirtualSection;
+
+typedef struct MenuVirtualChunk
+{
+    int32_t y; // only good for the first chunks_placed chunks
+    int32_t h;
+} MenuVirtualChunk;
+
+typedef struct MenuVirtualIndex
+{
+    uint16_t sections_count;
+    MenuVirtualSection *sections;
+    uint32_t lines_count;
+    uint32_t chunks_count;
+    MenuVirtualChunk *chunks;
+    uint32_t chunks_placed; // how many chunks, from the first, have a y
+    int32_t total_h;
+    int16_t line_estimate; // assumed height of lines not measured yet
+    int32_t base_y; // content y that the scroll layer's 0 maps to
+    MenuCellSpan span;
+    /* line heights of the last two chunks we looked at */
+    uint32_t hot_chunk[2];
+    int16_t hot_heights[2][MENU_VIRTUAL_CHUNK_LINES];
+    uint8_t hot_next;
+} MenuVirtualIndex;
+
+static void _virtual_free(MenuLayer *menu_layer);
+static void _virtual_reload(MenuLayer *menu_layer);
+static MenuCellSpan *_virtual_get_cell_span(MenuLayer *menu_layer, const MenuIndex *index);
+static void _virtual_draw(MenuLayer *menu_layer, Layer *layer, GContext *nGContext,
+                          GRect redraw, uint16_t cell_width);
+static void _menu_layer_draw_span(const MenuLayer *menu_layer, Layer *layer, GContext *nGContext,
+                                  MenuCellSpan *span, uint16_t width);
+
 void menu_layer_ctor(MenuLayer *mlayer, GRect frame)
 {
     layer_ctor(&mlayer->layer, frame);
@@ -41,6 +88,8 @@ void menu_layer_ctor(MenuLayer *mlayer, GRect frame)
 #else
     mlayer->is_center_focus = true;
 #endif
+    // the focus highlight stays put while the content moves under it
+    mlayer->scroll_layer.fb_shift_disabled = mlayer->is_center_focus;
 
     layer_set_update_proc(&mlayer->layer, menu_layer_update_proc);
 
@@ -53,6 +102,7 @@ void menu_layer_dtor(MenuLayer *menu)
     scroll_layer_dtor(&menu->scroll_layer);
     if (menu->cells_count > 0)
         app_free(menu->cells);
+    _virtual_free(menu);
 }
 
 MenuLayer *menu_layer_create(GRect frame)
@@ -126,6 +176,9 @@ void menu_layer_set_selected_next(MenuLayer *menu_layer, bool up, MenuRowAlign s
 
 static MenuCellSpan *_get_cell_span(MenuLayer *menu_layer, const MenuIndex *index)
 {
+    if (menu_layer->virtual_index)
+        return _virtual_get_cell_span(menu_layer, index);
+
     // TODO: optimize, binary search should be enough
     for (size_t cell = 0; cell < menu_layer->cells_count; ++cell)
         if (menu_index_compare(index, &menu_layer->cells[cell].index) == 0 && !menu_layer->cells[cell].header)
@@ -217,6 +270,7 @@ void menu_layer_set_center_focused(MenuLayer *menu_layer, bool center_focused)
 {
     if (menu_layer->is_center_focus != center_focused) {
         menu_layer->is_center_focus = center_focused;
+        menu_layer->scroll_layer.fb_shift_disabled = center_focused;
 
         _menu_layer_update_scroll_offset(menu_layer, MenuRowAlignCenter, false);
     }
@@ -242,6 +296,12 @@ void menu_layer_reload_data(MenuLayer *menu_layer)
 {
     menu_layer->is_reload_scheduled = false;
 
+    if (menu_layer->virtual_index)
+    {
+        _virtual_reload(menu_layer);
+        return;
+    }
+
     int16_t sections = 1;
     if (menu_layer->callbacks.get_num_sections)
         sections = menu_layer->callbacks.get_num_sections(menu_layer, menu_layer->context);
@@ -405,6 +465,32 @@ void menu_layer_set_reload_behaviour(MenuLayer* menu_layer, MenuLayerReloadBehav
     menu_layer->reload_behaviour = behaviour;
 }
 
+void menu_layer_set_virtualised(MenuLayer *menu_layer, bool virtualised)
+{
+    if (virtualised == (menu_layer->virtual_index != NULL))
+        return;
+
+    if (!virtualised)
+    {
+        _virtual_free(menu_layer);
+    }
+    else
+    {
+        menu_layer->virtual_index = app_calloc(1, sizeof(MenuVirtualIndex));
+        if (!menu_layer->virtual_index)
+            return;
+
+        // the cells array is not used any more
+        if (menu_layer->cells_count > 0)
+            app_free(menu_layer->cells);
+        menu_layer->cells_count = 0;
+        menu_layer->cells = NULL;
+    }
+
+    if (menu_layer->callbacks.get_num_rows)
+        menu_layer_reload_data(menu_layer);
+}
+
 void menu_layer_set_column_count(MenuLayer* menu_layer, uint16_t num_columns) {
     if (menu_layer->column_count != num_columns && num_columns > 0) {
         menu_layer->column_count = num_columns;
@@ -443,8 +529,19 @@ static void menu_layer_update_proc(Layer *layer, GContext *nGContext)
     GRect frame = layer_get_frame(layer);
     uint16_t cell_width = frame.size.w / menu_layer->column_count;
 
+    // the part of the menu that needs painting, in our coordinates
+    GRect redraw = scroll_layer_get_redraw_rect(&menu_layer->scroll_layer);
+
     if (menu_layer->is_reload_scheduled || menu_layer->reload_behaviour == MenuLayerReloadBehaviourOnRender)
+    {
         menu_layer_reload_data(menu_layer);
+        // anything could have changed, paint everything we can see
+        GPoint offset = scroll_layer_get_content_offset(&menu_layer->scroll_layer);
+        GSize size = layer_get_frame(&menu_layer->scroll_layer.layer).size;
+        redraw = GRect(-offset.x, -offset.y, size.w, size.h);
+    }
+    redraw.origin.x -= frame.origin.x;
+    redraw.origin.y -= frame.origin.y;
     
     // Draw background
     if (menu_layer->is_center_focus)
@@ -472,27 +569,470 @@ static void menu_layer_update_proc(Layer *layer, GContext *nGContext)
         graphics_fill_rect(nGContext, cursor_rect, 0, GCornerNone);
     } else if (!menu_layer->callbacks.draw_background) {
         graphics_context_set_fill_color(nGContext, menu_layer->bg_color);
-        graphics_fill_rect(nGContext, frame, 0, GCornerNone);
+        graphics_fill_rect(nGContext, redraw, 0, GCornerNone);
     }
 
     // Draw cells
-    for (size_t cell = 0; cell < menu_layer->cells_count; ++cell)
+    if (menu_layer->virtual_index)
+    {
+        _virtual_draw(menu_layer, layer, nGContext, redraw, cell_width);
+    }
+    else
     {
-        // TODO: only draw visible cells based on layer frame/bounds
-        MenuCellSpan *span = menu_layer->cells + cell;
-        layer->callback_data = span;
-        layer->frame = GRect(span->x, span->y, (span->header ? frame.size.w : cell_width), span->h);
-        // TODO: update bounds
+        for (size_t cell = 0; cell < menu_layer->cells_count; ++cell)
+        {
+            MenuCellSpan *span = menu_layer->cells + cell;
+            if (span->y + span->h <= redraw.origin.y || span->y >= redraw.origin.y + redraw.size.h)
+                continue;
+
+            _menu_layer_draw_span(menu_layer, layer, nGContext, span,
+                                  span->header ? frame.size.w : cell_width);
+        }
+    }
+
+    layer->frame = frame;
+}
+
+/*
+ * Draw one cell, pretending the menu's layer is the cell's layer
+ * for the benefit of the draw callbacks.
+ * The caller restores the layer frame once all cells are done.
+ */
+static void _menu_layer_draw_span(const MenuLayer *menu_layer, Layer *layer, GContext *nGContext,
+                                  MenuCellSpan *span, uint16_t width)
+{
+    layer->callback_data = span;
+    layer->frame = GRect(span->x, span->y, width, span->h);
+    // TODO: update bounds
+
+    GRect offset = nGContext->offset;
+    layer_apply_frame_offset(layer, nGContext);
+
+    menu_layer_draw_cell(nGContext, menu_layer, span, layer);
+
+    nGContext->offset = offset;
+}
 
-        GRect offset = nGContext->offset;
-        layer_apply_frame_offset(layer, nGContext);
+// Virtualised data --------------------
+
+/*
+ * A virtualised menu never lays out every cell. The menu is treated as a
+ * list of lines, where a line is either a section header or a row of
+ * column_count cells. Lines are grouped into chunks of
+ * MENU_VIRTUAL_CHUNK_LINES, and all we keep for each chunk is where it
+ * starts and how tall it is. Chunks nobody has looked at yet are assumed to
+ * be line_estimate tall per line, and get measured the first time they
+ * come near the screen. Where a chunk starts is only worked out when it's
+ * asked for, running on from the last chunk placed, and measuring a chunk
+ * only forgets where the ones after it start. So a reload is
+ * O(sections + chunks) with no height callbacks, a measurement is O(1),
+ * and mapping a scroll position to a line is a binary search over the
+ * chunks placed (or a walk on past them, from where we last got to) plus
+ * a short walk inside one.
+ */
+
+static void _virtual_free(MenuLayer *menu_layer)
+{
+    MenuVirtualIndex *vi = menu_layer->virtual_index;
+    if (!vi)
+        return;
+
+    if (vi->sections)
+        app_free(vi->sections);
+    if (vi->chunks)
+        app_free(vi->chunks);
+    app_free(vi);
+    menu_layer->virtual_index = NULL;
+}
 
-        menu_layer_draw_cell(nGContext, menu_layer, span, layer);
+static bool _virtual_has_headers(const MenuLayer *menu_layer)
+{
+    return menu_layer->callbacks.get_header_height != NULL;
+}
 
-        nGContext->offset = offset;
+/* binary search for the section a line lives in */
+static uint16_t _virtual_line_section(const MenuVirtualIndex *vi, uint32_t line)
+{
+    uint16_t lo = 0;
+    uint16_t hi = vi->sections_count - 1;
+
+    while (lo < hi)
+    {
+        uint16_t mid = (lo + hi + 1) / 2;
+        if (vi->sections[mid].first_line <= line)
+            lo = mid;
+        else
+            hi = mid - 1;
     }
 
-    layer->frame = frame;
+    return lo;
+}
+
+/* What is on a line? Either a header, or the first row of the line */
+static uint16_t _virtual_line_content(const MenuLayer *menu_layer, uint32_t line,
+                                      bool *header, uint16_t *row)
+{
+    const MenuVirtualIndex *vi = menu_layer->virtual_index;
+    uint16_t section = _virtual_line_section(vi, line);
+    uint32_t off = line - vi->sections[section].first_line;
+
+    *header = false;
+    if (_virtual_has_headers(menu_layer))
+    {
+        if (off == 0)
+        {
+            *header = true;
+            *row = 0;
+            return section;
+        }
+        off--;
+    }
+
+    *row = off * menu_layer->column_count;
+    return section;
+}
+
+static int16_t _virtual_measure_line(MenuLayer *menu_layer, uint32_t line)
+{
+    MenuVirtualIndex *vi = menu_layer->virtual_index;
+    bool header;
+    uint16_t row;
+    uint16_t section = _virtual_line_content(menu_layer, line, &header, &row);
+
+    if (header)
+        return vi->sections[section].header_height;
+
+    if (!menu_layer->callbacks.get_cell_height)
+        return MENU_CELL_BASIC_CELL_HEIGHT;
+
+    int16_t h = 0;
+    for (uint16_t col = 0; col < menu_layer->column_count && row + col < vi->sections[section].num_rows; col++)
+    {
+        MenuIndex index = MenuIndex(section, row + col);
+        int16_t cur_h = menu_layer->callbacks.get_cell_height(menu_layer, &index, menu_layer->context);
+        if (cur_h > h)
+            h = cur_h;
+    }
+
+    return h;
+}
+
+/* Where a chunk starts, placing the chunks before it that aren't yet */
+static int32_t _virtual_chunk_y(MenuVirtualIndex *vi, uint32_t chunk)
+{
+    for (; vi->chunks_placed <= chunk; vi->chunks_placed++)
+    {
+        MenuVirtualChunk *prev = &vi->chunks[vi->chunks_placed - 1];
+        vi->chunks[vi->chunks_placed].y = prev->y + prev->h;
+    }
+
+    return vi->chunks[chunk].y;
+}
+
+static void _virtual_update_content_size(MenuLayer *menu_layer)
+{
+    MenuVirtualIndex *vi = menu_layer->virtual_index;
+    ScrollLayer *scroll_layer = &menu_layer->scroll_layer;
+
+    int16_t h = CLAMP(vi->total_h - vi->base_y, 0, INT16_MAX);
+
+    /* poke the frame directly, as set_content_size would reset the offset */
+    GRect frame = layer_get_frame(&scroll_layer->content_sublayer);
+    frame.size.h = h;
+    scroll_layer->scroll_offset.size.h = h;
+    scroll_layer->prev_scroll_offset.size.h = h;
+    layer_set_frame(&scroll_layer->content_sublayer, frame);
+}
+
+/*
+ * Get the line heights for a chunk, measuring it if we haven't
+ * had a look at it recently.
+ */
+static int16_t *_virtual_chunk_heights(MenuLayer *menu_layer, uint32_t chunk)
+{
+    MenuVirtualIndex *vi = menu_layer->virtual_index;
+
+    for (uint8_t i = 0; i < 2; i++)
+        if (vi->hot_chunk[i] == chunk)
+            return vi->hot_heights[i];
+
+    uint8_t slot = vi->hot_next;
+    vi->hot_next ^= 1;
+    vi->hot_chunk[slot] = chunk;
+
+    uint32_t first = chunk * MENU_VIRTUAL_CHUNK_LINES;
+    uint32_t count = MIN(MENU_VIRTUAL_CHUNK_LINES, vi->lines_count - first);
+    int32_t h = 0;
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        vi->hot_heights[slot][i] = _virtual_measure_line(menu_layer, first + i);
+        h += vi->hot_heights[slot][i];
+    }
+
+    MenuVirtualChunk *c = &vi->chunks[chunk];
+    int32_t delta = h - c->h;
+
+    if (delta)
+    {
+        int32_t y = _virtual_chunk_y(vi, chunk);
+
+        c->h = h;
+        vi->total_h += delta;
+        /* everything after it has moved, so work that out again when asked */
+        vi->chunks_placed = MIN(vi->chunks_placed, chunk + 1);
+
+        /* if it was all above the scroll layer's origin, keep what is on
+         * screen where it is */
+        if (y + c->h - delta <= vi->base_y)
+            vi->base_y += delta;
+
+        _virtual_update_content_size(menu_layer);
+    }
+
+    return vi->hot_heights[slot];
+}
+
+static int32_t _virtual_line_y(MenuLayer *menu_layer, uint32_t line, int16_t *h)
+{
+    MenuVirtualIndex *vi = menu_layer->virtual_index;
+    uint32_t chunk = line / MENU_VIRTUAL_CHUNK_LINES;
+    int16_t *heights = _virtual_chunk_heights(menu_layer, chunk);
+    int32_t y = _virtual_chunk_y(vi, chunk);
+
+    for (uint32_t i = 0; i < line % MENU_VIRTUAL_CHUNK_LINES; i++)
+        y += heights[i];
+
+    *h = heights[line % MENU_VIRTUAL_CHUNK_LINES];
+    return y;
+}
+
+/*
+ * Find the chunk covering content position y. Among the chunks placed, a
+ * binary search. Past them, place more until we get there
+ */
+static uint32_t _virtual_chunk_from_y(MenuVirtualIndex *vi, int32_t y)
+{
+    uint32_t lo = 0;
+    uint32_t hi = vi->chunks_placed - 1;
+    MenuVirtualChunk *last = &vi->chunks[hi];
+
+    if (y >= last->y + last->h)
+    {
+        for (hi++; hi < vi->chunks_count; hi++)
+            if (_virtual_chunk_y(vi, hi) > y)
+                break;
+        return hi - 1;
+    }
+
+    while (lo < hi)
+    {
+        uint32_t mid = (lo + hi + 1) / 2;
+        if (vi->chunks[mid].y <= y)
+            lo = mid;
+        else
+            hi = mid - 1;
+    }
+
+    return lo;
+}
+
+/* Find the line covering content position y */
+static uint32_t _virtual_line_from_y(MenuLayer *menu_layer, int32_t y)
+{
+    MenuVirtualIndex *vi = menu_layer->virtual_index;
+    uint32_t lo = _virtual_chunk_from_y(vi, y);
+
+    int16_t *heights = _virtual_chunk_heights(menu_layer, lo);
+    /* measuring can change where its lines fall, that's ok, we just land nearby */
+    int32_t line_y = _virtual_chunk_y(vi, lo);
+    uint32_t line = lo * MENU_VIRTUAL_CHUNK_LINES;
+    uint32_t last = MIN(line + MENU_VIRTUAL_CHUNK_LINES, vi->lines_count) - 1;
+
+    while (line < last && line_y + heights[line % MENU_VIRTUAL_CHUNK_LINES] <= y)
+    {
+        line_y += heights[line % MENU_VIRTUAL_CHUNK_LINES];
+        line++;
+    }
+
+    return line;
+}
+
+static uint32_t _virtual_index_to_line(const MenuLayer *menu_layer, const MenuIndex *index)
+{
+    const MenuVirtualIndex *vi = menu_layer->virtual_index;
+    const MenuVirtualSection *section = &vi->sections[MIN(index->section, vi->sections_count - 1)];
+
+    return section->first_line + (_virtual_has_headers(menu_layer) ? 1 : 0)
+                + index->row / menu_layer->column_count;
+}
+
+static int16_t _virtual_cell_x(const MenuLayer *menu_layer, uint16_t column)
+{
+    uint16_t cell_width = menu_layer->layer.frame.size.w / menu_layer->column_count;
+    uint16_t oversized_columns = menu_layer->layer.frame.size.w % menu_layer->column_count;
+
+    return column * cell_width + (column > 0 && column < oversized_columns);
+}
+
+/*
+ * Move the scroll layer's origin to base_y, shifting the content offset
+ * so nothing moves on screen.
+ */
+static void _virtual_rebase(MenuLayer *menu_layer, int32_t base_y)
+{
+    MenuVirtualIndex *vi = menu_layer->virtual_index;
+    ScrollLayer *scroll_layer = &menu_layer->scroll_layer;
+    int32_t delta = base_y - vi->base_y;
+
+    vi->base_y = base_y;
+
+    GRect frame = layer_get_frame(&scroll_layer->content_sublayer);
+    frame.origin.y = CLAMP(frame.origin.y + delta, INT16_MIN, INT16_MAX);
+    scroll_layer->scroll_offset.origin.y = CLAMP(scroll_layer->scroll_offset.origin.y + delta, INT16_MIN, INT16_MAX);
+    scroll_layer->prev_scroll_offset.origin.y = CLAMP(scroll_layer->prev_scroll_offset.origin.y + delta, INT16_MIN, INT16_MAX);
+    layer_set_frame(&scroll_layer->content_sublayer, frame);
+
+    _virtual_update_content_size(menu_layer);
+    // the content moved, but what is on screen didn't, don't shift it
+    layer_mark_dirty(&menu_layer->layer);
+}
+
+static MenuCellSpan *_virtual_get_cell_span(MenuLayer *menu_layer, const MenuIndex *index)
+{
+    MenuVirtualIndex *vi = menu_layer->virtual_index;
+
+    if (vi->lines_count == 0 || index->section >= vi->sections_count ||
+        index->row >= vi->sections[index->section].num_rows)
+        return NULL;
+
+    int16_t h;
+    uint32_t line = _virtual_index_to_line(menu_layer, index);
+    int32_t y = _virtual_line_y(menu_layer, line, &h);
+
+    /* keep the selection within reach of the scroll layer's 16 bits */
+    if (y < vi->base_y || y - vi->base_y > MENU_VIRTUAL_REBASE_LIMIT)
+        _virtual_rebase(menu_layer, MAX(0, y - MENU_VIRTUAL_REBASE_LIMIT / 2));
+
+    vi->span = MenuRow(index->section, index->row,
+                       _virtual_cell_x(menu_layer, index->row % menu_layer->column_count),
+                       y - vi->base_y, h);
+    return &vi->span;
+}
+
+static void _virtual_reload(MenuLayer *menu_layer)
+{
+    MenuVirtualIndex *vi = menu_layer->virtual_index;
+    bool headers = _virtual_has_headers(menu_layer);
+
+    int16_t sections = 1;
+    if (menu_layer->callbacks.get_num_sections)
+        sections = menu_layer->callbacks.get_num_sections(menu_layer, menu_layer->context);
+
+    if (vi->sections_count != sections)
+    {
+        if (vi->sections)
+            app_free(vi->sections);
+        vi->sections = app_calloc(sections, sizeof(MenuVirtualSection));
+        vi->sections_count = vi->sections ? sections : 0;
+    }
+
+    uint32_t lines = 0;
+    for (uint16_t section = 0; section < vi->sections_count; ++section)
+    {
+        MenuVirtualSection *s = &vi->sections[section];
+        s->num_rows = get_num_rows(menu_layer, section);
+        s->header_height = headers
+            ? menu_layer->callbacks.get_header_height(menu_layer, section, menu_layer->context)
+            : 0;
+        s->first_line = lines;
+        lines += (headers ? 1 : 0) + (s->num_rows + menu_layer->column_count - 1) / menu_layer->column_count;
+    }
+
+    uint16_t last_section = (uint16_t) (vi->sections_count - 1);
+    menu_layer->end_index = MenuIndex(last_section, vi->sections_count ? vi->sections[last_section].num_rows : 0);
+
+    uint32_t chunks = (lines + MENU_VIRTUAL_CHUNK_LINES - 1) / MENU_VIRTUAL_CHUNK_LINES;
+    if (vi->chunks_count != chunks)
+    {
+        if (vi->chunks)
+            app_free(vi->chunks);
+        vi->chunks = chunks ? app_calloc(chunks, sizeof(MenuVirtualChunk)) : NULL;
+        if (!vi->chunks)
+            chunks = lines = 0;
+    }
+    vi->chunks_count = chunks;
+    vi->lines_count = lines;
+    vi->hot_chunk[0] = vi->hot_chunk[1] = MENU_VIRTUAL_NO_CHUNK;
+
+    /* guess at everything. The first real row is as good a guess as any */
+    vi->line_estimate = MENU_CELL_BASIC_CELL_HEIGHT;
+    if (lines > (headers ? 1 : 0))
+        vi->line_estimate = _virtual_measure_line(menu_layer, headers ? 1 : 0);
+
+    vi->total_h = 0;
+    for (uint32_t chunk = 0; chunk < chunks; chunk++)
+    {
+        uint32_t count = MIN(MENU_VIRTUAL_CHUNK_LINES, lines - chunk * MENU_VIRTUAL_CHUNK_LINES);
+        vi->chunks[chunk].h = count * vi->line_estimate;
+        vi->total_h += vi->chunks[chunk].h;
+    }
+    /* the first one starts at the top, the rest are placed as we need them */
+    if (chunks)
+        vi->chunks[0].y = 0;
+    vi->chunks_placed = chunks ? 1 : 0;
+
+    vi->base_y = CLAMP(vi->base_y, 0, vi->total_h);
+    _virtual_update_content_size(menu_layer);
+    _menu_layer_update_scroll_offset(menu_layer, MenuRowAlignCenter, false);
+    layer_mark_dirty(&menu_layer->layer);
+}
+
+/*
+ * Draw the lines that touch the redraw rect, and no others.
+ */
+static void _virtual_draw(MenuLayer *menu_layer, Layer *layer, GContext *nGContext,
+                          GRect redraw, uint16_t cell_width)
+{
+    MenuVirtualIndex *vi = menu_layer->virtual_index;
+    GRect frame = layer_get_frame(layer);
+
+    if (vi->lines_count == 0)
+        return;
+
+    int32_t top = vi->base_y + redraw.origin.y;
+    int32_t bottom = top + redraw.size.h;
+
+    uint32_t line = _virtual_line_from_y(menu_layer, top);
+    line = line > MENU_VIRTUAL_MARGIN_LINES ? line - MENU_VIRTUAL_MARGIN_LINES : 0;
+
+    uint32_t past_bottom = 0;
+    for (; line < vi->lines_count; line++)
+    {
+        int16_t h;
+        int32_t y = _virtual_line_y(menu_layer, line, &h);
+
+        if (y >= bottom && past_bottom++ == MENU_VIRTUAL_MARGIN_LINES)
+            break;
+
+        int16_t rel_y = CLAMP(y - vi->base_y, INT16_MIN, INT16_MAX);
+        bool header;
+        uint16_t row;
+        uint16_t section = _virtual_line_content(menu_layer, line, &header, &row);
+
+        if (header)
+        {
+            MenuCellSpan span = MenuHeader(section, 0, rel_y, h);
+            _menu_layer_draw_span(menu_layer, layer, nGContext, &span, frame.size.w);
+            continue;
+        }
+
+        for (uint16_t col = 0; col < menu_layer->column_count && row + col < vi->sections[section].num_rows; col++)
+        {
+            MenuCellSpan span = MenuRow(section, row + col, _virtual_cell_x(menu_layer, col), rel_y, h);
+            _menu_layer_draw_span(menu_layer, layer, nGContext, &span, cell_width);
+        }
+    }
 }
 
 void menu_cell_basic_draw(GContext *ctx, const Layer *layer, const char *title,
@@ -43,6 +43,7 @@ typedef struct MenuCellSpan
 } MenuCellSpan;
 
 struct MenuLayer;
+struct MenuVirtualIndex;
 
 typedef uint16_t (*MenuLayerGetNumberOfSectionsCallback)(struct MenuLayer *menu_layer, void *context);
 
@@ -110,6 +111,7 @@ typedef struct MenuLayer
   uint16_t column_count;
   size_t cells_count;
   MenuCellSpan *cells;
+  struct MenuVirtualIndex *virtual_index; // replaces cells when virtualised
   MenuIndex selected;
   MenuIndex end_index;
 
@@ -187,6 +189,14 @@ void menu_layer_set_column_count(MenuLayer *menu_layer, uint16_t num_columns);
 //! @see MenuLayerReloadBehaviour
 void menu_layer_set_reload_behaviour(MenuLayer *menu_layer, MenuLayerReloadBehaviour behaviour);
 
+//! Switches the \ref MenuLayer between laying out every cell on reload and a
+//! virtualised mode for large data sets. When virtualised, a reload only asks
+//! for the row count of each section. Cell heights are measured lazily in
+//! chunks as they come near the screen, and only visible cells are drawn.
+//! @param menu_layer Pointer to the \ref MenuLayer to change.
+//! @param virtualised true to use the virtualised mode.
+void menu_layer_set_virtualised(MenuLayer *menu_layer, bool virtualised);
+
 #ifdef PBL_RECT
 #define MENU_DEFAULT_TEXT_ALIGNMENT GTextAlignmentLeft
 #else
@@ -203,3 +213,6 @@ void menu_layer_set_reload_behaviour(MenuLayer *menu_layer, MenuLayerReloadBehav
 #define MENU_CELL_ROUND_UNFOCUSED_TALL_CELL_HEIGHT ((const int16_t) 32)
 #define MENU_BOTTOM_PADDING ((const int16_t) 20)
 #define MENU_CELL_PADDING ((const int16_t) 5)
+
+// lines (a header, or a row of cells) measured at once in a virtualised menu
+#define MENU_VIRTUAL_CHUNK_LINES 32
@@ -22,6 +22,7 @@ static void notification_layer_ctor(NotificationLayer *notification_layer, GRect
 {
     layer_ctor(&notification_layer->layer, frame);
     list_init_head(&notification_layer->notif_list_head);
+    text_layout_cache_ctor(&notification_layer->body_layout);
     layer_set_update_proc(&notification_layer->layer, _notification_layer_update_proc);
     SYS_LOG("noty", APP_LOG_LEVEL_ERROR, "N CTOR");
 }
@@ -41,6 +42,7 @@ static void notification_layer_dtor(NotificationLayer *notification_layer)
         break;
     }
 
+    text_layout_cache_dtor(&notification_layer->body_layout);
     layer_remove_from_parent(&notification_layer->status_bar.layer);
     status_bar_layer_dtor(&notification_layer->status_bar);
     layer_dtor(&notification_layer->layer);
@@ -389,8 +391,8 @@ static void _notification_layer_update_proc(Layer *layer, GContext *ctx)
     ctx->text_color = GColorBlack;
     graphics_draw_text(ctx, title, fonts_get_system_font(FONT_KEY_GOTHIC_18_BOLD), title_rect, GTextOverflowModeTrailingEllipsis, alignment, 0);
     
-    // Draw the body:
-    graphics_draw_text(ctx, body, fonts_get_system_font(FONT_KEY_GOTHIC_24), body_rect, GTextOverflowModeTrailingEllipsis, GTextAlignmentLeft, 0);
+    // Draw the body, it only needs wrapping again when the notification changes:
+    text_layout_cache_draw(ctx, &notification_layer->body_layout, body, fonts_get_system_font(FONT_KEY_GOTHIC_24), body_rect, GTextOverflowModeTrailingEllipsis, GTextAlignmentLeft, 0);
     
     // Draw the indicator:
     graphics_context_set_fill_color(ctx, GColorBlack);
@@ -43,6 +43,7 @@ typedef struct NotificationLayer
     PropertyAnimation prop_anim;
     NotificationAction *actions;
     Notification *active;
+    GTextLayoutCache body_layout;
     
     uint8_t notif_count;
     uint8_t selected_notif;
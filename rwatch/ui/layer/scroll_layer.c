@@ -9,32 +9,49 @@
 #include "scroll_layer.h"
 #include "utils.h"
 #include "property_animation.h"
+#include "overlay_manager.h"
+#include "appmanager.h"
 
 #define BUTTON_REPEAT_INTERVAL_MS 600
 #define CLICK_SCROLL_AMOUNT 16
 #define ANIMATE_ON_CLICK true
 
+static void _scroll_layer_update_proc(Layer *layer, GContext *ctx);
+static void _scroll_layer_shadow_update_proc(Layer *layer, GContext *ctx);
+
 void scroll_layer_ctor(ScrollLayer* slayer, GRect frame)
 {
     layer_ctor(&slayer->layer, frame);
     layer_ctor(&slayer->content_sublayer, frame);
+    layer_ctor(&slayer->shadow_sublayer, GRect(0, 0, frame.size.w, frame.size.h));
 
     // give the layer a reference back to us
     slayer->layer.container = slayer;
+    slayer->shadow_sublayer.container = slayer;
     slayer->context = slayer;
 
+    layer_set_update_proc(&slayer->layer, _scroll_layer_update_proc);
+    layer_set_update_proc(&slayer->shadow_sublayer, _scroll_layer_shadow_update_proc);
+
     layer_add_child(&slayer->layer, &slayer->content_sublayer);
+    layer_add_child(&slayer->layer, &slayer->shadow_sublayer);
 }
 
 void scroll_layer_dtor(ScrollLayer* slayer)
 {
+    app_running_thread *thread = appmanager_get_current_thread();
+
+    if (thread->fb_scroll_layer == slayer)
+        thread->fb_scroll_layer = NULL;
+
     layer_dtor(&slayer->layer);
     layer_dtor(&slayer->content_sublayer);
+    layer_dtor(&slayer->shadow_sublayer);
 }
 
 ScrollLayer *scroll_layer_create(GRect frame)
 {
-    ScrollLayer* slayer = app_calloc(1, sizeof(ScrollLayer));
+    ScrollLayer* slayer = app_pool_calloc(ObjectPoolScrollLayer, sizeof(ScrollLayer));
     scroll_layer_ctor(slayer, frame);
 
     return slayer;
@@ -142,15 +159,265 @@ GSize scroll_layer_get_content_size(const ScrollLayer *scroll_layer)
     return bounds.size;
 }
 
+GRect scroll_layer_get_redraw_rect(const ScrollLayer *scroll_layer)
+{
+    GPoint offset = layer_get_frame(&scroll_layer->content_sublayer).origin;
+    GRect rect = scroll_layer->fb_shifted
+        ? scroll_layer->fb_strip
+        : GRect(0, 0, scroll_layer->layer.frame.size.w, scroll_layer->layer.frame.size.h);
+
+    rect.origin.x -= offset.x;
+    rect.origin.y -= offset.y;
+    return rect;
+}
+
 void scroll_layer_set_frame(ScrollLayer *scroll_layer, GRect frame)
 {
     layer_set_frame(&scroll_layer->layer, frame);
+    layer_set_frame(&scroll_layer->shadow_sublayer, GRect(0, 0, frame.size.w, frame.size.h));
 
     // clamp content offset to new size
     GPoint offset = layer_get_frame(&scroll_layer->content_sublayer).origin;
     scroll_layer_set_content_offset(scroll_layer, offset, false);
 }
 
+/*
+ * Framebuffer shift scrolling.
+ * While a scroll animation runs, all that changes from one frame to the
+ * next is the content offset, and last frame's pixels are still sitting
+ * in the framebuffer. So before the window paints its background it asks
+ * us to slide those rows by the scroll delta, and to tell it which part of
+ * the screen to leave alone. Then only the strip the shift exposed needs
+ * painting: content children clear of it are skipped for the frame, and
+ * content that draws everything itself (MenuLayer) can ask
+ * scroll_layer_get_redraw_rect() where to paint.
+ *
+ * We only try this when we are sure the pixels are ours. One scroll layer
+ * at a time gets armed at the end of a frame it drew, and disarms if the
+ * content was marked dirty, it moved or got covered, or an overlay has
+ * been drawn over the top of the app.
+ */
+static bool _scroll_layer_rects_overlap(GRect a, GRect b)
+{
+    return a.origin.x < b.origin.x + b.size.w && b.origin.x < a.origin.x + a.size.w &&
+           a.origin.y < b.origin.y + b.size.h && b.origin.y < a.origin.y + a.size.h;
+}
+
+static Layer *_scroll_layer_get_root(ScrollLayer *slayer)
+{
+    Layer *layer = &slayer->layer;
+    while (layer->parent)
+        layer = layer->parent;
+    return layer;
+}
+
+/* Work out where the layer will land on screen, if it is drawn at all */
+static bool _scroll_layer_screen_rect(ScrollLayer *slayer, Window *window, GRect *rect)
+{
+    Layer *layer = &slayer->layer;
+    GPoint origin = window->frame.origin;
+
+    for (;;)
+    {
+        if (layer->hidden)
+            return false;
+        origin.x += layer->frame.origin.x;
+        origin.y += layer->frame.origin.y;
+        if (!layer->parent)
+            break;
+        layer = layer->parent;
+    }
+
+    if (layer != window->root_layer)
+        return false;
+
+    *rect = GRect(origin.x, origin.y, slayer->layer.frame.size.w, slayer->layer.frame.size.h);
+    return true;
+}
+
+/* Does any other layer in the window paint inside rect? */
+static bool _scroll_layer_is_covered(ScrollLayer *slayer, Window *window, GRect rect)
+{
+    Layer *layer = window->root_layer;
+    GPoint origin = window->frame.origin; // of the layer's parent
+
+    while (layer)
+    {
+        if (layer != &slayer->layer && !layer->hidden)
+        {
+            GRect frame = GRect(origin.x + layer->frame.origin.x, origin.y + layer->frame.origin.y,
+                                layer->frame.size.w, layer->frame.size.h);
+
+            if (layer->update_proc && _scroll_layer_rects_overlap(frame, rect))
+                return true;
+
+            if (layer->child)
+            {
+                origin = frame.origin;
+                layer = layer->child;
+                continue;
+            }
+        }
+
+        while (layer && !layer->sibling)
+        {
+            layer = layer->parent;
+            if (layer)
+            {
+                origin.x -= layer->frame.origin.x;
+                origin.y -= layer->frame.origin.y;
+            }
+        }
+
+        if (layer)
+            layer = layer->sibling;
+    }
+
+    return false;
+}
+
+/* Has the content changed since we were armed? */
+static bool _scroll_layer_content_is_valid(ScrollLayer *slayer)
+{
+    uint16_t count = 0;
+
+    for (Layer *child = slayer->content_sublayer.child; child; child = child->sibling)
+    {
+        if (child->dirty || child->hidden)
+            return false;
+        count++;
+    }
+
+    return count == slayer->fb_children;
+}
+
+/*
+ * Move rect's rows by dy. Rows are whole framebuffer lines when we are
+ * full width, which makes it a single memmove.
+ */
+static void _scroll_layer_shift_rows(GRect rect, int16_t dy)
+{
+    uint8_t *fb = display_get_buffer();
+    int16_t rows = rect.size.h - abs(dy);
+    int16_t src_y = rect.origin.y + (dy < 0 ? -dy : 0);
+    int16_t dst_y = rect.origin.y + (dy > 0 ? dy : 0);
+
+    if (rect.origin.x == 0 && rect.size.w == DISPLAY_COLS)
+    {
+        memmove(&fb[dst_y * DISPLAY_COLS], &fb[src_y * DISPLAY_COLS], rows * DISPLAY_COLS);
+        return;
+    }
+
+    /* copy away from the direction of travel so we don't eat our own rows */
+    for (int16_t i = 0; i < rows; i++)
+    {
+        int16_t row = dy > 0 ? rows - 1 - i : i;
+        memcpy(&fb[(dst_y + row) * DISPLAY_COLS + rect.origin.x],
+               &fb[(src_y + row) * DISPLAY_COLS + rect.origin.x],
+               rect.size.w);
+    }
+}
+
+GRect scroll_layer_shift_framebuffer(Window *window)
+{
+    /* overlays are painted over the app's pixels, not kept */
+    if (!window || window->is_overlay)
+        return GRect(0, 0, 0, 0);
+
+    /* the app's scroll layer whose last frame can be shifted into this one */
+    app_running_thread *thread = appmanager_get_current_thread();
+    ScrollLayer *slayer = thread->fb_scroll_layer;
+    thread->fb_scroll_layer = NULL;
+
+    if (!slayer)
+        return GRect(0, 0, 0, 0);
+
+    GRect rect;
+    GPoint offset = layer_get_frame(&slayer->content_sublayer).origin;
+    int16_t dy = offset.y - slayer->fb_offset.y;
+
+    if (slayer->fb_shift_disabled ||
+        dy == 0 || abs(dy) >= slayer->fb_rect.size.h ||
+        offset.x != slayer->fb_offset.x ||
+        overlay_window_count() > 0 ||
+        !_scroll_layer_content_is_valid(slayer) ||
+        !_scroll_layer_screen_rect(slayer, window, &rect) ||
+        !RECT_EQ(rect, slayer->fb_rect) ||
+        _scroll_layer_is_covered(slayer, window, rect))
+        return GRect(0, 0, 0, 0);
+
+    _scroll_layer_shift_rows(rect, dy);
+
+    slayer->fb_shifted = true;
+    slayer->fb_strip = dy > 0
+        ? GRect(0, 0, rect.size.w, dy)
+        : GRect(0, rect.size.h + dy, rect.size.w, -dy);
+
+    /* what we kept, the window paints the rest */
+    if (dy > 0)
+        return GRect(rect.origin.x, rect.origin.y + dy, rect.size.w, rect.size.h - dy);
+    return GRect(rect.origin.x, rect.origin.y, rect.size.w, rect.size.h + dy);
+}
+
+/*
+ * Drawn before the content. On a shifted frame, skip the content
+ * children that are nowhere near the exposed strip.
+ */
+static void _scroll_layer_update_proc(Layer *layer, GContext *ctx)
+{
+    ScrollLayer *slayer = (ScrollLayer *)layer->container;
+
+    if (!slayer->fb_shifted)
+        return;
+
+    GRect strip = scroll_layer_get_redraw_rect(slayer);
+    for (Layer *child = slayer->content_sublayer.child; child; child = child->sibling)
+        child->skip_draw = !_scroll_layer_rects_overlap(child->frame, strip);
+}
+
+/*
+ * Drawn after the content. Put the skipped children back, and if this
+ * frame is one we can shift next time, arm ourselves.
+ */
+static void _scroll_layer_shadow_update_proc(Layer *layer, GContext *ctx)
+{
+    ScrollLayer *slayer = (ScrollLayer *)layer->container;
+
+    if (slayer->fb_shifted)
+    {
+        for (Layer *child = slayer->content_sublayer.child; child; child = child->sibling)
+            child->skip_draw = false;
+        slayer->fb_shifted = false;
+    }
+
+#ifndef PBL_BW
+    /* XXX: PBL_BW framebuffer is packed 1bpp, rows don't shift as bytes */
+    Window *window = _scroll_layer_get_root(slayer)->window;
+    GRect rect = GRect(ctx->offset.origin.x, ctx->offset.origin.y,
+                       slayer->layer.frame.size.w, slayer->layer.frame.size.h);
+
+    if (slayer->fb_shift_disabled || !window || window->is_overlay ||
+        overlay_window_count() > 0 ||
+        rect.origin.x < 0 || rect.origin.y < 0 ||
+        rect.size.w <= 0 || rect.size.h <= 0 ||
+        rect.origin.x + rect.size.w > DISPLAY_COLS ||
+        rect.origin.y + rect.size.h > DISPLAY_ROWS)
+        return;
+
+    /* children get marked dirty when they change */
+    slayer->fb_children = 0;
+    for (Layer *child = slayer->content_sublayer.child; child; child = child->sibling)
+    {
+        child->dirty = false;
+        slayer->fb_children++;
+    }
+
+    slayer->fb_rect = rect;
+    slayer->fb_offset = layer_get_frame(&slayer->content_sublayer).origin;
+    appmanager_get_current_thread()->fb_scroll_layer = slayer;
+#endif
+}
+
 void scroll_layer_scroll_up_click_handler(ClickRecognizerRef recognizer, void *context)
 {
 }
@@ -26,12 +26,19 @@ typedef struct ScrollLayer
 {
     Layer layer;
     Layer content_sublayer;
-//     Layer shadow_sublayer;
+    Layer shadow_sublayer; // drawn over the content, finishes off each frame
     PropertyAnimation *animation;
     GRect prev_scroll_offset;
     GRect scroll_offset;
     ScrollLayerCallbacks callbacks;
     void *context;
+    /* framebuffer shift scrolling, see scroll_layer.c */
+    GRect fb_rect; // where on screen we were drawn last frame
+    GPoint fb_offset; // content offset we were drawn at last frame
+    GRect fb_strip; // part of the layer exposed by this frame's shift
+    uint16_t fb_children;
+    bool fb_shifted;
+    bool fb_shift_disabled; // content that can't be shifted, e.g. a fixed highlight
 } ScrollLayer;
 
 void scroll_layer_ctor(ScrollLayer* slayer, GRect frame);
@@ -49,6 +56,10 @@ void scroll_layer_set_content_offset(ScrollLayer *scroll_layer, GPoint offset, b
 GPoint scroll_layer_get_content_offset(ScrollLayer *scroll_layer);
 void scroll_layer_set_content_size(ScrollLayer *scroll_layer, GSize size);
 GSize scroll_layer_get_content_size(const ScrollLayer *scroll_layer);
+// the part of the content that needs painting this frame, in content coordinates
+GRect scroll_layer_get_redraw_rect(const ScrollLayer *scroll_layer);
+// called by the window before it paints, returns the screen rect it should leave alone
+GRect scroll_layer_shift_framebuffer(struct Window *window);
 void scroll_layer_set_frame(ScrollLayer *scroll_layer, GRect frame);
 void scroll_layer_scroll_up_click_handler(ClickRecognizerRef recognizer, void *context);
 void scroll_layer_scroll_down_click_handler(ClickRecognizerRef recognizer, void *context);
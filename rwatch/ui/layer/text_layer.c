@@ -19,6 +19,7 @@ void text_layer_ctor(TextLayer *tlayer, GRect frame)
     tlayer->background_color = GColorWhite;
     tlayer->text_alignment = GTextAlignmentLeft;
     tlayer->font = fonts_get_system_font(FONT_KEY_GOTHIC_14_BOLD);
+    tlayer->layout_cache = NULL;
 
     // hook the draw callback to us
     // this way we control the text, bound, pagination etc
@@ -27,13 +28,15 @@ void text_layer_ctor(TextLayer *tlayer, GRect frame)
 
 void text_layer_dtor(TextLayer *tlayer)
 {
+    text_layout_cache_destroy(tlayer->layout_cache);
+    tlayer->layout_cache = NULL;
     layer_dtor(&tlayer->layer);
 }
 
 // Layer Functions
 TextLayer *text_layer_create(GRect frame)
 {
-    TextLayer* tlayer = app_calloc(1, sizeof(TextLayer));
+    TextLayer* tlayer = app_pool_calloc(ObjectPoolTextLayer, sizeof(TextLayer));
     text_layer_ctor(tlayer, frame);
     
     return tlayer;
@@ -53,6 +56,8 @@ Layer *text_layer_get_layer(TextLayer *text_layer)
 void text_layer_set_text(TextLayer *text_layer, const char* text)
 {
     text_layer->text = text;
+    /* it may be the same buffer, written over with something as long */
+    text_layout_cache_invalidate(text_layer->layout_cache);
     layer_mark_dirty(&text_layer->layer);
 }
 
@@ -93,7 +98,12 @@ void text_layer_set_text_alignment(TextLayer *text_layer, GTextAlignment text_al
 
 GSize text_layer_get_content_size(TextLayer *text_layer)
 {
-    return text_layer->layer.bounds.size;
+    if (!text_layer->layout_cache)
+        text_layer->layout_cache = text_layout_cache_create();
+
+    GRect bounds = GRect(0, 0, text_layer->layer.frame.size.w, text_layer->layer.frame.size.h);
+    return text_layout_cache_get_content_size(text_layer->layout_cache, text_layer->text,
+                                              text_layer->font, bounds, text_layer->overflow_mode);
 }
 
 void text_layer_set_size(TextLayer *text_layer, const GSize max_size)
@@ -121,9 +131,13 @@ void text_layer_draw(struct Layer *layer, GContext *context)
     GRect bounds = GRect(0, 0, layer->frame.size.w, layer->frame.size.h);
     graphics_fill_rect(context, bounds, 0, GCornerNone);
 
-    graphics_draw_text(context, tlayer->text, tlayer->font,
-                       bounds, tlayer->overflow_mode,
-                       tlayer->text_alignment, &tlayer->text_attributes);
+    /* the line breaks are kept until the text, font or size change */
+    if (!tlayer->layout_cache)
+        tlayer->layout_cache = text_layout_cache_create();
+
+    text_layout_cache_draw(context, tlayer->layout_cache, tlayer->text, tlayer->font,
+                           bounds, tlayer->overflow_mode,
+                           tlayer->text_alignment, &tlayer->text_attributes);
 }
 
 // TODO paging...
@@ -13,13 +13,12 @@ typedef struct TextLayer
     Layer layer;
     const char *text;
     GFont font;
-//     GTextLayoutCacheRef layout_cache;
+    GTextLayoutCacheRef layout_cache;
     GColor text_color;
     GColor background_color;
     GTextOverflowMode overflow_mode;
     GTextAlignment text_alignment;
     GTextAttributes text_attributes;
-//     bool should_cache_layout;
 } TextLayer;
 
 void text_layer_dtor(TextLayer *tlayer);
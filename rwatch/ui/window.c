@@ -12,16 +12,26 @@
 #include "animation.h"
 #include "overlay_manager.h"
 #include "notification_manager.h"
+#include "utils.h"
 
 static list_head _window_list_head = LIST_HEAD(_window_list_head);
 
 static void _window_load_proc(Window *window);
 
 static bool _anim_direction_left = true;
-static void _animation_util_push_fb(GRect rect, int16_t distance);
+static void _animation_util_push_fb(int16_t distance);
 static void _animation_setup(bool direction_left);
 static void _push_animation_update(Animation *animation,
                                   const AnimationProgress progress);
+static GRect _window_push_framebuffer(Window *window);
+
+/* The window sliding in, and the x it was at when last painted. While it
+ * slides, the framebuffer is shoved along by however far it moved, and
+ * only the columns that uncovers are painted */
+static Animation *_push_animation;
+static Window *_push_window;
+static int16_t _push_drawn_x;
+static bool _push_drawn;
 
 
 /*
@@ -73,32 +83,28 @@ static void _push_animation_update(Animation *animation,
                                   const AnimationProgress progress)
 {
     Window *window = window_stack_get_top_window(); 
-    int existx = window->frame.origin.x; 
-    int newx, delta; 
-     
+
+    if (!window)
+        return;
+
+    /* Only move the window here. The pixels are pushed when it is painted,
+     * as that is when we hold the display */
     if (*((bool*)animation->context) == true) 
-    { 
-        newx = ANIM_LERP(DISPLAY_COLS, 0, progress) - 1; 
-        delta = (existx - newx);
-        if (delta && existx > 0)
-        {
-            _animation_util_push_fb(GRect(delta, 0, DISPLAY_COLS - delta, DISPLAY_ROWS), -delta);
-        }
-    } 
+        window->frame.origin.x = ANIM_LERP(DISPLAY_COLS, 0, progress);
     else 
-    {
-        newx = ANIM_LERP(-DISPLAY_COLS, 0, progress);
-        delta = newx - existx;
-        if (delta && existx < 0)
-            _animation_util_push_fb(GRect(DISPLAY_COLS + existx + 1, 0, DISPLAY_COLS - delta + 1, DISPLAY_ROWS), delta);
-    } 
+        window->frame.origin.x = ANIM_LERP(-DISPLAY_COLS, 0, progress);
 
-    window->frame.origin.x = newx; 
     window_dirty(true); 
 }
 
 static void _push_animation_teardown(Animation *animation) {
     SYS_LOG("window", APP_LOG_LEVEL_INFO, "Animation finished!");
+    if (_push_window)
+        _push_window->frame.origin.x = 0;
+    _push_animation = NULL;
+    _push_window = NULL;
+    /* one last full paint for anything that changed outside the strips */
+    window_dirty(true);
     animation_destroy(animation);
 }
 
@@ -155,6 +161,13 @@ void window_stack_push_configure(Window *window, bool animated)
 
 static void _animation_setup(bool direction_left)
 {
+    /* a new push takes over from one still sliding */
+    if (_push_animation)
+        animation_unschedule(_push_animation);
+
+    _push_window = window_stack_get_top_window();
+    _push_drawn = false;
+
     // Animate the window change
     Animation *animation = animation_create();
     animation_set_duration(animation, 1200);
@@ -168,6 +181,7 @@ static void _animation_setup(bool direction_left)
  
     _anim_direction_left = direction_left;
     animation->context = (void*)&_anim_direction_left;
+    _push_animation = animation;
     
     // Play the animation
     animation_schedule(animation);
@@ -216,6 +230,12 @@ bool window_stack_remove(Window *window, bool animated)
     if (top_window == window) {
         top_window = list_elem(list_get_head(lh), Window, node);
         if (top_window) {
+            if (animated)
+            {
+                /* the one underneath slides back in from the left */
+                top_window->frame.origin.x = -DISPLAY_COLS;
+                _animation_setup(false);
+            }
             window_configure(top_window);
             window_dirty(true);
         }
@@ -232,6 +252,47 @@ Window *window_stack_get_top_window(void)
     return list_elem(list_get_head(&_window_list_head), Window, node);
 }
 
+/* Move a whole list of windows over to a new head, leaving the old one empty */
+static void _window_list_move(list_head *to, list_head *from)
+{
+    if (list_get_head(from) == NULL)
+    {
+        list_init_head(to);
+        return;
+    }
+
+    to->node = from->node;
+    to->node.next->prev = &to->node;
+    to->node.prev->next = &to->node;
+    list_init_head(from);
+}
+
+/*
+ * Take every window off the stack, and anything sliding in, to hand back
+ * with window_stack_resume(). Whatever runs in the meantime starts with
+ * an empty stack and can't touch the suspended app's animation.
+ */
+void window_stack_suspend(WindowStackState *state)
+{
+    _window_list_move(&state->windows, &_window_list_head);
+    state->push_animation = _push_animation;
+    state->push_window = _push_window;
+    _push_animation = NULL;
+    _push_window = NULL;
+}
+
+/*
+ * Put a suspended app's windows back. The framebuffer has moved on since,
+ * so a push in progress is painted in full next time
+ */
+void window_stack_resume(WindowStackState *state)
+{
+    _window_list_move(&_window_list_head, &state->windows);
+    _push_animation = state->push_animation;
+    _push_window = state->push_window;
+    _push_drawn = false;
+}
+
 uint16_t window_count(void)
 {
     uint16_t count = 0;
@@ -320,6 +381,9 @@ void window_destroy(Window *window)
 
 void window_dtor(Window* window)
 {
+    if (window == _push_window)
+        _push_window = NULL;
+
     // free all of the layers
     layer_destroy(window->root_layer);
     SYS_LOG("window", APP_LOG_LEVEL_INFO, "DTOR");
@@ -346,9 +410,81 @@ void window_dirty(bool is_dirty)
     if (!wind)
         return;
 
+    /* the overlay thread only touches overlays, so their renders are stale */
+    if (is_dirty && appmanager_get_thread_type() == AppThreadOverlay)
+        overlay_window_dirty();
+
     wind->is_render_scheduled = is_dirty;
 }
 
+/*
+ * Paint the window background, leaving the screen rect keep alone.
+ */
+static void _window_fill_background(GContext *context, GRect frame, GRect keep)
+{
+    if (keep.size.w <= 0 || keep.size.h <= 0)
+    {
+        graphics_fill_rect(context, GRect(0, 0, frame.size.w, frame.size.h), 0, GCornerNone);
+        return;
+    }
+
+    /* into window coordinates */
+    keep.origin.x -= frame.origin.x;
+    keep.origin.y -= frame.origin.y;
+
+    int16_t bottom = keep.origin.y + keep.size.h;
+    int16_t right = keep.origin.x + keep.size.w;
+
+    if (keep.origin.y > 0)
+        graphics_fill_rect(context, GRect(0, 0, frame.size.w, keep.origin.y), 0, GCornerNone);
+    if (bottom < frame.size.h)
+        graphics_fill_rect(context, GRect(0, bottom, frame.size.w, frame.size.h - bottom), 0, GCornerNone);
+    if (keep.origin.x > 0)
+        graphics_fill_rect(context, GRect(0, keep.origin.y, keep.origin.x, keep.size.h), 0, GCornerNone);
+    if (right < frame.size.w)
+        graphics_fill_rect(context, GRect(right, keep.origin.y, frame.size.w - right, keep.size.h), 0, GCornerNone);
+}
+
+/*
+ * If the window is sliding in, push the framebuffer along by however far
+ * it moved since it was last painted, dragging the old window's pixels
+ * (and what we have of the new one) with it.
+ * Returns the screen columns that uncovered, which are all that need
+ * painting, or an empty rect when the window needs painting in full.
+ * Must be called with the display buffer held.
+ */
+static GRect _window_push_framebuffer(Window *window)
+{
+    GRect strip = GRect(0, 0, 0, 0);
+#ifndef PBL_BW
+    if (window != _push_window)
+        return strip;
+
+    int16_t x = window->frame.origin.x;
+    int16_t distance = x - _push_drawn_x;
+    /* overlays paint over us every frame, we can't drag those along */
+    bool can_push = _push_drawn && distance != 0 &&
+                    distance > -DISPLAY_COLS && distance < DISPLAY_COLS &&
+                    overlay_window_count() == 0;
+
+    _push_drawn_x = x;
+    _push_drawn = true;
+
+    if (!can_push)
+        return strip;
+
+    _animation_util_push_fb(distance);
+
+    int16_t left = distance < 0 ? DISPLAY_COLS + distance : 0;
+    int16_t right = distance < 0 ? DISPLAY_COLS : distance;
+    left = MAX(left, x);
+    right = MIN(right, x + window->frame.size.w);
+    if (right > left)
+        strip = GRect(left, 0, right - left, DISPLAY_ROWS);
+#endif
+    return strip;
+}
+
 /* 
  * Draw a window.
  */
@@ -361,10 +497,24 @@ void rbl_window_draw(Window *window)
     GRect windowframe = window->frame; 
     frame.origin.y += windowframe.origin.y; 
     frame.origin.x += windowframe.origin.x; 
+
+    /* sliding in, only paint the strip that came into view */
+    GRect strip = _window_push_framebuffer(window);
+    if (strip.size.w > 0)
+    {
+        context->offset = frame;
+        context->fill_color = window->background_color;
+        graphics_fill_rect(context, GRect(strip.origin.x - frame.origin.x, 0, strip.size.w, frame.size.h), 0, GCornerNone);
+        layer_draw_columns(window->root_layer, context, strip.origin.x, strip.size.w);
+        return;
+    }
+
+    /* a scrolling layer may be able to reuse last frame's pixels */
+    GRect keep = scroll_layer_shift_framebuffer(window);
     /* Apply window offset too */
     context->offset = frame;
     context->fill_color = window->background_color;
-    graphics_fill_rect(context, GRect(0, 0, frame.size.w, frame.size.h), 0, GCornerNone);
+    _window_fill_background(context, frame, keep);
     layer_draw(window->root_layer, context);
 }
 
@@ -571,57 +721,24 @@ void window_load_click_config(Window *window)
 
 /* 
  * Grab the screenbuffer and push it off the screen left or right by n
- * pixels.
+ * pixels. The whole buffer goes in one move, so what falls off the end
+ * of one row wraps into the next, but only ever into the columns that
+ * were uncovered, which the caller repaints.
+ * Call with the display buffer held.
  */
-static void _animation_util_push_fb(GRect rect, int16_t distance)
+static void _animation_util_push_fb(int16_t distance)
 {
 #ifdef PBL_BW
 #  warning XXX: PBL_BW no push_fb support
     return;
 #else
-    /* To revisit at some later time.
-     * The issue I can't find time to fix is that pushfb happens
-     * while we are painting */
-    return;
-    
     uint8_t *fb = display_get_buffer();
-    if (!display_buffer_lock_take(0))
-        return;
-    
-    if (rect.origin.x < 0) rect.origin.x = 0;
-    if (rect.origin.x > DISPLAY_COLS) rect.origin.x = DISPLAY_COLS;
-    if (rect.origin.y < 0) rect.origin.y = 0;
-    if (rect.origin.y > DISPLAY_ROWS) rect.origin.y = DISPLAY_ROWS;
-    
-    uint8_t *origin = &fb[(rect.origin.y * DISPLAY_COLS) + rect.origin.x];
-    uint8_t *p;
-    int8_t incr = distance > 0 ? -1 : 1;
+    size_t len = (DISPLAY_ROWS * DISPLAY_COLS) - abs(distance);
 
-    for (int16_t y = 0; y < rect.size.h; y++)
-    {
-        uint16_t x = distance > 0 ? rect.size.w - 1 : 0;
-       
-        p = origin + (y * DISPLAY_COLS) + x;
-        
-        for (;;)
-        {      
-            *(p + distance) = *p;
-            
-            x += incr;
-            p += incr;
-            
-            if (distance < 0 && x >= rect.size.w)
-                break;
-            else if (distance > 0 && x <= 0)
-                break;
-            
-            if ((p + distance > origin + (DISPLAY_COLS * rect.size.h) + rect.size.w) ||
-                p > origin + DISPLAY_ROWS * DISPLAY_COLS)
-                continue;
-        }
-        
-    }
-    display_buffer_lock_give();
+    if (distance < 0)
+        memmove(fb, fb - distance, len);
+    else
+        memmove(fb + distance, fb, len);
 #endif
 }
 
@@ -55,6 +55,15 @@ typedef struct Window
     list_node node;
 } Window;
 
+/* The main window stack, and any push still sliding in, as put to one
+ * side while their app is suspended */
+typedef struct WindowStackState
+{
+    list_head windows;
+    struct Animation *push_animation;
+    Window *push_window;
+} WindowStackState;
+
 // Window management
 Window *window_create();
 void window_ctor(Window *window);
@@ -84,6 +93,8 @@ void window_stack_pop_all(const bool animated);
 bool window_stack_remove(Window *window, bool animated);
 bool window_stack_contains_window(Window *window);
 Window * window_stack_get_top_window(void);
+void window_stack_suspend(WindowStackState *state);
+void window_stack_resume(WindowStackState *state);
 
 void window_configure(Window *window);
 void window_dirty(bool is_dirty);